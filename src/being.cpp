@@ -22,6 +22,7 @@
 #include "being.h"
 
 #include "animatedsprite.h"
+#include "beingmanager.h"
 #include "configuration.h"
 #include "effectmanager.h"
 #include "game.h"
@@ -95,13 +96,15 @@ Being::Being(int id, int job, Map *map):
 #endif
     mPx(0), mPy(0),
     mX(0), mY(0),
+    mOccupiesTile(false),
+    mOccupiedX(0), mOccupiedY(0),
     mUsedTargetCursor(NULL)
 {
     setMap(map);
 
     mSpeechBubble = new SpeechBubble;
 
-    mNameColor = &guiPalette->getColor(Palette::NPC);
+    mNameColor = Palette::NPC;
     mTextColor = &guiPalette->getColor(Palette::CHAT);
 }
 
@@ -122,8 +125,12 @@ Being::~Being()
 
 void Being::setPosition(const Vector &pos)
 {
+    const Vector oldPos = mPos;
     mPos = pos;
 
+    if (beingManager)
+        beingManager->beingMoved(this, oldPos);
+
     // Update pixel coordinates (convert once, for performance reasons)
     mPx = (int) pos.x;
     mPy = (int) pos.y;
@@ -135,6 +142,21 @@ void Being::setPosition(const Vector &pos)
                         mPy - getHeight() - mText->getHeight() - 6);
 }
 
+void Being::setTileCoords(int x, int y)
+{
+    mX = x;
+    mY = y;
+
+    updateOccupiedTile();
+}
+
+void Being::setJob(Uint16 job)
+{
+    mJob = job;
+
+    updateOccupiedTile();
+}
+
 #ifdef EATHENA_SUPPORT
 void Being::setDestination(Uint16 destX, Uint16 destY)
 {
@@ -267,7 +289,7 @@ void Being::setSpeech(const std::string &text, int time)
         mText = new Text(mSpeech,
                          mPx, mPy - getHeight(),
                          gcn::Graphics::CENTER,
-                         &guiPalette->getColor(Palette::PARTICLE),
+                         Palette::PARTICLE,
                          true);
     }
 }
@@ -277,14 +299,14 @@ void Being::takeDamage(Being *attacker, int amount, AttackType type)
     gcn::Font *font;
     std::string damage = amount ? toString(amount) : type == FLEE ?
             "dodge" : "miss";
-    const gcn::Color *color;
+    Palette::ColorType color;
 
     font = gui->getInfoParticleFont();
 
     // Selecting the right color
     if (type == CRITICAL || type == FLEE)
     {
-        color = &guiPalette->getColor(Palette::HIT_CRITICAL);
+        color = Palette::HIT_CRITICAL;
     }
     else if (!amount)
     {
@@ -292,20 +314,20 @@ void Being::takeDamage(Being *attacker, int amount, AttackType type)
         {
             // This is intended to be the wrong direction to visually
             // differentiate between hits and misses
-            color = &guiPalette->getColor(Palette::HIT_MONSTER_PLAYER);
+            color = Palette::HIT_MONSTER_PLAYER;
         }
         else
         {
-            color = &guiPalette->getColor(Palette::MISS);
+            color = Palette::MISS;
         }
     }
     else if (getType() == MONSTER)
     {
-        color = &guiPalette->getColor(Palette::HIT_PLAYER_MONSTER);
+        color = Palette::HIT_PLAYER_MONSTER;
     }
     else
     {
-        color = &guiPalette->getColor(Palette::HIT_MONSTER_PLAYER);
+        color = Palette::HIT_MONSTER_PLAYER;
     }
 
     // Show damage number
@@ -354,10 +376,23 @@ void Being::handleAttack(Being *victim, int damage, AttackType type)
 #endif
 }
 
+void Being::setId(int id)
+{
+    const int oldId = mId;
+    mId = id;
+
+    if (beingManager)
+        beingManager->beingIdChanged(this, oldId);
+}
+
 void Being::setName(const std::string &name)
 {
+    const std::string oldName = mName;
     mName = name;
 
+    if (beingManager)
+        beingManager->beingNameChanged(this, oldName);
+
     if (getShowName())
         showName();
 }
@@ -383,7 +418,10 @@ void Being::setMap(Map *map)
 {
     // Remove sprite from potential previous map
     if (mMap)
+    {
         mMap->removeSprite(mMapSprite);
+        freeOccupiedTile();
+    }
 
     mMap = map;
 
@@ -391,6 +429,8 @@ void Being::setMap(Map *map)
     if (mMap)
         mMapSprite = mMap->addSprite(this);
 
+    updateOccupiedTile();
+
     // Clear particle effect list because child particles became invalid
     mChildParticleEffects.clear();
     mMustResetParticles = true; // Reset status particles on next redraw
@@ -505,6 +545,7 @@ void Being::nextStep()
 
     mX = pos.x;
     mY = pos.y;
+    updateOccupiedTile();
     setAction(WALK);
     mWalkTime += mWalkSpeed / 10;
 }
@@ -707,7 +748,7 @@ void Being::drawSpeech(int offsetX, int offsetY)
             mText = new Text(mSpeech,
                              mPx, mPy - getHeight(),
                              gcn::Graphics::CENTER,
-                             &guiPalette->getColor(Palette::PARTICLE),
+                             Palette::PARTICLE,
                              true);
         }
     }
@@ -924,6 +965,35 @@ void Being::internalTriggerEffect(int effectId, bool sfx, bool gfx)
     }
 }
 
+void Being::updateOccupiedTile()
+{
+    // Job 45 is a portal, they don't collide
+    const bool occupies = mMap && mJob != 45;
+
+    if (mOccupiesTile == occupies &&
+        (!occupies || (mOccupiedX == mX && mOccupiedY == mY)))
+        return;
+
+    freeOccupiedTile();
+
+    if (occupies)
+    {
+        mMap->occupyTile(mX, mY);
+        mOccupiesTile = true;
+        mOccupiedX = mX;
+        mOccupiedY = mY;
+    }
+}
+
+void Being::freeOccupiedTile()
+{
+    if (!mOccupiesTile)
+        return;
+
+    mMap->freeTile(mOccupiedX, mOccupiedY);
+    mOccupiesTile = false;
+}
+
 void Being::updateCoords()
 {
     if (mDispName)
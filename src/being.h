@@ -37,6 +37,8 @@
 #include "sprite.h"
 #include "vector.h"
 
+#include "gui/palette.h"
+
 #include "resources/spritedef.h"
 
 #define FIRST_IGNORE_EMOTE 14
@@ -172,8 +174,7 @@ class Being : public Sprite, public ConfigListener
         /**
          * Sets the tile x or y coord
          */
-        void setTileCoords(int x, int y)
-        { mX = x; mY = y; }
+        void setTileCoords(int x, int y);
 
         /**
          * Puts a "speech balloon" above this being for the specified amount
@@ -272,10 +273,16 @@ class Being : public Sprite, public ConfigListener
          */
         float getWalkSpeed() const { return mWalkSpeed; }
 
+        /**
+         * Sets the job, updating the map occupation since portals don't
+         * occupy their tile.
+         */
+        void setJob(Uint16 job);
+
         /**
          * Sets the sprite id.
          */
-        void setId(int id) { mId = id; }
+        void setId(int id);
 
         int getId() const { return mId; }
 
@@ -535,7 +542,7 @@ class Being : public Sprite, public ConfigListener
          * Holds a text object when the being displays it's name, 0 otherwise
          */
         FlashText *mDispName;
-        const gcn::Color *mNameColor;
+        Palette::ColorType mNameColor;
         bool mShowName;
 
         /** Engine-related infos about weapon. */
@@ -569,6 +576,17 @@ class Being : public Sprite, public ConfigListener
         int getOffset(char pos, char neg) const;
 #endif
 
+        /**
+         * Keeps the occupation of the map tile this being stands on up to
+         * date with its tile coordinates, map and job.
+         */
+        void updateOccupiedTile();
+
+        /**
+         * Releases the map tile occupied by this being, if any.
+         */
+        void freeOccupiedTile();
+
         /** Reset particle status effects on next redraw? */
         bool mMustResetParticles;
 
@@ -587,6 +605,9 @@ class Being : public Sprite, public ConfigListener
         int mPx, mPy;                   /**< Position in pixels */
         int mX, mY;                     /**< Position on tile */
 
+        bool mOccupiesTile;             /**< Whether a map tile is occupied */
+        int mOccupiedX, mOccupiedY;     /**< Tile occupied on the map */
+
         /** Target cursor being used */
         SimpleAnimation* mUsedTargetCursor;
 };
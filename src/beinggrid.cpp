@@ -0,0 +1,294 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "beinggrid.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+/** Width and height of a cell in pixels */
+static const int CELL_SIZE = 128;
+
+/** Number of buckets the cells are hashed into, a power of two */
+static const int BUCKET_COUNT = 512;
+
+/**
+ * Returns the cell coordinate of a pixel coordinate, rounding down.
+ */
+static int toCell(int pixel)
+{
+    return pixel >= 0 ? pixel / CELL_SIZE : (pixel + 1) / CELL_SIZE - 1;
+}
+
+/**
+ * Orders found beings by their distance.
+ */
+static bool distanceCompare(const std::pair<int, Being*> &a,
+                            const std::pair<int, Being*> &b)
+{
+    return a.first < b.first;
+}
+
+BeingGrid::BeingGrid():
+    mBuckets(BUCKET_COUNT),
+    mBucketQuery(BUCKET_COUNT, 0),
+    mQuery(0)
+{
+}
+
+int BeingGrid::getCellBucket(int cellX, int cellY) const
+{
+    const unsigned int hash = (unsigned int) cellX * 73856093u ^
+                              (unsigned int) cellY * 19349663u;
+    return hash & (BUCKET_COUNT - 1);
+}
+
+int BeingGrid::getBucket(int x, int y) const
+{
+    return getCellBucket(toCell(x), toCell(y));
+}
+
+void BeingGrid::add(Being *being)
+{
+    const Vector &pos = being->getPosition();
+    mBuckets[getBucket((int) pos.x, (int) pos.y)].push_back(being);
+}
+
+void BeingGrid::remove(Being *being)
+{
+    const Vector &pos = being->getPosition();
+    Bucket &bucket = mBuckets[getBucket((int) pos.x, (int) pos.y)];
+    Bucket::iterator i = std::find(bucket.begin(), bucket.end(), being);
+
+    if (i != bucket.end())
+    {
+        *i = bucket.back();
+        bucket.pop_back();
+    }
+}
+
+void BeingGrid::move(Being *being, const Vector &oldPosition)
+{
+    const Vector &pos = being->getPosition();
+    const int oldBucket = getBucket((int) oldPosition.x,
+                                    (int) oldPosition.y);
+    const int newBucket = getBucket((int) pos.x, (int) pos.y);
+
+    if (oldBucket == newBucket)
+        return;
+
+    Bucket &bucket = mBuckets[oldBucket];
+    Bucket::iterator i = std::find(bucket.begin(), bucket.end(), being);
+
+    if (i != bucket.end())
+    {
+        *i = bucket.back();
+        bucket.pop_back();
+    }
+
+    mBuckets[newBucket].push_back(being);
+}
+
+void BeingGrid::clear()
+{
+    for (std::vector<Bucket>::iterator i = mBuckets.begin(),
+         i_end = mBuckets.end(); i != i_end; ++i)
+    {
+        i->clear();
+    }
+}
+
+void BeingGrid::newQuery() const
+{
+    if (++mQuery == 0)
+    {
+        // The query numbers wrapped around, clear them once
+        std::fill(mBucketQuery.begin(), mBucketQuery.end(), 0);
+        mQuery = 1;
+    }
+}
+
+bool BeingGrid::visit(int bucket) const
+{
+    if (mBucketQuery[bucket] == mQuery)
+        return false;
+
+    mBucketQuery[bucket] = mQuery;
+    return true;
+}
+
+/**
+ * Adds the beings in the bucket that are within the given rectangle.
+ */
+static void collect(const std::vector<Being*> &bucket,
+                    int x, int y, int width, int height,
+                    const BeingFilter &filter,
+                    std::vector<Being*> &result)
+{
+    for (std::vector<Being*>::const_iterator i = bucket.begin(),
+         i_end = bucket.end(); i != i_end; ++i)
+    {
+        Being *being = *i;
+        const Vector &pos = being->getPosition();
+
+        if (pos.x >= x && pos.x < x + width &&
+            pos.y >= y && pos.y < y + height &&
+            filter.matches(being))
+        {
+            result.push_back(being);
+        }
+    }
+}
+
+void BeingGrid::findInRectangle(int x, int y, int width, int height,
+                                const BeingFilter &filter,
+                                std::vector<Being*> &result) const
+{
+    result.clear();
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    const int startX = toCell(x);
+    const int startY = toCell(y);
+    const int endX = toCell(x + width - 1);
+    const int endY = toCell(y + height - 1);
+
+    // Large areas are easier to handle by looking at every bucket
+    if ((endX - startX + 1) * (endY - startY + 1) >= BUCKET_COUNT)
+    {
+        for (int b = 0; b < BUCKET_COUNT; b++)
+            collect(mBuckets[b], x, y, width, height, filter, result);
+        return;
+    }
+
+    newQuery();
+
+    for (int cy = startY; cy <= endY; cy++)
+    {
+        for (int cx = startX; cx <= endX; cx++)
+        {
+            const int b = getCellBucket(cx, cy);
+            if (visit(b))
+                collect(mBuckets[b], x, y, width, height, filter, result);
+        }
+    }
+}
+
+void BeingGrid::findInRadius(int x, int y, int radius,
+                             const BeingFilter &filter,
+                             std::vector<Being*> &result) const
+{
+    findInRectangle(x - radius, y - radius, radius * 2 + 1, radius * 2 + 1,
+                    filter, result);
+
+    // Remove the beings in the corners of the rectangle
+    std::vector<Being*>::iterator i = result.begin();
+    while (i != result.end())
+    {
+        const Vector &pos = (*i)->getPosition();
+        const float dx = pos.x - x;
+        const float dy = pos.y - y;
+
+        if (dx * dx + dy * dy > (float) radius * radius)
+        {
+            *i = result.back();
+            result.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void BeingGrid::findNearest(int x, int y, unsigned int count,
+                            int maxDistance, const BeingFilter &filter,
+                            std::vector<Being*> &result) const
+{
+    result.clear();
+
+    if (count == 0 || maxDistance < 0)
+        return;
+
+    std::vector<std::pair<int, Being*> > found;
+    const int centerX = toCell(x);
+    const int centerY = toCell(y);
+    int visited = 0;
+
+    newQuery();
+
+    // Search the cells in rings around the cell of the point, until the
+    // beings that weren't looked at yet are known to be further away
+    for (int ring = 0; visited < BUCKET_COUNT; ring++)
+    {
+        for (int cy = centerY - ring; cy <= centerY + ring; cy++)
+        {
+            const bool edgeRow = cy == centerY - ring || cy == centerY + ring;
+            const int step = edgeRow ? 1 : ring * 2;
+
+            for (int cx = centerX - ring; cx <= centerX + ring; cx += step)
+            {
+                const int b = getCellBucket(cx, cy);
+                if (!visit(b))
+                    continue;
+
+                visited++;
+
+                const Bucket &bucket = mBuckets[b];
+                for (Bucket::const_iterator i = bucket.begin(),
+                     i_end = bucket.end(); i != i_end; ++i)
+                {
+                    Being *being = *i;
+                    const Vector &pos = being->getPosition();
+                    const int d = abs((int) pos.x - x) + abs((int) pos.y - y);
+
+                    if (d <= maxDistance && filter.matches(being))
+                        found.push_back(std::make_pair(d, being));
+                }
+            }
+        }
+
+        // The distance from the point to the cells outside of this ring
+        const int reach = std::min(
+                std::min(x - (centerX - ring) * CELL_SIZE,
+                         (centerX + ring + 1) * CELL_SIZE - x),
+                std::min(y - (centerY - ring) * CELL_SIZE,
+                         (centerY + ring + 1) * CELL_SIZE - y));
+
+        if (reach > maxDistance)
+            break;
+
+        if (found.size() >= count)
+        {
+            std::nth_element(found.begin(), found.begin() + (count - 1),
+                             found.end(), distanceCompare);
+            if (found[count - 1].first <= reach)
+                break;
+        }
+    }
+
+    std::stable_sort(found.begin(), found.end(), distanceCompare);
+
+    for (unsigned int i = 0; i < found.size() && i < count; i++)
+        result.push_back(found[i].second);
+}
@@ -0,0 +1,151 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef BEINGGRID_H
+#define BEINGGRID_H
+
+#include "being.h"
+
+#include <vector>
+
+/**
+ * The conditions a being needs to meet to be returned by a BeingGrid query.
+ */
+struct BeingFilter
+{
+    /**
+     * Constructor.
+     *
+     * @param type      the type of being to look for, or Being::UNKNOWN for
+     *                  any type
+     * @param aliveOnly whether dead beings are skipped
+     * @param excluded  a being to skip, may be NULL
+     */
+    BeingFilter(Being::Type type = Being::UNKNOWN, bool aliveOnly = true,
+                const Being *excluded = NULL):
+        type(type),
+        aliveOnly(aliveOnly),
+        excluded(excluded)
+    {}
+
+    bool matches(const Being *being) const
+    {
+        return (type == Being::UNKNOWN || being->getType() == type) &&
+               (!aliveOnly || being->mAction != Being::DEAD) &&
+               being != excluded;
+    }
+
+    Being::Type type;
+    bool aliveOnly;
+    const Being *excluded;
+};
+
+/**
+ * A spatial hash of beings by pixel position, to find the beings in a part
+ * of the map without looking at all of them.
+ *
+ * The map is divided in square cells, which are hashed into a fixed number
+ * of buckets. Beings need to be moved in the grid whenever their position
+ * changes.
+ */
+class BeingGrid
+{
+    public:
+        BeingGrid();
+
+        /**
+         * Adds a being at its current position.
+         */
+        void add(Being *being);
+
+        /**
+         * Removes a being, which is expected to be at its current position.
+         */
+        void remove(Being *being);
+
+        /**
+         * Updates the grid after a being moved away from the given position.
+         */
+        void move(Being *being, const Vector &oldPosition);
+
+        /**
+         * Removes all beings.
+         */
+        void clear();
+
+        /**
+         * Finds the beings within the given rectangle, in pixels.
+         */
+        void findInRectangle(int x, int y, int width, int height,
+                             const BeingFilter &filter,
+                             std::vector<Being*> &result) const;
+
+        /**
+         * Finds the beings within the given distance in pixels of a point.
+         */
+        void findInRadius(int x, int y, int radius,
+                          const BeingFilter &filter,
+                          std::vector<Being*> &result) const;
+
+        /**
+         * Finds the beings closest to a point, measured in pixels along the
+         * axes (Manhattan distance). The result is sorted with the closest
+         * being first.
+         *
+         * @param count       the maximum number of beings to find
+         * @param maxDistance the maximum distance of the beings found
+         */
+        void findNearest(int x, int y, unsigned int count, int maxDistance,
+                         const BeingFilter &filter,
+                         std::vector<Being*> &result) const;
+
+    private:
+        typedef std::vector<Being*> Bucket;
+
+        /**
+         * Returns the bucket of the cell at the given pixel position.
+         */
+        int getBucket(int x, int y) const;
+
+        /**
+         * Returns the bucket of the cell with the given cell coordinates.
+         */
+        int getCellBucket(int cellX, int cellY) const;
+
+        /**
+         * Starts a new query, so that each bucket is only visited once by
+         * it even when several cells share the same bucket.
+         */
+        void newQuery() const;
+
+        /**
+         * Marks the bucket as visited by the current query. Returns false
+         * when it was visited already.
+         */
+        bool visit(int bucket) const;
+
+        std::vector<Bucket> mBuckets;
+        mutable std::vector<unsigned int> mBucketQuery;
+        mutable unsigned int mQuery;
+};
+
+#endif
@@ -27,9 +27,16 @@
 #include "player.h"
 
 #include "utils/dtor.h"
+#include "utils/stringutils.h"
 
 #include <cassert>
 
+/**
+ * The largest width and height of a being that can be picked with the
+ * mouse anywhere on its sprite.
+ */
+static const int MAX_PICK_SIZE = 256;
+
 class FindBeingFunctor
 {
     public:
@@ -67,6 +74,7 @@ void BeingManager::setPlayer(LocalPlayer *player)
 {
     player_node = player;
     mBeings.push_back(player);
+    addToIndex(player);
 }
 
 Being *BeingManager::createBeing(int id, Being::Type type, int subtype)
@@ -92,25 +100,88 @@ Being *BeingManager::createBeing(int id, Being::Type type, int subtype)
     }
 
     mBeings.push_back(being);
+    addToIndex(being);
     return being;
 }
 
 void BeingManager::destroyBeing(Being *being)
 {
+    removeFromIndex(being);
     mBeings.remove(being);
     delete being;
 }
 
 Being *BeingManager::findBeing(int id) const
 {
-    for (Beings::const_iterator i = mBeings.begin(), i_end = mBeings.end();
-         i != i_end; ++i)
+    BeingsById::const_iterator i = mBeingsById.find(id);
+    return (i == mBeingsById.end()) ? NULL : i->second;
+}
+
+void BeingManager::addToIndex(Being *being)
+{
+    mBeingsById[being->getId()] = being;
+    mGrid.add(being);
+
+    std::string name = being->getName();
+    mBeingsByName.insert(std::make_pair(toLower(name), being));
+}
+
+void BeingManager::removeFromIndex(Being *being)
+{
+    BeingsById::iterator i = mBeingsById.find(being->getId());
+    if (i != mBeingsById.end() && i->second == being)
+        mBeingsById.erase(i);
+
+    mGrid.remove(being);
+    removeName(being, being->getName());
+}
+
+void BeingManager::removeName(Being *being, const std::string &name)
+{
+    std::string key = name;
+    toLower(key);
+
+    std::pair<BeingsByName::iterator, BeingsByName::iterator> range =
+        mBeingsByName.equal_range(key);
+
+    for (BeingsByName::iterator i = range.first; i != range.second; ++i)
     {
-        Being *being = (*i);
-        if (being->getId() == id)
-            return being;
+        if (i->second == being)
+        {
+            mBeingsByName.erase(i);
+            return;
+        }
     }
-    return NULL;
+}
+
+void BeingManager::beingIdChanged(Being *being, int oldId)
+{
+    BeingsById::iterator i = mBeingsById.find(oldId);
+
+    // Beings that aren't managed, like characters on the selection screen,
+    // are not indexed
+    if (i == mBeingsById.end() || i->second != being)
+        return;
+
+    mBeingsById.erase(i);
+    mBeingsById[being->getId()] = being;
+}
+
+void BeingManager::beingNameChanged(Being *being, const std::string &oldName)
+{
+    if (findBeing(being->getId()) != being)
+        return;
+
+    removeName(being, oldName);
+
+    std::string name = being->getName();
+    mBeingsByName.insert(std::make_pair(toLower(name), being));
+}
+
+void BeingManager::beingMoved(Being *being, const Vector &oldPosition)
+{
+    if (findBeing(being->getId()) == being)
+        mGrid.move(being, oldPosition);
 }
 
 Being *BeingManager::findBeing(int x, int y, Being::Type type) const
@@ -119,27 +190,35 @@ Being *BeingManager::findBeing(int x, int y, Being::Type type) const
     beingFinder.y = y;
     beingFinder.type = type;
 
-    Beings::const_iterator i = find_if(mBeings.begin(), mBeings.end(),
-                                       beingFinder);
+    // NPCs are also found on the tile above them
+    std::vector<Being*> beings;
+    mGrid.findInRectangle(x * 32, y * 32, 32, 64,
+                          BeingFilter(type), beings);
+
+    std::vector<Being*>::const_iterator i =
+        find_if(beings.begin(), beings.end(), beingFinder);
 
-    return (i == mBeings.end()) ? NULL : *i;
+    return (i == beings.end()) ? NULL : *i;
 }
 
 Being *BeingManager::findBeingByPixel(int x, int y) const
 {
-    Beings::const_iterator itr = mBeings.begin();
-    Beings::const_iterator itr_end = mBeings.end();
-
-    for (; itr != itr_end; ++itr)
+    // Beings are positioned at the bottom center of their sprite
+    std::vector<Being*> beings;
+    mGrid.findInRectangle(x - MAX_PICK_SIZE / 2, y,
+                          MAX_PICK_SIZE + 1, MAX_PICK_SIZE + 1,
+                          BeingFilter(Being::UNKNOWN, true, player_node),
+                          beings);
+
+    for (std::vector<Being*>::const_iterator i = beings.begin(),
+         i_end = beings.end(); i != i_end; ++i)
     {
-        Being *being = (*itr);
+        Being *being = (*i);
 
         int xtol = being->getWidth() / 2;
         int uptol = being->getHeight();
 
-        if ((being->mAction != Being::DEAD) &&
-            (being != player_node) &&
-            (being->getPixelX() - xtol <= x) &&
+        if ((being->getPixelX() - xtol <= x) &&
             (being->getPixelX() + xtol >= x) &&
             (being->getPixelY() - uptol <= y) &&
             (being->getPixelY() >= y))
@@ -154,15 +233,28 @@ Being *BeingManager::findBeingByPixel(int x, int y) const
 Being *BeingManager::findBeingByName(const std::string &name,
                                      Being::Type type) const
 {
-    for (Beings::const_iterator i = mBeings.begin(), i_end = mBeings.end();
-         i != i_end; ++i)
+    std::string key = name;
+    toLower(key);
+
+    std::pair<BeingsByName::const_iterator, BeingsByName::const_iterator>
+        range = mBeingsByName.equal_range(key);
+
+    Being *found = NULL;
+
+    for (BeingsByName::const_iterator i = range.first; i != range.second; ++i)
     {
-        Being *being = (*i);
-        if (being->getName() == name &&
-           (type == Being::UNKNOWN || type == being->getType()))
+        Being *being = i->second;
+        if (type != Being::UNKNOWN && type != being->getType())
+            continue;
+
+        if (being->getName() == name)
             return being;
+
+        if (!found)
+            found = being;
     }
-    return NULL;
+
+    return found;
 }
 
 const Beings &BeingManager::getAll() const
@@ -182,6 +274,7 @@ void BeingManager::logic()
 #ifdef EATHENA_SUPPORT
         if (being->mAction == Being::DEAD && being->mFrame >= 20)
         {
+            removeFromIndex(being);
             delete being;
             i = mBeings.erase(i);
         }
@@ -200,91 +293,47 @@ void BeingManager::clear()
 
     delete_all(mBeings);
     mBeings.clear();
+    mBeingsById.clear();
+    mBeingsByName.clear();
+    mGrid.clear();
 
     if (player_node)
+    {
         mBeings.push_back(player_node);
+        addToIndex(player_node);
+    }
 }
 
 Being *BeingManager::findNearestLivingBeing(int x, int y, int maxdist,
                                             Being::Type type) const
 {
-    Being *closestBeing = NULL;
-    int dist = 0;
-
+    // The coordinates and distance are given in tiles
 #ifdef MANASERV_SUPPORT
-    //Why do we do this:
-    //For some reason x,y passed to this function is always
-    //in map coords, while down below its in pixels
-    //
-    //I believe there is a deeper problem under this, but
-    //for a temp solution we'll convert to coords to pixels
     x = x * 32;
     y = y * 32;
-    maxdist = maxdist * 32;
-#endif
-
-    Beings::const_iterator itr = mBeings.begin();
-    Beings::const_iterator itr_end = mBeings.end();
-
-    for (; itr != itr_end; ++itr)
-    {
-        Being *being = (*itr);
-#ifdef MANASERV_SUPPORT
-        const Vector &pos = being->getPosition();
-        int d = abs(((int) pos.x) - x) + abs(((int) pos.y) - y);
 #else
-        int d = abs(being->getTileX() - x) + abs(being->getTileY() - y);
+    // Beings standing on a tile are positioned at the bottom center of it
+    x = x * 32 + 16;
+    y = y * 32 + 32;
 #endif
+    maxdist = maxdist * 32;
 
-        if ((being->getType() == type || type == Being::UNKNOWN)
-                && (d < dist || closestBeing == NULL)   // it is closer
-                && being->mAction != Being::DEAD)       // no dead beings
-        {
-            dist = d;
-            closestBeing = being;
-        }
-    }
+    std::vector<Being*> beings;
+    mGrid.findNearest(x, y, 1, maxdist, BeingFilter(type), beings);
 
-    return (maxdist >= dist) ? closestBeing : NULL;
+    return beings.empty() ? NULL : beings.front();
 }
 
 Being *BeingManager::findNearestLivingBeing(Being *aroundBeing, int maxdist,
                                             Being::Type type) const
 {
-    Being *closestBeing = NULL;
-    int dist = 0;
-#ifdef MANASERV_SUPPORT
-    const Vector &apos = aroundBeing->getPosition();
-    int x = apos.x;
-    int y = apos.y;
-    maxdist = maxdist * 32;
-#else
-    int x = aroundBeing->getTileX();
-    int y = aroundBeing->getTileY();
-#endif
+    const Vector &pos = aroundBeing->getPosition();
 
-    for (Beings::const_iterator i = mBeings.begin(), i_end = mBeings.end();
-         i != i_end; ++i)
-    {
-        Being *being = (*i);
-#ifdef MANASERV_SUPPORT
-        const Vector &pos = being->getPosition();
-        int d = abs(((int) pos.x) - x) + abs(((int) pos.y) - y);
-#else
-        int d = abs(being->getTileX() - x) + abs(being->getTileY() - y);
-#endif
-
-        if ((being->getType() == type || type == Being::UNKNOWN)
-                && (d < dist || closestBeing == NULL)   // it is closer
-                && being->mAction != Being::DEAD        // no dead beings
-                && being != aroundBeing)
-        {
-            dist = d;
-            closestBeing = being;
-        }
-    }
+    std::vector<Being*> beings;
+    mGrid.findNearest((int) pos.x, (int) pos.y, 1, maxdist * 32,
+                      BeingFilter(type, true, aroundBeing), beings);
 
-    return (maxdist >= dist) ? closestBeing : NULL;
+    return beings.empty() ? NULL : beings.front();
 }
 
 bool BeingManager::hasBeing(Being *being) const
@@ -23,6 +23,9 @@
 #define BEINGMANAGER_H
 
 #include "being.h"
+#include "beinggrid.h"
+
+#include <map>
 
 class LocalPlayer;
 class Map;
@@ -61,6 +64,24 @@ class BeingManager
          */
         Being *findBeing(int id) const;
 
+        /**
+         * Updates the lookup by id after the id of a being changed. Called
+         * by Being::setId.
+         */
+        void beingIdChanged(Being *being, int oldId);
+
+        /**
+         * Updates the lookup by name after the name of a being changed.
+         * Called by Being::setName.
+         */
+        void beingNameChanged(Being *being, const std::string &oldName);
+
+        /**
+         * Updates the lookup by position after a being moved. Called by
+         * Being::setPosition.
+         */
+        void beingMoved(Being *being, const Vector &oldPosition);
+
         /**
          * Returns a being at specific coordinates.
          */
@@ -80,7 +101,9 @@ class BeingManager
                                       Being::Type type = Being::UNKNOWN) const;
 
        /**
-        * Finds a being by name and (optionally) by type.
+        * Finds a being by name and (optionally) by type. A being with
+        * exactly the given name is preferred, but names differing only in
+        * case are matched as well.
         */
         Being *findBeingByName(const std::string &name,
                                Being::Type type = Being::UNKNOWN) const;
@@ -99,6 +122,13 @@ class BeingManager
          */
         const Beings &getAll() const;
 
+        /**
+         * Returns the beings indexed by their pixel position, for finding
+         * the beings in a part of the map.
+         */
+        const BeingGrid &getGrid() const
+        { return mGrid; }
+
         /**
          * Returns true if the given being is in the manager's list, false
          * otherwise.
@@ -119,7 +149,28 @@ class BeingManager
         void clear();
 
     protected:
+        typedef std::map<int, Being*> BeingsById;
+        typedef std::multimap<std::string, Being*> BeingsByName;
+
+        /**
+         * Adds a being to the lookups by id, name and position.
+         */
+        void addToIndex(Being *being);
+
+        /**
+         * Removes a being from the lookups by id, name and position.
+         */
+        void removeFromIndex(Being *being);
+
+        /**
+         * Removes a being from the lookup by name, using the given name.
+         */
+        void removeName(Being *being, const std::string &name);
+
         Beings mBeings;
+        BeingsById mBeingsById;
+        BeingsByName mBeingsByName;  /**< Keyed by lower case name */
+        BeingGrid mGrid;
         Map *mMap;
 };
 
@@ -34,12 +34,15 @@
 #include "net/adminhandler.h"
 #include "net/chathandler.h"
 #include "net/gamehandler.h"
+#include "net/messagetable.h"
 #include "net/net.h"
 #include "net/partyhandler.h"
 
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
 
+#include <algorithm>
+
 CommandHandler::CommandHandler()
 {}
 
@@ -117,6 +120,10 @@ void CommandHandler::handleCommand(const std::string &command, ChatTab *tab)
     {
         handlePresent(args, tab);
     }
+    else if (type == "netstats")
+    {
+        handleNetStats(args, tab);
+    }
     else
     {
         tab->chatLog(_("Unknown command."));
@@ -154,6 +161,7 @@ void CommandHandler::handleHelp(const std::string &args, ChatTab *tab)
         tab->chatLog(_("/where > Display map name"));
         tab->chatLog(_("/who > Display number of online users"));
         tab->chatLog(_("/me > Tell something about yourself"));
+        tab->chatLog(_("/netstats > Display statistics of received messages"));
 
         tab->chatLog(_("/clear > Clears this window"));
 
@@ -226,6 +234,14 @@ void CommandHandler::handleHelp(const std::string &args, ChatTab *tab)
         tab->chatLog(_("Command: /me <message>"));
         tab->chatLog(_("This command tell others you are (doing) <msg>."));
     }
+    else if (args == "netstats")
+    {
+        tab->chatLog(_("Command: /netstats"));
+        tab->chatLog(_("This command displays the message types that took "
+                       "the most time to handle, with their count and size."));
+        tab->chatLog(_("Command: /netstats reset"));
+        tab->chatLog(_("This command clears the message statistics."));
+    }
     else if (args == "msg" || args == "whisper" || args == "w")
     {
         tab->chatLog(_("Command: /msg <nick> <message>"));
@@ -484,3 +500,32 @@ void CommandHandler::handleUnignore(const std::string &args, ChatTab *tab)
     else
         tab->chatLog(_("Player could not be unignored!"), BY_SERVER);
 }
+
+void CommandHandler::handleNetStats(const std::string &args, ChatTab *tab)
+{
+    if (args == "reset")
+    {
+        Net::MessageTable::resetStats();
+        tab->chatLog(_("Message statistics cleared."), BY_SERVER);
+        return;
+    }
+
+    const std::vector<Net::MessageStat> stats = Net::MessageTable::getStats();
+
+    if (stats.empty())
+    {
+        tab->chatLog(_("No messages received."), BY_SERVER);
+        return;
+    }
+
+    // Only show the most expensive message types
+    const unsigned int shown = std::min((unsigned int) stats.size(), 10u);
+
+    for (unsigned int i = 0; i < shown; ++i)
+    {
+        const Net::MessageStat &stat = stats[i];
+        tab->chatLog(strprintf("0x%04x: %u, %lu B, %lu.%03lu ms", stat.id,
+                               stat.count, stat.bytes, stat.time / 1000,
+                               stat.time % 1000), BY_SERVER);
+    }
+}
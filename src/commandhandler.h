@@ -137,6 +137,11 @@ class CommandHandler
          * Handle an unignore command.
          */
         void handleUnignore(const std::string &args, ChatTab *tab);
+
+        /**
+         * Handle a netstats command.
+         */
+        void handleNetStats(const std::string &args, ChatTab *tab);
 };
 
 extern CommandHandler *commandHandler;
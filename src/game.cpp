@@ -79,6 +79,7 @@
 #include "net/net.h"
 
 #include "resources/imagewriter.h"
+#include "resources/resourcemanager.h"
 
 #include "utils/gettext.h"
 
@@ -349,6 +350,7 @@ Game::~Game()
     destroyGuiWindows();
 
     delete beingManager;
+    beingManager = NULL;
     delete player_node;
     delete floorItemManager;
     delete channelManager;
@@ -359,7 +361,6 @@ Game::~Game()
 
     viewport->setMap(NULL);
     player_node = NULL;
-    beingManager = NULL;
     floorItemManager = NULL;
     joystick = NULL;
 
@@ -468,6 +469,7 @@ void Game::logic()
 
         keyboard.processStates();
 
+        ResourceManager::getInstance()->processAsyncLoads();
 
         // Handle all necessary game logic
         while (get_elapsed_time(gameTime) > 0)
@@ -26,6 +26,7 @@
 
 #include "resources/image.h"
 #include "resources/imageloader.h"
+#include "resources/scaledimagecache.h"
 
 Graphics::Graphics():
     mScreen(0)
@@ -133,17 +134,19 @@ bool Graphics::drawRescaledImage(Image *image, int srcX, int srcY,
     if (!mScreen || !image) return false;
     if (!image->mSDLSurface) return false;
 
-    Image *tmpImage = image->SDLgetScaledImage(desiredWidth, desiredHeight);
-    bool returnValue = false;
+    Image *tmpImage = ScaledImageCache::get(image, desiredWidth, desiredHeight);
 
     if (!tmpImage) return false;
-    if (!tmpImage->mSDLSurface) return false;
+
+    int offsetX, offsetY;
+    SDL_Surface *surface = tmpImage->SDLgetSurface(offsetX, offsetY);
+    if (!surface) return false;
 
     dstX += mClipStack.top().xOffset;
     dstY += mClipStack.top().yOffset;
 
-    srcX += image->mBounds.x;
-    srcY += image->mBounds.y;
+    srcX += image->mBounds.x + offsetX;
+    srcY += image->mBounds.y + offsetY;
 
     SDL_Rect dstRect;
     SDL_Rect srcRect;
@@ -152,11 +155,7 @@ bool Graphics::drawRescaledImage(Image *image, int srcX, int srcY,
     srcRect.w = width;
     srcRect.h = height;
 
-    returnValue = !(SDL_BlitSurface(tmpImage->mSDLSurface, &srcRect, mScreen, &dstRect) < 0);
-
-    delete tmpImage;
-
-    return returnValue;
+    return !(SDL_BlitSurface(surface, &srcRect, mScreen, &dstRect) < 0);
 }
 
 bool Graphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY,
@@ -164,13 +163,16 @@ bool Graphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY,
 {
     // Check that preconditions for blitting are met.
     if (!mScreen || !image) return false;
-    if (!image->mSDLSurface) return false;
+
+    int offsetX, offsetY;
+    SDL_Surface *surface = image->SDLgetSurface(offsetX, offsetY);
+    if (!surface) return false;
 
     dstX += mClipStack.top().xOffset;
     dstY += mClipStack.top().yOffset;
 
-    srcX += image->mBounds.x;
-    srcY += image->mBounds.y;
+    srcX += offsetX;
+    srcY += offsetY;
 
     SDL_Rect dstRect;
     SDL_Rect srcRect;
@@ -179,7 +181,7 @@ bool Graphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY,
     srcRect.w = width;
     srcRect.h = height;
 
-    return !(SDL_BlitSurface(image->mSDLSurface, &srcRect, mScreen, &dstRect) < 0);
+    return !(SDL_BlitSurface(surface, &srcRect, mScreen, &dstRect) < 0);
 }
 
 void Graphics::drawImage(gcn::Image const *image, int srcX, int srcY,
@@ -195,7 +197,10 @@ void Graphics::drawImagePattern(Image *image, int x, int y, int w, int h)
 {
     // Check that preconditions for blitting are met.
     if (!mScreen || !image) return;
-    if (!image->mSDLSurface) return;
+
+    int offsetX, offsetY;
+    SDL_Surface *surface = image->SDLgetSurface(offsetX, offsetY);
+    if (!surface) return;
 
     const int iw = image->getWidth();
     const int ih = image->getHeight();
@@ -205,13 +210,13 @@ void Graphics::drawImagePattern(Image *image, int x, int y, int w, int h)
     for (int py = 0; py < h; py += ih)     // Y position on pattern plane
     {
         int dh = (py + ih >= h) ? h - py : ih;
-        int srcY = image->mBounds.y;
+        int srcY = offsetY;
         int dstY = y + py + mClipStack.top().yOffset;
 
         for (int px = 0; px < w; px += iw) // X position on pattern plane
         {
             int dw = (px + iw >= w) ? w - px : iw;
-            int srcX = image->mBounds.x;
+            int srcX = offsetX;
             int dstX = x + px + mClipStack.top().xOffset;
 
             SDL_Rect dstRect;
@@ -220,7 +225,7 @@ void Graphics::drawImagePattern(Image *image, int x, int y, int w, int h)
             srcRect.x = srcX; srcRect.y = srcY;
             srcRect.w = dw;   srcRect.h = dh;
 
-            SDL_BlitSurface(image->mSDLSurface, &srcRect, mScreen, &dstRect);
+            SDL_BlitSurface(surface, &srcRect, mScreen, &dstRect);
         }
     }
 }
@@ -234,9 +239,13 @@ void Graphics::drawRescaledImagePattern(Image *image, int x, int y,
 
     if (scaledHeight == 0 || scaledWidth == 0) return;
 
-    Image *tmpImage = image->SDLgetScaledImage(scaledWidth, scaledHeight);
+    Image *tmpImage = ScaledImageCache::get(image, scaledWidth, scaledHeight);
     if (!tmpImage) return;
 
+    int offsetX, offsetY;
+    SDL_Surface *surface = tmpImage->SDLgetSurface(offsetX, offsetY);
+    if (!surface) return;
+
     const int iw = tmpImage->getWidth();
     const int ih = tmpImage->getHeight();
 
@@ -245,13 +254,13 @@ void Graphics::drawRescaledImagePattern(Image *image, int x, int y,
     for (int py = 0; py < h; py += ih)     // Y position on pattern plane
     {
         int dh = (py + ih >= h) ? h - py : ih;
-        int srcY = tmpImage->mBounds.y;
+        int srcY = offsetY;
         int dstY = y + py + mClipStack.top().yOffset;
 
         for (int px = 0; px < w; px += iw) // X position on pattern plane
         {
             int dw = (px + iw >= w) ? w - px : iw;
-            int srcX = tmpImage->mBounds.x;
+            int srcX = offsetX;
             int dstX = x + px + mClipStack.top().xOffset;
 
             SDL_Rect dstRect;
@@ -260,11 +269,9 @@ void Graphics::drawRescaledImagePattern(Image *image, int x, int y,
             srcRect.x = srcX; srcRect.y = srcY;
             srcRect.w = dw;   srcRect.h = dh;
 
-            SDL_BlitSurface(tmpImage->mSDLSurface, &srcRect, mScreen, &dstRect);
+            SDL_BlitSurface(surface, &srcRect, mScreen, &dstRect);
         }
     }
-
-    delete tmpImage;
 }
 
 void Graphics::drawImageRect(int x, int y, int w, int h,
@@ -33,8 +33,20 @@
 #include "particle.h"
 #include "main.h"
 #include "map.h"
+#ifdef USE_OPENGL
+#include "openglgraphics.h"
+#endif
+
+#ifdef EATHENA_SUPPORT
+#include "net/ea/network.h"
+#endif
 
 #include "resources/image.h"
+#include "resources/particleeffectdef.h"
+#include "resources/scaledimagecache.h"
+#ifdef USE_OPENGL
+#include "resources/textureatlas.h"
+#endif
 
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
@@ -48,12 +60,12 @@ DebugWindow::DebugWindow():
     setResizable(true);
     setCloseButton(true);
     setSaveVisible(true);
-    setDefaultSize(400, 100, ImageRect::CENTER);
+    setDefaultSize(400, 140, ImageRect::CENTER);
 
 #ifdef USE_OPENGL
     if (Image::getLoadAsOpenGL())
     {
-        mFPSText = _("%d FPS (OpenGL)");
+        mFPSText = _("%d FPS (OpenGL, %d draw calls)");
     }
     else
 #endif
@@ -69,6 +81,9 @@ DebugWindow::DebugWindow():
     mParticleCountLabel = new Label(strprintf(_("Particle count: %d"), 88888));
     mParticleDetailLabel = new Label();
     mAmbientDetailLabel = new Label();
+    mParticleEffectLabel = new Label();
+    mTextureLabel = new Label();
+    mNetworkLabel = new Label();
 
     place(0, 0, mFPSLabel, 3);
     place(3, 0, mTileMouseLabel);
@@ -78,6 +93,9 @@ DebugWindow::DebugWindow():
     place(3, 2, mParticleDetailLabel);
     place(0, 3, mMinimapLabel, 4);
     place(3, 3, mAmbientDetailLabel);
+    place(0, 4, mTextureLabel, 3);
+    place(3, 4, mParticleEffectLabel);
+    place(0, 5, mNetworkLabel, 4);
 
     loadWindowState();
 }
@@ -91,7 +109,32 @@ void DebugWindow::logic()
     int mouseTileX = (viewport->getMouseX() + viewport->getCameraX()) / 32;
     int mouseTileY = (viewport->getMouseY() + viewport->getCameraY()) / 32;
 
-    mFPSLabel->setCaption(strprintf(mFPSText.c_str(), fps));
+#ifdef USE_OPENGL
+    if (Image::getLoadAsOpenGL())
+    {
+        OpenGLGraphics *glGraphics = static_cast<OpenGLGraphics*>(graphics);
+        mFPSLabel->setCaption(strprintf(mFPSText.c_str(), fps,
+                                        glGraphics->getDrawCallCount()));
+
+        mTextureLabel->setCaption(
+                strprintf(_("Atlas: %d pages, %d%% used, %d binds"),
+                          TextureAtlas::getShared()->getPageCount(),
+                          TextureAtlas::getShared()->getOccupancy(),
+                          glGraphics->getTextureBindCount()));
+        mTextureLabel->adjustSize();
+    }
+    else
+#endif
+    {
+        mFPSLabel->setCaption(strprintf(mFPSText.c_str(), fps));
+
+        mTextureLabel->setCaption(
+                strprintf(_("Scaled images: %d cached, %d hits, %d misses"),
+                          ScaledImageCache::getSize(),
+                          ScaledImageCache::getHits(),
+                          ScaledImageCache::getMisses()));
+        mTextureLabel->adjustSize();
+    }
 
     mTileMouseLabel->setCaption(strprintf(_("Cursor: (%d, %d)"), mouseTileX,
                                           mouseTileY));
@@ -127,4 +170,25 @@ void DebugWindow::logic()
                                     Setup_Video::overlayDetailToString()));
 
     mAmbientDetailLabel->adjustSize();
+
+    mParticleEffectLabel->setCaption(
+            strprintf(_("Particle effects: %d parsed, %d spawned"),
+                      ParticleEffectDef::loadCount,
+                      ParticleEffectDef::instanceCount));
+
+    mParticleEffectLabel->adjustSize();
+
+#ifdef EATHENA_SUPPORT
+    if (EAthena::Network *network = EAthena::Network::instance())
+    {
+        mNetworkLabel->setCaption(
+                strprintf(_("Sending: %d bytes queued, %d ms to wire "
+                            "(%d ms max), %d stalls"),
+                          network->getQueuedBytes(),
+                          network->getSendLatency(),
+                          network->getMaxSendLatency(),
+                          network->getSendStalls()));
+        mNetworkLabel->adjustSize();
+    }
+#endif
 }
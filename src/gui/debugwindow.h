@@ -48,7 +48,9 @@ class DebugWindow : public Window
         Label *mMusicFileLabel, *mMapLabel, *mMinimapLabel;
         Label *mTileMouseLabel, *mFPSLabel;
         Label *mParticleCountLabel, *mParticleDetailLabel;
-        Label *mAmbientDetailLabel;
+        Label *mAmbientDetailLabel, *mParticleEffectLabel;
+        Label *mTextureLabel;
+        Label *mNetworkLabel;
 
 
         std::string mFPSText;
@@ -25,6 +25,7 @@
 #include "gui/palette.h"
 #include "gui/sdlinput.h"
 #include "gui/skin.h"
+#include "gui/textrenderer.h"
 #include "gui/truetypefont.h"
 #include "gui/viewport.h"
 
@@ -158,6 +159,8 @@ Gui::~Gui()
     if (mMouseCursors)
         mMouseCursors->decRef();
 
+    TextRenderer::clearCache();
+
     delete mGuiFont;
     delete boldFont;
     delete mInfoParticleFont;
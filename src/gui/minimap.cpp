@@ -176,10 +176,21 @@ void Minimap::draw(gcn::Graphics *graphics)
             drawImage(mMapImage, mapOriginX, mapOriginY);
     }
 
-    const Beings &beings = beingManager->getAll();
+    // Only look for the beings within the shown part of the map
+    std::vector<Being*> beings;
+    if (mWidthProportion > 0 && mHeightProportion > 0)
+    {
+        beingManager->getGrid().findInRectangle(
+                (int) (-mapOriginX * 32 / mWidthProportion),
+                (int) (-mapOriginY * 32 / mHeightProportion),
+                (int) (a.width * 32 / mWidthProportion) + 1,
+                (int) (a.height * 32 / mHeightProportion) + 1,
+                BeingFilter(Being::UNKNOWN, false),
+                beings);
+    }
 
-    for (Beings::const_iterator bi = beings.begin(), bi_end = beings.end();
-         bi != bi_end; ++bi)
+    for (std::vector<Being*>::const_iterator bi = beings.begin(),
+         bi_end = beings.end(); bi != bi_end; ++bi)
     {
         const Being *being = (*bi);
         int dotSize = 2;
@@ -201,6 +201,17 @@ class Palette : public gcn::ListModel
             return mColVector[type].grad;
         }
 
+        /**
+         * Returns whether the color of the specified type changes over
+         * time.
+         *
+         * @param type the color type of the color
+         */
+        inline bool isAnimated(ColorType type)
+        {
+            return mColVector[type].grad != STATIC;
+        }
+
         /**
          * Gets the gradient delay for the specified type.
          *
@@ -0,0 +1,349 @@
+/*
+ *  Text Renderer
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "gui/textrenderer.h"
+
+#include "gui/truetypefont.h"
+
+#include "resources/image.h"
+
+#include <algorithm>
+#include <vector>
+
+/** Maximum number of cached text images */
+static const unsigned int MAX_ENTRIES = 1024;
+
+/** Maximum number of bytes taken by the pixels of the cached images */
+static const unsigned int MAX_CACHE_BYTES = 4 * 1024 * 1024;
+
+TextRenderer::Entries TextRenderer::mEntries;
+std::map<TextRenderer::Key, TextRenderer::Entries::iterator>
+        TextRenderer::mIndex;
+unsigned int TextRenderer::mCacheBytes = 0;
+
+static unsigned int packRGB(const gcn::Color &color)
+{
+    return ((unsigned int) color.r << 16) | (color.g << 8) | color.b;
+}
+
+/**
+ * Returns whether one of the colors of the text changes over time, in which
+ * case a cached image would have to be composed again on every frame.
+ */
+static bool isAnimated(bool animated, bool outline, bool shadow)
+{
+    return animated ||
+           (outline && guiPalette->isAnimated(Palette::OUTLINE)) ||
+           (shadow && guiPalette->isAnimated(Palette::SHADOW));
+}
+
+bool TextRenderer::Key::operator<(const Key &other) const
+{
+    if (font != other.font)
+        return font < other.font;
+    if (color != other.color)
+        return color < other.color;
+    if (outlineColor != other.outlineColor)
+        return outlineColor < other.outlineColor;
+    if (shadowColor != other.shadowColor)
+        return shadowColor < other.shadowColor;
+    return text < other.text;
+}
+
+void TextRenderer::renderText(gcn::Graphics *graphics,
+                              const std::string &text,
+                              int x, int y,
+                              gcn::Graphics::Alignment align,
+                              const gcn::Color &color,
+                              gcn::Font *font,
+                              bool outline, bool shadow, int alpha,
+                              bool animated)
+{
+    Graphics *g = dynamic_cast<Graphics*>(graphics);
+
+    // Plain text is drawn glyph by glyph, which is already cheap
+    if (!g || (!outline && !shadow) || text.empty() || alpha <= 0 ||
+        !dynamic_cast<TrueTypeFont*>(font) ||
+        isAnimated(animated, outline, shadow))
+    {
+        renderLayers(graphics, text, x, y, align, color, font,
+                     outline, shadow, alpha);
+        return;
+    }
+
+    Key key;
+    key.text = text;
+    key.font = font;
+    // The alpha value is applied to the whole image, so the text is
+    // composed with its alpha relative to it
+    key.color = (packRGB(color) << 8) | std::min(255, color.a * 255 / alpha);
+    key.outlineColor = outline ?
+            (int) packRGB(guiPalette->getColor(Palette::OUTLINE)) : -1;
+    key.shadowColor = shadow ?
+            (int) packRGB(guiPalette->getColor(Palette::SHADOW)) : -1;
+
+    std::map<Key, Entries::iterator>::iterator i = mIndex.find(key);
+
+    if (i != mIndex.end())
+    {
+        // Move the entry to the front
+        mEntries.splice(mEntries.begin(), mEntries, i->second);
+    }
+    else
+    {
+        Entry entry;
+        entry.key = key;
+        compose(entry);
+
+        mEntries.push_front(entry);
+        mIndex[key] = mEntries.begin();
+
+        if (entry.image)
+        {
+            mCacheBytes += entry.image->getWidth() *
+                           entry.image->getHeight() * 4;
+        }
+
+        evict();
+    }
+
+    const Entry &entry = mEntries.front();
+
+    if (!entry.image)
+        return;
+
+    if (align == gcn::Graphics::CENTER)
+        x -= entry.width / 2;
+    else if (align == gcn::Graphics::RIGHT)
+        x -= entry.width;
+
+    // The shadow and outline were composed at full alpha, apply it to the
+    // whole image instead
+    entry.image->setAlpha(alpha / 255.0f);
+    g->drawImage(entry.image, x - entry.offsetX, y - entry.offsetY);
+}
+
+void TextRenderer::renderLayers(gcn::Graphics *graphics,
+                                const std::string &text,
+                                int x, int y,
+                                gcn::Graphics::Alignment align,
+                                const gcn::Color &color,
+                                gcn::Font *font,
+                                bool outline, bool shadow, int alpha)
+{
+    graphics->setFont(font);
+
+    // Text shadow
+    if (shadow)
+    {
+        graphics->setColor(guiPalette->getColor(Palette::SHADOW,
+                                                alpha / 2));
+        if (outline)
+        {
+            graphics->drawText(text, x + 2, y + 2, align);
+        }
+        else
+        {
+            graphics->drawText(text, x + 1, y + 1, align);
+        }
+    }
+
+    if (outline) {
+/*            graphics->setColor(guiPalette->getColor(Palette::OUTLINE,
+                    alpha/4));
+            // TODO: Reanable when we can draw it nicely in software mode
+            graphics->drawText(text, x + 2, y + 2, align);
+            graphics->drawText(text, x + 1, y + 2, align);
+            graphics->drawText(text, x + 2, y + 1, align);*/
+
+        // Text outline
+        graphics->setColor(guiPalette->getColor(Palette::OUTLINE, alpha));
+        graphics->drawText(text, x + 1, y, align);
+        graphics->drawText(text, x - 1, y, align);
+        graphics->drawText(text, x, y + 1, align);
+        graphics->drawText(text, x, y - 1, align);
+    }
+
+    graphics->setColor(color);
+    graphics->drawText(text, x, y, align);
+}
+
+void TextRenderer::compose(Entry &entry)
+{
+    const Key &key = entry.key;
+    const TrueTypeFont *font = static_cast<TrueTypeFont*>(key.font);
+    const bool outline = key.outlineColor >= 0;
+    const bool shadow = key.shadowColor >= 0;
+    const int shadowOffset = outline ? 2 : 1;
+
+    entry.image = NULL;
+    entry.width = font->getWidth(key.text);
+    entry.offsetX = entry.offsetY = outline ? 1 : 0;
+
+    const int extra = shadow ? shadowOffset : (outline ? 1 : 0);
+    const int width = entry.offsetX + entry.width + extra;
+    const int height = entry.offsetY + font->getHeight() + extra;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    std::vector<Uint8> coverage(width * height, 0);
+    font->renderCoverage(key.text, &coverage[0], width, height,
+                         entry.offsetX, entry.offsetY);
+
+    // The layers are composed with premultiplied alpha
+    std::vector<float> pixels(width * height * 4, 0.0f);
+
+    struct Layer
+    {
+        int dx, dy;
+        int color;
+        float alpha;
+    };
+
+    Layer layers[6];
+    int layerCount = 0;
+
+    if (shadow)
+    {
+        Layer layer = { shadowOffset, shadowOffset, key.shadowColor, 0.5f };
+        layers[layerCount++] = layer;
+    }
+
+    if (outline)
+    {
+        static const int offsets[4][2] = { { 1, 0 }, { -1, 0 },
+                                           { 0, 1 }, { 0, -1 } };
+        for (int i = 0; i < 4; ++i)
+        {
+            Layer layer = { offsets[i][0], offsets[i][1],
+                            key.outlineColor, 1.0f };
+            layers[layerCount++] = layer;
+        }
+    }
+
+    Layer fill = { 0, 0, (int) (key.color >> 8),
+                   (key.color & 0xFF) / 255.0f };
+    layers[layerCount++] = fill;
+
+    for (int l = 0; l < layerCount; ++l)
+    {
+        const Layer &layer = layers[l];
+        const float r = ((layer.color >> 16) & 0xFF) / 255.0f;
+        const float g = ((layer.color >> 8) & 0xFF) / 255.0f;
+        const float b = (layer.color & 0xFF) / 255.0f;
+
+        for (int y = 0; y < height; ++y)
+        {
+            const int sy = y - layer.dy;
+            if (sy < 0 || sy >= height)
+                continue;
+
+            for (int x = 0; x < width; ++x)
+            {
+                const int sx = x - layer.dx;
+                if (sx < 0 || sx >= width)
+                    continue;
+
+                const Uint8 c = coverage[sy * width + sx];
+                if (!c)
+                    continue;
+
+                const float a = c / 255.0f * layer.alpha;
+                float *p = &pixels[(y * width + x) * 4];
+                p[0] = r * a + p[0] * (1.0f - a);
+                p[1] = g * a + p[1] * (1.0f - a);
+                p[2] = b * a + p[2] * (1.0f - a);
+                p[3] = a + p[3] * (1.0f - a);
+            }
+        }
+    }
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            width, height, 32,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+
+    if (!surface)
+        return;
+
+    SDL_LockSurface(surface);
+
+    for (int y = 0; y < height; ++y)
+    {
+        Uint32 *row = (Uint32*) ((Uint8*) surface->pixels +
+                                 y * surface->pitch);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const float *p = &pixels[(y * width + x) * 4];
+            const float a = p[3];
+
+            if (a <= 0.0f)
+            {
+                row[x] = 0;
+                continue;
+            }
+
+            // Back to straight alpha
+            row[x] = ((Uint32) (a * 255.0f + 0.5f) << 24) |
+                     ((Uint32) (p[0] / a * 255.0f + 0.5f) << 16) |
+                     ((Uint32) (p[1] / a * 255.0f + 0.5f) << 8) |
+                     (Uint32) (p[2] / a * 255.0f + 0.5f);
+        }
+    }
+
+    SDL_UnlockSurface(surface);
+
+    entry.image = Image::load(surface);
+    SDL_FreeSurface(surface);
+}
+
+void TextRenderer::evict()
+{
+    while (mEntries.size() > 1 &&
+           (mEntries.size() > MAX_ENTRIES || mCacheBytes > MAX_CACHE_BYTES))
+    {
+        Entry &entry = mEntries.back();
+
+        if (entry.image)
+        {
+            mCacheBytes -= entry.image->getWidth() *
+                           entry.image->getHeight() * 4;
+            delete entry.image;
+        }
+
+        mIndex.erase(entry.key);
+        mEntries.pop_back();
+    }
+}
+
+void TextRenderer::clearCache()
+{
+    for (Entries::iterator i = mEntries.begin(), i_end = mEntries.end();
+         i != i_end; ++i)
+    {
+        delete i->image;
+    }
+
+    mEntries.clear();
+    mIndex.clear();
+    mCacheBytes = 0;
+}
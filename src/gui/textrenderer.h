@@ -25,61 +25,99 @@
 #include "graphics.h"
 #include "palette.h"
 
+#include <list>
+#include <map>
+#include <string>
+
+class Image;
+
 /**
  * Class for text rendering. Used by the TextParticle, the Text and FlashText
  * objects and the Preview in the color dialog.
+ *
+ * Text drawn with an outline or shadow in a TrueTypeFont is composed into a
+ * single image, which is cached so that it can be drawn in one go on the
+ * following frames.
  */
 class TextRenderer
 {
     public:
-    /**
-     * Renders a specified text.
-     */
-    static inline void renderText(gcn::Graphics *graphics,
-                                  const std::string &text,
-                                  int x, int y,
-                                  gcn::Graphics::Alignment align,
-                                  const gcn::Color &color,
-                                  gcn::Font *font,
-                                  bool outline = false,
-                                  bool shadow = false, int alpha = 255)
-    {
-        graphics->setFont(font);
+        /**
+         * Renders a specified text. Text in a color that changes over time,
+         * like a palette color with a gradient, is not cached and has to
+         * be marked as animated.
+         */
+        static void renderText(gcn::Graphics *graphics,
+                               const std::string &text,
+                               int x, int y,
+                               gcn::Graphics::Alignment align,
+                               const gcn::Color &color,
+                               gcn::Font *font,
+                               bool outline = false,
+                               bool shadow = false, int alpha = 255,
+                               bool animated = false);
+
+        /**
+         * Deletes all cached text images. Needs to be called before
+         * deleting a font that was used to render text.
+         */
+        static void clearCache();
+
+    private:
+        /**
+         * Renders a text by drawing it once for the shadow, once for each
+         * side of the outline and once more for the text itself.
+         */
+        static void renderLayers(gcn::Graphics *graphics,
+                                 const std::string &text,
+                                 int x, int y,
+                                 gcn::Graphics::Alignment align,
+                                 const gcn::Color &color,
+                                 gcn::Font *font,
+                                 bool outline, bool shadow, int alpha);
 
-        // Text shadow
-        if (shadow)
+        /**
+         * Identifies a composed text image.
+         */
+        struct Key
         {
-            graphics->setColor(guiPalette->getColor(Palette::SHADOW,
-                                                    alpha / 2));
-            if (outline)
-            {
-                graphics->drawText(text, x + 2, y + 2, align);
-            }
-            else
-            {
-                graphics->drawText(text, x + 1, y + 1, align);
-            }
-        }
+            std::string text;
+            gcn::Font *font;
+            unsigned int color; /**< RGBA color of the text */
+            int outlineColor;   /**< RGB color of the outline, if any */
+            int shadowColor;    /**< RGB color of the shadow, if any */
+
+            bool operator<(const Key &other) const;
+        };
+
+        struct Entry
+        {
+            Key key;
+            Image *image;
+            int offsetX;        /**< Position of the text in the image */
+            int offsetY;
+            int width;          /**< Width of the text, for alignment */
+        };
+
+        typedef std::list<Entry> Entries;
 
-        if (outline) {
-/*            graphics->setColor(guiPalette->getColor(Palette::OUTLINE,
-                    alpha/4));
-            // TODO: Reanable when we can draw it nicely in software mode
-            graphics->drawText(text, x + 2, y + 2, align);
-            graphics->drawText(text, x + 1, y + 2, align);
-            graphics->drawText(text, x + 2, y + 1, align);*/
+        /**
+         * Composes the image of the text with the colors of the entry's
+         * key. The image is left <code>NULL</code> when there is nothing to
+         * draw.
+         */
+        static void compose(Entry &entry);
 
-            // Text outline
-            graphics->setColor(guiPalette->getColor(Palette::OUTLINE, alpha));
-            graphics->drawText(text, x + 1, y, align);
-            graphics->drawText(text, x - 1, y, align);
-            graphics->drawText(text, x, y + 1, align);
-            graphics->drawText(text, x, y - 1, align);
-        }
+        /**
+         * Deletes the least recently used images until the cache fits its
+         * limits.
+         */
+        static void evict();
 
-        graphics->setColor(color);
-        graphics->drawText(text, x, y, align);
-    }
+        /** Cached images, most recently used first */
+        static Entries mEntries;
+        static std::map<Key, Entries::iterator> mIndex;
+        static unsigned int mCacheBytes;
 };
 
 #endif
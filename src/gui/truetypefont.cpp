@@ -22,61 +22,73 @@
 #include "gui/truetypefont.h"
 
 #include "graphics.h"
+
 #include "resources/image.h"
+#include "resources/textureatlas.h"
 
 #include <guichan/exception.hpp>
 
-#define CACHE_SIZE 256
+#include <algorithm>
 
-class TextChunk
-{
-    public:
-        TextChunk(const std::string &text, const gcn::Color &color) :
-            img(NULL), text(text), color(color)
-        {
-        }
+/** Maximum number of cached glyph images, over all colors */
+static const unsigned int MAX_GLYPH_IMAGES = 2048;
 
-        ~TextChunk()
-        {
-            delete img;
-        }
+/** Preferred width and height of the glyph atlas pages */
+static const int GLYPH_PAGE_SIZE = 256;
 
-        bool operator==(const TextChunk &chunk) const
-        {
-            return (chunk.text == text && chunk.color == color);
-        }
+/** Kerning of characters is only provided by newer versions of SDL_ttf */
+#if SDL_TTF_MAJOR_VERSION > 2 || (SDL_TTF_MAJOR_VERSION == 2 && \
+    (SDL_TTF_MINOR_VERSION > 0 || SDL_TTF_PATCHLEVEL >= 14))
+#define TTF_HAS_GLYPH_KERNING
+#endif
 
-        void generate(TTF_Font *font)
-        {
-            SDL_Color sdlCol;
-            sdlCol.b = color.b;
-            sdlCol.r = color.r;
-            sdlCol.g = color.g;
-
-            SDL_Surface *surface = TTF_RenderUTF8_Blended(
-                    font, text.c_str(), sdlCol);
+/**
+ * Decodes the UTF-8 character at the given position of the text and moves
+ * the position past it. Characters outside of the range SDL_ttf can render
+ * are replaced by a question mark.
+ */
+static Uint16 decodeUTF8(const std::string &text, std::string::size_type &pos)
+{
+    const unsigned char c = text[pos++];
 
-            if (!surface)
-            {
-                throw "Rendering font to surface failed: " +
-                    std::string(TTF_GetError());
-            }
+    int length;
+    Uint32 code;
 
-            img = Image::load(surface);
+    if (c < 0x80)
+        return c;
+    else if ((c & 0xE0) == 0xC0)
+    {
+        length = 1;
+        code = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        length = 2;
+        code = c & 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        length = 3;
+        code = c & 0x07;
+    }
+    else
+        return '?';
 
-            SDL_FreeSurface(surface);
-        }
+    for (; length > 0; --length)
+    {
+        if (pos >= text.length() || (text[pos] & 0xC0) != 0x80)
+            return '?';
 
-        Image *img;
-        std::string text;
-        gcn::Color color;
-};
+        code = (code << 6) | (text[pos++] & 0x3F);
+    }
 
-typedef std::list<TextChunk>::iterator CacheIterator;
+    return code > 0xFFFF ? '?' : code;
+}
 
 static int fontCounter;
 
-TrueTypeFont::TrueTypeFont(const std::string &filename, int size, int style)
+TrueTypeFont::TrueTypeFont(const std::string &filename, int size, int style):
+    mGlyphAtlas(0)
 {
     if (fontCounter == 0 && TTF_Init() == -1)
     {
@@ -94,10 +106,24 @@ TrueTypeFont::TrueTypeFont(const std::string &filename, int size, int style)
     }
 
     TTF_SetFontStyle(mFont, style);
+
+    GlyphMetrics unknown;
+    unknown.x = unknown.y = 0;
+    unknown.advance = -1;
+    mLowMetrics.resize(256, unknown);
+
+#ifdef USE_OPENGL
+    mGlyphAtlas = new TextureAtlas(GLYPH_PAGE_SIZE);
+#endif
 }
 
 TrueTypeFont::~TrueTypeFont()
 {
+    clearGlyphImages();
+#ifdef USE_OPENGL
+    delete mGlyphAtlas;
+#endif
+
     TTF_CloseFont(mFont);
     --fontCounter;
 
@@ -107,6 +133,95 @@ TrueTypeFont::~TrueTypeFont()
     }
 }
 
+const TrueTypeFont::GlyphMetrics &TrueTypeFont::getMetrics(Uint16 glyph) const
+{
+    GlyphMetrics *metrics;
+
+    if (glyph < mLowMetrics.size())
+    {
+        metrics = &mLowMetrics[glyph];
+        if (metrics->advance >= 0)
+            return *metrics;
+    }
+    else
+    {
+        std::map<Uint16, GlyphMetrics>::iterator i = mHighMetrics.find(glyph);
+        if (i != mHighMetrics.end())
+            return i->second;
+
+        metrics = &mHighMetrics[glyph];
+    }
+
+    int minX, maxX, minY, maxY, advance;
+    if (TTF_GlyphMetrics(mFont, glyph, &minX, &maxX, &minY, &maxY,
+                         &advance) == -1)
+    {
+        minX = maxY = advance = 0;
+    }
+
+    // Glyphs are placed the same way TTF_RenderUTF8_Blended does
+    metrics->x = minX;
+    metrics->y = TTF_FontAscent(mFont) - maxY;
+    metrics->advance = advance;
+
+    return *metrics;
+}
+
+int TrueTypeFont::getKerning(Uint16 previous, Uint16 glyph) const
+{
+#ifdef TTF_HAS_GLYPH_KERNING
+    if (previous)
+        return TTF_GetFontKerningSizeGlyphs(mFont, previous, glyph);
+#endif
+    return 0;
+}
+
+Image *TrueTypeFont::getGlyphImage(Uint16 glyph, const gcn::Color &color)
+{
+    const int rgb = (color.r << 16) | (color.g << 8) | color.b;
+    const std::pair<int, Uint16> key(rgb, glyph);
+
+    GlyphImages::iterator i = mGlyphImages.find(key);
+    if (i != mGlyphImages.end())
+        return i->second;
+
+    // Start over when many colors have been used
+    if (mGlyphImages.size() >= MAX_GLYPH_IMAGES)
+        clearGlyphImages();
+
+    SDL_Color sdlCol;
+    sdlCol.b = color.b;
+    sdlCol.r = color.r;
+    sdlCol.g = color.g;
+
+    Image *image = NULL;
+
+    // Blank glyphs like spaces may fail to render, which is fine
+    SDL_Surface *surface = TTF_RenderGlyph_Blended(mFont, glyph, sdlCol);
+
+    if (surface)
+    {
+        if (surface->w > 0 && surface->h > 0)
+            image = Image::load(surface, mGlyphAtlas);
+
+        SDL_FreeSurface(surface);
+    }
+
+    mGlyphImages[key] = image;
+    return image;
+}
+
+void TrueTypeFont::clearGlyphImages()
+{
+    for (GlyphImages::iterator i = mGlyphImages.begin(),
+         i_end = mGlyphImages.end(); i != i_end; ++i)
+    {
+        delete i->second;
+    }
+
+    mGlyphImages.clear();
+}
+
 void TrueTypeFont::drawString(gcn::Graphics *graphics,
                               const std::string &text,
                               int x, int y)
@@ -121,49 +236,99 @@ void TrueTypeFont::drawString(gcn::Graphics *graphics,
         throw "Not a valid graphics object!";
     }
 
-    gcn::Color col = g->getColor();
-    const float alpha = col.a / 255.0f;
+    const gcn::Color &col = g->getColor();
 
-    /* The alpha value is ignored at string generation so avoid caching the
-     * same text with different alpha values.
-     */
-    col.a = 255;
-
-    TextChunk chunk(text, col);
-
-    bool found = false;
+    // The alpha value is applied when drawing, so that the glyph images can
+    // be shared by all alpha values
+    const float alpha = col.a / 255.0f;
 
-    for (CacheIterator i = mCache.begin(); i != mCache.end(); ++i)
+    Uint16 previous = 0;
+    std::string::size_type pos = 0;
+    while (pos < text.length())
     {
-        if (chunk == (*i))
+        const Uint16 glyph = decodeUTF8(text, pos);
+        const GlyphMetrics &metrics = getMetrics(glyph);
+        x += getKerning(previous, glyph);
+
+        if (Image *image = getGlyphImage(glyph, col))
         {
-            // Raise priority: move it to front
-            mCache.splice(mCache.begin(), mCache, i);
-            found = true;
-            break;
+            image->setAlpha(alpha);
+            g->drawImage(image, x + metrics.x, y + metrics.y);
         }
+
+        x += metrics.advance;
+        previous = glyph;
     }
+}
 
-    // Surface not found
-    if (!found)
+void TrueTypeFont::renderCoverage(const std::string &text, Uint8 *buffer,
+                                  int width, int height, int x, int y) const
+{
+    SDL_Color white;
+    white.r = white.g = white.b = 255;
+
+    Uint16 previous = 0;
+    std::string::size_type pos = 0;
+    while (pos < text.length())
     {
-        if (mCache.size() >= CACHE_SIZE)
+        const Uint16 glyph = decodeUTF8(text, pos);
+        const GlyphMetrics &metrics = getMetrics(glyph);
+        x += getKerning(previous, glyph);
+        SDL_Surface *surface = TTF_RenderGlyph_Blended(mFont, glyph, white);
+
+        if (surface)
         {
-            mCache.pop_back();
+            const SDL_PixelFormat *format = surface->format;
+            const int left = x + metrics.x;
+            const int top = y + metrics.y;
+
+            SDL_LockSurface(surface);
+
+            for (int sy = 0; sy < surface->h; ++sy)
+            {
+                const int by = top + sy;
+                if (by < 0 || by >= height)
+                    continue;
+
+                const Uint32 *row = (const Uint32*) ((const Uint8*)
+                        surface->pixels + sy * surface->pitch);
+
+                for (int sx = 0; sx < surface->w; ++sx)
+                {
+                    const int bx = left + sx;
+                    if (bx < 0 || bx >= width)
+                        continue;
+
+                    // Glyphs may overlap slightly, keep the highest coverage
+                    const Uint8 a = (row[sx] & format->Amask) >> format->Ashift;
+                    Uint8 &covered = buffer[by * width + bx];
+                    covered = std::max(covered, a);
+                }
+            }
+
+            SDL_UnlockSurface(surface);
+            SDL_FreeSurface(surface);
         }
-        mCache.push_front(chunk);
-        mCache.front().generate(mFont);
-    }
 
-    mCache.front().img->setAlpha(alpha);
-    g->drawImage(mCache.front().img, x, y);
+        x += metrics.advance;
+        previous = glyph;
+    }
 }
 
 int TrueTypeFont::getWidth(const std::string &text) const
 {
-    int w, h;
-    TTF_SizeUTF8(mFont, text.c_str(), &w, &h);
-    return w;
+    int width = 0;
+
+    Uint16 previous = 0;
+    std::string::size_type pos = 0;
+    while (pos < text.length())
+    {
+        const Uint16 glyph = decodeUTF8(text, pos);
+        width += getKerning(previous, glyph) + getMetrics(glyph).advance;
+        previous = glyph;
+    }
+
+    return width;
 }
 
 int TrueTypeFont::getHeight() const
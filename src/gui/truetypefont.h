@@ -22,8 +22,9 @@
 #ifndef TRUETYPEFONT_H
 #define TRUETYPEFONT_H
 
-#include <list>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <guichan/font.hpp>
 #ifdef __APPLE__
@@ -36,11 +37,17 @@
 #endif
 #endif
 
-class TextChunk;
+class Image;
+class TextureAtlas;
 
 /**
  * A wrapper around SDL_ttf for allowing the use of TrueType fonts.
  *
+ * Each glyph is rendered once per color and kept as an image, which is packed
+ * into a texture atlas of the font when using OpenGL. Strings are drawn glyph by glyph,
+ * laid out using the cached glyph metrics and the kerning of the font. The
+ * kerning is only available with SDL_ttf 2.0.14 or later.
+ *
  * <b>NOTE:</b> This class initializes SDL_ttf as necessary.
  */
 class TrueTypeFont : public gcn::Font
@@ -70,11 +77,69 @@ class TrueTypeFont : public gcn::Font
                         const std::string &text,
                         int x, int y);
 
+        /**
+         * Renders the text into an alpha coverage buffer of the given size,
+         * laid out the same way as by drawString. Parts falling outside of
+         * the buffer are clipped.
+         *
+         * @param x the horizontal position of the text in the buffer
+         * @param y the vertical position of the text in the buffer
+         */
+        void renderCoverage(const std::string &text, Uint8 *buffer,
+                            int width, int height, int x, int y) const;
+
     private:
+        /**
+         * The placement of a glyph relative to the pen position.
+         */
+        struct GlyphMetrics
+        {
+            int x;          /**< Horizontal offset of the glyph image */
+            int y;          /**< Vertical offset of the glyph image */
+            int advance;    /**< Distance to the next pen position */
+        };
+
+        /**
+         * Returns the metrics of the given glyph, looking them up when
+         * they're not cached yet.
+         */
+        const GlyphMetrics &getMetrics(Uint16 glyph) const;
+
+        /**
+         * Returns the kerning between two glyphs, to be added to the pen
+         * position after the previous glyph. There is no previous glyph
+         * when it is 0.
+         */
+        int getKerning(Uint16 previous, Uint16 glyph) const;
+
+        /**
+         * Returns the image of the given glyph in the given color, rendering
+         * it when it's not cached yet. Returns <code>NULL</code> for glyphs
+         * that have nothing to draw.
+         */
+        Image *getGlyphImage(Uint16 glyph, const gcn::Color &color);
+
+        /**
+         * Deletes all cached glyph images.
+         */
+        void clearGlyphImages();
+
         TTF_Font *mFont;
 
-        // Word surfaces cache
-        std::list<TextChunk> mCache;
+        /** Metrics of the first 256 glyphs, valid when the advance is set */
+        mutable std::vector<GlyphMetrics> mLowMetrics;
+        mutable std::map<Uint16, GlyphMetrics> mHighMetrics;
+
+        /** Glyph images, keyed by RGB color and glyph */
+        typedef std::map<std::pair<int, Uint16>, Image*> GlyphImages;
+        GlyphImages mGlyphImages;
+
+        /**
+         * Holds the glyph images when using OpenGL. Its pages are freed when
+         * the glyph images are cleared, rather than leaving holes in the
+         * atlas shared by the other images.
+         */
+        TextureAtlas *mGlyphAtlas;
 };
 
 #endif
@@ -283,7 +283,7 @@ void Viewport::_drawPath(Graphics *graphics, const Path &path)
 
         graphics->fillRectangle(gcn::Rectangle(squareX, squareY, 8, 8));
         graphics->drawText(
-                toString(mMap->getMetaTile(i->x, i->y)->Gcost),
+                toString(mMap->getPathCost(i->x, i->y)),
                 squareX + 4, squareY + 12, gcn::Graphics::CENTER);
     }
 }
@@ -35,7 +35,8 @@ BrowserBox::BrowserBox(unsigned int mode, bool opaque):
     mOpaque(opaque),
     mUseLinksAndUserColors(true),
     mSelectedLink(-1),
-    mMaxRows(0)
+    mMaxRows(0),
+    mLayoutWidth(-1)
 {
     setFocusable(true);
     addMouseListener(this);
@@ -72,6 +73,7 @@ void BrowserBox::addRow(const std::string &row)
     BROWSER_LINK bLink;
     std::string::size_type idx1, idx2, idx3;
     gcn::Font *font = getFont();
+    unsigned int linkCount = 0;
 
     // Use links and user defined colors
     if (mUseLinksAndUserColors)
@@ -87,23 +89,13 @@ void BrowserBox::addRow(const std::string &row)
                 break;
             bLink.link = tmp.substr(idx1 + 2, idx2 - (idx1 + 2));
             bLink.caption = tmp.substr(idx2 + 1, idx3 - (idx2 + 1));
-            bLink.y1 = mTextRows.size() * font->getHeight();
-            bLink.y2 = bLink.y1 + font->getHeight();
-
-            newRow += tmp.substr(0, idx1);
-
-            std::string tmp2 = newRow;
-            idx1 = tmp2.find("##");
-            while (idx1 != std::string::npos)
-            {
-                tmp2.erase(idx1, 3);
-                idx1 = tmp2.find("##");
-            }
-            bLink.x1 = font->getWidth(tmp2) - 1;
-            bLink.x2 = bLink.x1 + font->getWidth(bLink.caption) + 1;
 
+            // The position of the link is set when laying out the row
+            bLink.x1 = bLink.x2 = bLink.y1 = bLink.y2 = 0;
             mLinks.push_back(bLink);
+            linkCount++;
 
+            newRow += tmp.substr(0, idx1);
             newRow += "##<" + bLink.caption;
 
             tmp.erase(0, idx3 + 2);
@@ -122,21 +114,41 @@ void BrowserBox::addRow(const std::string &row)
         newRow = row;
     }
 
-    mTextRows.push_back(newRow);
+    int y = 0;
+    if (!mRows.empty())
+        y = mRows.back().y + mRows.back().lines * font->getHeight();
+
+    mRows.push_back(Row());
+    Row &newTextRow = mRows.back();
+    newTextRow.y = y;
+    newTextRow.linkCount = linkCount;
+
+    parseRow(newTextRow, newRow);
+
+    if (mMode == AUTO_WRAP && mLayoutWidth != getWidth())
+        relayout();
+    else
+        layoutRow(newTextRow, mLinks.size() - linkCount);
 
     //discard older rows when a row limit has been set
     if (mMaxRows > 0)
     {
-        while (mTextRows.size() > mMaxRows)
+        while (mRows.size() > mMaxRows)
         {
-            mTextRows.pop_front();
-            for (unsigned int i = 0; i < mLinks.size(); i++)
-            {
-                mLinks[i].y1 -= font->getHeight();
-                mLinks[i].y2 -= font->getHeight();
+            const Row &oldRow = mRows.front();
+            const int height = oldRow.lines * font->getHeight();
+
+            mLinks.erase(mLinks.begin(), mLinks.begin() + oldRow.linkCount);
+            mRows.pop_front();
+            mSelectedLink = -1;
 
-                if (mLinks[i].y1 < 0)
-                    mLinks.erase(mLinks.begin() + i);
+            for (Rows::iterator i = mRows.begin(); i != mRows.end(); ++i)
+                i->y -= height;
+
+            for (LinkIterator i = mLinks.begin(); i != mLinks.end(); ++i)
+            {
+                i->y1 -= height;
+                i->y2 -= height;
             }
         }
     }
@@ -144,78 +156,288 @@ void BrowserBox::addRow(const std::string &row)
     // Auto size mode
     if (mMode == AUTO_SIZE)
     {
-        std::string plain = newRow;
-        for (idx1 = plain.find("##"); idx1 != std::string::npos; idx1 = plain.find("##"))
-            plain.erase(idx1, 3);
-
         // Adjust the BrowserBox size
-        int w = font->getWidth(plain);
-        if (w > getWidth())
-            setWidth(w);
+        if (mRows.back().width > getWidth())
+            setWidth(mRows.back().width);
     }
 
-    if (mMode == AUTO_WRAP)
+    setHeight(mRows.back().y + mRows.back().lines * font->getHeight());
+}
+
+void BrowserBox::parseRow(Row &row, const std::string &text)
+{
+    gcn::Font *font = getFont();
+
+    row.separator = text.find("---", 0) == 0;
+    row.lines = 1;
+    row.width = 0;
+
+    if (row.separator)
+        return;
+
+    char color = 0;
+    char prevColor = 0;
+
+    for (std::string::size_type start = 0, end = std::string::npos;
+            start != std::string::npos;
+            start = end, end = std::string::npos)
     {
-        unsigned int y = 0;
-        unsigned int nextChar;
-        const char *hyphen = "~";
-        int hyphenWidth = font->getWidth(hyphen);
-        int x = 0;
+        bool link = false;
 
-        for (TextRowIterator i = mTextRows.begin(); i != mTextRows.end(); i++)
+        // "Tokenize" the string at control sequences
+        if (mUseLinksAndUserColors)
+            end = text.find("##", start + 1);
+
+        if (mUseLinksAndUserColors || start == 0)
         {
-            std::string row = *i;
-            for (unsigned int j = 0; j < row.size(); j++)
+            // Check for color change in format "##x", x = [L,P,0..9]
+            if (text.find("##", start) == start && text.size() > start + 2)
             {
-                std::string character = row.substr(j, 1);
-                x += font->getWidth(character);
-                nextChar = j + 1;
+                const char c = text.at(start + 2);
 
-                // Wraping between words (at blank spaces)
-                if ((nextChar < row.size()) && (row.at(nextChar) == ' '))
+                if (c == '>')
                 {
-                    int nextSpacePos = row.find(" ", (nextChar + 1));
-                    if (nextSpacePos <= 0)
-                    {
-                        nextSpacePos = row.size() - 1;
-                    }
-                    int nextWordWidth = font->getWidth(
-                            row.substr(nextChar,
-                                (nextSpacePos - nextChar)));
+                    color = prevColor;
+                }
+                else if (c == '<')
+                {
+                    prevColor = color;
+                    color = c;
+                    link = true;
+                }
+                else
+                {
+                    color = c;
+                }
+                start += 3;
+
+                if (start == text.size())
+                {
+                    break;
+                }
+            }
+        }
+
+        std::string::size_type len =
+            end == std::string::npos ? end : end - start;
+
+        Run run;
+        run.text = text.substr(start, len);
+        run.color = color;
+        run.link = link;
+        run.width = font->getWidth(run.text);
+
+        row.runs.push_back(run);
+        row.width += run.width;
+    }
+}
+
+void BrowserBox::layoutRow(Row &row, unsigned int firstLink)
+{
+    row.pieces.clear();
+    row.lines = 1;
+
+    if (row.separator)
+        return;
 
-                    if ((x + nextWordWidth + 10) > getWidth())
+    gcn::Font *font = getFont();
+    const int width = getWidth();
+    const int indent = 15; // Wrapped line continuation shall be indented
+    char const *hyphen = "~";
+    const int hyphenWidth = font->getWidth(hyphen);
+
+    unsigned int link = firstLink;
+    int x = 0;
+    int line = 0;
+
+    for (std::vector<Run>::const_iterator i = row.runs.begin(),
+         i_end = row.runs.end(); i != i_end; ++i)
+    {
+        const std::string &text = i->text;
+        std::string::size_type start = 0;
+        int partWidth = i->width;
+        bool placed = false;
+
+        do
+        {
+            std::string::size_type end = text.size();
+
+            // Auto wrap mode
+            if (mMode == AUTO_WRAP && x + partWidth + 10 > width)
+            {
+                // Look for the last space that lets the text before it fit
+                end = std::string::npos;
+                for (std::string::size_type space = text.rfind(' ');
+                     space != std::string::npos && space > start;
+                     space = text.rfind(' ', space - 1))
+                {
+                    partWidth =
+                        font->getWidth(text.substr(start, space - start));
+                    if (x + partWidth + 10 <= width)
                     {
-                        x = 15; // Ident in new line
-                        y += 1;
-                        j++;
+                        end = space;
+                        break;
                     }
                 }
-                // Wrapping looong lines (brutal force)
-                else if ((x + 2 * hyphenWidth) > getWidth())
+
+                if (end == std::string::npos && x > (line ? indent : 0))
                 {
-                    x = 15; // Ident in new line
-                    y += 1;
+                    // Try again on the next line
+                    x = indent;
+                    line++;
+                    partWidth = font->getWidth(text.substr(start));
+                    continue;
+                }
+
+                if (end == std::string::npos)
+                {
+                    // Force-wrap, keeping at least one character per line
+                    end = start;
+                    partWidth = 0;
+                    while (end < text.size())
+                    {
+                        // Skip to the end of the current character
+                        std::string::size_type next = end + 1;
+                        while (next < text.size() && (text[next] & 192) == 128)
+                            next++;
+
+                        const int nextWidth =
+                            font->getWidth(text.substr(start, next - start));
+                        if (end > start &&
+                            x + nextWidth + hyphenWidth + 10 > width)
+                        {
+                            break;
+                        }
+
+                        end = next;
+                        partWidth = nextWidth;
+                    }
+
+                    if (end < text.size())
+                    {
+                        Piece notifier;
+                        notifier.text = hyphen;
+                        notifier.color = i->color;
+                        notifier.x = width - hyphenWidth;
+                        notifier.line = line;
+                        row.pieces.push_back(notifier);
+                    }
                 }
             }
-        }
 
-        setHeight(font->getHeight() * (mTextRows.size() + y));
+            Piece piece;
+            piece.text = text.substr(start, end - start);
+            piece.color = i->color;
+            piece.x = x;
+            piece.line = line;
+            row.pieces.push_back(piece);
+
+            if (i->link && !placed && link < mLinks.size())
+            {
+                BROWSER_LINK &bLink = mLinks[link];
+                bLink.x1 = x;
+                bLink.y1 = row.y + line * font->getHeight();
+                bLink.x2 = bLink.x1 + font->getWidth(bLink.caption) + 1;
+                bLink.y2 = bLink.y1 + font->getHeight() - 1;
+            }
+            placed = true;
+
+            x += partWidth;
+            start = end;
+
+            if (start < text.size())
+            {
+                // Skip the space the line was wrapped at
+                if (text[start] == ' ')
+                    start++;
+
+                x = indent;
+                line++;
+                partWidth = font->getWidth(text.substr(start));
+            }
+        } while (start < text.size());
+
+        if (i->link)
+            link++;
     }
-    else
+
+    row.lines = line + 1;
+}
+
+void BrowserBox::relayout()
+{
+    const int height = getFont()->getHeight();
+    unsigned int link = 0;
+    int y = 0;
+
+    mLayoutWidth = getWidth();
+
+    for (Rows::iterator i = mRows.begin(); i != mRows.end(); ++i)
+    {
+        i->y = y;
+        layoutRow(*i, link);
+
+        link += i->linkCount;
+        y += i->lines * height;
+    }
+
+    setHeight(y);
+}
+
+gcn::Color BrowserBox::getColor(char code) const
+{
+    const gcn::Color textColor = guiPalette->getColor(Palette::TEXT);
+
+    if (!code)
+        return textColor;
+
+    bool valid;
+    const gcn::Color col = guiPalette->getColor(code, valid);
+
+    if (valid)
+        return col;
+
+    switch (code)
     {
-        setHeight(font->getHeight() * mTextRows.size());
+        case '1': return gcn::Color(RED);
+        case '2': return gcn::Color(GREEN);
+        case '3': return gcn::Color(BLUE);
+        case '4': return gcn::Color(ORANGE);
+        case '5': return gcn::Color(YELLOW);
+        case '6': return gcn::Color(PINK);
+        case '7': return gcn::Color(PURPLE);
+        case '8': return gcn::Color(GRAY);
+        case '9': return gcn::Color(BROWN);
+        case '0':
+        default:
+            return textColor;
     }
 }
 
 void BrowserBox::clearRows()
 {
-    mTextRows.clear();
+    mRows.clear();
     mLinks.clear();
     setWidth(0);
     setHeight(0);
     mSelectedLink = -1;
+    mLayoutWidth = -1;
 }
 
+/**
+ * Tells whether a row ends above the given vertical position.
+ */
+struct RowAbove
+{
+    RowAbove(int lineHeight) : mLineHeight(lineHeight) { }
+    template<typename Row>
+    bool operator() (const Row &row, int y) const
+    {
+        return row.y + row.lines * mLineHeight <= y;
+    }
+    int mLineHeight;
+};
+
 struct MouseOverLink
 {
     MouseOverLink(int x, int y) : mX(x),mY(y) { }
@@ -278,163 +500,40 @@ void BrowserBox::draw(gcn::Graphics *graphics)
         }
     }
 
-    int x = 0, y = 0;
-    int wrappedLines = 0;
-    int link = 0;
+    if (mMode == AUTO_WRAP && mLayoutWidth != getWidth())
+        relayout();
+
     gcn::Font *font = getFont();
+    const int height = font->getHeight();
+
+    // Only draw the rows intersecting the visible area
+    const gcn::ClipRectangle &clip = graphics->getCurrentClipArea();
+    const int top = clip.y - clip.yOffset;
+    const int bottom = top + clip.height;
 
-    graphics->setColor(guiPalette->getColor(Palette::TEXT));
-    for (TextRowIterator i = mTextRows.begin(); i != mTextRows.end(); i++)
+    Rows::const_iterator i = std::lower_bound(mRows.begin(), mRows.end(),
+                                              top, RowAbove(height));
+
+    for (; i != mRows.end() && i->y < bottom; ++i)
     {
-        const gcn::Color textColor = guiPalette->getColor(Palette::TEXT);
-        gcn::Color selColor = textColor;
-        gcn::Color prevColor = selColor;
-        const std::string row = *(i);
-        bool wrapped = false;
-        x = 0;
-
-        // Check for separator lines
-        if (row.find("---", 0) == 0)
+        // Draw separator lines
+        if (i->separator)
         {
+            graphics->setColor(getColor(0));
             const int dashWidth = font->getWidth("-");
-            for (x = 0; x < getWidth(); x++)
+            for (int x = 0; x < getWidth(); x++)
             {
-                font->drawString(graphics, "-", x, y);
+                font->drawString(graphics, "-", x, i->y);
                 x += dashWidth - 2;
             }
-            y += font->getHeight();
             continue;
         }
 
-        // TODO: Check if we must take texture size limits into account here
-        // TODO: Check if some of the O(n) calls can be removed
-        for (std::string::size_type start = 0, end = std::string::npos;
-                start != std::string::npos;
-                start = end, end = std::string::npos)
+        for (std::vector<Piece>::const_iterator j = i->pieces.begin(),
+             j_end = i->pieces.end(); j != j_end; ++j)
         {
-            // Wrapped line continuation shall be indented
-            if (wrapped)
-            {
-                y += font->getHeight();
-                x = 15;
-            }
-
-            // "Tokenize" the string at control sequences
-            if (mUseLinksAndUserColors)
-                end = row.find("##", start + 1);
-
-            if (mUseLinksAndUserColors ||
-                    (!mUseLinksAndUserColors && (start == 0)))
-            {
-                // Check for color change in format "##x", x = [L,P,0..9]
-                if (row.find("##", start) == start && row.size() > start + 2)
-                {
-                    const char c = row.at(start + 2);
-                    bool valid;
-                    const gcn::Color col = guiPalette->getColor(c, valid);
-
-                    if (c == '>')
-                    {
-                        selColor = prevColor;
-                    }
-                    else if (c == '<')
-                    {
-                        const int size = mLinks[link].x2 - mLinks[link].x1;
-                        mLinks[link].x1 = x;
-                        mLinks[link].y1 = y;
-                        mLinks[link].x2 = mLinks[link].x1 + size;
-                        mLinks[link].y2 = y + font->getHeight() - 1;
-                        link++;
-                        prevColor = selColor;
-                        selColor = col;
-                    }
-                    else if (valid)
-                    {
-                        selColor = col;
-                    }
-                    else
-                    {
-                        switch (c)
-                        {
-                            case '1': selColor = RED; break;
-                            case '2': selColor = GREEN; break;
-                            case '3': selColor = BLUE; break;
-                            case '4': selColor = ORANGE; break;
-                            case '5': selColor = YELLOW; break;
-                            case '6': selColor = PINK; break;
-                            case '7': selColor = PURPLE; break;
-                            case '8': selColor = GRAY; break;
-                            case '9': selColor = BROWN; break;
-                            case '0':
-                            default:
-                                selColor = textColor;
-                        }
-                    }
-                    start += 3;
-
-                    if (start == row.size())
-                    {
-                        break;
-                    }
-                }
-                graphics->setColor(selColor);
-            }
-
-            std::string::size_type len =
-                end == std::string::npos ? end : end - start;
-            std::string part = row.substr(start, len);
-
-            // Auto wrap mode
-            if (mMode == AUTO_WRAP &&
-                    (x + font->getWidth(part) + 10) > getWidth())
-            {
-                bool forced = false;
-                char const *hyphen = "~";
-                int hyphenWidth = font->getWidth(hyphen);
-
-                /* FIXME: This code layout makes it easy to crash remote
-                   clients by talking garbage. Forged long utf-8 characters
-                   will cause either a buffer underflow in substr or an
-                   infinite loop in the main loop. */
-                do
-                {
-                    if (!forced)
-                        end = row.rfind(' ', end);
-
-                    // Check if we have to (stupidly) force-wrap
-                    if (end == std::string::npos || end <= start)
-                    {
-                        forced = true;
-                        end = row.size();
-                        x += hyphenWidth; // Account for the wrap-notifier
-                        continue;
-                    }
-
-                    // Skip to the start of the current character
-                    while ((row[end] & 192) == 128)
-                        end--;
-                    end--; // And then to the last byte of the previous one
-
-                    part = row.substr(start, end - start + 1);
-                } while (end > start && (x + font->getWidth(part) + 10) > getWidth());
-
-                if (forced)
-                {
-                    x -= hyphenWidth; // Remove the wrap-notifier accounting
-                    font->drawString(graphics, hyphen,
-                            getWidth() - hyphenWidth, y);
-                    end++; // Skip to the next character
-                }
-                else
-                    end += 2; // Skip to after the space
-
-                wrapped = true;
-                wrappedLines++;
-            }
-            font->drawString(graphics, part, x, y);
-            x += font->getWidth(part);
+            graphics->setColor(getColor(j->color));
+            font->drawString(graphics, j->text, j->x, i->y + j->line * height);
         }
-        y += font->getHeight();
-        setHeight((mTextRows.size() + wrappedLines) * font->getHeight());
     }
 }
@@ -22,9 +22,11 @@
 #ifndef BROWSERBOX_H
 #define BROWSERBOX_H
 
-#include <list>
+#include <deque>
+#include <string>
 #include <vector>
 
+#include <guichan/color.hpp>
 #include <guichan/mouselistener.hpp>
 #include <guichan/widget.hpp>
 
@@ -139,9 +141,67 @@ class BrowserBox : public gcn::Widget, public gcn::MouseListener
         };
 
     private:
-        typedef std::list<std::string> TextRows;
-        typedef TextRows::iterator TextRowIterator;
-        TextRows mTextRows;
+        /**
+         * A part of a row drawn in a single color.
+         */
+        struct Run
+        {
+            std::string text;
+            char color;         /**< Color code, 0 for the text color */
+            bool link;          /**< Whether this run is a link caption */
+            int width;
+        };
+
+        /**
+         * A piece of text placed by the layout.
+         */
+        struct Piece
+        {
+            std::string text;
+            char color;
+            int x;
+            int line;           /**< Line within the row */
+        };
+
+        /**
+         * A row of text, parsed into runs when it is added. The pieces are
+         * laid out again only when the width of the browser box changes.
+         */
+        struct Row
+        {
+            std::vector<Run> runs;
+            std::vector<Piece> pieces;
+            bool separator;     /**< Whether this row is a separator line */
+            int y;              /**< Top of the row */
+            int lines;          /**< Number of lines after wrapping */
+            int width;          /**< Width of the row without wrapping */
+            unsigned int linkCount;
+        };
+
+        /**
+         * Splits the row at color changes, resolving the color codes that
+         * depend on earlier ones.
+         */
+        void parseRow(Row &row, const std::string &text);
+
+        /**
+         * Places the pieces of the row and the links in it, starting with
+         * the given link.
+         */
+        void layoutRow(Row &row, unsigned int firstLink);
+
+        /**
+         * Lays out all rows again for the current width.
+         */
+        void relayout();
+
+        /**
+         * Returns the color for the given color code.
+         */
+        gcn::Color getColor(char code) const;
+
+        typedef std::deque<Row> Rows;
+        Rows mRows;
 
         typedef std::vector<BROWSER_LINK> Links;
         typedef Links::iterator LinkIterator;
@@ -154,6 +214,7 @@ class BrowserBox : public gcn::Widget, public gcn::MouseListener
         bool mUseLinksAndUserColors;
         int mSelectedLink;
         unsigned int mMaxRows;
+        int mLayoutWidth;       /**< The width the rows were laid out for */
 };
 
 #endif
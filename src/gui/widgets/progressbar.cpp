@@ -164,7 +164,8 @@ void ProgressBar::draw(gcn::Graphics *graphics)
         TextRenderer::renderText(graphics, mText, textX, textY,
                                  gcn::Graphics::CENTER,
                                  guiPalette->getColor(Palette::PROGRESS_BAR),
-                                 gui->getFont(), true, false);
+                                 gui->getFont(), true, false, 255,
+                                 guiPalette->isAnimated(Palette::PROGRESS_BAR));
     }
 }
 
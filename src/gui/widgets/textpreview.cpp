@@ -74,8 +74,9 @@ void TextPreview::draw(gcn::Graphics* graphics)
         graphics->fillRectangle(gcn::Rectangle(1, 1, x, y));
     }
 
+    // The previewed colors are being edited, so they are not worth caching
     TextRenderer::renderText(graphics, mText, 2, 2,  gcn::Graphics::LEFT,
                              gcn::Color(mTextColor->r, mTextColor->g,
                                         mTextColor->b, alpha),
-                             mFont, mOutline, mShadow, alpha);
+                             mFont, mOutline, mShadow, alpha, true);
 }
@@ -120,7 +120,7 @@ LocalPlayer::LocalPlayer(int id, int job, Map *map):
     mUpdateName = true;
 
     mTextColor = &guiPalette->getColor(Palette::PLAYER);
-    mNameColor = &guiPalette->getColor(Palette::SELF);
+    mNameColor = Palette::SELF;
 
     initTargetCursor();
 
@@ -165,7 +165,7 @@ void LocalPlayer::logic()
                     (int) pos.y - 48,*/
                     getPixelX(),
                     getPixelY() - 48,
-                    &guiPalette->getColor(info.second),
+                    info.second,
                     gui->getInfoParticleFont(), true);
 
             mMessages.pop_front();
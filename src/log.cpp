@@ -34,9 +34,14 @@
 
 #include "gui/widgets/chattab.h"
 
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
 Logger::Logger():
     mLogToStandardOut(false),
-    mChatWindow(NULL)
+    mChatWindow(NULL),
+    mMutex(SDL_CreateMutex()),
+    mMainThread(SDL_ThreadID())
 {
 }
 
@@ -46,6 +51,8 @@ Logger::~Logger()
     {
         mLogFile.close();
     }
+
+    SDL_DestroyMutex(mMutex);
 }
 
 void Logger::setLogFile(const std::string &logFilename)
@@ -94,6 +101,8 @@ void Logger::log(const char *log_text, ...)
         << (int)((tv.tv_usec / 10000) % 100)
         << "] ";
 
+    SDL_mutexP(mMutex);
+
     mLogFile << timeStr.str() << buf << std::endl;
 
     if (mLogToStandardOut)
@@ -101,7 +110,9 @@ void Logger::log(const char *log_text, ...)
         std::cout << timeStr.str() << buf << std::endl;
     }
 
-    if (mChatWindow)
+    SDL_mutexV(mMutex);
+
+    if (mChatWindow && SDL_ThreadID() == mMainThread)
     {
         localChatTab->chatLog(buf, BY_LOGGER);
     }
@@ -25,6 +25,7 @@
 #include <fstream>
 
 class ChatWindow;
+struct SDL_mutex;
 
 /**
  * The Log Class : Useful to write debug or info messages
@@ -59,6 +60,8 @@ class Logger
 
         /**
          * Enters a message in the log. The message will be timestamped.
+         * Messages may be logged from any thread, but only the ones logged
+         * from the thread that created the logger go to the chat window.
          */
         void log(const char *log_text, ...)
 #ifdef __GNUC__
@@ -76,6 +79,8 @@ class Logger
         std::ofstream mLogFile;
         bool mLogToStandardOut;
         ChatWindow *mChatWindow;
+        SDL_mutex *mMutex;
+        unsigned int mMainThread;
 };
 
 extern Logger *logger;
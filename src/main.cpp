@@ -70,6 +70,7 @@
 #include "net/worldinfo.h"
 
 #include "resources/colordb.h"
+#include "resources/datafile.h"
 #include "resources/emotedb.h"
 #include "resources/image.h"
 #include "resources/itemdb.h"
@@ -79,6 +80,7 @@
 
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
+#include "utils/taskpool.h"
 
 #include <SDL_image.h>
 
@@ -424,6 +426,8 @@ static void initEngine(const Options &options)
 
     // Setup image loading for the right image format
     Image::setLoadAsOpenGL(useOpenGL);
+    Image::setUseAtlas(useOpenGL &&
+                       config.getValue("textureAtlas", 1) == 1);
 
     // Create the graphics context
     graphics = useOpenGL ? new OpenGLGraphics : new Graphics;
@@ -846,6 +850,7 @@ int main(int argc, char *argv[])
         {
             Net::getGeneralHandler()->flushNetwork();
         }
+        ResourceManager::getInstance()->processAsyncLoads();
         gui->logic();
 
         if (progressBar && progressBar->isVisible())
@@ -1050,15 +1055,27 @@ int main(int argc, char *argv[])
                             false);
                     }
 
-                    // Load XML databases
-                    ColorDB::load();
-                    ItemDB::load();
-                    Being::load(); // Hairstyles
-                    MonsterDB::load();
-                    NPCDB::load();
-                    EmoteDB::load();
-                    StatusEffect::load();
-                    Units::loadUnits();
+                    // Load XML databases, keeping compiled copies of the
+                    // larger ones next to the updates
+                    DataFile::setCacheDirectory(updatesDir + "/cache");
+                    {
+                        TaskPool pool(config.getValue("loaderThreads", 2));
+                        pool.add("ColorDB", ColorDB::load);
+                        pool.add("ItemDB", ItemDB::load);
+                        pool.add("MonsterDB", MonsterDB::load);
+                        pool.add("NPCDB", NPCDB::load);
+                        pool.add("StatusEffect", StatusEffect::load);
+                        pool.add("Units", Units::loadUnits);
+                        pool.start();
+
+                        // Emotes load sprites, which needs the main thread
+                        pool.run("EmoteDB", EmoteDB::load);
+                        pool.wait();
+
+                        // Hairstyles are counted from the item database
+                        pool.run("Hairstyles", Being::load);
+                        pool.logTimes("Loading the databases");
+                    }
 
                     desktop->reloadWallpaper();
 
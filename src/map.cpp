@@ -19,7 +19,8 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#include <queue>
+#include <algorithm>
+#include <cstring>
 
 #include "beingmanager.h"
 #include "configuration.h"
@@ -27,6 +28,7 @@
 #include "graphics.h"
 #include "map.h"
 #include "particle.h"
+#include "pathfinder.h"
 #include "simpleanimation.h"
 #include "sprite.h"
 #include "tileset.h"
@@ -45,30 +47,6 @@ extern volatile int tick_time;
  */
 const int DEFAULT_TILE_SIDE_LENGTH = 32;
 
-/**
- * A location on a tile map. Used for pathfinding, open list.
- */
-struct Location
-{
-    /**
-     * Constructor.
-     */
-    Location(int px, int py, MetaTile *ptile):
-        x(px), y(py), tile(ptile)
-    {}
-
-    /**
-     * Comparison operator.
-     */
-    bool operator< (const Location &loc) const
-    {
-        return tile->Fcost > loc.tile->Fcost;
-    }
-
-    int x, y;
-    MetaTile *tile;
-};
-
 TileAnimation::TileAnimation(Animation *ani):
     mLastImage(NULL)
 {
@@ -101,100 +79,41 @@ void TileAnimation::update(int ticks)
     }
 }
 
-MapLayer::MapLayer(int x, int y, int width, int height, bool isFringeLayer):
-    mX(x), mY(y),
-    mWidth(width), mHeight(height),
-    mIsFringeLayer(isFringeLayer)
-{
-    const int size = mWidth * mHeight;
-    mTiles = new Image*[size];
-    std::fill_n(mTiles, size, (Image*) 0);
-}
-
-MapLayer::~MapLayer()
-{
-    delete[] mTiles;
-}
-
-void MapLayer::setTile(int x, int y, Image *img)
-{
-    setTile(x + y * mWidth, img);
-}
-
-Image* MapLayer::getTile(int x, int y) const
+void TileAnimation::addAffectedTile(MapLayer *layer, int index)
 {
-    return mTiles[x + y * mWidth];
-}
-
-void MapLayer::draw(Graphics *graphics, int startX, int startY,
-                    int endX, int endY, int scrollX, int scrollY,
-                    const MapSprites &sprites) const
-{
-    startX -= mX;
-    startY -= mY;
-    endX -= mX;
-    endY -= mY;
-
-    if (startX < 0) startX = 0;
-    if (startY < 0) startY = 0;
-    if (endX > mWidth) endX = mWidth;
-    if (endY > mHeight) endY = mHeight;
-
-    MapSprites::const_iterator si = sprites.begin();
-
-    for (int y = startY; y < endY; y++)
-    {
-        // If drawing the fringe layer, make sure all sprites above this row of
-        // tiles have been drawn
-        if (mIsFringeLayer)
-        {
-            while (si != sprites.end() && (*si)->getPixelY() <= y * 32)
-            {
-                (*si)->setAlpha(1.0f);
-                (*si)->draw(graphics, -scrollX, -scrollY);
-                si++;
-            }
-        }
-
-        for (int x = startX; x < endX; x++)
-        {
-            Image *img = getTile(x, y);
-            if (img)
-            {
-                const int px = (x + mX) * 32 - scrollX;
-                const int py = (y + mY) * 32 - scrollY + 32 - img->getHeight();
-                graphics->drawImage(img, px, py);
-            }
-        }
-    }
-
-    // Draw any remaining sprites
-    if (mIsFringeLayer)
-    {
-        while (si != sprites.end())
-        {
-            (*si)->setAlpha(1.0f);
-            (*si)->draw(graphics, -scrollX, -scrollY);
-            si++;
-        }
-    }
+    mAffected.push_back(std::make_pair(layer, index));
+    layer->setAnimated(index);
 }
 
 Map::Map(int width, int height, int tileWidth, int tileHeight):
     mWidth(width), mHeight(height),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
     mMaxTileHeight(height),
-    mOnClosedList(1), mOnOpenList(2),
+    mPrerenderLayers(config.getValue("prerenderLayers", 1)),
     mLastScrollX(0.0f), mLastScrollY(0.0f)
 {
     const int size = mWidth * mHeight;
 
+#ifdef USE_OPENGL
+    // Tiles are already drawn in batches, and can't be read back
+    if (Image::getLoadAsOpenGL())
+        mPrerenderLayers = false;
+#endif
+
     mMetaTiles = new MetaTile[size];
     for (int i = 0; i < NB_BLOCKTYPES; i++)
     {
         mOccupation[i] = new int[size];
         memset(mOccupation[i], 0, size * sizeof(int));
     }
+    mBeingOccupation = new int[size];
+    memset(mBeingOccupation, 0, size * sizeof(int));
+
+    mPathFinder = new PathFinder(mWidth, mHeight,
+                                 mMetaTiles, mBeingOccupation);
+    mPathFinder->setLongRange(config.getValue("longRangePathfinding", 0));
+    mPathFinder->setScanLimit(config.getValue("longRangeScanLimit",
+                                              PathFinder::DEFAULT_SCAN_LIMIT));
 }
 
 Map::~Map()
@@ -205,6 +124,8 @@ Map::~Map()
     {
         delete[] mOccupation[i];
     }
+    delete[] mBeingOccupation;
+    delete mPathFinder;
     delete_all(mLayers);
     delete_all(mTilesets);
     delete_all(mOverlays);
@@ -286,6 +207,12 @@ void Map::draw(Graphics *graphics, int scrollX, int scrollY)
     Layers::const_iterator layeri = mLayers.begin();
     for (; layeri != mLayers.end(); ++layeri)
     {
+        if (mPrerenderLayers && !(*layeri)->isFringeLayer())
+        {
+            (*layeri)->drawPrerendered(graphics, scrollX, scrollY);
+            continue;
+        }
+
         (*layeri)->draw(graphics,
                         startX, startY, endX, endY,
                         scrollX, scrollY,
@@ -434,6 +361,8 @@ void Map::blockTile(int x, int y, BlockType type)
 
     const int tileNum = x + y * mWidth;
 
+    mPathFinder->blockmaskChanged();
+
     if ((++mOccupation[type][tileNum]) > 0)
     {
         switch (type)
@@ -464,19 +393,27 @@ bool Map::getWalk(int x, int y, unsigned char walkmask) const
     return !(mMetaTiles[x + y * mWidth].blockmask & walkmask);
 }
 
-bool Map::occupied(int x, int y) const
+void Map::occupyTile(int x, int y)
 {
-    const Beings &beings = beingManager->getAll();
-    for (Beings::const_iterator i = beings.begin(); i != beings.end(); i++)
-    {
-        const Being *being = *i;
+    if (!contains(x, y))
+        return;
 
-        // job 45 is a portal, they don't collide
-        if (being->getTileX() == x && being->getTileY() == y && being->mJob != 45)
-            return true;
-    }
+    if (mBeingOccupation[x + y * mWidth]++ == 0)
+        mPathFinder->beingCountChanged(x, y);
+}
+
+void Map::freeTile(int x, int y)
+{
+    if (!contains(x, y) || mBeingOccupation[x + y * mWidth] == 0)
+        return;
+
+    if (--mBeingOccupation[x + y * mWidth] == 0)
+        mPathFinder->beingCountChanged(x, y);
+}
 
-    return false;
+bool Map::occupied(int x, int y) const
+{
+    return contains(x, y) && mBeingOccupation[x + y * mWidth] > 0;
 }
 
 bool Map::contains(int x, int y) const
@@ -513,190 +450,16 @@ const std::string &Map::getName() const
     return getProperty("mapname");
 }
 
-static int const basicCost = 100;
-
 Path Map::findPath(int startX, int startY, int destX, int destY,
                    unsigned char walkmask, int maxCost)
 {
-    // Path to be built up (empty by default)
-    Path path;
-
-    // Declare open list, a list with open tiles sorted on F cost
-    std::priority_queue<Location> openList;
-
-    // Return when destination not walkable
-    if (!getWalk(destX, destY, walkmask)) return path;
-
-    // Reset starting tile's G cost to 0
-    MetaTile *startTile = getMetaTile(startX, startY);
-    startTile->Gcost = 0;
-
-    // Add the start point to the open list
-    openList.push(Location(startX, startY, startTile));
-
-    bool foundPath = false;
-
-    // Keep trying new open tiles until no more tiles to try or target found
-    while (!openList.empty() && !foundPath)
-    {
-        // Take the location with the lowest F cost from the open list.
-        Location curr = openList.top();
-        openList.pop();
-
-        // If the tile is already on the closed list, this means it has already
-        // been processed with a shorter path to the start point (lower G cost)
-        if (curr.tile->whichList == mOnClosedList)
-        {
-            continue;
-        }
-
-        // Put the current tile on the closed list
-        curr.tile->whichList = mOnClosedList;
-
-        // Check the adjacent tiles
-        for (int dy = -1; dy <= 1; dy++)
-        {
-            for (int dx = -1; dx <= 1; dx++)
-            {
-                // Calculate location of tile to check
-                const int x = curr.x + dx;
-                const int y = curr.y + dy;
-
-                // Skip if if we're checking the same tile we're leaving from,
-                // or if the new location falls outside of the map boundaries
-                if ((dx == 0 && dy == 0) || !contains(x, y))
-                {
-                    continue;
-                }
-
-                MetaTile *newTile = getMetaTile(x, y);
-
-                // Skip if the tile is on the closed list or is not walkable
-                // unless its the destination tile
-                if (newTile->whichList == mOnClosedList ||
-                    ((newTile->blockmask & walkmask)
-                     && !(x == destX && y == destY)))
-                {
-                    continue;
-                }
-
-                // When taking a diagonal step, verify that we can skip the
-                // corner.
-                if (dx != 0 && dy != 0)
-                {
-                    MetaTile *t1 = getMetaTile(curr.x, curr.y + dy);
-                    MetaTile *t2 = getMetaTile(curr.x + dx, curr.y);
-
-                    if ((t1->blockmask | t2->blockmask) & BLOCKMASK_WALL)
-                        continue;
-                }
-
-                // Calculate G cost for this route, ~sqrt(2) for moving diagonal
-                int Gcost = curr.tile->Gcost +
-                    (dx == 0 || dy == 0 ? basicCost : basicCost * 362 / 256);
-
-                /* Demote an arbitrary direction to speed pathfinding by
-                   adding a defect (TODO: change depending on the desired
-                   visual effect, e.g. a cross-product defect toward
-                   destination).
-                   Important: as long as the total defect along any path is
-                   less than the basicCost, the pathfinder will still find one
-                   of the shortest paths! */
-                if (dx == 0 || dy == 0)
-                {
-                    // Demote horizontal and vertical directions, so that two
-                    // consecutive directions cannot have the same Fcost.
-                    ++Gcost;
-                }
-
-                // It costs extra to walk through a being (needs to be enough
-                // to make it more attractive to walk around).
-                if (occupied(x, y))
-                {
-                    Gcost += 3 * basicCost;
-                }
-
-                // Skip if Gcost becomes too much
-                // Warning: probably not entirely accurate
-                if (Gcost > maxCost * basicCost)
-                {
-                    continue;
-                }
-
-                if (newTile->whichList != mOnOpenList)
-                {
-                    // Found a new tile (not on open nor on closed list)
-
-                    /* Update Hcost of the new tile. The pathfinder does not
-                       work reliably if the heuristic cost is higher than the
-                       real cost. In particular, using Manhattan distance is
-                       forbidden here. */
-                    int dx = std::abs(x - destX), dy = std::abs(y - destY);
-                    newTile->Hcost = std::abs(dx - dy) * basicCost +
-                        std::min(dx, dy) * (basicCost * 362 / 256);
-
-                    // Set the current tile as the parent of the new tile
-                    newTile->parentX = curr.x;
-                    newTile->parentY = curr.y;
-
-                    // Update Gcost and Fcost of new tile
-                    newTile->Gcost = Gcost;
-                    newTile->Fcost = Gcost + newTile->Hcost;
-
-                    if (x != destX || y != destY) {
-                        // Add this tile to the open list
-                        newTile->whichList = mOnOpenList;
-                        openList.push(Location(x, y, newTile));
-                    }
-                    else {
-                        // Target location was found
-                        foundPath = true;
-                    }
-                }
-                else if (Gcost < newTile->Gcost)
-                {
-                    // Found a shorter route.
-                    // Update Gcost and Fcost of the new tile
-                    newTile->Gcost = Gcost;
-                    newTile->Fcost = Gcost + newTile->Hcost;
-
-                    // Set the current tile as the parent of the new tile
-                    newTile->parentX = curr.x;
-                    newTile->parentY = curr.y;
-
-                    // Add this tile to the open list (it's already
-                    // there, but this instance has a lower F score)
-                    openList.push(Location(x, y, newTile));
-                }
-            }
-        }
-    }
-
-    // Two new values to indicate whether a tile is on the open or closed list,
-    // this way we don't have to clear all the values between each pathfinding.
-    mOnClosedList += 2;
-    mOnOpenList += 2;
-
-    // If a path has been found, iterate backwards using the parent locations
-    // to extract it.
-    if (foundPath)
-    {
-        int pathX = destX;
-        int pathY = destY;
-
-        while (pathX != startX || pathY != startY)
-        {
-            // Add the new path node to the start of the path list
-            path.push_front(Position(pathX, pathY));
-
-            // Find out the next parent
-            MetaTile *tile = getMetaTile(pathX, pathY);
-            pathX = tile->parentX;
-            pathY = tile->parentY;
-        }
-    }
+    return mPathFinder->findPath(startX, startY, destX, destY,
+                                 walkmask, maxCost);
+}
 
-    return path;
+int Map::getPathCost(int x, int y) const
+{
+    return mPathFinder->getPathCost(x, y);
 }
 
 void Map::addParticleEffect(const std::string &effectFile, int x, int y)
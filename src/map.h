@@ -25,6 +25,7 @@
 #include <list>
 #include <vector>
 
+#include "maplayer.h"
 #include "position.h"
 #include "properties.h"
 
@@ -32,15 +33,13 @@ class Animation;
 class AmbientOverlay;
 class Graphics;
 class Image;
-class MapLayer;
 class Particle;
+class PathFinder;
 class SimpleAnimation;
 class Sprite;
 class Tileset;
 
 typedef std::vector<Tileset*> Tilesets;
-typedef std::list<Sprite*> MapSprites;
-typedef MapSprites::iterator MapSprite;
 typedef std::vector<MapLayer*> Layers;
 
 extern const int DEFAULT_TILE_SIDE_LENGTH;
@@ -49,21 +48,17 @@ extern const int DEFAULT_TILE_SIDE_LENGTH;
  * A meta tile stores additional information about a location on a tile map.
  * This is information that doesn't need to be repeated for each tile in each
  * layer of the map.
+ *
+ * The pathfinding state is kept separately (see PathFinder), so that the
+ * grid of meta tiles stays compact.
  */
 struct MetaTile
 {
     /**
      * Constructor.
      */
-    MetaTile() : whichList(0), blockmask(0) {}
-
-    // Pathfinding members
-    int Fcost;               /**< Estimation of total path cost */
-    int Gcost;               /**< Cost from start to this location */
-    int Hcost;               /**< Estimated cost to goal */
-    int whichList;           /**< No list, open list or closed list */
-    int parentX;             /**< X coordinate of parent tile */
-    int parentY;             /**< Y coordinate of parent tile */
+    MetaTile() : blockmask(0) {}
+
     unsigned char blockmask; /**< Blocking properties of this tile */
 };
 
@@ -76,69 +71,13 @@ class TileAnimation
         TileAnimation(Animation *ani);
         ~TileAnimation();
         void update(int ticks = 1);
-        void addAffectedTile(MapLayer *layer, int index)
-        { mAffected.push_back(std::make_pair(layer, index)); }
+        void addAffectedTile(MapLayer *layer, int index);
     private:
         std::list<std::pair<MapLayer*, int> > mAffected;
         SimpleAnimation *mAnimation;
         Image *mLastImage;
 };
 
-/**
- * A map layer. Stores a grid of tiles and their offset, and implements layer
- * rendering.
- */
-class MapLayer
-{
-    public:
-        /**
-         * Constructor, taking layer origin, size and whether this layer is the
-         * fringe layer. The fringe layer is the layer that draws the sprites.
-         * There can be only one fringe layer per map.
-         */
-        MapLayer(int x, int y, int width, int height, bool isFringeLayer);
-
-        /**
-         * Destructor.
-         */
-        ~MapLayer();
-
-        /**
-         * Set tile image, with x and y in layer coordinates.
-         */
-        void setTile(int x, int y, Image *img);
-
-        /**
-         * Set tile image with x + y * width already known.
-         */
-        void setTile(int index, Image *img) { mTiles[index] = img; }
-
-        /**
-         * Get tile image, with x and y in layer coordinates.
-         */
-        Image *getTile(int x, int y) const;
-
-        /**
-         * Draws this layer to the given graphics context. The coordinates are
-         * expected to be in map range and will be translated to local layer
-         * coordinates and clipped to the layer's dimensions.
-         *
-         * The given sprites are only drawn when this layer is the fringe
-         * layer.
-         */
-        void draw(Graphics *graphics,
-                  int startX, int startY,
-                  int endX, int endY,
-                  int scrollX, int scrollY,
-                  const MapSprites &sprites) const;
-
-    private:
-        int mX, mY;
-        int mWidth, mHeight;
-        bool mIsFringeLayer;    /**< Whether the sprites are drawn. */
-        Image **mTiles;
-};
-
 /**
  * A tile map.
  */
@@ -229,6 +168,17 @@ class Map : public Properties
         bool getWalk(int x, int y,
                      unsigned char walkmask = BLOCKMASK_WALL) const;
 
+        /**
+         * Marks a tile as occupied by a being. Each call should be matched
+         * by a call to freeTile once the being leaves the tile.
+         */
+        void occupyTile(int x, int y);
+
+        /**
+         * Releases a tile previously marked by occupyTile.
+         */
+        void freeTile(int x, int y);
+
         /**
          * Tells whether a tile is occupied by a being.
          */
@@ -259,10 +209,20 @@ class Map : public Properties
 
         /**
          * Find a path from one location to the next.
+         *
+         * When long range pathfinding is enabled in the configuration,
+         * destinations that can't be reached within maxCost are searched
+         * for with a jump point search that has no cost limit.
          */
         Path findPath(int startX, int startY, int destX, int destY,
                       unsigned char walkmask, int maxCost = 20);
 
+        /**
+         * Returns the cost of reaching the given tile during the last call
+         * to findPath, or 0 when the tile wasn't reached. Used for debugging.
+         */
+        int getPathCost(int x, int y) const;
+
         /**
          * Adds a sprite to the map.
          */
@@ -311,6 +271,11 @@ class Map : public Properties
          */
         int *mOccupation[NB_BLOCKTYPES];
 
+        /**
+         * Number of beings standing on each tile
+         */
+        int *mBeingOccupation;
+
         int mWidth, mHeight;
         int mTileWidth, mTileHeight;
         int mMaxTileHeight;
@@ -319,8 +284,9 @@ class Map : public Properties
         Tilesets mTilesets;
         MapSprites mSprites;
 
-        // Pathfinding members
-        int mOnClosedList, mOnOpenList;
+        PathFinder *mPathFinder;
+
+        bool mPrerenderLayers;  /**< Whether static layers use chunks */
 
         // Overlay data
         std::list<AmbientOverlay*> mOverlays;
@@ -0,0 +1,415 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "maplayer.h"
+
+#include "graphics.h"
+#include "sprite.h"
+
+#include "resources/image.h"
+
+#include "utils/dtor.h"
+
+#include <algorithm>
+
+/**
+ * The width and height in pixels of the chunks static layers are
+ * prerendered in.
+ */
+static const int CHUNK_SIZE = 256;
+
+MapLayer::MapLayer(int x, int y, int width, int height, bool isFringeLayer):
+    mX(x), mY(y),
+    mWidth(width), mHeight(height),
+    mMaxTileWidth(32), mMaxTileHeight(32),
+    mIsFringeLayer(isFringeLayer),
+    mHasAnimatedTiles(false),
+    mLiveValid(true),
+    mChunkStartX(0), mChunkStartY(0), mChunkEndX(0), mChunkEndY(0)
+{
+    const int size = mWidth * mHeight;
+    mTiles = new Image*[size];
+    std::fill_n(mTiles, size, (Image*) 0);
+    mAnimated.resize(size, false);
+    mLive.resize(size, false);
+
+    mChunkColumns = ((mX + mWidth) * 32 + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    mChunkRows = ((mY + mHeight) * 32 + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    mChunks.resize(mChunkColumns * mChunkRows, (Image*) 0);
+    mChunkValid.resize(mChunkColumns * mChunkRows, false);
+}
+
+MapLayer::~MapLayer()
+{
+    delete[] mTiles;
+    delete_all(mChunks);
+}
+
+void MapLayer::setTile(int x, int y, Image *img)
+{
+    setTile(x + y * mWidth, img);
+}
+
+void MapLayer::setTile(int index, Image *img)
+{
+    Image *oldImg = mTiles[index];
+    mTiles[index] = img;
+
+    if (img)
+    {
+        mMaxTileWidth = std::max(mMaxTileWidth, img->getWidth());
+        mMaxTileHeight = std::max(mMaxTileHeight, img->getHeight());
+    }
+
+    // Tiles drawn live are not part of the prerendered chunks
+    if (!mLive[index])
+        invalidateTile(index, oldImg, img);
+
+    // Other tiles may now overlap a tile drawn live
+    if (mHasAnimatedTiles && (!mLive[index] || !oldImg || !img ||
+                              oldImg->getWidth() != img->getWidth() ||
+                              oldImg->getHeight() != img->getHeight()))
+    {
+        mLiveValid = false;
+    }
+}
+
+void MapLayer::setAnimated(int index)
+{
+    if (mAnimated[index])
+        return;
+
+    mAnimated[index] = true;
+    mHasAnimatedTiles = true;
+    mLiveValid = false;
+}
+
+void MapLayer::updateLiveTiles() const
+{
+    mLiveValid = true;
+
+    const int reachX = (mMaxTileWidth + 31) / 32;
+    const int reachY = (mMaxTileHeight + 31) / 32;
+
+    for (int y = 0; y < mHeight; y++)
+    {
+        for (int x = 0; x < mWidth; x++)
+        {
+            const int index = x + y * mWidth;
+            Image *img = mTiles[index];
+            bool live = mAnimated[index];
+
+            // Tiles are aligned to the bottom left corner of their position,
+            // look for earlier tiles drawn live that this one overlaps
+            if (!live && img)
+            {
+                const int left = x * 32;
+                const int right = left + img->getWidth();
+                const int bottom = (y + 1) * 32;
+                const int top = bottom - img->getHeight();
+
+                for (int ty = std::max(0, y - reachY); ty <= y && !live; ty++)
+                {
+                    const int endX = ty < y ? std::min(mWidth, x + reachX + 1)
+                                            : x;
+                    for (int tx = std::max(0, x - reachX); tx < endX; tx++)
+                    {
+                        const int other = tx + ty * mWidth;
+                        const Image *otherImg = mTiles[other];
+                        if (!mLive[other] || !otherImg)
+                            continue;
+
+                        const int otherLeft = tx * 32;
+                        const int otherBottom = (ty + 1) * 32;
+                        if (left < otherLeft + otherImg->getWidth() &&
+                            otherLeft < right &&
+                            top < otherBottom &&
+                            otherBottom - otherImg->getHeight() < bottom)
+                        {
+                            live = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // The chunks covering the tile need to be rendered again
+            if (live != mLive[index])
+            {
+                mLive[index] = live;
+                invalidateTile(index, img, 0);
+            }
+        }
+    }
+}
+
+void MapLayer::invalidateTile(int index, Image *oldImg, Image *img) const
+{
+    int width = 0;
+    int height = 0;
+
+    if (oldImg)
+    {
+        width = oldImg->getWidth();
+        height = oldImg->getHeight();
+    }
+    if (img)
+    {
+        width = std::max(width, img->getWidth());
+        height = std::max(height, img->getHeight());
+    }
+
+    // Tiles are aligned to the bottom left corner of their position
+    const int x = index % mWidth + mX;
+    const int y = index / mWidth + mY;
+    invalidate(x * 32, (y + 1) * 32 - height, width, height);
+}
+
+void MapLayer::invalidate(int x, int y, int width, int height) const
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    const int startX = std::max(0, x / CHUNK_SIZE);
+    const int startY = std::max(0, y / CHUNK_SIZE);
+    const int endX = std::min(mChunkColumns, (x + width - 1) / CHUNK_SIZE + 1);
+    const int endY = std::min(mChunkRows, (y + height - 1) / CHUNK_SIZE + 1);
+
+    for (int cy = startY; cy < endY; cy++)
+    {
+        for (int cx = startX; cx < endX; cx++)
+        {
+            const int i = cx + cy * mChunkColumns;
+            delete mChunks[i];
+            mChunks[i] = 0;
+            mChunkValid[i] = false;
+        }
+    }
+}
+
+Image* MapLayer::getTile(int x, int y) const
+{
+    return mTiles[x + y * mWidth];
+}
+
+void MapLayer::draw(Graphics *graphics, int startX, int startY,
+                    int endX, int endY, int scrollX, int scrollY,
+                    const MapSprites &sprites) const
+{
+    startX -= mX;
+    startY -= mY;
+    endX -= mX;
+    endY -= mY;
+
+    if (startX < 0) startX = 0;
+    if (startY < 0) startY = 0;
+    if (endX > mWidth) endX = mWidth;
+    if (endY > mHeight) endY = mHeight;
+
+    MapSprites::const_iterator si = sprites.begin();
+
+    for (int y = startY; y < endY; y++)
+    {
+        // If drawing the fringe layer, make sure all sprites above this row of
+        // tiles have been drawn
+        if (mIsFringeLayer)
+        {
+            while (si != sprites.end() && (*si)->getPixelY() <= y * 32)
+            {
+                (*si)->setAlpha(1.0f);
+                (*si)->draw(graphics, -scrollX, -scrollY);
+                si++;
+            }
+        }
+
+        for (int x = startX; x < endX; x++)
+        {
+            Image *img = getTile(x, y);
+            if (img)
+            {
+                const int px = (x + mX) * 32 - scrollX;
+                const int py = (y + mY) * 32 - scrollY + 32 - img->getHeight();
+                graphics->drawImage(img, px, py);
+            }
+        }
+    }
+
+    // Draw any remaining sprites
+    if (mIsFringeLayer)
+    {
+        while (si != sprites.end())
+        {
+            (*si)->setAlpha(1.0f);
+            (*si)->draw(graphics, -scrollX, -scrollY);
+            si++;
+        }
+    }
+}
+
+void MapLayer::drawPrerendered(Graphics *graphics,
+                               int scrollX, int scrollY) const
+{
+    if (!mLiveValid)
+        updateLiveTiles();
+
+    const int startX = std::max(0, scrollX / CHUNK_SIZE);
+    const int startY = std::max(0, scrollY / CHUNK_SIZE);
+    const int endX = std::min(mChunkColumns,
+            (scrollX + graphics->getWidth() - 1) / CHUNK_SIZE + 1);
+    const int endY = std::min(mChunkRows,
+            (scrollY + graphics->getHeight() - 1) / CHUNK_SIZE + 1);
+
+    // When scrolling into other chunks, free the ones that are out of sight,
+    // keeping a margin of one chunk to avoid rendering them again when
+    // scrolling back and forth.
+    if (startX != mChunkStartX || startY != mChunkStartY ||
+        endX != mChunkEndX || endY != mChunkEndY)
+    {
+        for (int cy = 0; cy < mChunkRows; cy++)
+        {
+            for (int cx = 0; cx < mChunkColumns; cx++)
+            {
+                if (cx >= startX - 1 && cx <= endX &&
+                    cy >= startY - 1 && cy <= endY)
+                    continue;
+
+                const int i = cx + cy * mChunkColumns;
+                delete mChunks[i];
+                mChunks[i] = 0;
+                mChunkValid[i] = false;
+            }
+        }
+
+        mChunkStartX = startX;
+        mChunkStartY = startY;
+        mChunkEndX = endX;
+        mChunkEndY = endY;
+    }
+
+    for (int cy = startY; cy < endY; cy++)
+    {
+        for (int cx = startX; cx < endX; cx++)
+        {
+            const int i = cx + cy * mChunkColumns;
+
+            if (!mChunkValid[i])
+            {
+                mChunks[i] = renderChunk(cx, cy);
+                mChunkValid[i] = true;
+            }
+
+            if (mChunks[i])
+            {
+                graphics->drawImage(mChunks[i],
+                                    cx * CHUNK_SIZE - scrollX,
+                                    cy * CHUNK_SIZE - scrollY);
+            }
+        }
+    }
+
+    if (!mHasAnimatedTiles)
+        return;
+
+    // Draw the visible tiles that are not kept in the chunks, row by row so
+    // that they overlap each other like they would without the chunks
+    const int tileStartX = std::max(0,
+            (scrollX - mMaxTileWidth + 32) / 32 - mX);
+    const int tileStartY = std::max(0, scrollY / 32 - mY);
+    const int tileEndX = std::min(mWidth,
+            (scrollX + graphics->getWidth() + 31) / 32 - mX);
+    const int tileEndY = std::min(mHeight,
+            (scrollY + graphics->getHeight() + mMaxTileHeight - 1) / 32 - mY);
+
+    for (int y = tileStartY; y < tileEndY; y++)
+    {
+        for (int x = tileStartX; x < tileEndX; x++)
+        {
+            const int index = x + y * mWidth;
+            Image *img = mTiles[index];
+            if (img && mLive[index])
+            {
+                const int px = (x + mX) * 32 - scrollX;
+                const int py = (y + mY) * 32 - scrollY + 32 - img->getHeight();
+                graphics->drawImage(img, px, py);
+            }
+        }
+    }
+}
+
+Image *MapLayer::renderChunk(int chunkX, int chunkY) const
+{
+    const int left = chunkX * CHUNK_SIZE;
+    const int top = chunkY * CHUNK_SIZE;
+
+    // Find the tiles overlapping this chunk, taking into account that tiles
+    // larger than 32x32 stick out to the right and to the top
+    const int startX = std::max(0, (left - mMaxTileWidth + 32) / 32 - mX);
+    const int startY = std::max(0, top / 32 - mY);
+    const int endX = std::min(mWidth,
+            (left + CHUNK_SIZE + 31) / 32 - mX);
+    const int endY = std::min(mHeight,
+            (top + CHUNK_SIZE + mMaxTileHeight - 1) / 32 - mY);
+
+    // Determine 32-bit masks based on byte order
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0x0000ff00;
+    gmask = 0x00ff0000;
+    bmask = 0xff000000;
+    amask = 0x000000ff;
+#else
+    rmask = 0x00ff0000;
+    gmask = 0x0000ff00;
+    bmask = 0x000000ff;
+    amask = 0xff000000;
+#endif
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            CHUNK_SIZE, CHUNK_SIZE, 32, rmask, gmask, bmask, amask);
+
+    if (!surface)
+        return NULL;
+
+    SDL_FillRect(surface, NULL, 0);
+
+    bool empty = true;
+
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
+        {
+            const int index = x + y * mWidth;
+            Image *img = mTiles[index];
+            if (img && !mLive[index])
+            {
+                const int px = (x + mX) * 32 - left;
+                const int py = (y + mY) * 32 - top + 32 - img->getHeight();
+                img->SDLdrawOnto(surface, px, py);
+                empty = false;
+            }
+        }
+    }
+
+    Image *chunk = empty ? 0 : Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    return chunk;
+}
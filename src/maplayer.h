@@ -0,0 +1,151 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MAPLAYER_H
+#define MAPLAYER_H
+
+#include <list>
+#include <vector>
+
+class Graphics;
+class Image;
+class Sprite;
+
+typedef std::list<Sprite*> MapSprites;
+typedef MapSprites::iterator MapSprite;
+
+/**
+ * A map layer. Stores a grid of tiles and their offset, and implements layer
+ * rendering.
+ */
+class MapLayer
+{
+    public:
+        /**
+         * Constructor, taking layer origin, size and whether this layer is the
+         * fringe layer. The fringe layer is the layer that draws the sprites.
+         * There can be only one fringe layer per map.
+         */
+        MapLayer(int x, int y, int width, int height, bool isFringeLayer);
+
+        /**
+         * Destructor.
+         */
+        ~MapLayer();
+
+        /**
+         * Set tile image, with x and y in layer coordinates.
+         */
+        void setTile(int x, int y, Image *img);
+
+        /**
+         * Set tile image with x + y * width already known.
+         */
+        void setTile(int index, Image *img);
+
+        /**
+         * Get tile image, with x and y in layer coordinates.
+         */
+        Image *getTile(int x, int y) const;
+
+        /**
+         * Marks the tile with the given index as animated. Animated tiles
+         * are left out of the prerendered chunks and drawn on top of them,
+         * so that their frame changes don't cause chunks to be rendered
+         * again. So are the tiles drawn after them that overlap them.
+         */
+        void setAnimated(int index);
+
+        /**
+         * Draws this layer to the given graphics context. The coordinates are
+         * expected to be in map range and will be translated to local layer
+         * coordinates and clipped to the layer's dimensions.
+         *
+         * The given sprites are only drawn when this layer is the fringe
+         * layer.
+         */
+        void draw(Graphics *graphics,
+                  int startX, int startY,
+                  int endX, int endY,
+                  int scrollX, int scrollY,
+                  const MapSprites &sprites) const;
+
+        /**
+         * Draws this layer using prerendered chunks of tiles, rendering the
+         * chunks that became visible, followed by the tiles that are drawn
+         * live. Only supported for layers other than the fringe layer, and
+         * only when not using OpenGL.
+         */
+        void drawPrerendered(Graphics *graphics,
+                             int scrollX, int scrollY) const;
+
+        /**
+         * Returns whether this layer is the fringe layer.
+         */
+        bool isFringeLayer() const
+        { return mIsFringeLayer; }
+
+    private:
+        /**
+         * Marks the prerendered chunks overlapping the given area, in map
+         * pixel coordinates, as outdated.
+         */
+        void invalidate(int x, int y, int width, int height) const;
+
+        /**
+         * Marks the chunks covered by the tile with the given index as
+         * outdated, given its old and new image.
+         */
+        void invalidateTile(int index, Image *oldImg, Image *img) const;
+
+        /**
+         * Determines the tiles to draw live rather than from the chunks.
+         * These are the animated tiles, and the tiles that come later in
+         * drawing order and overlap a tile drawn live. Drawing them after
+         * the chunks, by row, then keeps the order in which the tiles
+         * overlap.
+         */
+        void updateLiveTiles() const;
+
+        /**
+         * Renders the tiles overlapping the given chunk into a new image.
+         * Returns <code>NULL</code> when the chunk contains no tiles.
+         */
+        Image *renderChunk(int chunkX, int chunkY) const;
+
+        int mX, mY;
+        int mWidth, mHeight;
+        int mMaxTileWidth, mMaxTileHeight;
+        bool mIsFringeLayer;    /**< Whether the sprites are drawn. */
+        Image **mTiles;
+        std::vector<bool> mAnimated; /**< Animated tiles, by index */
+        bool mHasAnimatedTiles;
+        mutable std::vector<bool> mLive; /**< Tiles drawn live, by index */
+        mutable bool mLiveValid;
+
+        // Prerendered chunks, only kept around near the visible area
+        int mChunkColumns, mChunkRows;
+        mutable std::vector<Image*> mChunks;
+        mutable std::vector<bool> mChunkValid;
+        mutable int mChunkStartX, mChunkStartY, mChunkEndX, mChunkEndY;
+};
+
+#endif
@@ -63,7 +63,7 @@ Monster::Monster(int id, int job, Map *map):
         }
     }
 
-    mNameColor = &guiPalette->getColor(Palette::MONSTER);
+    mNameColor = Palette::MONSTER;
     mTextColor = &guiPalette->getColor(Palette::MONSTER);
 
     Being::setName(getInfo().getName());
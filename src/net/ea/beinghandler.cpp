@@ -161,7 +161,7 @@ void BeingHandler::handleMessage(Net::MessageIn &msg)
             if (speed == 0) { speed = 150; }
 
             dstBeing->setWalkSpeed(speed);
-            dstBeing->mJob = job;
+            dstBeing->setJob(job);
             hairStyle = msg.readInt16();
             weapon = msg.readInt16();
             headBottom = msg.readInt16();
@@ -490,7 +490,7 @@ void BeingHandler::handleMessage(Net::MessageIn &msg)
             }
 
             dstBeing->setWalkSpeed(speed);
-            dstBeing->mJob = job;
+            dstBeing->setJob(job);
             hairStyle = msg.readInt16();
             weapon = msg.readInt16();
             shield = msg.readInt16();
@@ -41,7 +41,7 @@ MessageOut::MessageOut(short id):
 
 void MessageOut::expand(size_t bytes)
 {
-    mNetwork->mOutSize += bytes;
+    mData = mNetwork->reserve(mData, bytes);
 }
 
 void MessageOut::writeInt16(Sint16 value)
@@ -74,8 +74,8 @@ void MessageOut::writeInt32(Sint32 value)
 void MessageOut::writeCoordinates(unsigned short x, unsigned short y,
                                   unsigned char direction)
 {
+    expand(3);
     char *data = mData + mPos;
-    mNetwork->mOutSize += 3;
     mPos += 3;
 
     short temp;
@@ -31,7 +31,9 @@
 
 #include "log.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <cstring>
 #include <sstream>
 
 /** Warning: buffers and other variables are shared,
@@ -82,10 +84,20 @@ short packet_lengths[] = {
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
 };
 
+/** Size of the buffers, the receive buffer size needs to be a power of two */
 const unsigned int BUFFER_SIZE = 65536;
 
 namespace EAthena {
 
+int sendThread(void *data)
+{
+    Network *network = static_cast<Network*>(data);
+
+    network->send();
+
+    return 0;
+}
+
 int networkThread(void *data)
 {
     Network *network = static_cast<Network*>(data);
@@ -93,8 +105,23 @@ int networkThread(void *data)
     if (!network->realConnect())
         return -1;
 
+    network->mSendThread = SDL_CreateThread(sendThread, network);
+    if (!network->mSendThread)
+    {
+        network->setError("Unable to create network sending thread");
+        return -1;
+    }
+
     network->receive();
 
+    // Wake up the sending thread so that it notices the connection is gone
+    SDL_mutexP(network->mMutex);
+    SDL_CondSignal(network->mSendCond);
+    SDL_mutexV(network->mMutex);
+
+    SDL_WaitThread(network->mSendThread, NULL);
+    network->mSendThread = NULL;
+
     return 0;
 }
 
@@ -103,15 +130,29 @@ Network *Network::mInstance = 0;
 Network::Network():
     mSocket(0),
     mInBuffer(new char[BUFFER_SIZE]),
+    mReadPos(0), mWritePos(0),
+    mMessageBuffer(new char[BUFFER_SIZE]),
     mOutBuffer(new char[BUFFER_SIZE]),
-    mInSize(0), mOutSize(0),
+    mOutSize(0),
+    mSendBuffer(new char[BUFFER_SIZE]),
+    mSendSize(0),
+    mWireBuffer(new char[BUFFER_SIZE]),
+    mSendQueueTime(0),
+    mWireSize(0),
+    mSendLatency(0),
+    mMaxSendLatency(0),
+    mSendStalls(0),
     mToSkip(0),
+    mConnection(0),
     mState(IDLE),
-    mWorkerThread(0)
+    mWorkerThread(0),
+    mSendThread(0)
 {
     SDLNet_Init();
 
     mMutex = SDL_CreateMutex();
+    mSendCond = SDL_CreateCond();
+    mSentCond = SDL_CreateCond();
     mInstance = this;
 }
 
@@ -122,11 +163,16 @@ Network::~Network()
     if (mState != IDLE && mState != NET_ERROR)
         disconnect();
 
+    SDL_DestroyCond(mSendCond);
+    SDL_DestroyCond(mSentCond);
     SDL_DestroyMutex(mMutex);
     mInstance = 0;
 
     delete[] mInBuffer;
+    delete[] mMessageBuffer;
     delete[] mOutBuffer;
+    delete[] mSendBuffer;
+    delete[] mWireBuffer;
 
     SDLNet_Quit();
 }
@@ -154,8 +200,12 @@ bool Network::connect(ServerInfo server)
 
     // Reset to sane values
     mOutSize = 0;
-    mInSize = 0;
+    mSendSize = 0;
+    mWireSize = 0;
+    mReadPos = 0;
+    mWritePos = 0;
     mToSkip = 0;
+    mConnection++;
 
     mState = CONNECTING;
     mWorkerThread = SDL_CreateThread(networkThread, this);
@@ -187,149 +237,138 @@ void Network::disconnect()
 
 void Network::registerHandler(MessageHandler *handler)
 {
-    for (const Uint16 *i = handler->handledMessages; *i; ++i)
-    {
-        mMessageHandlers[*i] = handler;
-    }
-
+    mMessageHandlers.add(handler);
     handler->setNetwork(this);
 }
 
 void Network::unregisterHandler(MessageHandler *handler)
 {
-    for (const Uint16 *i = handler->handledMessages; *i; ++i)
-    {
-        mMessageHandlers.erase(*i);
-    }
-
+    mMessageHandlers.remove(handler);
     handler->setNetwork(0);
 }
 
 void Network::clearHandlers()
 {
-    MessageHandlerIterator i;
-    for (i = mMessageHandlers.begin(); i != mMessageHandlers.end(); ++i)
+    for (unsigned int id = 0; id < mMessageHandlers.size(); ++id)
     {
-        i->second->setNetwork(0);
+        if (Net::MessageHandler *handler = mMessageHandlers.get(id))
+            static_cast<MessageHandler*>(handler)->setNetwork(0);
     }
     mMessageHandlers.clear();
 }
 
 void Network::dispatchMessages()
 {
-    while (messageReady())
+    // Only the network thread changes the write position
+    SDL_mutexP(mMutex);
+    unsigned int available = mWritePos - mReadPos;
+    SDL_mutexV(mMutex);
+
+    const unsigned int connection = mConnection;
+    unsigned int readPos = mReadPos;
+
+    if (mToSkip)
     {
-        MessageIn msg = getNextMessage();
+        const unsigned int skipped = std::min(mToSkip, available);
+        readPos += skipped;
+        available -= skipped;
+        mToSkip -= skipped;
+    }
 
-        MessageHandlerIterator iter = mMessageHandlers.find(msg.getId());
+    while (available >= 2)
+    {
+        const int msgId = readWord(readPos);
+        int len;
 
-        if (iter != mMessageHandlers.end())
-        {
-            iter->second->handleMessage(msg);
-        }
+        if (msgId == SMSG_SERVER_VERSION_RESPONSE)
+            len = 10;
+        else if (msgId < (int) (sizeof(packet_lengths) / sizeof(short)))
+            len = packet_lengths[msgId];
         else
+            len = 0;
+
+        if (len == -1)
         {
-            logger->log("Unhandled packet: %x", msg.getId());
+            if (available < 4)
+                break;
+            len = readWord(readPos + 2);
         }
 
-        skip(msg.getLength());
-    }
-}
+        // Don't get stuck on messages of unknown length
+        if (len < 2)
+            len = 2;
 
-void Network::flush()
-{
-    if (!mOutSize || mState != CONNECTED)
-        return;
+        if (available < (unsigned int) len)
+            break;
 
-    int ret;
+#ifdef DEBUG
+        logger->log("Received packet 0x%x of length %d\n", msgId, len);
+#endif
 
+        MessageIn msg(getData(readPos, len), len);
 
-    SDL_mutexP(mMutex);
-    ret = SDLNet_TCP_Send(mSocket, mOutBuffer, mOutSize);
-    if (ret < (int)mOutSize)
-    {
-        setError("Error in SDLNet_TCP_Send(): " +
-                 std::string(SDLNet_GetError()));
+        if (!mMessageHandlers.dispatch(msg))
+            logger->log("Unhandled packet: %x", msg.getId());
+
+        // The handler may have connected to another server, which resets
+        // the receive buffer
+        if (mConnection != connection)
+            return;
+
+        readPos += len;
+        available -= len;
     }
-    mOutSize = 0;
+
+    SDL_mutexP(mMutex);
+    mReadPos = readPos;
     SDL_mutexV(mMutex);
 }
 
-void Network::skip(int len)
+void Network::flush()
 {
-    SDL_mutexP(mMutex);
-    mToSkip += len;
-    if (!mInSize)
-    {
-        SDL_mutexV(mMutex);
+    if (!mOutSize || mState != CONNECTED)
         return;
-    }
 
-    if (mInSize >= mToSkip)
+    SDL_mutexP(mMutex);
+    if (mSendSize + mOutSize <= BUFFER_SIZE)
     {
-        mInSize -= mToSkip;
-        memmove(mInBuffer, mInBuffer + mToSkip, mInSize);
-        mToSkip = 0;
+        queue(mOutBuffer, mOutSize);
+        mOutSize = 0;
     }
     else
     {
-        mToSkip -= mInSize;
-        mInSize = 0;
+        // The connection can't keep up, try again on the next flush
+        mSendStalls++;
     }
     SDL_mutexV(mMutex);
 }
 
-bool Network::messageReady()
+unsigned int Network::getQueuedBytes() const
 {
-    int len = -1, msgId;
-
     SDL_mutexP(mMutex);
-    if (mInSize >= 2)
-    {
-        msgId = readWord(0);
-        if (msgId == SMSG_SERVER_VERSION_RESPONSE)
-            len = 10;
-        else
-            len = packet_lengths[msgId];
-
-        if (len == -1 && mInSize > 4)
-            len = readWord(2);
-
-    }
-
-    bool ret = (mInSize >= static_cast<unsigned int>(len));
+    const unsigned int queued = mOutSize + mSendSize + mWireSize;
     SDL_mutexV(mMutex);
 
-    return ret;
+    return queued;
 }
 
-MessageIn Network::getNextMessage()
+void Network::skip(int len)
 {
-    while (!messageReady())
-    {
-        if (mState == NET_ERROR)
-            break;
-    }
-
-    SDL_mutexP(mMutex);
-    int msgId = readWord(0);
-    int len;
-    if (msgId == SMSG_SERVER_VERSION_RESPONSE)
-        len = 10;
-    else
-        len = packet_lengths[msgId];
+    // Applied to the received data when dispatching messages
+    mToSkip += len;
+}
 
-    if (len == -1)
-        len = readWord(2);
+const char *Network::getData(unsigned int pos, unsigned int length)
+{
+    const unsigned int offset = pos & (BUFFER_SIZE - 1);
 
-#ifdef DEBUG
-    logger->log("Received packet 0x%x of length %d\n", msgId, len);
-#endif
+    if (offset + length <= BUFFER_SIZE)
+        return mInBuffer + offset;
 
-    MessageIn msg(mInBuffer, len);
-    SDL_mutexV(mMutex);
-
-    return msg;
+    const unsigned int firstPart = BUFFER_SIZE - offset;
+    memcpy(mMessageBuffer, mInBuffer + offset, firstPart);
+    memcpy(mMessageBuffer + firstPart, mInBuffer, length - firstPart);
+    return mMessageBuffer;
 }
 
 bool Network::realConnect()
@@ -396,9 +435,24 @@ void Network::receive()
                 break;
 
             case 1:
-                // Receive data from the socket
+            {
+                // Find the free space in the receive buffer
                 SDL_mutexP(mMutex);
-                ret = SDLNet_TCP_Recv(mSocket, mInBuffer + mInSize, BUFFER_SIZE - mInSize);
+                const unsigned int writePos = mWritePos;
+                const unsigned int space = BUFFER_SIZE - (mWritePos - mReadPos);
+                SDL_mutexV(mMutex);
+
+                if (space == 0)
+                {
+                    // Wait for the messages to be handled
+                    SDL_Delay(10);
+                    break;
+                }
+
+                // Receive data from the socket, straight into the buffer
+                const unsigned int offset = writePos & (BUFFER_SIZE - 1);
+                ret = SDLNet_TCP_Recv(mSocket, mInBuffer + offset,
+                                      std::min(space, BUFFER_SIZE - offset));
 
                 if (!ret)
                 {
@@ -411,25 +465,14 @@ void Network::receive()
                     setError(_("Connection to server terminated. ") +
                              std::string(SDLNet_GetError()));
                 }
-                else {
-                    mInSize += ret;
-                    if (mToSkip)
-                    {
-                        if (mInSize >= mToSkip)
-                        {
-                            mInSize -= mToSkip;
-                            memmove(mInBuffer, mInBuffer + mToSkip, mInSize);
-                            mToSkip = 0;
-                        }
-                        else
-                        {
-                            mToSkip -= mInSize;
-                            mInSize = 0;
-                        }
-                    }
+                else
+                {
+                    SDL_mutexP(mMutex);
+                    mWritePos += ret;
+                    SDL_mutexV(mMutex);
                 }
-                SDL_mutexV(mMutex);
                 break;
+            }
 
             default:
                 // more than one socket is ready..
@@ -450,6 +493,88 @@ void Network::receive()
     SDLNet_FreeSocketSet(set);
 }
 
+void Network::send()
+{
+    SDL_mutexP(mMutex);
+
+    while (mState == CONNECTED)
+    {
+        if (!mSendSize)
+        {
+            SDL_CondWait(mSendCond, mMutex);
+            continue;
+        }
+
+        // Take all queued data, so that more can be queued while sending
+        std::swap(mSendBuffer, mWireBuffer);
+        mWireSize = mSendSize;
+        mSendSize = 0;
+        const Uint32 queueTime = mSendQueueTime;
+        SDL_mutexV(mMutex);
+
+        const int ret = SDLNet_TCP_Send(mSocket, mWireBuffer, mWireSize);
+
+        SDL_mutexP(mMutex);
+        if (ret < (int) mWireSize)
+        {
+            setError("Error in SDLNet_TCP_Send(): " +
+                     std::string(SDLNet_GetError()));
+        }
+
+        const unsigned int latency = SDL_GetTicks() - queueTime;
+        mSendLatency = (mSendLatency * 7 + latency) / 8;
+        mMaxSendLatency = std::max(mMaxSendLatency, latency);
+        mWireSize = 0;
+
+        SDL_CondSignal(mSentCond);
+    }
+
+    // Don't leave the main thread waiting for room in the queue
+    SDL_CondSignal(mSentCond);
+    SDL_mutexV(mMutex);
+}
+
+void Network::queue(const char *data, unsigned int size)
+{
+    if (!mSendSize)
+        mSendQueueTime = SDL_GetTicks();
+
+    memcpy(mSendBuffer + mSendSize, data, size);
+    mSendSize += size;
+
+    SDL_CondSignal(mSendCond);
+}
+
+char *Network::reserve(char *message, unsigned int bytes)
+{
+    if (mOutSize + bytes <= BUFFER_SIZE)
+    {
+        mOutSize += bytes;
+        return message;
+    }
+
+    const unsigned int complete = message - mOutBuffer;
+    const unsigned int partial = mOutSize - complete;
+    assert(partial + bytes <= BUFFER_SIZE);
+
+    SDL_mutexP(mMutex);
+    while (mState == CONNECTED && mSendSize + complete > BUFFER_SIZE)
+    {
+        mSendStalls++;
+        SDL_CondWait(mSentCond, mMutex);
+    }
+
+    if (mState == CONNECTED)
+        queue(mOutBuffer, complete);
+    else
+        logger->log("Dropped %d bytes of outgoing messages", complete);
+    SDL_mutexV(mMutex);
+
+    memmove(mOutBuffer, message, partial);
+    mOutSize = partial + bytes;
+    return mOutBuffer;
+}
+
 Network *Network::instance()
 {
     return mInstance;
@@ -462,13 +587,12 @@ void Network::setError(const std::string &error)
     mState = NET_ERROR;
 }
 
-Uint16 Network::readWord(int pos)
+Uint16 Network::readWord(unsigned int pos) const
 {
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    return SDL_Swap16((*(Uint16*)(mInBuffer+(pos))));
-#else
-    return (*(Uint16*)(mInBuffer+(pos)));
-#endif
+    // Words are sent in little endian byte order
+    const Uint8 low = mInBuffer[pos & (BUFFER_SIZE - 1)];
+    const Uint8 high = mInBuffer[(pos + 1) & (BUFFER_SIZE - 1)];
+    return low | (high << 8);
 }
 
 }
@@ -22,6 +22,7 @@
 #ifndef NET_EA_NETWORK_H
 #define NET_EA_NETWORK_H
 
+#include "net/messagetable.h"
 #include "net/serverinfo.h"
 
 #include "net/ea/messagehandler.h"
@@ -31,7 +32,6 @@
 #include <SDL_net.h>
 #include <SDL_thread.h>
 
-#include <map>
 #include <string>
 
 /**
@@ -68,18 +68,51 @@ class Network
 
         bool isConnected() const { return mState == CONNECTED; }
 
-        int getInSize() const { return mInSize; }
+        int getInSize() const { return mWritePos - mReadPos; }
 
+        /**
+         * Skips the given number of received bytes, which may not have
+         * arrived yet.
+         */
         void skip(int len);
 
-        bool messageReady();
-
-        MessageIn getNextMessage();
-
+        /**
+         * Handles all complete messages that have been received.
+         */
         void dispatchMessages();
 
+        /**
+         * Hands the messages written since the last flush over to the
+         * sending thread. When the send queue is too full to take them,
+         * they are kept until the next flush.
+         */
         void flush();
 
+        /**
+         * Returns the number of bytes waiting to be sent.
+         */
+        unsigned int getQueuedBytes() const;
+
+        /**
+         * Returns the average time in milliseconds between flushing data
+         * and it being handed to the socket.
+         */
+        unsigned int getSendLatency() const { return mSendLatency; }
+
+        /**
+         * Returns the longest time in milliseconds it took for flushed data
+         * to be handed to the socket.
+         */
+        unsigned int getMaxSendLatency() const { return mMaxSendLatency; }
+
+        /**
+         * Returns how often flushing was delayed because the send queue was
+         * full.
+         */
+        unsigned int getSendStalls() const { return mSendStalls; }
+
+        static Network *instance();
+
         // ERROR replaced by NET_ERROR because already defined in Windows
         enum {
             IDLE,
@@ -91,36 +124,92 @@ class Network
 
     protected:
         friend int networkThread(void *data);
+        friend int sendThread(void *data);
         friend class MessageOut;
 
-        static Network *instance();
-
         void setError(const std::string &error);
 
-        Uint16 readWord(int pos);
+        /**
+         * Reads a word from the receive buffer at the given read position.
+         */
+        Uint16 readWord(unsigned int pos) const;
+
+        /**
+         * Returns a pointer to the received data at the given read position,
+         * copying it when it wraps around the end of the receive buffer.
+         */
+        const char *getData(unsigned int pos, unsigned int length);
 
         bool realConnect();
 
         void receive();
 
+        /**
+         * Sends the queued data until the connection is closed.
+         */
+        void send();
+
+        /**
+         * Extends the message being written to the outgoing buffer by the
+         * given number of bytes. When the buffer is full, the messages
+         * before it are queued, waiting for the sending thread if needed,
+         * and the message is moved to the start of the buffer.
+         *
+         * @return the location of the message
+         */
+        char *reserve(char *message, unsigned int bytes);
+
+        /**
+         * Appends data to the send queue. The mutex needs to be locked.
+         */
+        void queue(const char *data, unsigned int size);
+
         TCPsocket mSocket;
 
         ServerInfo mServer;
 
-        char *mInBuffer, *mOutBuffer;
-        unsigned int mInSize, mOutSize;
+        /**
+         * The received data is kept in a ring buffer. The network thread
+         * only advances mWritePos, and the main thread only advances
+         * mReadPos, so that the mutex is only needed to see the changes
+         * made by the other thread.
+         */
+        char *mInBuffer;
+        unsigned int mReadPos, mWritePos;
+
+        /** Messages wrapping around the end of the ring are copied here */
+        char *mMessageBuffer;
+
+        /**
+         * Messages are written to mOutBuffer by the main thread. Flushing
+         * appends them to mSendBuffer, from which the sending thread takes
+         * all queued data at once by swapping it with mWireBuffer.
+         */
+        char *mOutBuffer;
+        unsigned int mOutSize;
+        char *mSendBuffer;
+        unsigned int mSendSize;
+        char *mWireBuffer;
+        Uint32 mSendQueueTime;      /**< When the oldest queued data was flushed */
+        unsigned int mWireSize;     /**< Bytes currently being sent */
+
+        unsigned int mSendLatency;
+        unsigned int mMaxSendLatency;
+        unsigned int mSendStalls;
 
         unsigned int mToSkip;
+        unsigned int mConnection;  /**< Increased on each connect */
 
         int mState;
         std::string mError;
 
         SDL_Thread *mWorkerThread;
+        SDL_Thread *mSendThread;
         SDL_mutex *mMutex;
+        SDL_cond *mSendCond;        /**< Signalled when data is queued */
+        SDL_cond *mSentCond;        /**< Signalled when data has been sent */
 
-        typedef std::map<Uint16, MessageHandler*> MessageHandlers;
-        typedef MessageHandlers::iterator MessageHandlerIterator;
-        MessageHandlers mMessageHandlers;
+        Net::MessageTable mMessageHandlers;
 
         static Network *mInstance;
 };
@@ -60,7 +60,9 @@ bool Connection::connect(const std::string &address, short port)
     enetAddress.port = port;
 
     // Initiate the connection, allocating channel 0.
+    lockHost();
     mConnection = enet_host_connect(mClient, &enetAddress, 1);
+    unlockHost();
 
     if (!mConnection)
     {
@@ -79,9 +81,11 @@ void Connection::disconnect()
     if (!mConnection)
         return;
 
+    lockHost();
     enet_peer_disconnect(mConnection, 0);
     enet_host_flush(mClient);
     enet_peer_reset(mConnection);
+    unlockHost();
 
     mConnection = 0;
 }
@@ -92,7 +96,7 @@ bool Connection::isConnected()
                     (mConnection->state == ENET_PEER_STATE_CONNECTED) : false;
 }
 
-void Connection::send(const ManaServ::MessageOut &msg)
+void Connection::send(ManaServ::MessageOut &msg)
 {
     if (!isConnected())
     {
@@ -100,10 +104,12 @@ void Connection::send(const ManaServ::MessageOut &msg)
         return;
     }
 
-    ENetPacket *packet = enet_packet_create(msg.getData(),
-                                            msg.getDataSize(),
-                                            ENET_PACKET_FLAG_RELIABLE);
-    enet_peer_send(mConnection, 0, packet);
+    ENetPacket *packet = msg.createPacket(ENET_PACKET_FLAG_RELIABLE);
+
+    lockHost();
+    if (packet && enet_peer_send(mConnection, 0, packet) < 0)
+        enet_packet_destroy(packet);
+    unlockHost();
 }
 
 } // namespace ManaServ
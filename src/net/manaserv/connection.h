@@ -63,9 +63,10 @@ namespace ManaServ
             bool isConnected();
 
             /**
-             * Sends a message.
+             * Sends a message. The message data is handed over to ENet, so
+             * the message can't be used anymore afterwards.
              */
-            void send(const ManaServ::MessageOut &msg);
+            void send(ManaServ::MessageOut &msg);
 
         private:
             friend Connection *ManaServ::getConnection();
@@ -25,6 +25,17 @@
 namespace ManaServ
 {
     extern int connections;
+
+    /**
+     * Locks the ENet host. Needed around every use of the host or its
+     * peers, since it may be serviced by a separate thread.
+     */
+    void lockHost();
+
+    /**
+     * Unlocks the ENet host.
+     */
+    void unlockHost();
 }
 
 #endif
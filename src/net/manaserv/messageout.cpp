@@ -23,26 +23,139 @@
 
 #include <enet/enet.h>
 
+#include <SDL_mutex.h>
+
+#include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
+
+/** Capacity of newly allocated buffers */
+static const unsigned int INITIAL_CAPACITY = 64;
+
+/** Buffers that grew larger than this are freed instead of pooled */
+static const unsigned int MAX_POOLED_CAPACITY = 4096;
+
+/** Maximum number of unused buffers kept around */
+static const unsigned int MAX_POOLED_BUFFERS = 64;
+
+/**
+ * Each buffer is preceded by its capacity, so that it can be found again
+ * when ENet hands the buffer back.
+ */
+struct BufferHeader
+{
+    unsigned int capacity;
+};
+
+static std::vector<char*> bufferPool;
+
+/**
+ * Guards the pool, since ENet may destroy packets on its service thread.
+ */
+static SDL_mutex *bufferPoolMutex;
+
+static inline BufferHeader *getHeader(char *data)
+{
+    return reinterpret_cast<BufferHeader*>(data - sizeof(BufferHeader));
+}
 
 namespace ManaServ {
 
+int MessageOut::mAllocationCount = 0;
+
 MessageOut::MessageOut(short id):
         Net::MessageOut(id)
 {
+    mData = acquireBuffer();
     writeInt16(id);
 }
 
 MessageOut::~MessageOut()
 {
-    free(mData);
+    if (mData)
+        releaseBuffer(mData);
+}
+
+char *MessageOut::acquireBuffer()
+{
+    // The first buffer is always acquired before ENet can release any
+    if (!bufferPoolMutex)
+        bufferPoolMutex = SDL_CreateMutex();
+
+    SDL_mutexP(bufferPoolMutex);
+    if (!bufferPool.empty())
+    {
+        char *data = bufferPool.back();
+        bufferPool.pop_back();
+        SDL_mutexV(bufferPoolMutex);
+        return data;
+    }
+
+    mAllocationCount++;
+    SDL_mutexV(bufferPoolMutex);
+
+    BufferHeader *header = static_cast<BufferHeader*>(
+            malloc(sizeof(BufferHeader) + INITIAL_CAPACITY));
+    header->capacity = INITIAL_CAPACITY;
+    return reinterpret_cast<char*>(header + 1);
+}
+
+void MessageOut::releaseBuffer(char *data)
+{
+    SDL_mutexP(bufferPoolMutex);
+    if (getHeader(data)->capacity <= MAX_POOLED_CAPACITY &&
+        bufferPool.size() < MAX_POOLED_BUFFERS)
+    {
+        bufferPool.push_back(data);
+        data = 0;
+    }
+    SDL_mutexV(bufferPoolMutex);
+
+    if (data)
+        free(getHeader(data));
+}
+
+void MessageOut::freePacket(ENetPacket *packet)
+{
+    releaseBuffer(reinterpret_cast<char*>(packet->data));
 }
 
 void MessageOut::expand(size_t bytes)
 {
-    mData = (char*)realloc(mData, mPos + bytes);
-    mDataSize = mPos + bytes;
+    const unsigned int required = mPos + bytes;
+    unsigned int capacity = getHeader(mData)->capacity;
+
+    if (required > capacity)
+    {
+        while (capacity < required)
+            capacity *= 2;
+
+        mAllocationCount++;
+
+        BufferHeader *header = static_cast<BufferHeader*>(
+                realloc(getHeader(mData), sizeof(BufferHeader) + capacity));
+        header->capacity = capacity;
+        mData = reinterpret_cast<char*>(header + 1);
+    }
+
+    mDataSize = required;
+}
+
+ENetPacket *MessageOut::createPacket(enet_uint32 flags)
+{
+    ENetPacket *packet = enet_packet_create(mData, mDataSize,
+                                            flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    if (!packet)
+        return NULL;
+
+    // The packet owns the buffer now
+    packet->freeCallback = freePacket;
+    mData = 0;
+    mDataSize = 0;
+    mPos = 0;
+
+    return packet;
 }
 
 void MessageOut::writeInt16(Sint16 value)
@@ -24,8 +24,19 @@
 
 #include "net/messageout.h"
 
+#include <enet/enet.h>
+
 namespace ManaServ {
 
+/**
+ * Used for building an outgoing message.
+ *
+ * The data is written to a buffer taken from a pool. The buffer grows
+ * geometrically and is handed to ENet without copying when the message is
+ * sent, after which ENet returns it to the pool.
+ *
+ * \ingroup Network
+ */
 class MessageOut : public Net::MessageOut
 {
     public:
@@ -42,15 +53,43 @@ class MessageOut : public Net::MessageOut
         void writeInt16(Sint16 value);        /**< Writes a short. */
         void writeInt32(Sint32 value);        /**< Writes a long. */
 
+        /**
+         * Creates a packet that takes over the data of this message, which
+         * can't be written to anymore afterwards.
+         */
+        ENetPacket *createPacket(enet_uint32 flags);
+
+        /**
+         * Returns the number of buffers allocated since the start, which
+         * stops increasing once the pool has enough buffers.
+         */
+        static int getAllocationCount()
+        { return mAllocationCount; }
+
     protected:
         /**
-         * Expand the packet data to be able to hold more data.
-         *
-         * NOTE: For performance enhancements this method could allocate extra
-         * memory in advance instead of expanding size every time more data is
-         * added.
+         * Expand the packet data to be able to hold more data. The buffer
+         * is only reallocated when it is full, doubling its capacity.
          */
         void expand(size_t size);
+
+    private:
+        /**
+         * Returns a buffer of at least the initial capacity.
+         */
+        static char *acquireBuffer();
+
+        /**
+         * Returns a buffer to the pool, or frees it when the pool is full.
+         */
+        static void releaseBuffer(char *data);
+
+        /**
+         * Called by ENet when destroying a packet created by createPacket.
+         */
+        static void freePacket(ENetPacket *packet);
+
+        static int mAllocationCount;
 };
 
 }
@@ -26,25 +26,52 @@
 #include "net/manaserv/messagehandler.h"
 #include "net/manaserv/messagein.h"
 
+#include "net/messagetable.h"
+
+#include "configuration.h"
 #include "log.h"
 
 #include <enet/enet.h>
 
-#include <map>
+#include <SDL.h>
+#include <SDL_thread.h>
+
+/** Number of received packets the service thread can queue */
+static const unsigned int QUEUE_SIZE = 1024;
+
+/** Time in milliseconds that queued packets may be handled for per frame */
+static const Uint32 DISPATCH_BUDGET = 4;
 
 /**
  * The local host which is shared for all outgoing connections.
  */
 namespace {
     ENetHost *client;
+
+    /**
+     * When ENet is serviced by its own thread, the host is only used with
+     * this mutex locked.
+     */
+    SDL_mutex *hostMutex;
+    SDL_Thread *serviceThread;
+    bool serviceThreadRunning;
+
+    /**
+     * Packets received by the service thread. Only the service thread
+     * advances queueWritePos and only the main thread advances
+     * queueReadPos, so queueMutex is only held to exchange them.
+     */
+    ENetPacket *queue[QUEUE_SIZE];
+    unsigned int queueReadPos, queueWritePos;
+    SDL_mutex *queueMutex;
 }
 
 namespace ManaServ
 {
 
-typedef std::map<unsigned short, MessageHandler*> MessageHandlers;
-typedef MessageHandlers::iterator MessageHandlerIterator;
-static MessageHandlers mMessageHandlers;
+static Net::MessageTable mMessageHandlers;
+
+static int serviceThreadMain(void *data);
 
 void initialize()
 {
@@ -59,6 +86,19 @@ void initialize()
     {
         logger->error("Failed to create the local host.");
     }
+
+    hostMutex = SDL_CreateMutex();
+
+    if (config.getValue("networkThread", 0))
+    {
+        queueMutex = SDL_CreateMutex();
+        queueReadPos = queueWritePos = 0;
+        serviceThreadRunning = true;
+        serviceThread = SDL_CreateThread(serviceThreadMain, NULL);
+
+        if (!serviceThread)
+            logger->log("Unable to create the network service thread.");
+    }
 }
 
 void finalize()
@@ -71,10 +111,37 @@ void finalize()
                 "are network connections left!");
     }
 
+    if (serviceThread)
+    {
+        serviceThreadRunning = false;
+        SDL_WaitThread(serviceThread, NULL);
+        serviceThread = NULL;
+
+        // Throw away the packets that were never handled
+        for (; queueReadPos != queueWritePos; ++queueReadPos)
+            enet_packet_destroy(queue[queueReadPos % QUEUE_SIZE]);
+
+        SDL_DestroyMutex(queueMutex);
+        queueMutex = NULL;
+    }
+
+    SDL_DestroyMutex(hostMutex);
+    hostMutex = NULL;
+
     clearNetworkHandlers();
     enet_deinitialize();
 }
 
+void lockHost()
+{
+    SDL_mutexP(hostMutex);
+}
+
+void unlockHost()
+{
+    SDL_mutexV(hostMutex);
+}
+
 Connection *getConnection()
 {
     if (!client)
@@ -88,18 +155,12 @@ Connection *getConnection()
 
 void registerHandler(MessageHandler *handler)
 {
-    for (const Uint16 *i = handler->handledMessages; *i; i++)
-    {
-        mMessageHandlers[*i] = handler;
-    }
+    mMessageHandlers.add(handler);
 }
 
 void unregisterHandler(MessageHandler *handler)
 {
-    for (const Uint16 *i = handler->handledMessages; *i; i++)
-    {
-        mMessageHandlers.erase(*i);
-    }
+    mMessageHandlers.remove(handler);
 }
 
 void clearNetworkHandlers()
@@ -118,14 +179,7 @@ namespace
     {
         MessageIn msg((const char *)packet->data, packet->dataLength);
 
-        MessageHandlerIterator iter = mMessageHandlers.find(msg.getId());
-
-        if (iter != mMessageHandlers.end()) {
-            //logger->log("Received packet %x (%i B)",
-            //        msg.getId(), msg.getLength());
-            iter->second->handleMessage(msg);
-        }
-        else {
+        if (!mMessageHandlers.dispatch(msg)) {
             logger->log("Unhandled packet %x (%i B)",
                     msg.getId(), msg.getLength());
         }
@@ -133,14 +187,12 @@ namespace
         // Clean up the packet now that we're done using it.
         enet_packet_destroy(packet);
     }
-}
 
-void flush()
-{
-    ENetEvent event;
-
-    // Wait up to 10 milliseconds for an event.
-    while (enet_host_service(client, &event, 10) > 0)
+    /**
+     * Handles an ENet event. Received packets are passed to the given
+     * function.
+     */
+    void handleEvent(ENetEvent &event, void (*receive)(ENetPacket *packet))
     {
         switch (event.type)
         {
@@ -151,7 +203,7 @@ void flush()
                 break;
 
             case ENET_EVENT_TYPE_RECEIVE:
-                dispatchMessage(event.packet);
+                receive(event.packet);
                 break;
 
             case ENET_EVENT_TYPE_DISCONNECT:
@@ -169,6 +221,98 @@ void flush()
                 break;
         }
     }
+
+    /**
+     * Adds a received packet to the queue. Called by the service thread,
+     * which makes sure there is room.
+     */
+    void queuePacket(ENetPacket *packet)
+    {
+        queue[queueWritePos % QUEUE_SIZE] = packet;
+
+        SDL_mutexP(queueMutex);
+        ++queueWritePos;
+        SDL_mutexV(queueMutex);
+    }
+
+    /**
+     * Handles the queued packets until they run out or the time budget for
+     * this frame is used up.
+     */
+    void dispatchQueuedMessages()
+    {
+        SDL_mutexP(queueMutex);
+        const unsigned int writePos = queueWritePos;
+        SDL_mutexV(queueMutex);
+
+        const Uint32 start = SDL_GetTicks();
+        unsigned int readPos = queueReadPos;
+
+        while (readPos != writePos)
+        {
+            dispatchMessage(queue[readPos % QUEUE_SIZE]);
+            ++readPos;
+
+            if (SDL_GetTicks() - start >= DISPATCH_BUDGET)
+                break;
+        }
+
+        SDL_mutexP(queueMutex);
+        queueReadPos = readPos;
+        SDL_mutexV(queueMutex);
+    }
+}
+
+static int serviceThreadMain(void *data)
+{
+    ENetEvent event;
+
+    while (serviceThreadRunning)
+    {
+        // Wait for data without keeping the host locked
+        enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+        enet_socket_wait(client->socket, &condition, 10);
+
+        lockHost();
+        for (;;)
+        {
+            // Leave further events with ENet while the queue is full
+            SDL_mutexP(queueMutex);
+            const bool full = queueWritePos - queueReadPos == QUEUE_SIZE;
+            SDL_mutexV(queueMutex);
+
+            if (full || enet_host_service(client, &event, 0) <= 0)
+                break;
+
+            handleEvent(event, queuePacket);
+        }
+        unlockHost();
+    }
+
+    return 0;
+}
+
+void flush()
+{
+    if (serviceThread)
+    {
+        dispatchQueuedMessages();
+
+        // Send the messages written this frame without waiting for the
+        // service thread
+        lockHost();
+        enet_host_flush(client);
+        unlockHost();
+        return;
+    }
+
+    ENetEvent event;
+
+    // Wait up to 10 milliseconds for an event.
+    while (enet_host_service(client, &event, 10) > 0)
+    {
+        handleEvent(event, dispatchMessage);
+    }
 }
 
 }
@@ -0,0 +1,124 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "net/messagetable.h"
+
+#include "net/messagehandler.h"
+#include "net/messagein.h"
+
+#include <algorithm>
+
+#include <sys/time.h>
+
+namespace Net {
+
+std::vector<MessageStat> MessageTable::mStats;
+
+/**
+ * Orders statistics with the most expensive message ids first.
+ */
+static bool moreExpensive(const MessageStat &a, const MessageStat &b)
+{
+    if (a.time != b.time)
+        return a.time > b.time;
+    return a.bytes > b.bytes;
+}
+
+/**
+ * Returns the current time in microseconds.
+ */
+static unsigned long getMicroseconds()
+{
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+void MessageTable::add(MessageHandler *handler)
+{
+    for (const Uint16 *i = handler->handledMessages; *i; ++i)
+    {
+        if (*i >= mHandlers.size())
+            mHandlers.resize(*i + 1, NULL);
+
+        mHandlers[*i] = handler;
+    }
+}
+
+void MessageTable::remove(MessageHandler *handler)
+{
+    for (const Uint16 *i = handler->handledMessages; *i; ++i)
+    {
+        if (*i < mHandlers.size() && mHandlers[*i] == handler)
+            mHandlers[*i] = NULL;
+    }
+}
+
+void MessageTable::clear()
+{
+    mHandlers.clear();
+}
+
+bool MessageTable::dispatch(MessageIn &msg)
+{
+    const Uint16 id = msg.getId();
+
+    if (id >= mStats.size())
+        mStats.resize(id + 1);
+
+    MessageStat &stat = mStats[id];
+    stat.count++;
+    stat.bytes += msg.getLength();
+
+    MessageHandler *handler = get(id);
+    if (!handler)
+        return false;
+
+    const unsigned long start = getMicroseconds();
+    handler->handleMessage(msg);
+    stat.time += getMicroseconds() - start;
+
+    return true;
+}
+
+std::vector<MessageStat> MessageTable::getStats()
+{
+    std::vector<MessageStat> stats;
+
+    for (unsigned int id = 0; id < mStats.size(); ++id)
+    {
+        if (!mStats[id].count)
+            continue;
+
+        stats.push_back(mStats[id]);
+        stats.back().id = id;
+    }
+
+    std::sort(stats.begin(), stats.end(), moreExpensive);
+    return stats;
+}
+
+void MessageTable::resetStats()
+{
+    mStats.clear();
+}
+
+} // namespace Net
@@ -0,0 +1,118 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NET_MESSAGETABLE_H
+#define NET_MESSAGETABLE_H
+
+#include <SDL_types.h>
+
+#include <vector>
+
+namespace Net {
+
+class MessageHandler;
+class MessageIn;
+
+/**
+ * Statistics gathered for a single message id.
+ */
+struct MessageStat
+{
+    MessageStat():
+        id(0), count(0), bytes(0), time(0)
+    {}
+
+    Uint16 id;
+    unsigned int count;     /**< Number of messages received */
+    unsigned long bytes;    /**< Total size of those messages */
+    unsigned long time;     /**< Time spent handling them in microseconds */
+};
+
+/**
+ * Maps message ids to their handlers through a table indexed directly by
+ * the id, which is filled when handlers are registered. Dispatching a
+ * message through the table also keeps per message id statistics, which
+ * are shared by all tables.
+ *
+ * \ingroup Network
+ */
+class MessageTable
+{
+    public:
+        /**
+         * Makes the handler responsible for the messages it handles,
+         * replacing any handler previously registered for them.
+         */
+        void add(MessageHandler *handler);
+
+        /**
+         * Removes the handler for the messages it handles.
+         */
+        void remove(MessageHandler *handler);
+
+        /**
+         * Removes all handlers.
+         */
+        void clear();
+
+        /**
+         * Returns the handler of the given message id, or <code>NULL</code>
+         * when there is none.
+         */
+        MessageHandler *get(Uint16 id) const
+        { return id < mHandlers.size() ? mHandlers[id] : NULL; }
+
+        /**
+         * Returns one more than the highest message id that may have a
+         * handler.
+         */
+        unsigned int size() const
+        { return mHandlers.size(); }
+
+        /**
+         * Passes the message to its handler, recording how long that
+         * took.
+         *
+         * @return <code>false</code> when no handler was registered for the
+         *         message
+         */
+        bool dispatch(MessageIn &msg);
+
+        /**
+         * Returns the statistics of all message ids that were received,
+         * ordered by the time spent handling them.
+         */
+        static std::vector<MessageStat> getStats();
+
+        /**
+         * Clears the statistics.
+         */
+        static void resetStats();
+
+    private:
+        std::vector<MessageHandler*> mHandlers;
+
+        static std::vector<MessageStat> mStats;
+};
+
+} // namespace Net
+
+#endif // NET_MESSAGETABLE_H
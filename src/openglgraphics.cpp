@@ -37,14 +37,23 @@
 #define GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB 0x84F8
 #endif
 
+OpenGLGraphics *OpenGLGraphics::mActive = NULL;
+
 OpenGLGraphics::OpenGLGraphics():
     mAlpha(false), mTexture(false), mColorAlpha(false),
-    mSync(false)
+    mSync(false),
+    mBatchTexture(0),
+    mDrawCalls(0), mLastDrawCalls(0),
+    mLastBoundTexture(0),
+    mTextureBinds(0), mLastTextureBinds(0)
 {
+    mActive = this;
 }
 
 OpenGLGraphics::~OpenGLGraphics()
 {
+    if (mActive == this)
+        mActive = NULL;
 }
 
 void OpenGLGraphics::setSync(bool sync)
@@ -106,75 +115,114 @@ bool OpenGLGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
     return true;
 }
 
-static inline void drawQuad(Image *image,
-                            int srcX, int srcY, int dstX, int dstY,
-                            int width, int height)
+void OpenGLGraphics::addQuad(Image *image,
+                             int srcX, int srcY, int dstX, int dstY,
+                             int width, int height,
+                             int desiredWidth, int desiredHeight)
 {
+    float texX1 = srcX;
+    float texY1 = srcY;
+    float texX2 = srcX + width;
+    float texY2 = srcY + height;
+
     if (image->getTextureType() == GL_TEXTURE_2D)
     {
         // Find OpenGL normalized texture coordinates.
-        float texX1 = srcX / (float) image->getTextureWidth();
-        float texY1 = srcY / (float) image->getTextureHeight();
-        float texX2 = (srcX + width) / (float) image->getTextureWidth();
-        float texY2 = (srcY + height) / (float) image->getTextureHeight();
-
-        glTexCoord2f(texX1, texY1);
-        glVertex2i(dstX, dstY);
-        glTexCoord2f(texX2, texY1);
-        glVertex2i(dstX + width, dstY);
-        glTexCoord2f(texX2, texY2);
-        glVertex2i(dstX + width, dstY + height);
-        glTexCoord2f(texX1, texY2);
-        glVertex2i(dstX, dstY + height);
+        texX1 /= (float) image->getTextureWidth();
+        texY1 /= (float) image->getTextureHeight();
+        texX2 /= (float) image->getTextureWidth();
+        texY2 /= (float) image->getTextureHeight();
     }
-    else
+
+    const float texCoords[8] = {
+        texX1, texY1,
+        texX2, texY1,
+        texX2, texY2,
+        texX1, texY2
+    };
+    const int vertices[8] = {
+        dstX, dstY,
+        dstX + desiredWidth, dstY,
+        dstX + desiredWidth, dstY + desiredHeight,
+        dstX, dstY + desiredHeight
+    };
+
+    mBatchTexCoords.insert(mBatchTexCoords.end(), texCoords, texCoords + 8);
+    mBatchVertices.insert(mBatchVertices.end(), vertices, vertices + 8);
+    for (int i = 0; i < 4; i++)
+        mBatchColors.insert(mBatchColors.end(), mBatchColor, mBatchColor + 4);
+}
+
+void OpenGLGraphics::setBatchTexture(unsigned int texture,
+                                     const gcn::Color &color)
+{
+    if (texture != mBatchTexture)
     {
-        glTexCoord2i(srcX, srcY);
-        glVertex2i(dstX, dstY);
-        glTexCoord2i(srcX + width, srcY);
-        glVertex2i(dstX + width, dstY);
-        glTexCoord2i(srcX + width, srcY + height);
-        glVertex2i(dstX + width, dstY + height);
-        glTexCoord2i(srcX, srcY + height);
-        glVertex2i(dstX, dstY + height);
+        flushBatch();
+        mBatchTexture = texture;
     }
+
+    mBatchColor[0] = color.r;
+    mBatchColor[1] = color.g;
+    mBatchColor[2] = color.b;
+    mBatchColor[3] = color.a;
 }
 
-static inline void drawRescaledQuad(Image *image,
-                            int srcX, int srcY, int dstX, int dstY,
-                            int width, int height,
-                            int desiredWidth, int desiredHeight)
+void OpenGLGraphics::flushBatch()
 {
-    if (image->getTextureType() == GL_TEXTURE_2D)
+    if (mBatchVertices.empty())
+        return;
+
+    glBindTexture(Image::mTextureType, mBatchTexture);
+    if (mBatchTexture != mLastBoundTexture)
     {
-        // Find OpenGL normalized texture coordinates.
-        float texX1 = srcX / (float) image->getTextureWidth();
-        float texY1 = srcY / (float) image->getTextureHeight();
-        float texX2 = (srcX + width) / (float) image->getTextureWidth();
-        float texY2 = (srcY + height) / (float) image->getTextureHeight();
-
-        glTexCoord2f(texX1, texY1);
-        glVertex2i(dstX, dstY);
-        glTexCoord2f(texX2, texY1);
-        glVertex2i(dstX + desiredWidth, dstY);
-        glTexCoord2f(texX2, texY2);
-        glVertex2i(dstX + desiredWidth, dstY + desiredHeight);
-        glTexCoord2f(texX1, texY2);
-        glVertex2i(dstX, dstY + desiredHeight);
+        mLastBoundTexture = mBatchTexture;
+        mTextureBinds++;
     }
-    else
+
+    setTexturingAndBlending(true);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    glVertexPointer(2, GL_INT, 0, &mBatchVertices[0]);
+    glTexCoordPointer(2, GL_FLOAT, 0, &mBatchTexCoords[0]);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, &mBatchColors[0]);
+
+    glDrawArrays(GL_QUADS, 0, mBatchVertices.size() / 2);
+    mDrawCalls++;
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    // The current color is undefined after drawing with a color array
+    glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+
+    mBatchVertices.clear();
+    mBatchTexCoords.clear();
+    mBatchColors.clear();
+}
+
+void OpenGLGraphics::releaseTexture(unsigned int texture)
+{
+    if (mActive && mActive->mBatchTexture == texture)
     {
-        glTexCoord2i(srcX, srcY);
-        glVertex2i(dstX, dstY);
-        glTexCoord2i(srcX + width, srcY);
-        glVertex2i(dstX + desiredWidth, dstY);
-        glTexCoord2i(srcX + width, srcY + height);
-        glVertex2i(dstX + desiredWidth, dstY + desiredHeight);
-        glTexCoord2i(srcX, srcY + height);
-        glVertex2i(dstX, dstY + desiredHeight);
+        mActive->flushBatch();
+        mActive->mBatchTexture = 0;
     }
+    if (mActive && mActive->mLastBoundTexture == texture)
+        mActive->mLastBoundTexture = 0;
 }
 
+/**
+ * Returns the color images are drawn with when not using the current color.
+ */
+static inline gcn::Color imageColor(const Image *image)
+{
+    return gcn::Color(255, 255, 255, (int) (image->getAlpha() * 255));
+}
 
 bool OpenGLGraphics::drawImage(Image *image, int srcX, int srcY,
                                int dstX, int dstY,
@@ -186,20 +234,9 @@ bool OpenGLGraphics::drawImage(Image *image, int srcX, int srcY,
     srcX += image->mBounds.x;
     srcY += image->mBounds.y;
 
-    if (!useColor)
-        glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
-
-    setTexturingAndBlending(true);
-
-    // Draw a textured quad.
-    glBegin(GL_QUADS);
-    drawQuad(image, srcX, srcY, dstX, dstY, width, height);
-    glEnd();
-
-    if (!useColor)
-        glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+    setBatchTexture(image->mGLImage,
+                    useColor ? mColor : imageColor(image));
+    addQuad(image, srcX, srcY, dstX, dstY, width, height, width, height);
 
     return true;
 }
@@ -238,42 +275,28 @@ bool OpenGLGraphics::drawRescaledImage(Image *image, int srcX, int srcY,
     srcX += image->mBounds.x;
     srcY += image->mBounds.y;
 
-    if (!useColor)
-        glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
-
-    setTexturingAndBlending(true);
-
-    // Draw a textured quad.
-    glBegin(GL_QUADS);
-    drawRescaledQuad(image, srcX, srcY, dstX, dstY, width, height,
-                     desiredWidth, desiredHeight);
+    setBatchTexture(image->mGLImage,
+                    useColor ? mColor : imageColor(image));
+    addQuad(image, srcX, srcY, dstX, dstY, width, height,
+            desiredWidth, desiredHeight);
 
     if (smooth) // A basic smooth effect...
     {
-        glColor4f(1.0f, 1.0f, 1.0f, 0.2f);
-        drawRescaledQuad(image, srcX, srcY, dstX - 1, dstY - 1, width, height,
-                        desiredWidth + 1, desiredHeight + 1);
-        drawRescaledQuad(image, srcX, srcY, dstX + 1, dstY + 1, width, height,
-                        desiredWidth - 1, desiredHeight - 1);
-
-        drawRescaledQuad(image, srcX, srcY, dstX + 1, dstY, width, height,
-                        desiredWidth - 1, desiredHeight);
-        drawRescaledQuad(image, srcX, srcY, dstX, dstY + 1, width, height,
-                        desiredWidth, desiredHeight - 1);
+        setBatchTexture(image->mGLImage, gcn::Color(255, 255, 255, 51));
+        addQuad(image, srcX, srcY, dstX - 1, dstY - 1, width, height,
+                desiredWidth + 1, desiredHeight + 1);
+        addQuad(image, srcX, srcY, dstX + 1, dstY + 1, width, height,
+                desiredWidth - 1, desiredHeight - 1);
+
+        addQuad(image, srcX, srcY, dstX + 1, dstY, width, height,
+                desiredWidth - 1, desiredHeight);
+        addQuad(image, srcX, srcY, dstX, dstY + 1, width, height,
+                desiredWidth, desiredHeight - 1);
     }
 
-    glEnd();
-
-    if (!useColor)
-        glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
-
     return true;
 }
 
-/* Optimising the functions that Graphics::drawImagePattern would call,
- * so that glBegin...glEnd are outside the main loop. */
 void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
 {
     if (!image)
@@ -287,15 +310,9 @@ void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
     if (iw == 0 || ih == 0)
         return;
 
-    glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
-
-    setTexturingAndBlending(true);
+    setBatchTexture(image->mGLImage, imageColor(image));
 
     // Draw a set of textured rectangles
-    glBegin(GL_QUADS);
-
     for (int py = 0; py < h; py += ih)
     {
         const int height = (py + ih >= h) ? h - py : ih;
@@ -305,13 +322,10 @@ void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
             int width = (px + iw >= w) ? w - px : iw;
             int dstX = x + px;
 
-            drawQuad(image, srcX, srcY, dstX, dstY, width, height);
+            addQuad(image, srcX, srcY, dstX, dstY,
+                    width, height, width, height);
         }
     }
-
-    glEnd();
-
-    glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
 }
 
 void OpenGLGraphics::drawRescaledImagePattern(Image *image, int x, int y,
@@ -329,15 +343,9 @@ void OpenGLGraphics::drawRescaledImagePattern(Image *image, int x, int y,
     if (iw == 0 || ih == 0)
         return;
 
-    glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
-
-    setTexturingAndBlending(true);
+    setBatchTexture(image->mGLImage, imageColor(image));
 
     // Draw a set of textured rectangles
-    glBegin(GL_QUADS);
-
     for (int py = 0; py < h; py += ih)
     {
         const int height = (py + ih >= h) ? h - py : ih;
@@ -347,25 +355,30 @@ void OpenGLGraphics::drawRescaledImagePattern(Image *image, int x, int y,
             int width = (px + iw >= w) ? w - px : iw;
             int dstX = x + px;
 
-            drawRescaledQuad(image, srcX, srcY, dstX, dstY,
-                             width, height, scaledWidth, scaledHeight);
+            addQuad(image, srcX, srcY, dstX, dstY,
+                    width, height, scaledWidth, scaledHeight);
         }
     }
-
-    glEnd();
-
-    glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
 }
 
 void OpenGLGraphics::updateScreen()
 {
-    glFlush();
-    glFinish();
+    flushBatch();
+
+    mLastDrawCalls = mDrawCalls;
+    mDrawCalls = 0;
+    mLastTextureBinds = mTextureBinds;
+    mTextureBinds = 0;
+
+    // Swapping the buffers synchronizes as needed, there is no need to
+    // stall on glFinish here.
     SDL_GL_SwapBuffers();
 }
 
 void OpenGLGraphics::_beginDraw()
 {
+    flushBatch();
+
     glMatrixMode(GL_TEXTURE);
     glLoadIdentity();
 
@@ -386,10 +399,13 @@ void OpenGLGraphics::_beginDraw()
 
 void OpenGLGraphics::_endDraw()
 {
+    flushBatch();
 }
 
 SDL_Surface* OpenGLGraphics::getScreenshot()
 {
+    flushBatch();
+
     int h = mScreen->h;
     int w = mScreen->w;
 
@@ -429,6 +445,8 @@ SDL_Surface* OpenGLGraphics::getScreenshot()
 
 bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
 {
+    flushBatch();
+
     int transX = 0;
     int transY = 0;
 
@@ -455,6 +473,8 @@ bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
 
 void OpenGLGraphics::popClipArea()
 {
+    flushBatch();
+
     gcn::Graphics::popClipArea();
 
     if (mClipStack.empty())
@@ -477,15 +497,18 @@ void OpenGLGraphics::setColor(const gcn::Color& color)
 
 void OpenGLGraphics::drawPoint(int x, int y)
 {
+    flushBatch();
     setTexturingAndBlending(false);
 
     glBegin(GL_POINTS);
     glVertex2i(x, y);
     glEnd();
+    mDrawCalls++;
 }
 
 void OpenGLGraphics::drawLine(int x1, int y1, int x2, int y2)
 {
+    flushBatch();
     setTexturingAndBlending(false);
 
     glBegin(GL_LINES);
@@ -496,6 +519,7 @@ void OpenGLGraphics::drawLine(int x1, int y1, int x2, int y2)
     glBegin(GL_POINTS);
     glVertex2f(x2 + 0.5f, y2 + 0.5f);
     glEnd();
+    mDrawCalls += 2;
 }
 
 void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rect)
@@ -553,6 +577,7 @@ void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rect, bool filled)
 {
     const float offset = filled ? 0 : 0.5f;
 
+    flushBatch();
     setTexturingAndBlending(false);
 
     glBegin(filled ? GL_QUADS : GL_LINE_LOOP);
@@ -561,6 +586,7 @@ void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rect, bool filled)
     glVertex2f(rect.x + rect.width - offset, rect.y + rect.height - offset);
     glVertex2f(rect.x + offset, rect.y + rect.height - offset);
     glEnd();
+    mDrawCalls++;
 }
 
 #endif // USE_OPENGL
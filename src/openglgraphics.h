@@ -24,6 +24,16 @@
 
 #include "graphics.h"
 
+#include <vector>
+
+/**
+ * Graphics implementation using OpenGL.
+ *
+ * Textured quads are not drawn right away, but collected in vertex arrays
+ * and drawn with a single call for each run of quads using the same
+ * texture. The batch is flushed when the texture changes, before anything
+ * else is drawn or the clip area changes, and when the frame ends.
+ */
 class OpenGLGraphics : public Graphics
 {
     public:
@@ -102,13 +112,65 @@ class OpenGLGraphics : public Graphics
          */
         SDL_Surface *getScreenshot();
 
+        /**
+         * Returns the number of draw calls issued during the last frame.
+         */
+        int getDrawCallCount() const { return mLastDrawCalls; }
+
+        /**
+         * Returns the number of texture binds during the last frame.
+         */
+        int getTextureBindCount() const { return mLastTextureBinds; }
+
+        /**
+         * Draws any batched quads that use the given texture, so that the
+         * texture can be deleted. Called by Image before freeing a texture.
+         */
+        static void releaseTexture(unsigned int texture);
+
     protected:
         void setTexturingAndBlending(bool enable);
 
     private:
+        /**
+         * Prepares the batch for quads using the given texture and color,
+         * drawing the pending quads when the texture changes.
+         */
+        void setBatchTexture(unsigned int texture,
+                             const gcn::Color &color);
+
+        /**
+         * Adds a textured quad to the batch.
+         */
+        void addQuad(Image *image,
+                     int srcX, int srcY, int dstX, int dstY,
+                     int width, int height,
+                     int desiredWidth, int desiredHeight);
+
+        /**
+         * Draws all batched quads.
+         */
+        void flushBatch();
+
         bool mAlpha, mTexture;
         bool mColorAlpha;
         bool mSync;
+
+        // Batched quads, sharing the texture mBatchTexture
+        unsigned int mBatchTexture;
+        unsigned char mBatchColor[4];
+        std::vector<int> mBatchVertices;
+        std::vector<float> mBatchTexCoords;
+        std::vector<unsigned char> mBatchColors;
+
+        int mDrawCalls;       /**< Draw calls issued this frame */
+        int mLastDrawCalls;   /**< Draw calls issued during the last frame */
+        unsigned int mLastBoundTexture;
+        int mTextureBinds;    /**< Texture binds this frame */
+        int mLastTextureBinds;
+
+        /** The instance batching quads, if any */
+        static OpenGLGraphics *mActive;
 };
 
 #endif
@@ -34,11 +34,12 @@
 #include "rotationalparticle.h"
 #include "textparticle.h"
 
+#include "resources/animation.h"
+#include "resources/particleeffectdef.h"
 #include "resources/resourcemanager.h"
 
 #include "utils/dtor.h"
 #include "utils/mathutils.h"
-#include "utils/xml.h"
 
 #define SIN45 0.707106781f
 
@@ -49,6 +50,7 @@ int Particle::particleCount = 0;
 int Particle::maxCount = 0;
 int Particle::fastPhysics = 0;
 int Particle::emitterSkip = 1;
+int Particle::pooling = 1;
 const float Particle::PARTICLE_SKY = 800.0f;
 
 Particle::Particle(Map *map):
@@ -60,6 +62,7 @@ Particle::Particle(Map *map):
     mAlpha(1.0f),
     mAutoDelete(true),
     mMap(map),
+    mEffectDef(NULL),
     mGravity(0.0f),
     mRandomness(0),
     mBounce(0.0f),
@@ -81,6 +84,8 @@ Particle::~Particle()
         mMap->removeSprite(mSpriteIterator);
     // Delete child emitters and child particles
     clear();
+    if (mEffectDef)
+        mEffectDef->decRef();
     Particle::particleCount--;
 }
 
@@ -89,6 +94,7 @@ void Particle::setupEngine()
     Particle::maxCount = (int)config.getValue("particleMaxCount", 3000);
     Particle::fastPhysics = (int)config.getValue("particleFastPhysics", 0);
     Particle::emitterSkip = (int)config.getValue("particleEmitterSkip", 1) + 1;
+    Particle::pooling = (int)config.getValue("particlePooling", 1);
     disableAutoDelete();
     logger->log("Particle engine set up");
 }
@@ -189,6 +195,12 @@ bool Particle::update()
             for (EmitterIterator e = mChildEmitters.begin();
                  e != mChildEmitters.end(); e++)
             {
+                if ((*e)->usesPool())
+                {
+                    (*e)->createPooledParticles(mLifetimePast, mPos);
+                    continue;
+                }
+
                 Particles newParticles = (*e)->createParticles(mLifetimePast);
                 for (ParticleIterator p = newParticles.begin();
                      p != newParticles.end(); p++)
@@ -223,7 +235,16 @@ bool Particle::update()
             p = mChildParticles.erase(p);
         }
     }
-    if (!mAlive && mChildParticles.empty() && mAutoDelete)
+
+    // Update pooled child particles
+    for (EmitterIterator e = mChildEmitters.begin();
+         e != mChildEmitters.end(); e++)
+    {
+        (*e)->updatePool(change, getPixelY());
+    }
+
+    if (!mAlive && mChildParticles.empty() && !hasPooledParticles() &&
+        mAutoDelete)
     {
         return false;
     }
@@ -242,6 +263,22 @@ void Particle::moveBy(const Vector &change)
             (*p)->moveBy(change);
         }
     }
+    for (EmitterIterator e = mChildEmitters.begin();
+         e != mChildEmitters.end(); e++)
+    {
+        (*e)->movePool(change);
+    }
+}
+
+bool Particle::hasPooledParticles() const
+{
+    for (Emitters::const_iterator e = mChildEmitters.begin();
+         e != mChildEmitters.end(); e++)
+    {
+        if ((*e)->getPooledCount() > 0)
+            return true;
+    }
+    return false;
 }
 
 void Particle::moveTo(float x, float y)
@@ -252,88 +289,72 @@ void Particle::moveTo(float x, float y)
 Particle *Particle::addEffect(const std::string &particleEffectFile,
                               int pixelX, int pixelY, int rotation)
 {
-    Particle *newParticle = NULL;
-
-    XML::Document doc(particleEffectFile);
-    xmlNodePtr rootNode = doc.rootNode();
-
-    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "effect"))
-    {
-        logger->log("Error loading particle: %s", particleEffectFile.c_str());
-        return NULL;
-    }
-
     ResourceManager *resman = ResourceManager::getInstance();
+    ParticleEffectDef *def = resman->getParticleEffect(particleEffectFile);
 
-    // Parse particles
-    for_each_xml_child_node(effectChildNode, rootNode)
-    {
-        // We're only interested in particles
-        if (!xmlStrEqual(effectChildNode->name, BAD_CAST "particle"))
-            continue;
+    if (!def)
+        return NULL;
 
-        // Determine the exact particle type
-        xmlNodePtr node;
+    ParticleEffectDef::instanceCount++;
 
-        // Animation
-        if ((node = XML::findFirstChildByName(effectChildNode, "animation")))
-        {
-            newParticle = new AnimationParticle(mMap, node);
-        }
-        // Rotational
-        else if ((node = XML::findFirstChildByName(effectChildNode, "rotation")))
-        {
-            newParticle = new RotationalParticle(mMap, node);
-        }
-        // Image
-        else if ((node = XML::findFirstChildByName(effectChildNode, "image")))
-        {
-            Image *img= resman->getImage((const char*)
-                    node->xmlChildrenNode->content);
+    Particle *newParticle = NULL;
+    const ParticleEffectDef::ParticleDefs &particles = def->getParticles();
 
-            newParticle = new ImageParticle(mMap, img);
-        }
-        // Other
-        else
+    for (ParticleEffectDef::ParticleDefs::const_iterator i = particles.begin(),
+         i_end = particles.end(); i != i_end; ++i)
+    {
+        // Create the exact particle type
+        switch (i->type)
         {
-            newParticle = new Particle(mMap);
+            case ParticleEffectDef::PARTICLE_ANIMATION:
+                newParticle = new AnimationParticle(mMap,
+                        new Animation(i->animation));
+                break;
+            case ParticleEffectDef::PARTICLE_ROTATIONAL:
+                newParticle = new RotationalParticle(mMap,
+                        new Animation(i->animation));
+                break;
+            case ParticleEffectDef::PARTICLE_IMAGE:
+                newParticle = new ImageParticle(mMap, i->image);
+                break;
+            default:
+                newParticle = new Particle(mMap);
+                break;
         }
 
-        // Read and set the basic properties of the particle
-        float offsetX = XML::getFloatProperty(effectChildNode, "position-x", 0);
-        float offsetY = XML::getFloatProperty(effectChildNode, "position-y", 0);
-        float offsetZ = XML::getFloatProperty(effectChildNode, "position-z", 0);
-        Vector position (mPos.x + (float)pixelX + offsetX,
-                         mPos.y + (float)pixelY + offsetY,
-                         mPos.z + offsetZ);
+        // Set the basic properties of the particle
+        Vector position(mPos.x + (float)pixelX + i->offset.x,
+                        mPos.y + (float)pixelY + i->offset.y,
+                        mPos.z + i->offset.z);
         newParticle->moveTo(position);
+        newParticle->setLifetime(i->lifetime);
 
-        int lifetime = XML::getProperty(effectChildNode, "lifetime", -1);
-        newParticle->setLifetime(lifetime);
+        // Keep the compiled effect loaded while the effect is alive
+        newParticle->mEffectDef = def;
+        def->incRef();
 
-        // Look for additional emitters for this particle
-        for_each_xml_child_node(emitterNode, effectChildNode)
+        // Instantiate the emitters of this particle
+        for (std::list<ParticleEmitter>::const_iterator e = i->emitters.begin(),
+             e_end = i->emitters.end(); e != e_end; ++e)
         {
-            if (!xmlStrEqual(emitterNode->name, BAD_CAST "emitter"))
-                continue;
-
-            ParticleEmitter *newEmitter;
-            newEmitter = new ParticleEmitter(emitterNode, newParticle, mMap,
-                                             rotation);
-            newParticle->addEmitter(newEmitter);
+            newParticle->addEmitter(new ParticleEmitter(*e, newParticle, mMap,
+                                                        rotation));
         }
 
         mChildParticles.push_back(newParticle);
     }
 
+    def->decRef();
+
     return newParticle;
 }
 
 Particle *Particle::addTextSplashEffect(const std::string &text, int x, int y,
-                                        const gcn::Color *color,
+                                        Palette::ColorType colorType,
                                         gcn::Font *font, bool outline)
 {
-    Particle *newParticle = new TextParticle(mMap, text, color, font, outline);
+    Particle *newParticle = new TextParticle(mMap, text, colorType, font,
+                                             outline);
     newParticle->moveTo(x, y);
     newParticle->setVelocity(((rand() % 100) - 50) / 200.0f,    // X
                              ((rand() % 100) - 50) / 200.0f,    // Y
@@ -350,10 +371,11 @@ Particle *Particle::addTextSplashEffect(const std::string &text, int x, int y,
 
 Particle *Particle::addTextRiseFadeOutEffect(const std::string &text,
                                              int x, int y,
-                                             const gcn::Color *color,
+                                             Palette::ColorType colorType,
                                              gcn::Font *font, bool outline)
 {
-    Particle *newParticle = new TextParticle(mMap, text, color, font, outline);
+    Particle *newParticle = new TextParticle(mMap, text, colorType, font,
+                                             outline);
     newParticle->moveTo(x, y);
     newParticle->setVelocity(0.0f, 0.0f, 0.5f);
     newParticle->setGravity(0.0015f);
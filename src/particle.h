@@ -29,8 +29,11 @@
 #include "sprite.h"
 #include "vector.h"
 
+#include "gui/palette.h"
+
 class Map;
 class Particle;
+class ParticleEffectDef;
 class ParticleEmitter;
 
 typedef std::list<Particle *> Particles;
@@ -49,6 +52,7 @@ class Particle : public Sprite
         static int particleCount;        /**< Current number of particles */
         static int maxCount;             /**< Maximum number of particles */
         static int emitterSkip;          /**< Duration of pause between two emitter updates in ticks */
+        static int pooling;              /**< Whether simple particles are kept in pools */
 
         /**
          * Constructor.
@@ -106,14 +110,14 @@ class Particle : public Sprite
          * Creates a standalone text particle.
          */
         Particle *addTextSplashEffect(const std::string &text, int x, int y,
-                const gcn::Color *color, gcn::Font *font,
+                Palette::ColorType colorType, gcn::Font *font,
                 bool outline = false);
 
         /**
          * Creates a standalone text particle.
          */
         Particle *addTextRiseFadeOutEffect(const std::string &text,
-                int x, int y, const gcn::Color *color, gcn::Font *font,
+                int x, int y, Palette::ColorType colorType, gcn::Font *font,
                 bool outline = false);
 
         /**
@@ -249,7 +253,7 @@ class Particle : public Sprite
          * Determines whether the particle and its children are all dead
          */
         bool isExtinct()
-        { return !isAlive() && mChildParticles.empty(); }
+        { return !isAlive() && mChildParticles.empty() && !hasPooledParticles(); }
 
         /**
          * Manually marks the particle for deletion.
@@ -269,6 +273,11 @@ class Particle : public Sprite
         { return 1; }
 
     protected:
+        /**
+         * Tells whether any of the child emitters still has pooled particles.
+         */
+        bool hasPooledParticles() const;
+
         bool mAlive;                /**< Is the particle supposed to be drawn and updated?*/
         Vector mPos;                /**< Position in pixels relative to map. */
         int mLifetimeLeft;          /**< Lifetime left in game ticks*/
@@ -283,6 +292,7 @@ class Particle : public Sprite
         std::list<Sprite*>::iterator mSpriteIterator;   /**< iterator of the particle on the current map */
         Emitters mChildEmitters;    /**< List of child emitters. */
         Particles mChildParticles;  /**< List of particles controlled by this particle */
+        ParticleEffectDef *mEffectDef; /**< Effect the particle was instantiated from, kept loaded while it lives */
 
         // dynamic particle
         Vector mVelocity;           /**< Speed in pixels per game-tick. */
@@ -37,7 +37,8 @@
 
 ParticleEmitter::ParticleEmitter(xmlNodePtr emitterNode, Particle *target, Map *map, int rotation):
     mOutputPauseLeft(0),
-    mParticleImage(0)
+    mParticleImage(0),
+    mPool(0)
 {
     mMap = map;
     mParticleTarget = target;
@@ -47,6 +48,7 @@ ParticleEmitter::ParticleEmitter(xmlNodePtr emitterNode, Particle *target, Map *
     mParticlePosY.set(0.0f);
     mParticlePosZ.set(0.0f);
     mParticleAngleHorizontal.set(0.0f);
+    mHasAngleHorizontal = false;
     mParticleAngleVertical.set(0.0f);
     mParticlePower.set(0.0f);
     mParticleGravity.set(0.0f);
@@ -106,6 +108,7 @@ ParticleEmitter::ParticleEmitter(xmlNodePtr emitterNode, Particle *target, Map *
                 mParticleAngleHorizontal.maxVal += rotation;
                 mParticleAngleHorizontal.maxVal *= DEG_RAD_FACTOR;
                 mParticleAngleHorizontal.changeAmplitude *= DEG_RAD_FACTOR;
+                mHasAngleHorizontal = true;
             }
             else if (name == "vertical-angle")
             {
@@ -324,17 +327,35 @@ ParticleEmitter::ParticleEmitter(xmlNodePtr emitterNode, Particle *target, Map *
     }
 }
 
-ParticleEmitter::ParticleEmitter(const ParticleEmitter &o)
+ParticleEmitter::ParticleEmitter(const ParticleEmitter &o):
+    mPool(0)
 {
     *this = o;
 }
 
+ParticleEmitter::ParticleEmitter(const ParticleEmitter &o, Particle *target,
+                                 Map *map, int rotation):
+    mPool(0)
+{
+    *this = o;
+    bind(target, map);
+
+    // Like the XML constructor, only rotate an explicitly given angle
+    if (mHasAngleHorizontal)
+    {
+        mParticleAngleHorizontal.minVal += rotation * DEG_RAD_FACTOR;
+        mParticleAngleHorizontal.maxVal += rotation * DEG_RAD_FACTOR;
+    }
+    mOutputPauseLeft = mOutputPause.value(0);
+}
+
 ParticleEmitter & ParticleEmitter::operator=(const ParticleEmitter &o)
 {
     mParticlePosX = o.mParticlePosX;
     mParticlePosY = o.mParticlePosY;
     mParticlePosZ = o.mParticlePosZ;
     mParticleAngleHorizontal = o.mParticleAngleHorizontal;
+    mHasAngleHorizontal = o.mHasAngleHorizontal;
     mParticleAngleVertical = o.mParticleAngleVertical;
     mParticlePower = o.mParticlePower;
     mParticleGravity = o.mParticleGravity;
@@ -359,6 +380,9 @@ ParticleEmitter & ParticleEmitter::operator=(const ParticleEmitter &o)
 
     mOutputPauseLeft = 0;
 
+    // Pooled particles belong to the emitter that spawned them
+    mPool = 0;
+
     if (mParticleImage) mParticleImage->incRef();
 
     return *this;
@@ -367,9 +391,22 @@ ParticleEmitter & ParticleEmitter::operator=(const ParticleEmitter &o)
 
 ParticleEmitter::~ParticleEmitter()
 {
+    delete mPool;
     if (mParticleImage) mParticleImage->decRef();
 }
 
+void ParticleEmitter::bind(Particle *target, Map *map)
+{
+    mParticleTarget = target;
+    mMap = map;
+
+    for (std::list<ParticleEmitter>::iterator i = mParticleChildEmitters.begin();
+         i != mParticleChildEmitters.end();
+         i++)
+    {
+        i->bind(target, map);
+    }
+}
 
 template <typename T> ParticleEmitterProp<T>
 ParticleEmitter::readParticleEmitterProp(xmlNodePtr propertyNode, T def)
@@ -398,18 +435,48 @@ ParticleEmitter::readParticleEmitterProp(xmlNodePtr propertyNode, T def)
 }
 
 
-std::list<Particle *> ParticleEmitter::createParticles(int tick)
+int ParticleEmitter::getOutput(int tick)
 {
-    std::list<Particle *> newParticles;
-
     if (mOutputPauseLeft > 0)
     {
         mOutputPauseLeft--;
-        return newParticles;
+        return 0;
     }
     mOutputPauseLeft = mOutputPause.value(tick);
 
-    for (int i = mOutput.value(tick); i > 0; i--)
+    return mOutput.value(tick);
+}
+
+void ParticleEmitter::initParticle(int tick, ParticleState &state)
+{
+    state.position = Vector(mParticlePosX.value(tick),
+                            mParticlePosY.value(tick),
+                            mParticlePosZ.value(tick));
+
+    float angleH = mParticleAngleHorizontal.value(tick);
+    float angleV = mParticleAngleVertical.value(tick);
+    float power = mParticlePower.value(tick);
+    state.velocity = Vector(cos(angleH) * cos(angleV) * power,
+                            sin(angleH) * cos(angleV) * power,
+                            sin(angleV) * power);
+
+    state.randomness = mParticleRandomness.value(tick);
+    state.gravity = mParticleGravity.value(tick);
+    state.bounce = mParticleBounce.value(tick);
+    state.acceleration = mParticleAcceleration.value(tick);
+    state.momentum = mParticleMomentum.value(tick);
+    state.dieDistance = mParticleDieDistance.value(tick);
+    state.lifetime = mParticleLifetime.value(tick);
+    state.fadeOut = mParticleFadeOut.value(tick);
+    state.fadeIn = mParticleFadeIn.value(tick);
+    state.alpha = mParticleAlpha.value(tick);
+}
+
+std::list<Particle *> ParticleEmitter::createParticles(int tick)
+{
+    std::list<Particle *> newParticles;
+
+    for (int i = getOutput(tick); i > 0; i--)
     {
         // Limit maximum particles
         if (Particle::particleCount > Particle::maxCount) break;
@@ -434,34 +501,28 @@ std::list<Particle *> ParticleEmitter::createParticles(int tick)
             newParticle = new Particle(mMap);
         }
 
-        Vector position(mParticlePosX.value(tick),
-                        mParticlePosY.value(tick),
-                        mParticlePosZ.value(tick));
-        newParticle->moveTo(position);
-
-        float angleH = mParticleAngleHorizontal.value(tick);
-        float angleV = mParticleAngleVertical.value(tick);
-        float power = mParticlePower.value(tick);
-        newParticle->setVelocity(
-                cos(angleH) * cos(angleV) * power,
-                sin(angleH) * cos(angleV) * power,
-                sin(angleV) * power);
-
-        newParticle->setRandomness(mParticleRandomness.value(tick));
-        newParticle->setGravity(mParticleGravity.value(tick));
-        newParticle->setBounce(mParticleBounce.value(tick));
+        ParticleState state;
+        initParticle(tick, state);
+
+        newParticle->moveTo(state.position);
+        newParticle->setVelocity(state.velocity.x,
+                                 state.velocity.y,
+                                 state.velocity.z);
+
+        newParticle->setRandomness(state.randomness);
+        newParticle->setGravity(state.gravity);
+        newParticle->setBounce(state.bounce);
         newParticle->setFollow(mParticleFollow);
 
         newParticle->setDestination(mParticleTarget,
-                                    mParticleAcceleration.value(tick),
-                                    mParticleMomentum.value(tick)
-                                   );
-        newParticle->setDieDistance(mParticleDieDistance.value(tick));
+                                    state.acceleration,
+                                    state.momentum);
+        newParticle->setDieDistance(state.dieDistance);
 
-        newParticle->setLifetime(mParticleLifetime.value(tick));
-        newParticle->setFadeOut(mParticleFadeOut.value(tick));
-        newParticle->setFadeIn(mParticleFadeIn.value(tick));
-        newParticle->setAlpha(mParticleAlpha.value(tick));
+        newParticle->setLifetime(state.lifetime);
+        newParticle->setFadeOut(state.fadeOut);
+        newParticle->setFadeIn(state.fadeIn);
+        newParticle->setAlpha(state.alpha);
 
         for (std::list<ParticleEmitter>::iterator i = mParticleChildEmitters.begin();
              i != mParticleChildEmitters.end();
@@ -475,3 +536,45 @@ std::list<Particle *> ParticleEmitter::createParticles(int tick)
 
     return newParticles;
 }
+
+bool ParticleEmitter::usesPool() const
+{
+    // Animated particles and particles hosting emitters need to be
+    // individual particles
+    return Particle::pooling && mMap && mParticleChildEmitters.empty() &&
+        (mParticleImage || (mParticleRotation.getLength() == 0 &&
+                            mParticleAnimation.getLength() == 0));
+}
+
+void ParticleEmitter::createPooledParticles(int tick, const Vector &origin)
+{
+    for (int i = getOutput(tick); i > 0; i--)
+    {
+        // Limit maximum particles
+        if (Particle::particleCount > Particle::maxCount) break;
+
+        if (!mPool)
+            mPool = new ParticlePool(mMap, mParticleImage);
+
+        ParticleState state;
+        initParticle(tick, state);
+        state.position += origin;
+
+        mPool->add(state);
+    }
+}
+
+void ParticleEmitter::updatePool(const Vector &change, int pixelY)
+{
+    if (!mPool)
+        return;
+
+    movePool(change);
+    mPool->update(mParticleTarget, pixelY);
+}
+
+void ParticleEmitter::movePool(const Vector &change)
+{
+    if (mPool && mParticleFollow)
+        mPool->moveBy(change);
+}
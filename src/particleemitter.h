@@ -27,6 +27,7 @@
 #include "utils/xml.h"
 
 #include "particleemitterprop.h"
+#include "particlepool.h"
 
 #include "resources/animation.h"
 
@@ -46,6 +47,15 @@ class ParticleEmitter
          */
         ParticleEmitter(xmlNodePtr emitterNode,  Particle *target, Map *map, int rotation = 0);
 
+        /**
+         * Creates an emitter from a compiled template, spawning particles
+         * on the given map that target the given particle. The rotation in
+         * degrees is added to the horizontal angle of the template, when
+         * the template defines one.
+         */
+        ParticleEmitter(const ParticleEmitter &o, Particle *target, Map *map,
+                        int rotation);
+
         /**
          * Copy Constructor (necessary for reference counting of particle images)
          */
@@ -67,6 +77,40 @@ class ParticleEmitter
          */
         std::list<Particle *> createParticles(int tick);
 
+        /**
+         * Spawns new particles into the particle pool of this emitter.
+         *
+         * @param origin position of the particle hosting the emitter
+         */
+        void createPooledParticles(int tick, const Vector &origin);
+
+        /**
+         * Tells whether the particles of this emitter are simple enough to
+         * be kept in a ParticlePool instead of being created as individual
+         * Particle instances.
+         */
+        bool usesPool() const;
+
+        /**
+         * Updates the pooled particles of this emitter.
+         *
+         * @param change how far the hosting particle moved this update
+         * @param pixelY the pixel Y coordinate of the hosting particle
+         */
+        void updatePool(const Vector &change, int pixelY);
+
+        /**
+         * Moves the pooled particles along with the hosting particle, if
+         * they are supposed to follow it.
+         */
+        void movePool(const Vector &change);
+
+        /**
+         * Returns the number of pooled particles of this emitter.
+         */
+        int getPooledCount() const
+        { return mPool ? mPool->size() : 0; }
+
         /**
          * Sets the target of the particles that are created
          */
@@ -74,6 +118,21 @@ class ParticleEmitter
         { mParticleTarget = target; };
 
     private:
+        /**
+         * Sets the target and map of this emitter and its child emitters.
+         */
+        void bind(Particle *target, Map *map);
+
+        /**
+         * Determines the initial state of a new particle.
+         */
+        void initParticle(int tick, ParticleState &state);
+
+        /**
+         * Returns the number of particles to spawn this update.
+         */
+        int getOutput(int tick);
+
         template <typename T> ParticleEmitterProp<T> readParticleEmitterProp(xmlNodePtr propertyNode, T def);
 
         /**
@@ -85,6 +144,7 @@ class ParticleEmitter
          * initial vector of particles:
          */
         ParticleEmitterProp<float> mParticleAngleHorizontal, mParticleAngleVertical;
+        bool mHasAngleHorizontal; /**< Whether the horizontal angle was given and follows the rotation */
 
         /**
          * Initial velocity of particles
@@ -130,5 +190,8 @@ class ParticleEmitter
 
         /** List of emitters the spawned particles are equipped with */
         std::list<ParticleEmitter> mParticleChildEmitters;
+
+        /** Storage of the spawned particles, when they can be pooled */
+        ParticlePool *mPool;
 };
 #endif
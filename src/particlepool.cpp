@@ -0,0 +1,311 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "graphics.h"
+#include "map.h"
+#include "particle.h"
+#include "particlepool.h"
+
+#include "resources/image.h"
+
+#include "utils/mathutils.h"
+
+#define SIN45 0.707106781f
+
+ParticlePool::ParticlePool(Map *map, Image *image):
+    mMap(map),
+    mImage(image),
+    mPixelY(0),
+    mSpriteAlpha(1.0f),
+    mRandomState(rand() | 1)
+{
+    if (mImage)
+        mImage->incRef();
+
+    mSpriteIterator = mMap->addSprite(this);
+}
+
+ParticlePool::~ParticlePool()
+{
+    mMap->removeSprite(mSpriteIterator);
+    Particle::particleCount -= size();
+
+    if (mImage)
+        mImage->decRef();
+}
+
+void ParticlePool::add(const ParticleState &p)
+{
+    mX.push_back(p.position.x);
+    mY.push_back(p.position.y);
+    mZ.push_back(p.position.z);
+    mVelocityX.push_back(p.velocity.x);
+    mVelocityY.push_back(p.velocity.y);
+    mVelocityZ.push_back(p.velocity.z);
+    mLifetimeLeft.push_back(p.lifetime);
+    mLifetimePast.push_back(0);
+    mFadeOut.push_back(p.fadeOut);
+    mFadeIn.push_back(p.fadeIn);
+    mAlpha.push_back(p.alpha);
+    mRandomness.push_back(p.randomness);
+    mGravity.push_back(p.gravity);
+    mBounce.push_back(p.bounce);
+    mAcceleration.push_back(p.acceleration);
+    mInvDieDistance.push_back(1.0f / p.dieDistance);
+    mMomentum.push_back(p.momentum);
+    mAlive.push_back(1);
+
+    Particle::particleCount++;
+}
+
+void ParticlePool::remove(int index)
+{
+    const int last = size() - 1;
+
+    if (index != last)
+    {
+        mX[index] = mX[last];
+        mY[index] = mY[last];
+        mZ[index] = mZ[last];
+        mVelocityX[index] = mVelocityX[last];
+        mVelocityY[index] = mVelocityY[last];
+        mVelocityZ[index] = mVelocityZ[last];
+        mLifetimeLeft[index] = mLifetimeLeft[last];
+        mLifetimePast[index] = mLifetimePast[last];
+        mFadeOut[index] = mFadeOut[last];
+        mFadeIn[index] = mFadeIn[last];
+        mAlpha[index] = mAlpha[last];
+        mRandomness[index] = mRandomness[last];
+        mGravity[index] = mGravity[last];
+        mBounce[index] = mBounce[last];
+        mAcceleration[index] = mAcceleration[last];
+        mInvDieDistance[index] = mInvDieDistance[last];
+        mMomentum[index] = mMomentum[last];
+        mAlive[index] = mAlive[last];
+    }
+
+    mX.pop_back();
+    mY.pop_back();
+    mZ.pop_back();
+    mVelocityX.pop_back();
+    mVelocityY.pop_back();
+    mVelocityZ.pop_back();
+    mLifetimeLeft.pop_back();
+    mLifetimePast.pop_back();
+    mFadeOut.pop_back();
+    mFadeIn.pop_back();
+    mAlpha.pop_back();
+    mRandomness.pop_back();
+    mGravity.pop_back();
+    mBounce.pop_back();
+    mAcceleration.pop_back();
+    mInvDieDistance.pop_back();
+    mMomentum.pop_back();
+    mAlive.pop_back();
+
+    Particle::particleCount--;
+}
+
+unsigned int ParticlePool::random()
+{
+    // Xorshift, which is plenty for jittering particles
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return mRandomState;
+}
+
+void ParticlePool::moveBy(const Vector &change)
+{
+    const int count = size();
+    for (int i = 0; i < count; i++)
+    {
+        mX[i] += change.x;
+        mY[i] += change.y;
+        mZ[i] += change.z;
+    }
+}
+
+void ParticlePool::update(const Particle *target, int pixelY)
+{
+    mPixelY = pixelY;
+
+    const int count = size();
+    if (count == 0)
+        return;
+
+    // Particles that ran out of lifetime die without moving any further
+    for (int i = 0; i < count; i++)
+        mAlive[i] = mLifetimeLeft[i] != 0;
+
+    // Calculate particle movement
+    Vector targetPos;
+    if (target)
+        targetPos = target->getPosition();
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!mAlive[i])
+            continue;
+
+        if (mMomentum[i] != 1.0f)
+        {
+            mVelocityX[i] *= mMomentum[i];
+            mVelocityY[i] *= mMomentum[i];
+            mVelocityZ[i] *= mMomentum[i];
+        }
+
+        if (target && mAcceleration[i] != 0.0f)
+        {
+            const float distX = (mX[i] - targetPos.x) * SIN45;
+            const float distY = mY[i] - targetPos.y;
+            const float distZ = mZ[i] - targetPos.z;
+            float invHypotenuse;
+
+            switch (Particle::fastPhysics)
+            {
+                case 1:
+                    invHypotenuse = fastInvSqrt(
+                        distX * distX + distY * distY + distZ * distZ);
+                    break;
+                case 2:
+                    invHypotenuse = 2.0f /
+                        fabs(distX) + fabs(distY) + fabs(distZ);
+                    break;
+                default:
+                    invHypotenuse = 1.0f / sqrt(
+                        distX * distX + distY * distY + distZ * distZ);
+                    break;
+            }
+
+            if (invHypotenuse)
+            {
+                if (mInvDieDistance[i] > 0.0f &&
+                    invHypotenuse > mInvDieDistance[i])
+                {
+                    mAlive[i] = 0;
+                }
+                const float accFactor = invHypotenuse * mAcceleration[i];
+                mVelocityX[i] -= distX * accFactor;
+                mVelocityY[i] -= distY * accFactor;
+                mVelocityZ[i] -= distZ * accFactor;
+            }
+        }
+
+        const int r = mRandomness[i];
+        if (r > 0)
+        {
+            mVelocityX[i] += ((int) (random() % r) -
+                              (int) (random() % r)) / 1000.0f;
+            mVelocityY[i] += ((int) (random() % r) -
+                              (int) (random() % r)) / 1000.0f;
+            mVelocityZ[i] += ((int) (random() % r) -
+                              (int) (random() % r)) / 1000.0f;
+        }
+
+        mVelocityZ[i] -= mGravity[i];
+    }
+
+    // Update positions and lifetimes. Dead particles are removed below, so
+    // these loops don't need to skip them.
+    for (int i = 0; i < count; i++)
+    {
+        mX[i] += mVelocityX[i];
+        mY[i] += mVelocityY[i] * SIN45;
+        mZ[i] += mVelocityZ[i] * SIN45;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (mLifetimeLeft[i] > 0)
+            mLifetimeLeft[i]--;
+        mLifetimePast[i]++;
+    }
+
+    // Bounce off the ground and remove dead particles. Going backwards
+    // means the particle moved into a freed slot has already been handled.
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (mAlive[i] && (mZ[i] > Particle::PARTICLE_SKY || mZ[i] < 0.0f))
+        {
+            if (mBounce[i] > 0.0f)
+            {
+                mZ[i] *= -mBounce[i];
+                mVelocityX[i] *= mBounce[i];
+                mVelocityY[i] *= mBounce[i];
+                mVelocityZ[i] *= -mBounce[i];
+            }
+            else
+            {
+                mAlive[i] = 0;
+            }
+        }
+
+        if (!mAlive[i])
+            remove(i);
+    }
+}
+
+void ParticlePool::setAlpha(float alpha)
+{
+    mSpriteAlpha = alpha;
+    std::fill(mAlpha.begin(), mAlpha.end(), alpha);
+}
+
+void ParticlePool::draw(Graphics *graphics, int offsetX, int offsetY) const
+{
+    if (!mImage)
+        return;
+
+    const int width = mImage->getWidth();
+    const int height = mImage->getHeight();
+    const int count = size();
+
+    for (int i = 0; i < count; i++)
+    {
+        int screenX = (int) mX[i] + offsetX - width / 2;
+        int screenY = (int) mY[i] - (int) mZ[i] + offsetY - height / 2;
+
+        // Check if on screen
+        if (screenX + width < 0 ||
+                screenX > graphics->getWidth() ||
+                screenY + height < 0 ||
+                screenY > graphics->getHeight())
+        {
+            continue;
+        }
+
+        float alphafactor = mAlpha[i];
+
+        if (mLifetimeLeft[i] > -1 && mLifetimeLeft[i] < mFadeOut[i])
+            alphafactor *= (float) mLifetimeLeft[i] / (float) mFadeOut[i];
+
+        if (mLifetimePast[i] < mFadeIn[i])
+            alphafactor *= (float) mLifetimePast[i] / (float) mFadeIn[i];
+
+        mImage->setAlpha(alphafactor);
+        graphics->drawImage(mImage, screenX, screenY);
+    }
+}
@@ -0,0 +1,157 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#include <list>
+#include <vector>
+
+#include "sprite.h"
+#include "vector.h"
+
+class Image;
+class Map;
+class Particle;
+
+/**
+ * The initial state of a particle created by a ParticleEmitter, either as a
+ * Particle instance or in a ParticlePool.
+ */
+struct ParticleState
+{
+    Vector position;
+    Vector velocity;
+    int randomness;
+    float gravity;
+    float bounce;
+    float acceleration;
+    float momentum;
+    float dieDistance;
+    int lifetime;
+    int fadeOut;
+    int fadeIn;
+    float alpha;
+};
+
+/**
+ * Storage for the simple particles spawned by a single ParticleEmitter.
+ *
+ * Particles that have no animation and no emitters of their own don't need
+ * to be individual objects. The pool keeps their state in parallel arrays
+ * and updates them all in one pass, behaving like a set of ImageParticles
+ * (or plain Particles when there is no image). The pool is added to the map
+ * as a single sprite, sorted by the position of the particle hosting the
+ * emitter.
+ */
+class ParticlePool : public Sprite
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param map   the map the particles appear on, may not be NULL
+         * @param image the image drawn for each particle, may be NULL
+         */
+        ParticlePool(Map *map, Image *image);
+
+        /**
+         * Destructor.
+         */
+        ~ParticlePool();
+
+        /**
+         * Adds a particle to the pool.
+         */
+        void add(const ParticleState &particle);
+
+        /**
+         * Moves all particles in the pool.
+         */
+        void moveBy(const Vector &change);
+
+        /**
+         * Updates all particles in the pool, removing the ones that died.
+         *
+         * @param target the particle attracting the particles, may be NULL
+         * @param pixelY the pixel Y coordinate used for sorting the pool
+         */
+        void update(const Particle *target, int pixelY);
+
+        /**
+         * Returns the number of particles in the pool.
+         */
+        int size() const
+        { return mX.size(); }
+
+        /**
+         * Draws the particles of the pool.
+         */
+        virtual void draw(Graphics *graphics, int offsetX, int offsetY) const;
+
+        virtual int getPixelY() const
+        { return mPixelY; }
+
+        /**
+         * Sets the alpha value of all particles in the pool, the same way
+         * the map sets it on individual particles.
+         */
+        virtual void setAlpha(float alpha);
+
+        virtual float getAlpha() const
+        { return mSpriteAlpha; }
+
+        /** Pooled particles are one layer sprites, like other particles */
+        virtual int getNumberOfLayers() const
+        { return 1; }
+
+    private:
+        /**
+         * Returns the next number of the pool's random number generator.
+         */
+        unsigned int random();
+
+        /**
+         * Removes the particle at the given index by moving the last
+         * particle into its place.
+         */
+        void remove(int index);
+
+        Map *mMap;
+        Image *mImage;
+        std::list<Sprite*>::iterator mSpriteIterator;
+        int mPixelY;
+        float mSpriteAlpha;
+        unsigned int mRandomState;
+
+        // Particle state, one entry per particle
+        std::vector<float> mX, mY, mZ;
+        std::vector<float> mVelocityX, mVelocityY, mVelocityZ;
+        std::vector<int> mLifetimeLeft, mLifetimePast;
+        std::vector<int> mFadeOut, mFadeIn;
+        std::vector<float> mAlpha;
+        std::vector<int> mRandomness;
+        std::vector<float> mGravity, mBounce;
+        std::vector<float> mAcceleration, mInvDieDistance, mMomentum;
+        std::vector<unsigned char> mAlive;
+};
+
+#endif
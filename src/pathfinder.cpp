@@ -0,0 +1,924 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "pathfinder.h"
+
+#include "map.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * The search state of the pathfinder, stored as a structure of arrays indexed
+ * by tile number. Each tile is stamped with the search that last touched it,
+ * so that nothing needs to be cleared between two searches. The open list is
+ * a binary heap indexed by tile, which allows the F cost of tiles already on
+ * it to be lowered in place.
+ */
+class PathWorkspace
+{
+    public:
+        enum ListState
+        {
+            NO_LIST = 0,
+            OPEN_LIST,
+            CLOSED_LIST
+        };
+
+        PathWorkspace(int size):
+            mSearch(0),
+            mExpanded(0),
+            mStamp(size, 0),
+            mList(size),
+            mGcost(size),
+            mFcost(size),
+            mParent(size),
+            mHeapIndex(size)
+        {
+            mHeap.reserve(64);
+            mPath.reserve(64);
+        }
+
+        /**
+         * Starts a new search, invalidating the state of all tiles.
+         */
+        void newSearch()
+        {
+            mHeap.clear();
+            mPath.clear();
+            mExpanded = 0;
+
+            if (++mSearch == 0)
+            {
+                // The stamps wrapped around, clear them once
+                std::fill(mStamp.begin(), mStamp.end(), 0);
+                mSearch = 1;
+            }
+        }
+
+        /**
+         * Returns which list the given tile is on during this search.
+         */
+        ListState getList(int tile) const
+        {
+            return mStamp[tile] == mSearch ? (ListState) mList[tile] : NO_LIST;
+        }
+
+        /**
+         * Marks the tile as reached in this search, with the given costs.
+         */
+        void reach(int tile, int parent, int Gcost, int Fcost)
+        {
+            mStamp[tile] = mSearch;
+            mList[tile] = NO_LIST;
+            mParent[tile] = parent;
+            mGcost[tile] = Gcost;
+            mFcost[tile] = Fcost;
+        }
+
+        void close(int tile) { mList[tile] = CLOSED_LIST; }
+
+        /**
+         * Adds a reached tile to the open list.
+         */
+        void push(int tile)
+        {
+            mList[tile] = OPEN_LIST;
+            mHeapIndex[tile] = mHeap.size();
+            mHeap.push_back(tile);
+            siftUp(mHeap.size() - 1);
+        }
+
+        /**
+         * Removes the tile with the lowest F cost from the open list.
+         */
+        int pop()
+        {
+            const int tile = mHeap.front();
+            ++mExpanded;
+            mHeap.front() = mHeap.back();
+            mHeapIndex[mHeap.front()] = 0;
+            mHeap.pop_back();
+            if (!mHeap.empty())
+                siftDown(0);
+            return tile;
+        }
+
+        /**
+         * Lowers the costs of a tile on the open list and moves it to its
+         * new place in the heap.
+         */
+        void decrease(int tile, int parent, int Gcost)
+        {
+            mFcost[tile] += Gcost - mGcost[tile];
+            mGcost[tile] = Gcost;
+            mParent[tile] = parent;
+            siftUp(mHeapIndex[tile]);
+        }
+
+        bool empty() const { return mHeap.empty(); }
+
+        int getGcost(int tile) const { return mGcost[tile]; }
+        int getParent(int tile) const { return mParent[tile]; }
+        bool reached(int tile) const { return mStamp[tile] == mSearch; }
+        int getExpandedCount() const { return mExpanded; }
+
+        /**
+         * Returns the buffer the found path is collected into, from
+         * destination to start.
+         */
+        std::vector<Position> &getPathBuffer() { return mPath; }
+
+    private:
+        void siftUp(int i)
+        {
+            const int tile = mHeap[i];
+            while (i > 0)
+            {
+                const int parent = (i - 1) / 2;
+                if (mFcost[mHeap[parent]] <= mFcost[tile])
+                    break;
+                mHeap[i] = mHeap[parent];
+                mHeapIndex[mHeap[i]] = i;
+                i = parent;
+            }
+            mHeap[i] = tile;
+            mHeapIndex[tile] = i;
+        }
+
+        void siftDown(int i)
+        {
+            const int size = mHeap.size();
+            const int tile = mHeap[i];
+            for (;;)
+            {
+                int child = 2 * i + 1;
+                if (child >= size)
+                    break;
+                if (child + 1 < size &&
+                    mFcost[mHeap[child + 1]] < mFcost[mHeap[child]])
+                    ++child;
+                if (mFcost[tile] <= mFcost[mHeap[child]])
+                    break;
+                mHeap[i] = mHeap[child];
+                mHeapIndex[mHeap[i]] = i;
+                i = child;
+            }
+            mHeap[i] = tile;
+            mHeapIndex[tile] = i;
+        }
+
+        unsigned int mSearch;              /**< Number of the current search */
+        int mExpanded;                     /**< Tiles taken from the heap */
+        std::vector<unsigned int> mStamp;  /**< Search that last reached a tile */
+        std::vector<unsigned char> mList;  /**< No list, open or closed list */
+        std::vector<int> mGcost;           /**< Cost from start to the tile */
+        std::vector<int> mFcost;           /**< Estimation of total path cost */
+        std::vector<int> mParent;          /**< Tile number of the parent */
+        std::vector<int> mHeapIndex;       /**< Position in the open list */
+        std::vector<int> mHeap;            /**< Open list, sorted on F cost */
+        std::vector<Position> mPath;       /**< Path buffer */
+};
+
+/**
+ * One bit per tile, stored row by row in 64-bit words. Used by the jump
+ * point search to test a whole stretch of a row at once. The bits past the
+ * end of a row stay cleared.
+ */
+class TileBits
+{
+    public:
+        typedef unsigned long long Word;
+
+        TileBits(): mRows(0), mLength(0), mWordsPerRow(0) {}
+
+        void resize(int rows, int length)
+        {
+            mRows = rows;
+            mLength = length;
+            mWordsPerRow = (length + 63) / 64;
+            mWords.assign(mRows * mWordsPerRow, 0);
+        }
+
+        bool empty() const { return mWords.empty(); }
+
+        void set(int row, int i, bool value)
+        {
+            Word &word = mWords[row * mWordsPerRow + i / 64];
+            const Word bit = (Word) 1 << (i % 64);
+            if (value)
+                word |= bit;
+            else
+                word &= ~bit;
+        }
+
+        /**
+         * Returns the bits of positions start to start + 63 of the given
+         * row, the first one in the lowest bit. Positions outside of the
+         * map give cleared bits.
+         */
+        Word get(int row, int start) const
+        {
+            if (row < 0 || row >= mRows || start >= mLength || start <= -64)
+                return 0;
+            if (start < 0)
+                return get(row, 0) << -start;
+
+            const Word *words = &mWords[row * mWordsPerRow];
+            const int index = start / 64;
+            const int shift = start % 64;
+
+            Word bits = words[index] >> shift;
+            if (shift && index + 1 < mWordsPerRow)
+                bits |= words[index + 1] << (64 - shift);
+            return bits;
+        }
+
+    private:
+        int mRows, mLength, mWordsPerRow;
+        std::vector<Word> mWords;
+};
+
+/**
+ * Returns the index of the lowest set bit, or 64 when no bit is set.
+ */
+static inline int lowestBit(TileBits::Word bits)
+{
+    if (!bits)
+        return 64;
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int i = 0;
+    while (!(bits & 1))
+    {
+        bits >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+/**
+ * Returns the number of cleared bits above the highest set bit, or 64 when
+ * no bit is set.
+ */
+static inline int highestBitDistance(TileBits::Word bits)
+{
+    if (!bits)
+        return 64;
+#ifdef __GNUC__
+    return __builtin_clzll(bits);
+#else
+    int i = 0;
+    while (!(bits & ((TileBits::Word) 1 << 63)))
+    {
+        bits <<= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+/**
+ * The tiles a jump point search may step on, by row and by column.
+ */
+struct JumpBits
+{
+    TileBits walkRows, walkColumns;  /**< Tiles not blocked by the walkmask */
+    TileBits freeRows, freeColumns;  /**< Tiles without beings */
+    int walkmask;                    /**< Walkmask of the walk bits, or -1 */
+};
+
+/**
+ * Scan steps a jump point search may take before giving up, by default. This
+ * is about a millisecond on maps full of obstacles.
+ */
+const int PathFinder::DEFAULT_SCAN_LIMIT = 10000;
+
+static int const basicCost = 100;
+static int const diagonalCost = basicCost * 362 / 256;
+
+/**
+ * Estimates the cost of walking between two tiles. The pathfinder does not
+ * work reliably if the heuristic cost is higher than the real cost. In
+ * particular, using Manhattan distance is forbidden here.
+ */
+static int estimateCost(int x1, int y1, int x2, int y2)
+{
+    const int dx = std::abs(x1 - x2), dy = std::abs(y1 - y2);
+    return std::abs(dx - dy) * basicCost + std::min(dx, dy) * diagonalCost;
+}
+
+PathFinder::PathFinder(int width, int height,
+                       const MetaTile *tiles, const int *beings):
+    mWidth(width), mHeight(height),
+    mTiles(tiles),
+    mBeings(beings),
+    mLongRange(false),
+    mScanLimit(DEFAULT_SCAN_LIMIT),
+    mWorkspace(NULL),
+    mJumpBits(NULL),
+    mAvoidBeings(false),
+    mDestTile(-1),
+    mBlockedByBeing(false),
+    mScanned(0)
+{
+}
+
+PathFinder::~PathFinder()
+{
+    delete mWorkspace;
+    delete mJumpBits;
+}
+
+void PathFinder::blockmaskChanged()
+{
+    if (mJumpBits)
+        mJumpBits->walkmask = -1;
+}
+
+void PathFinder::beingCountChanged(int x, int y)
+{
+    if (mJumpBits)
+        setFree(x, y, mBeings[x + y * mWidth] == 0);
+}
+
+void PathFinder::setFree(int x, int y, bool free)
+{
+    mJumpBits->freeRows.set(y, x, free);
+    mJumpBits->freeColumns.set(x, y, free);
+}
+
+void PathFinder::prepareJumpBits(unsigned char walkmask)
+{
+    if (!mJumpBits)
+    {
+        mJumpBits = new JumpBits;
+        mJumpBits->walkmask = -1;
+        mJumpBits->walkRows.resize(mHeight, mWidth);
+        mJumpBits->walkColumns.resize(mWidth, mHeight);
+        mJumpBits->freeRows.resize(mHeight, mWidth);
+        mJumpBits->freeColumns.resize(mWidth, mHeight);
+
+        for (int y = 0; y < mHeight; ++y)
+            for (int x = 0; x < mWidth; ++x)
+                setFree(x, y, mBeings[x + y * mWidth] == 0);
+    }
+
+    if (mJumpBits->walkmask == walkmask)
+        return;
+
+    for (int y = 0; y < mHeight; ++y)
+    {
+        for (int x = 0; x < mWidth; ++x)
+        {
+            const bool walk = getWalk(x, y, walkmask);
+            mJumpBits->walkRows.set(y, x, walk);
+            mJumpBits->walkColumns.set(x, y, walk);
+        }
+    }
+
+    mJumpBits->walkmask = walkmask;
+}
+
+PathWorkspace &PathFinder::getWorkspace()
+{
+    if (!mWorkspace)
+        mWorkspace = new PathWorkspace(mWidth * mHeight);
+
+    return *mWorkspace;
+}
+
+bool PathFinder::getWalk(int x, int y, unsigned char walkmask) const
+{
+    return contains(x, y) && !(mTiles[x + y * mWidth].blockmask & walkmask);
+}
+
+bool PathFinder::isFree(int x, int y, unsigned char walkmask) const
+{
+    if (!getWalk(x, y, walkmask))
+        return false;
+
+    const int tile = x + y * mWidth;
+    if (mAvoidBeings && mBeings[tile] > 0 && tile != mDestTile)
+    {
+        mBlockedByBeing = true;
+        return false;
+    }
+
+    return true;
+}
+
+Path PathFinder::findPath(int startX, int startY, int destX, int destY,
+                          unsigned char walkmask, int maxCost)
+{
+    // Return when destination not walkable
+    if (!getWalk(destX, destY, walkmask) || !contains(startX, startY))
+        return Path();
+
+    if (!mLongRange)
+        return findAStarPath(startX, startY, destX, destY, walkmask, maxCost);
+
+    // Only try A* when the destination could be within reach
+    if (estimateCost(startX, startY, destX, destY) <= maxCost * basicCost)
+    {
+        Path path = findAStarPath(startX, startY, destX, destY,
+                                  walkmask, maxCost);
+        if (!path.empty())
+            return path;
+    }
+
+    return findJumpPointPath(startX, startY, destX, destY, walkmask);
+}
+
+Path PathFinder::findAStarPath(int startX, int startY,
+                               int destX, int destY,
+                               unsigned char walkmask, int maxCost)
+{
+    // Path to be built up (empty by default)
+    Path path;
+
+    PathWorkspace &ws = getWorkspace();
+    ws.newSearch();
+
+    const int startTile = startX + startY * mWidth;
+    const int destTile = destX + destY * mWidth;
+
+    // Add the start point to the open list, with a G cost of 0
+    ws.reach(startTile, startTile, 0, 0);
+    ws.push(startTile);
+
+    bool foundPath = false;
+
+    // Keep trying new open tiles until no more tiles to try or target found
+    while (!ws.empty() && !foundPath)
+    {
+        // Take the location with the lowest F cost from the open list and
+        // put it on the closed list.
+        const int curr = ws.pop();
+        ws.close(curr);
+
+        const int currX = curr % mWidth;
+        const int currY = curr / mWidth;
+        const int currGcost = ws.getGcost(curr);
+
+        // Check the adjacent tiles
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                // Calculate location of tile to check
+                const int x = currX + dx;
+                const int y = currY + dy;
+
+                // Skip if if we're checking the same tile we're leaving from,
+                // or if the new location falls outside of the map boundaries
+                if ((dx == 0 && dy == 0) || !contains(x, y))
+                {
+                    continue;
+                }
+
+                const int newTile = x + y * mWidth;
+                const PathWorkspace::ListState list = ws.getList(newTile);
+
+                // Skip if the tile is on the closed list or is not walkable
+                // unless its the destination tile
+                if (list == PathWorkspace::CLOSED_LIST ||
+                    ((mTiles[newTile].blockmask & walkmask)
+                     && newTile != destTile))
+                {
+                    continue;
+                }
+
+                // When taking a diagonal step, verify that we can skip the
+                // corner.
+                if (dx != 0 && dy != 0)
+                {
+                    const MetaTile &t1 = mTiles[curr + dy * mWidth];
+                    const MetaTile &t2 = mTiles[curr + dx];
+
+                    if ((t1.blockmask | t2.blockmask) & Map::BLOCKMASK_WALL)
+                        continue;
+                }
+
+                // Calculate G cost for this route, ~sqrt(2) for moving diagonal
+                int Gcost = currGcost +
+                    (dx == 0 || dy == 0 ? basicCost : diagonalCost);
+
+                /* Demote an arbitrary direction to speed pathfinding by
+                   adding a defect (TODO: change depending on the desired
+                   visual effect, e.g. a cross-product defect toward
+                   destination).
+                   Important: as long as the total defect along any path is
+                   less than the basicCost, the pathfinder will still find one
+                   of the shortest paths! */
+                if (dx == 0 || dy == 0)
+                {
+                    // Demote horizontal and vertical directions, so that two
+                    // consecutive directions cannot have the same Fcost.
+                    ++Gcost;
+                }
+
+                // It costs extra to walk through a being (needs to be enough
+                // to make it more attractive to walk around).
+                if (mBeings[newTile] > 0)
+                {
+                    Gcost += 3 * basicCost;
+                }
+
+                // Skip if Gcost becomes too much
+                // Warning: probably not entirely accurate
+                if (Gcost > maxCost * basicCost)
+                {
+                    continue;
+                }
+
+                if (list == PathWorkspace::NO_LIST)
+                {
+                    // Found a new tile (not on open nor on closed list)
+
+                    const int Hcost = estimateCost(x, y, destX, destY);
+
+                    // Set the current tile as the parent of the new tile
+                    ws.reach(newTile, curr, Gcost, Gcost + Hcost);
+
+                    if (newTile != destTile) {
+                        // Add this tile to the open list
+                        ws.push(newTile);
+                    }
+                    else {
+                        // Target location was found
+                        foundPath = true;
+                    }
+                }
+                else if (Gcost < ws.getGcost(newTile))
+                {
+                    // Found a shorter route. Update the costs of the new tile
+                    // and make the current tile its parent.
+                    ws.decrease(newTile, curr, Gcost);
+                }
+            }
+        }
+    }
+
+    // If a path has been found, iterate backwards using the parent locations
+    // to extract it.
+    if (foundPath)
+    {
+        int tile = destTile;
+
+        while (tile != startTile)
+        {
+            ws.getPathBuffer().push_back(Position(tile % mWidth, tile / mWidth));
+            tile = ws.getParent(tile);
+        }
+
+        path.assign(ws.getPathBuffer().rbegin(), ws.getPathBuffer().rend());
+    }
+
+    return path;
+}
+
+Path PathFinder::findJumpPointPath(int startX, int startY,
+                                   int destX, int destY,
+                                   unsigned char walkmask)
+{
+    // Both searches share the scan limit
+    mScanned = 0;
+
+    Path path = searchJumpPoints(startX, startY, destX, destY,
+                                 walkmask, true);
+
+    // When beings are in the way of every route, walk through them like A*
+    // would rather than not moving at all
+    if (path.empty() && mBlockedByBeing && mScanned <= mScanLimit)
+    {
+        path = searchJumpPoints(startX, startY, destX, destY,
+                                walkmask, false);
+    }
+
+    return path;
+}
+
+Path PathFinder::searchJumpPoints(int startX, int startY,
+                                  int destX, int destY,
+                                  unsigned char walkmask, bool avoidBeings)
+{
+    Path path;
+
+    PathWorkspace &ws = getWorkspace();
+    ws.newSearch();
+
+    const int startTile = startX + startY * mWidth;
+    const int destTile = destX + destY * mWidth;
+
+    mAvoidBeings = avoidBeings;
+    mDestTile = destTile;
+    mBlockedByBeing = false;
+
+    prepareJumpBits(walkmask);
+
+    // Beings don't keep us from walking up to them
+    const bool destOccupied = mBeings[destTile] > 0;
+    if (destOccupied)
+        setFree(destX, destY, true);
+
+    ws.reach(startTile, startTile, 0,
+             estimateCost(startX, startY, destX, destY));
+    ws.push(startTile);
+
+    bool foundPath = false;
+
+    // Give up once the scans took too long, the destination is most likely
+    // unreachable
+    while (!ws.empty() && mScanned <= mScanLimit)
+    {
+        const int curr = ws.pop();
+        ws.close(curr);
+
+        if (curr == destTile)
+        {
+            foundPath = true;
+            break;
+        }
+
+        const int x = curr % mWidth;
+        const int y = curr / mWidth;
+        const int parent = ws.getParent(curr);
+
+        // Collect the directions worth scanning. From the start tile these
+        // are all directions, otherwise only the direction of travel and the
+        // directions of the neighbours that are not reached more cheaply
+        // through the parent.
+        int dirs[8][2];
+        int dirCount = 0;
+
+        if (parent == curr)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (dx == 0 && dy == 0)
+                        continue;
+                    dirs[dirCount][0] = dx;
+                    dirs[dirCount][1] = dy;
+                    dirCount++;
+                }
+            }
+        }
+        else
+        {
+            const int px = parent % mWidth;
+            const int py = parent / mWidth;
+            const int dx = (x > px) - (x < px);
+            const int dy = (y > py) - (y < py);
+
+            if (dx != 0 && dy != 0)
+            {
+                dirs[dirCount][0] = 0; dirs[dirCount][1] = dy; dirCount++;
+                dirs[dirCount][0] = dx; dirs[dirCount][1] = 0; dirCount++;
+                dirs[dirCount][0] = dx; dirs[dirCount][1] = dy; dirCount++;
+            }
+            else if (dx != 0)
+            {
+                dirs[dirCount][0] = dx; dirs[dirCount][1] = 0; dirCount++;
+                dirs[dirCount][0] = dx; dirs[dirCount][1] = 1; dirCount++;
+                dirs[dirCount][0] = dx; dirs[dirCount][1] = -1; dirCount++;
+                dirs[dirCount][0] = 0; dirs[dirCount][1] = 1; dirCount++;
+                dirs[dirCount][0] = 0; dirs[dirCount][1] = -1; dirCount++;
+            }
+            else
+            {
+                dirs[dirCount][0] = 0; dirs[dirCount][1] = dy; dirCount++;
+                dirs[dirCount][0] = 1; dirs[dirCount][1] = dy; dirCount++;
+                dirs[dirCount][0] = -1; dirs[dirCount][1] = dy; dirCount++;
+                dirs[dirCount][0] = 1; dirs[dirCount][1] = 0; dirCount++;
+                dirs[dirCount][0] = -1; dirs[dirCount][1] = 0; dirCount++;
+            }
+        }
+
+        for (int i = 0; i < dirCount; i++)
+        {
+            const int dx = dirs[i][0];
+            const int dy = dirs[i][1];
+
+            // Diagonal steps are only taken when both corners are free
+            if (dx != 0 && dy != 0 &&
+                (!isFree(x + dx, y, walkmask) ||
+                 !isFree(x, y + dy, walkmask)))
+            {
+                continue;
+            }
+
+            const int jumpTile = jump(x + dx, y + dy, dx, dy,
+                                      destTile, walkmask);
+            if (jumpTile < 0 ||
+                ws.getList(jumpTile) == PathWorkspace::CLOSED_LIST)
+            {
+                continue;
+            }
+
+            // Jump points are always reached in a straight or diagonal line
+            const int jumpX = jumpTile % mWidth;
+            const int jumpY = jumpTile / mWidth;
+            const int steps = std::max(std::abs(jumpX - x),
+                                       std::abs(jumpY - y));
+            const int Gcost = ws.getGcost(curr) + steps *
+                (dx != 0 && dy != 0 ? diagonalCost : basicCost);
+
+            if (ws.getList(jumpTile) == PathWorkspace::NO_LIST)
+            {
+                ws.reach(jumpTile, curr, Gcost, Gcost +
+                         estimateCost(jumpX, jumpY, destX, destY));
+                ws.push(jumpTile);
+            }
+            else if (Gcost < ws.getGcost(jumpTile))
+            {
+                ws.decrease(jumpTile, curr, Gcost);
+            }
+        }
+    }
+
+    if (destOccupied)
+        setFree(destX, destY, false);
+
+    // Walk back over the jump points, filling in the tiles between them
+    if (foundPath)
+    {
+        int tile = destTile;
+
+        while (tile != startTile)
+        {
+            const int parent = ws.getParent(tile);
+            int x = tile % mWidth;
+            int y = tile / mWidth;
+            const int px = parent % mWidth;
+            const int py = parent / mWidth;
+            const int dx = (px > x) - (px < x);
+            const int dy = (py > y) - (py < y);
+
+            while (x != px || y != py)
+            {
+                ws.getPathBuffer().push_back(Position(x, y));
+                x += dx;
+                y += dy;
+            }
+
+            tile = parent;
+        }
+
+        path.assign(ws.getPathBuffer().rbegin(), ws.getPathBuffer().rend());
+    }
+
+    return path;
+}
+
+int PathFinder::jump(int x, int y, int dx, int dy, int destTile,
+                     unsigned char walkmask) const
+{
+    if (dx == 0 || dy == 0)
+        return scanStraight(x, y, dx, dy);
+
+    for (;;)
+    {
+        if (++mScanned > mScanLimit || !isFree(x, y, walkmask))
+            return -1;
+
+        const int tile = x + y * mWidth;
+        if (tile == destTile)
+            return tile;
+
+        // A diagonal scan stops where a straight scan finds something
+        if (scanStraight(x + dx, y, dx, 0) >= 0 ||
+            scanStraight(x, y + dy, 0, dy) >= 0)
+            return tile;
+
+        // Diagonal steps are only taken when both corners are free
+        if (!isFree(x + dx, y, walkmask) || !isFree(x, y + dy, walkmask))
+            return -1;
+
+        x += dx;
+        y += dy;
+    }
+}
+
+int PathFinder::scanStraight(int x, int y, int dx, int dy) const
+{
+    // Vertical scans run along the rows of the transposed bits
+    const bool horizontal = dy == 0;
+    const TileBits &walk = horizontal ? mJumpBits->walkRows
+                                      : mJumpBits->walkColumns;
+    const TileBits &free = horizontal ? mJumpBits->freeRows
+                                      : mJumpBits->freeColumns;
+    const int row = horizontal ? y : x;
+    const int d = horizontal ? dx : dy;
+    int i = horizontal ? x : y;
+
+    const int destX = mDestTile % mWidth;
+    const int destY = mDestTile / mWidth;
+    const int dest = (horizontal ? destY : destX) == row ?
+                     (horizontal ? destX : destY) : -1;
+
+    for (;;)
+    {
+        // Look at the next 64 tiles in the direction of the scan, with the
+        // tile at i in the lowest bit when scanning forward and in the
+        // highest bit when scanning backward
+        const int start = d > 0 ? i : i - 63;
+
+        TileBits::Word open = walk.get(row, start);
+        TileBits::Word side1 = walk.get(row - 1, start);
+        TileBits::Word side1Behind = walk.get(row - 1, start - d);
+        TileBits::Word side2 = walk.get(row + 1, start);
+        TileBits::Word side2Behind = walk.get(row + 1, start - d);
+
+        if (mAvoidBeings)
+        {
+            const TileBits::Word freeOpen = free.get(row, start);
+            const TileBits::Word freeSide1 = free.get(row - 1, start);
+            const TileBits::Word freeSide2 = free.get(row + 1, start);
+
+            // Remember seeing beings, the search is repeated without
+            // avoiding them when it fails
+            if ((open & ~freeOpen) | (side1 & ~freeSide1) |
+                (side2 & ~freeSide2))
+                mBlockedByBeing = true;
+
+            open &= freeOpen;
+            side1 &= freeSide1;
+            side1Behind &= free.get(row - 1, start - d);
+            side2 &= freeSide2;
+            side2Behind &= free.get(row + 1, start - d);
+        }
+
+        // Stop when a neighbour opens up that was blocked behind us
+        TileBits::Word stop = (side1 & ~side1Behind) | (side2 & ~side2Behind);
+        if (dest >= start && dest < start + 64)
+            stop |= (TileBits::Word) 1 << (dest - start);
+
+        const TileBits::Word blocked = ~open;
+        const int blockedAt = d > 0 ? lowestBit(blocked)
+                                    : highestBitDistance(blocked);
+        const int stopAt = d > 0 ? lowestBit(stop) : highestBitDistance(stop);
+
+        if (blockedAt < 64 && blockedAt <= stopAt)
+        {
+            ++mScanned;
+            return -1;
+        }
+
+        if (stopAt < 64)
+        {
+            if (++mScanned > mScanLimit)
+                return -1;
+
+            const int at = i + d * stopAt;
+            return horizontal ? at + y * mWidth : x + at * mWidth;
+        }
+
+        if (++mScanned > mScanLimit)
+            return -1;
+
+        i += 64 * d;
+    }
+}
+
+int PathFinder::getPathCost(int x, int y) const
+{
+    if (!mWorkspace || !contains(x, y))
+        return 0;
+
+    const int tile = x + y * mWidth;
+    return mWorkspace->reached(tile) ? mWorkspace->getGcost(tile) : 0;
+}
+
+int PathFinder::getScannedCount() const
+{
+    return mScanned;
+}
+
+int PathFinder::getExpandedCount() const
+{
+    return mWorkspace ? mWorkspace->getExpandedCount() : 0;
+}
@@ -0,0 +1,192 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include "position.h"
+
+struct JumpBits;
+struct MetaTile;
+class PathWorkspace;
+
+/**
+ * Finds paths over the tiles of a map.
+ *
+ * The pathfinder refers to the blockmasks and being counts of the map, which
+ * may change between searches. Its search state is allocated on the first
+ * search and reused by the following ones.
+ */
+class PathFinder
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param tiles  the meta tiles of the map, row by row
+         * @param beings the number of beings standing on each tile
+         */
+        PathFinder(int width, int height,
+                   const MetaTile *tiles, const int *beings);
+
+        /**
+         * Destructor.
+         */
+        ~PathFinder();
+
+        /**
+         * Sets whether destinations out of reach of A* are searched for
+         * with jump point search.
+         */
+        void setLongRange(bool longRange)
+        { mLongRange = longRange; }
+
+        /**
+         * Sets the number of scan steps a jump point search may take before
+         * it gives up, including its retry through beings. A step looks at
+         * up to 64 tiles of a row or column, or moves one tile diagonally,
+         * so the limit bounds the time spent on each search.
+         */
+        void setScanLimit(int steps)
+        { mScanLimit = steps; }
+
+        static const int DEFAULT_SCAN_LIMIT;
+
+        /**
+         * Tells the pathfinder that the blockmasks of the tiles changed.
+         */
+        void blockmaskChanged();
+
+        /**
+         * Tells the pathfinder that the number of beings standing on the
+         * given tile changed.
+         */
+        void beingCountChanged(int x, int y);
+
+        /**
+         * Finds a path from one location to the next, as described at
+         * Map::findPath.
+         */
+        Path findPath(int startX, int startY, int destX, int destY,
+                      unsigned char walkmask, int maxCost);
+
+        /**
+         * Finds a path using A*, taking the tiles occupied by beings into
+         * account. Gives up on routes that cost more than maxCost.
+         */
+        Path findAStarPath(int startX, int startY, int destX, int destY,
+                           unsigned char walkmask, int maxCost);
+
+        /**
+         * Finds a path using jump point search. The cost of each step is
+         * uniform, which allows long straight stretches to be skipped
+         * without expanding every tile along them. Tiles occupied by beings
+         * are avoided like blocked tiles, unless there is no other way.
+         */
+        Path findJumpPointPath(int startX, int startY, int destX, int destY,
+                               unsigned char walkmask);
+
+        /**
+         * Returns the cost of reaching the given tile during the last
+         * search, or 0 when the tile wasn't reached.
+         */
+        int getPathCost(int x, int y) const;
+
+        /**
+         * Returns the number of tiles taken from the open list during the
+         * last search.
+         */
+        int getExpandedCount() const;
+
+        /**
+         * Returns the number of scan steps taken by the last jump point
+         * search.
+         */
+        int getScannedCount() const;
+
+    private:
+        /**
+         * Returns the search state, allocating it on first use.
+         */
+        PathWorkspace &getWorkspace();
+
+        bool contains(int x, int y) const
+        { return x >= 0 && y >= 0 && x < mWidth && y < mHeight; }
+
+        /**
+         * Tells whether the given tile is on the map and not blocked.
+         */
+        bool getWalk(int x, int y, unsigned char walkmask) const;
+
+        /**
+         * Runs a jump point search, optionally treating the tiles occupied
+         * by beings as blocked.
+         */
+        Path searchJumpPoints(int startX, int startY, int destX, int destY,
+                              unsigned char walkmask, bool avoidBeings);
+
+        /**
+         * Brings the bits used by the jump point search up to date for the
+         * given walkmask.
+         */
+        void prepareJumpBits(unsigned char walkmask);
+
+        /**
+         * Sets whether the jump point search sees the given tile as free
+         * of beings.
+         */
+        void setFree(int x, int y, bool free);
+
+        /**
+         * Scans a row or column for the next jump point, testing many tiles
+         * at once. Returns its tile number, or -1 if there is none.
+         */
+        int scanStraight(int x, int y, int dx, int dy) const;
+
+        /**
+         * Tells whether the current jump point search may step on the given
+         * tile.
+         */
+        bool isFree(int x, int y, unsigned char walkmask) const;
+
+        /**
+         * Scans from the given tile in the given direction for the next
+         * jump point. Returns its tile number, or -1 if there is none.
+         */
+        int jump(int x, int y, int dx, int dy, int destTile,
+                 unsigned char walkmask) const;
+
+        int mWidth, mHeight;
+        const MetaTile *mTiles;
+        const int *mBeings;
+        bool mLongRange;
+        int mScanLimit;
+        PathWorkspace *mWorkspace;
+        JumpBits *mJumpBits;    /**< Allocated on the first jump search */
+
+        // State of the current jump point search
+        bool mAvoidBeings;
+        int mDestTile;
+        mutable bool mBlockedByBeing;
+        mutable int mScanned;
+};
+
+#endif // PATHFINDER_H
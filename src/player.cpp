@@ -33,6 +33,8 @@
 #include "resources/colordb.h"
 #include "resources/itemdb.h"
 #include "resources/iteminfo.h"
+#include "resources/resourcemanager.h"
+#include "resources/spritedef.h"
 
 #include "utils/stringutils.h"
 
@@ -49,6 +51,7 @@ Player::Player(int id, int job, Map *map, bool isNPC):
             mSprites.push_back(NULL);
             mSpriteIDs.push_back(0);
             mSpriteColors.push_back("");
+            mPendingSprites.push_back("");
         }
 
         /* Human base sprite. When implementing different races remove this
@@ -66,6 +69,7 @@ Player::Player(int id, int job, Map *map, bool isNPC):
 Player::~Player()
 {
     config.removeListener("visiblenames", this);
+    ResourceManager::getInstance()->cancelAsync(this);
 }
 
 #ifdef EATHENA_SUPPORT
@@ -154,6 +158,8 @@ void Player::setSprite(unsigned int slot, int id, const std::string &color)
 {
     assert(slot >= BASE_SPRITE && slot < VECTOREND_SPRITE);
 
+    mPendingSprites[slot].clear();
+
     // id = 0 means unequip
     if (id == 0)
     {
@@ -168,24 +174,22 @@ void Player::setSprite(unsigned int slot, int id, const std::string &color)
     else
     {
         std::string filename = ItemDB::get(id).getSprite(mGender);
-        AnimatedSprite *equipmentSprite = NULL;
 
         if (!filename.empty())
         {
             if (!color.empty())
                 filename += "|" + color;
 
-            equipmentSprite = AnimatedSprite::load("graphics/sprites/" +
-                                                   filename);
+            // The current sprite is shown until the new one is loaded
+            mPendingSprites[slot] = "graphics/sprites/" + filename;
+            ResourceManager::getInstance()->getSpriteAsync(
+                    mPendingSprites[slot], 0, this);
         }
-
-        if (equipmentSprite)
-            equipmentSprite->setDirection(getSpriteDirection());
-
-        if (mSprites[slot])
+        else
+        {
             delete mSprites[slot];
-
-        mSprites[slot] = equipmentSprite;
+            mSprites[slot] = NULL;
+        }
 
         if (slot == WEAPON_SPRITE)
             mEquippedWeapon = &ItemDB::get(id);
@@ -197,6 +201,37 @@ void Player::setSprite(unsigned int slot, int id, const std::string &color)
     mSpriteColors[slot] = color;
 }
 
+void Player::resourceLoaded(const std::string &path, Resource *resource)
+{
+    SpriteDef *spriteDef = static_cast<SpriteDef*>(resource);
+    bool changed = false;
+
+    for (unsigned int slot = 0; slot < mPendingSprites.size(); slot++)
+    {
+        if (mPendingSprites[slot] != path)
+            continue;
+
+        AnimatedSprite *equipmentSprite = NULL;
+
+        if (spriteDef)
+        {
+            equipmentSprite = new AnimatedSprite(spriteDef);
+            equipmentSprite->setDirection(getSpriteDirection());
+        }
+
+        delete mSprites[slot];
+        mSprites[slot] = equipmentSprite;
+        mPendingSprites[slot].clear();
+        changed = true;
+    }
+
+    if (spriteDef)
+        spriteDef->decRef();
+
+    if (changed)
+        setAction(mAction);
+}
+
 void Player::setSpriteID(unsigned int slot, int id)
 {
     setSprite(slot, id, mSpriteColors[slot]);
@@ -274,14 +309,14 @@ void Player::updateColors()
     if (mIsGM)
     {
         mTextColor = &guiPalette->getColor(Palette::GM);
-        mNameColor = &guiPalette->getColor(Palette::GM_NAME);
+        mNameColor = Palette::GM_NAME;
     }
     else if (mInParty)
     {
-        mNameColor = &guiPalette->getColor(Palette::PARTY);
+        mNameColor = Palette::PARTY;
     }
     else
     {
-        mNameColor = &guiPalette->getColor(Palette::PC);
+        mNameColor = Palette::PC;
     }
 }
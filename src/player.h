@@ -24,6 +24,8 @@
 
 #include "being.h"
 
+#include "resources/resourcemanager.h"
+
 class Graphics;
 class Map;
 class Guild;
@@ -39,8 +41,11 @@ enum Gender
  * A player being. Players have their name drawn beneath them. This class also
  * implements player-specific loading of base sprite, hair sprite and equipment
  * sprites.
+ *
+ * Equipment sprites are loaded in the background. Until a new sprite is
+ * available, the previous sprite in its slot is shown in its place.
  */
-class Player : public Being
+class Player : public Being, public AsyncResourceListener
 {
     public:
         enum Sprite
@@ -152,6 +157,13 @@ class Player : public Being
          */
         virtual void optionChanged(const std::string &value);
 
+        /**
+         * Puts a sprite loaded in the background into the slots waiting for
+         * it.
+         */
+        virtual void resourceLoaded(const std::string &path,
+                                    Resource *resource);
+
     protected:
         /**
          * Gets the way the monster blocks pathfinding for other objects.
@@ -164,6 +176,7 @@ class Player : public Being
         Gender mGender;
         std::vector<int> mSpriteIDs;
         std::vector<std::string> mSpriteColors;
+        std::vector<std::string> mPendingSprites; /**< Paths being loaded */
 
         // Character guild information
         std::map<int, Guild*> mGuilds;
@@ -0,0 +1,443 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/datafile.h"
+
+#include "resources/resourcemanager.h"
+
+#include "log.h"
+
+#include <libxml/tree.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+/** Increase whenever the layout of compiled data files changes */
+static const Uint32 DATA_FILE_VERSION = 1;
+
+static const char DATA_FILE_MAGIC[4] = { 'M', 'D', 'A', 'T' };
+
+std::string DataFile::mCacheDirectory;
+
+struct DataFile::Header
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 checksum;        /**< Checksum of the XML file */
+    Uint32 sourceSize;      /**< Size of the XML file */
+    Uint32 elementCount;
+    Uint32 attributeCount;
+    Uint32 stringSize;
+};
+
+struct DataFile::Element
+{
+    Uint32 name;
+    Uint32 text;
+    Uint32 firstAttribute;
+    Uint32 attributeCount;
+    Uint32 firstChild;
+    Uint32 childCount;
+};
+
+struct DataFile::Attribute
+{
+    Uint32 name;
+    Uint32 value;
+};
+
+/**
+ * Computes the 32-bit FNV-1a hash of the given data.
+ */
+static Uint32 checksum(const char *data, int size)
+{
+    Uint32 hash = 2166136261u;
+    for (int i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char) data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Collects the strings of a data file, storing each of them only once.
+ */
+class StringTable
+{
+    public:
+        StringTable(): mStrings(1, '\0') {}
+
+        Uint32 add(const std::string &s)
+        {
+            if (s.empty())
+                return 0;
+
+            std::map<std::string, Uint32>::const_iterator i = mOffsets.find(s);
+            if (i != mOffsets.end())
+                return i->second;
+
+            const Uint32 offset = mStrings.size();
+            mStrings.append(s.c_str(), s.size() + 1);
+            mOffsets[s] = offset;
+            return offset;
+        }
+
+        const std::string &getData() const
+        { return mStrings; }
+
+    private:
+        std::string mStrings;
+        std::map<std::string, Uint32> mOffsets;
+};
+
+typedef std::pair<std::string, std::string> XmlAttribute;
+
+DataFile::DataFile(const std::string &filename):
+    mData(0),
+    mSize(0),
+    mHeader(0),
+    mElements(0),
+    mAttributes(0),
+    mStrings(0)
+{
+    ResourceManager *resman = ResourceManager::getInstance();
+
+    int size;
+    char *source = (char*) resman->loadFile(filename, size);
+    if (!source)
+    {
+        logger->log("Error loading %s", filename.c_str());
+        return;
+    }
+
+    const Uint32 sum = checksum(source, size);
+
+    std::string cacheFile;
+    if (!mCacheDirectory.empty())
+    {
+        std::string name = filename;
+        std::replace(name.begin(), name.end(), '/', '_');
+        cacheFile = mCacheDirectory + "/" + name + ".bin";
+
+        if (loadCache(cacheFile, sum, size))
+        {
+            free(source);
+            return;
+        }
+    }
+
+    const bool compiled = compile(source, size, sum);
+    free(source);
+
+    if (!compiled)
+    {
+        logger->log("Error parsing XML file %s", filename.c_str());
+        return;
+    }
+
+    if (!cacheFile.empty() && resman->saveFile(cacheFile, mData, mSize))
+    {
+        logger->log("Compiled %s into %s", filename.c_str(),
+                    cacheFile.c_str());
+    }
+}
+
+DataFile::~DataFile()
+{
+    free(mData);
+}
+
+void DataFile::setCacheDirectory(const std::string &directory)
+{
+    mCacheDirectory = directory;
+
+    if (directory.empty())
+        return;
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    if (!resman->isDirectory("/" + directory) &&
+        !resman->mkdir("/" + directory))
+    {
+        logger->log("Warning: Couldn't create data cache directory %s",
+                    directory.c_str());
+        mCacheDirectory.clear();
+    }
+}
+
+bool DataFile::loadCache(const std::string &path, Uint32 sum, Uint32 size)
+{
+    ResourceManager *resman = ResourceManager::getInstance();
+    if (!resman->exists(path))
+        return false;
+
+    int cacheSize;
+    char *data = (char*) resman->loadFile(path, cacheSize);
+    if (!data)
+        return false;
+
+    if (cacheSize < (int) sizeof(Header))
+    {
+        logger->log("Ignoring damaged %s", path.c_str());
+        free(data);
+        return false;
+    }
+
+    setData(data);
+    mSize = cacheSize;
+
+    if (validate(cacheSize) &&
+        mHeader->checksum == sum && mHeader->sourceSize == size)
+    {
+        return true;
+    }
+
+    logger->log("Ignoring outdated or damaged %s", path.c_str());
+    free(mData);
+    mData = 0;
+    mSize = 0;
+    mHeader = 0;
+    mElements = 0;
+    mAttributes = 0;
+    mStrings = 0;
+    return false;
+}
+
+bool DataFile::compile(const char *data, int size, Uint32 sum)
+{
+    xmlDocPtr doc = xmlParseMemory(data, size);
+    if (!doc)
+        return false;
+
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    if (!root)
+    {
+        xmlFreeDoc(doc);
+        return false;
+    }
+
+    StringTable strings;
+    std::vector<Element> elements;
+    std::vector<Attribute> attributes;
+    std::vector<XmlAttribute> properties;
+
+    // Breadth-first, so that the children of each element end up together
+    std::vector<xmlNodePtr> nodes(1, root);
+
+    for (unsigned int i = 0; i < nodes.size(); ++i)
+    {
+        xmlNodePtr node = nodes[i];
+        Element element;
+        element.name = strings.add((const char*) node->name);
+
+        xmlNodePtr first = node->xmlChildrenNode;
+        element.text = 0;
+        if (first && first->content &&
+            (first->type == XML_TEXT_NODE ||
+             first->type == XML_CDATA_SECTION_NODE))
+        {
+            element.text = strings.add((const char*) first->content);
+        }
+
+        properties.clear();
+        for (xmlAttrPtr attr = node->properties; attr; attr = attr->next)
+        {
+            xmlChar *value = xmlGetProp(node, attr->name);
+            properties.push_back(XmlAttribute((const char*) attr->name,
+                                              value ? (const char*) value
+                                                    : ""));
+            xmlFree(value);
+        }
+        std::sort(properties.begin(), properties.end());
+
+        element.firstAttribute = attributes.size();
+        element.attributeCount = properties.size();
+        for (std::vector<XmlAttribute>::const_iterator j = properties.begin(),
+             j_end = properties.end(); j != j_end; ++j)
+        {
+            Attribute attribute;
+            attribute.name = strings.add(j->first);
+            attribute.value = strings.add(j->second);
+            attributes.push_back(attribute);
+        }
+
+        element.firstChild = nodes.size();
+        for (xmlNodePtr child = first; child; child = child->next)
+        {
+            if (child->type == XML_ELEMENT_NODE)
+                nodes.push_back(child);
+        }
+        element.childCount = nodes.size() - element.firstChild;
+
+        elements.push_back(element);
+    }
+
+    xmlFreeDoc(doc);
+
+    Header header;
+    memcpy(header.magic, DATA_FILE_MAGIC, sizeof(header.magic));
+    header.version = DATA_FILE_VERSION;
+    header.checksum = sum;
+    header.sourceSize = size;
+    header.elementCount = elements.size();
+    header.attributeCount = attributes.size();
+    header.stringSize = strings.getData().size();
+
+    const int elementsSize = elements.size() * sizeof(Element);
+    const int attributesSize = attributes.size() * sizeof(Attribute);
+
+    mSize = sizeof(Header) + elementsSize + attributesSize + header.stringSize;
+    char *compiled = (char*) malloc(mSize);
+    char *pos = compiled;
+
+    memcpy(pos, &header, sizeof(Header));
+    pos += sizeof(Header);
+    memcpy(pos, &elements[0], elementsSize);
+    pos += elementsSize;
+    if (attributesSize)
+        memcpy(pos, &attributes[0], attributesSize);
+    pos += attributesSize;
+    memcpy(pos, strings.getData().data(), header.stringSize);
+
+    setData(compiled);
+    return true;
+}
+
+bool DataFile::validate(int size)
+{
+    if (memcmp(mHeader->magic, DATA_FILE_MAGIC, sizeof(mHeader->magic)) ||
+        mHeader->version != DATA_FILE_VERSION)
+    {
+        return false;
+    }
+
+    const Uint32 elementCount = mHeader->elementCount;
+    const Uint32 attributeCount = mHeader->attributeCount;
+    const Uint32 stringSize = mHeader->stringSize;
+
+    // Compare in 64 bits, so that bogus counts can't overflow
+    const Uint64 expected = (Uint64) sizeof(Header) +
+                            (Uint64) elementCount * sizeof(Element) +
+                            (Uint64) attributeCount * sizeof(Attribute) +
+                            stringSize;
+
+    if (expected != (Uint64) size || elementCount == 0 || stringSize == 0 ||
+        mStrings[stringSize - 1] != '\0')
+    {
+        return false;
+    }
+
+    for (Uint32 i = 0; i < elementCount; ++i)
+    {
+        const Element &e = mElements[i];
+        if (e.name >= stringSize || e.text >= stringSize ||
+            e.firstAttribute > attributeCount ||
+            e.attributeCount > attributeCount - e.firstAttribute ||
+            e.firstChild > elementCount ||
+            e.childCount > elementCount - e.firstChild)
+        {
+            return false;
+        }
+    }
+
+    for (Uint32 i = 0; i < attributeCount; ++i)
+    {
+        const Attribute &a = mAttributes[i];
+        if (a.name >= stringSize || a.value >= stringSize)
+            return false;
+    }
+
+    return true;
+}
+
+void DataFile::setData(char *data)
+{
+    mData = data;
+    mHeader = (const Header*) data;
+
+    // The counts are only trusted once validate() has checked them
+    mElements = (const Element*) (data + sizeof(Header));
+    mAttributes = (const Attribute*) (mElements + mHeader->elementCount);
+    mStrings = (const char*) (mAttributes + mHeader->attributeCount);
+}
+
+const char *DataFile::Node::getName() const
+{
+    return mFile->getString(mFile->mElements[mIndex].name);
+}
+
+bool DataFile::Node::hasName(const char *name) const
+{
+    return strcmp(getName(), name) == 0;
+}
+
+const char *DataFile::Node::getText() const
+{
+    return mFile->getString(mFile->mElements[mIndex].text);
+}
+
+const char *DataFile::Node::getAttribute(const char *name) const
+{
+    const Element &element = mFile->mElements[mIndex];
+    const Attribute *attributes = mFile->mAttributes + element.firstAttribute;
+
+    // Attributes are sorted by name
+    int low = 0;
+    int high = (int) element.attributeCount - 1;
+    while (low <= high)
+    {
+        const int middle = (low + high) / 2;
+        const int cmp = strcmp(mFile->getString(attributes[middle].name),
+                               name);
+        if (cmp == 0)
+            return mFile->getString(attributes[middle].value);
+        else if (cmp < 0)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+
+    return NULL;
+}
+
+int DataFile::Node::getProperty(const char *name, int def) const
+{
+    const char *value = getAttribute(name);
+    return value ? atoi(value) : def;
+}
+
+std::string DataFile::Node::getProperty(const char *name,
+                                        const std::string &def) const
+{
+    const char *value = getAttribute(name);
+    return value ? value : def;
+}
+
+DataFile::Node DataFile::Node::firstChild() const
+{
+    const Element &element = mFile->mElements[mIndex];
+    return Node(mFile, element.firstChild,
+                element.firstChild + element.childCount);
+}
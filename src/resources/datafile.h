@@ -0,0 +1,187 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DATAFILE_H
+#define DATAFILE_H
+
+#include <SDL_types.h>
+
+#include <string>
+
+/**
+ * An XML data file reduced to its elements, their attributes and their text,
+ * stored in flat arrays that refer to a single string table.
+ *
+ * The first time a file is loaded it is parsed as XML and the compiled form
+ * is written to the cache directory, tagged with a checksum of the XML file.
+ * Later loads use the cached copy as long as the checksum still matches,
+ * without going through the XML parser. Any mismatch or damage to the cache
+ * makes it fall back to parsing the XML file again.
+ *
+ * The children of an element are stored next to each other and its
+ * attributes are sorted by name, so walking the tree and looking up
+ * properties don't involve any allocations.
+ */
+class DataFile
+{
+    public:
+        /**
+         * A reference to an element of a data file. Only valid as long as
+         * the data file it came from.
+         */
+        class Node
+        {
+            public:
+                Node(): mFile(0), mIndex(0), mEnd(0) {}
+
+                /**
+                 * Returns whether this node refers to an element.
+                 */
+                bool isValid() const
+                { return mIndex < mEnd; }
+
+                /**
+                 * Returns the element name.
+                 */
+                const char *getName() const;
+
+                /**
+                 * Returns whether the element has the given name.
+                 */
+                bool hasName(const char *name) const;
+
+                /**
+                 * Returns the text the element starts with, or an empty
+                 * string when it doesn't start with text.
+                 */
+                const char *getText() const;
+
+                /**
+                 * Returns the value of an attribute, or <code>NULL</code> when
+                 * the element doesn't have it.
+                 */
+                const char *getAttribute(const char *name) const;
+
+                /**
+                 * Gets an integer property, like XML::getProperty.
+                 */
+                int getProperty(const char *name, int def) const;
+
+                /**
+                 * Gets a string property, like XML::getProperty.
+                 */
+                std::string getProperty(const char *name,
+                                        const std::string &def) const;
+
+                /**
+                 * Returns the first child element.
+                 */
+                Node firstChild() const;
+
+                /**
+                 * Returns the next element with the same parent.
+                 */
+                Node next() const
+                { return Node(mFile, mIndex + 1, mEnd); }
+
+            private:
+                friend class DataFile;
+
+                Node(const DataFile *file, Uint32 index, Uint32 end):
+                    mFile(file), mIndex(index), mEnd(end) {}
+
+                const DataFile *mFile;
+                Uint32 mIndex;  /**< Index of the element */
+                Uint32 mEnd;    /**< End of the range of siblings */
+        };
+
+        /**
+         * Loads the given data file through the resource manager, from the
+         * cache when possible. Logs errors.
+         */
+        DataFile(const std::string &filename);
+
+        /**
+         * Destructor.
+         */
+        ~DataFile();
+
+        /**
+         * Returns the root element, which is not valid when the file
+         * couldn't be loaded.
+         */
+        Node rootNode() const
+        { return Node(this, 0, mHeader ? 1 : 0); }
+
+        /**
+         * Sets the directory, relative to the write directory, in which
+         * compiled data files are kept. An empty string disables the cache.
+         * The directory is created when needed.
+         */
+        static void setCacheDirectory(const std::string &directory);
+
+    private:
+        struct Header;
+        struct Element;
+        struct Attribute;
+
+        /**
+         * Uses the compiled data file at the given path, if it was compiled
+         * from a file with the given checksum and size.
+         */
+        bool loadCache(const std::string &path, Uint32 checksum, Uint32 size);
+
+        /**
+         * Compiles the given XML data.
+         */
+        bool compile(const char *data, int size, Uint32 checksum);
+
+        /**
+         * Checks that all references in the compiled data stay in bounds.
+         */
+        bool validate(int size);
+
+        /**
+         * Points the arrays into the compiled data.
+         */
+        void setData(char *data);
+
+        const char *getString(Uint32 offset) const
+        { return mStrings + offset; }
+
+        char *mData;
+        int mSize;
+        const Header *mHeader;
+        const Element *mElements;
+        const Attribute *mAttributes;
+        const char *mStrings;
+
+        static std::string mCacheDirectory;
+};
+
+/**
+ * Iterates over the child elements of a DataFile::Node.
+ */
+#define for_each_data_child_node(var, parent) \
+    for (DataFile::Node var = (parent).firstChild(); var.isValid(); \
+         var = var.next())
+
+#endif // DATAFILE_H
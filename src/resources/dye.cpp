@@ -23,6 +23,7 @@
 
 #include "log.h"
 
+#include <algorithm>
 #include <sstream>
 
 DyePalette::DyePalette(const std::string &description)
@@ -121,10 +122,28 @@ void DyePalette::getColor(int intensity, int color[3]) const
     color[2] = ((255 - t) * b1 + t * b2) / 255;
 }
 
+bool DyePalette::getTable(unsigned int table[256]) const
+{
+    if (mColors.empty())
+        return false;
+
+    table[0] = 0;
+    for (int intensity = 1; intensity < 256; ++intensity)
+    {
+        int color[3];
+        getColor(intensity, color);
+        table[intensity] = (color[0] << 24) | (color[1] << 16) | (color[2] << 8);
+    }
+    return true;
+}
+
 Dye::Dye(const std::string &description)
 {
     for (int i = 0; i < 7; ++i)
+    {
         mDyePalettes[i] = 0;
+        mTables[i] = 0;
+    }
 
     if (description.empty())
         return;
@@ -138,38 +157,55 @@ Dye::Dye(const std::string &description)
         if (next_pos == std::string::npos)
             next_pos = length;
 
-        if (next_pos <= pos + 3 || description[pos + 1] != ':')
+        int i = -1;
+
+        if (next_pos > pos + 3 && description[pos + 1] == ':')
         {
-            logger->log("Error, invalid dye: %s", description.c_str());
-            return;
+            switch (description[pos])
+            {
+                case 'R': i = 0; break;
+                case 'G': i = 1; break;
+                case 'Y': i = 2; break;
+                case 'B': i = 3; break;
+                case 'M': i = 4; break;
+                case 'C': i = 5; break;
+                case 'W': i = 6; break;
+            }
         }
 
-        int i = 0;
-
-        switch (description[pos])
+        if (i < 0)
         {
-            case 'R': i = 0; break;
-            case 'G': i = 1; break;
-            case 'Y': i = 2; break;
-            case 'B': i = 3; break;
-            case 'M': i = 4; break;
-            case 'C': i = 5; break;
-            case 'W': i = 6; break;
-            default:
-                logger->log("Error, invalid dye: %s", description.c_str());
-                return;
+            logger->log("Error, invalid dye: %s", description.c_str());
+            break;
         }
+
         mDyePalettes[i] = new DyePalette(description.substr(pos + 2,
                                                             next_pos - pos - 2));
         ++next_pos;
     }
     while (next_pos < length);
+
+    for (int i = 0; i < 7; ++i)
+    {
+        if (!mDyePalettes[i])
+            continue;
+
+        mTables[i] = new unsigned int[256];
+        if (!mDyePalettes[i]->getTable(mTables[i]))
+        {
+            delete[] mTables[i];
+            mTables[i] = 0;
+        }
+    }
 }
 
 Dye::~Dye()
 {
     for (int i = 0; i < 7; ++i)
+    {
         delete mDyePalettes[i];
+        delete[] mTables[i];
+    }
 }
 
 void Dye::update(int color[3]) const
@@ -194,6 +230,34 @@ void Dye::update(int color[3]) const
         mDyePalettes[i - 1]->getColor(cmax, color);
 }
 
+void Dye::update(unsigned int *pixels, int count) const
+{
+    for (unsigned int *p_end = pixels + count; pixels != p_end; ++pixels)
+    {
+        const unsigned int pixel = *pixels;
+        if (!(pixel & 255))
+            continue;
+
+        const unsigned int r = pixel >> 24;
+        const unsigned int g = (pixel >> 16) & 255;
+        const unsigned int b = (pixel >> 8) & 255;
+        const unsigned int cmax = std::max(r, std::max(g, b));
+
+        // Only pure colors, whose non-zero channels are all equal, are dyed
+        if ((r != 0 && r != cmax) | (g != 0 && g != cmax) |
+            (b != 0 && b != cmax) | (cmax == 0))
+        {
+            continue;
+        }
+
+        const unsigned int *table =
+            mTables[((r != 0) | ((g != 0) << 1) | ((b != 0) << 2)) - 1];
+
+        if (table)
+            *pixels = table[cmax] | (pixel & 255);
+    }
+}
+
 void Dye::instantiate(std::string &target, const std::string &palettes)
 {
     std::string::size_type next_pos = target.find('|');
@@ -44,6 +44,15 @@ class DyePalette
          */
         void getColor(int intensity, int color[3]) const;
 
+        /**
+         * Fills the table with the colors for all intensities, packed as
+         * 0xRRGGBB00.
+         *
+         * @return <code>false</code> when the palette is empty, in which case
+         *         it leaves pixels untouched
+         */
+        bool getTable(unsigned int table[256]) const;
+
     private:
 
         struct Color { unsigned char value[3]; };
@@ -76,6 +85,13 @@ class Dye
          */
         void update(int color[3]) const;
 
+        /**
+         * Recolors a row of 32-bit RGBA pixels, with red in the highest
+         * byte. Gives the same result as calling update on every pixel that
+         * isn't fully transparent, using tables prepared by the constructor.
+         */
+        void update(unsigned int *pixels, int count) const;
+
         /**
          * Fills the blank in a dye placeholder with some palette names.
          */
@@ -90,6 +106,12 @@ class Dye
          * Red, Green, Yellow, Blue, Magenta, White (or rather gray).
          */
         DyePalette *mDyePalettes[7];
+
+        /**
+         * The colors of each palette for all intensities, or NULL for missing
+         * and empty palettes.
+         */
+        unsigned int *mTables[7];
 };
 
 #endif
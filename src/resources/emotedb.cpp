@@ -21,10 +21,11 @@
 
 #include "resources/emotedb.h"
 
+#include "resources/datafile.h"
+
 #include "animatedsprite.h"
 #include "log.h"
 
-#include "utils/xml.h"
 
 namespace
 {
@@ -48,22 +49,22 @@ void EmoteDB::load()
 
     logger->log("Initializing emote database...");
 
-    XML::Document doc("emotes.xml");
-    xmlNodePtr rootNode = doc.rootNode();
+    DataFile file("emotes.xml");
+    DataFile::Node rootNode = file.rootNode();
 
-    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "emotes"))
+    if (!rootNode.isValid() || !rootNode.hasName("emotes"))
     {
         logger->log("Emote Database: Error while loading emotes.xml!");
         return;
     }
 
     //iterate <emote>s
-    for_each_xml_child_node(emoteNode, rootNode)
+    for_each_data_child_node(emoteNode, rootNode)
     {
-        if (!xmlStrEqual(emoteNode->name, BAD_CAST "emote"))
+        if (!emoteNode.hasName("emote"))
             continue;
 
-        int id = XML::getProperty(emoteNode, "id", -1);
+        int id = emoteNode.getProperty("id", -1);
         if (id == -1)
         {
             logger->log("Emote Database: Emote with missing ID in emotes.xml!");
@@ -72,20 +73,20 @@ void EmoteDB::load()
 
         EmoteInfo *currentInfo = new EmoteInfo;
 
-        for_each_xml_child_node(spriteNode, emoteNode)
+        for_each_data_child_node(spriteNode, emoteNode)
         {
-            if (xmlStrEqual(spriteNode->name, BAD_CAST "sprite"))
+            if (spriteNode.hasName("sprite"))
             {
                 EmoteSprite *currentSprite = new EmoteSprite;
-                std::string file = "graphics/sprites/" + (std::string)
-                            (const char*) spriteNode->xmlChildrenNode->content;
+                std::string file = "graphics/sprites/" +
+                                   std::string(spriteNode.getText());
                 currentSprite->sprite = AnimatedSprite::load(file,
-                                XML::getProperty(spriteNode, "variant", 0));
+                                spriteNode.getProperty("variant", 0));
                 currentInfo->sprites.push_back(currentSprite);
             }
-            else if (xmlStrEqual(spriteNode->name, BAD_CAST "particlefx"))
+            else if (spriteNode.hasName("particlefx"))
             {
-                std::string particlefx = (const char*) spriteNode->xmlChildrenNode->content;
+                std::string particlefx = spriteNode.getText();
                 currentInfo->particles.push_back(particlefx);
             }
         }
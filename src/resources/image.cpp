@@ -22,14 +22,31 @@
 #include "resources/image.h"
 
 #include "resources/dye.h"
+#include "resources/scaledimagecache.h"
+#ifdef USE_OPENGL
+#include "resources/textureatlas.h"
+#endif
 
 #include "log.h"
 
+#ifdef USE_OPENGL
+#include "openglgraphics.h"
+#endif
+
 #include <SDL_image.h>
 #include "resources/sdlrescalefacility.h"
 
+#include <algorithm>
+
+/** Number of steps alpha values are rounded to for alpha variants */
+static const int ALPHA_LEVELS = 32;
+
+/** Maximum number of alpha variants kept for a single image */
+static const unsigned int MAX_ALPHA_VARIANTS = 4;
+
 #ifdef USE_OPENGL
 bool Image::mUseOpenGL = false;
+bool Image::mUseAtlas = false;
 int Image::mTextureType = 0;
 int Image::mTextureSize = 0;
 #endif
@@ -42,6 +59,7 @@ Image::Image(SDL_Surface *image, bool hasAlphaChannel, Uint8 *alphaChannel):
 {
 #ifdef USE_OPENGL
     mGLImage = 0;
+    mAtlasPage = 0;
 #endif
 
     mBounds.x = 0;
@@ -69,7 +87,8 @@ Image::Image(GLuint glimage, int width, int height, int texWidth, int texHeight)
     mAlphaChannel(0),
     mGLImage(glimage),
     mTexWidth(texWidth),
-    mTexHeight(texHeight)
+    mTexHeight(texHeight),
+    mAtlasPage(0)
 {
     mBounds.x = 0;
     mBounds.y = 0;
@@ -89,6 +108,7 @@ Image::Image(GLuint glimage, int width, int height, int texWidth, int texHeight)
 
 Image::~Image()
 {
+    ScaledImageCache::remove(this);
     unload();
 }
 
@@ -104,13 +124,25 @@ Resource *Image::load(void *buffer, unsigned bufferSize)
         return NULL;
     }
 
-    Image *image = load(tmpImage);
+    Image *image = load(tmpImage, true);
 
     SDL_FreeSurface(tmpImage);
     return image;
 }
 
 Resource *Image::load(void *buffer, unsigned bufferSize, Dye const &dye)
+{
+    SDL_Surface *source = loadRGBA(buffer, bufferSize);
+
+    if (!source)
+        return NULL;
+
+    Image *image = load(source, dye);
+    SDL_FreeSurface(source);
+    return image;
+}
+
+SDL_Surface *Image::loadRGBA(void *buffer, unsigned bufferSize)
 {
     SDL_RWops *rw = SDL_RWFromMem(buffer, bufferSize);
     SDL_Surface *tmpImage = IMG_Load_RW(rw, 1);
@@ -134,30 +166,54 @@ Resource *Image::load(void *buffer, unsigned bufferSize, Dye const &dye)
 
     SDL_Surface *surf = SDL_ConvertSurface(tmpImage, &rgba, SDL_SWSURFACE);
     SDL_FreeSurface(tmpImage);
+    return surf;
+}
 
-    Uint32 *pixels = static_cast< Uint32 * >(surf->pixels);
-    for (Uint32 *p_end = pixels + surf->w * surf->h; pixels != p_end; ++pixels)
-    {
-        int alpha = *pixels & 255;
-        if (!alpha) continue;
-        int v[3];
-        v[0] = (*pixels >> 24) & 255;
-        v[1] = (*pixels >> 16) & 255;
-        v[2] = (*pixels >> 8 ) & 255;
-        dye.update(v);
-        *pixels = (v[0] << 24) | (v[1] << 16) | (v[2] << 8) | alpha;
-    }
+SDL_Surface *Image::applyDye(SDL_Surface *source, Dye const &dye)
+{
+    // Recolor a copy, the source may be shared by other dyes
+    SDL_Surface *surf = SDL_ConvertSurface(source, source->format,
+                                           SDL_SWSURFACE);
+    if (!surf)
+        return NULL;
+
+    Uint8 *row = static_cast< Uint8 * >(surf->pixels);
+    for (int y = 0; y < surf->h; ++y, row += surf->pitch)
+        dye.update(reinterpret_cast< Uint32 * >(row), surf->w);
+
+    return surf;
+}
+
+Image *Image::load(SDL_Surface *source, Dye const &dye)
+{
+    SDL_Surface *surf = applyDye(source, dye);
+    if (!surf)
+        return NULL;
 
-    Image *image = load(surf);
+    Image *image = load(surf, true);
     SDL_FreeSurface(surf);
     return image;
 }
 
 Image *Image::load(SDL_Surface *tmpImage)
+{
+    return load(tmpImage, false);
+}
+
+Image *Image::load(SDL_Surface *tmpImage, bool shared)
+{
+#ifdef USE_OPENGL
+    if (shared)
+        return load(tmpImage, TextureAtlas::getShared());
+#endif
+    return load(tmpImage, (TextureAtlas*) 0);
+}
+
+Image *Image::load(SDL_Surface *tmpImage, TextureAtlas *atlas)
 {
 #ifdef USE_OPENGL
     if (mUseOpenGL)
-        return _GLload(tmpImage);
+        return _GLload(tmpImage, mUseAtlas ? atlas : 0);
 #endif
     return _SDLload(tmpImage);
 }
@@ -166,6 +222,8 @@ void Image::unload()
 {
     mLoaded = false;
 
+    SDLclearAlphaVariants();
+
     if (mSDLSurface)
     {
         // Free the image surface.
@@ -177,8 +235,16 @@ void Image::unload()
     }
 
 #ifdef USE_OPENGL
-    if (mGLImage)
+    if (mAtlasPage)
+    {
+        // The texture is shared with the other images in the page
+        TextureAtlas::release(mAtlasPage, mBounds.y, mBounds.w, mBounds.h);
+        mAtlasPage = 0;
+        mGLImage = 0;
+    }
+    else if (mGLImage)
     {
+        OpenGLGraphics::releaseTexture(mGLImage);
         glDeleteTextures(1, &mGLImage);
         mGLImage = 0;
     }
@@ -209,56 +275,210 @@ bool Image::hasAlphaChannel()
 
 void Image::setAlpha(float alpha)
 {
-    if (mAlpha == alpha)
-        return;
-
     if (alpha < 0.0f || alpha > 1.0f)
         return;
 
+    // The alpha value is applied when drawing, see SDLgetSurface
     mAlpha = alpha;
+}
 
-    if (mSDLSurface)
+SDL_Surface *Image::SDLgetSurface(int &x, int &y)
+{
+    x = mBounds.x;
+    y = mBounds.y;
+
+    if (!mSDLSurface)
+        return NULL;
+
+    if (!mHasAlphaChannel || !mAlphaChannel)
+    {
+        // Surfaces without an alpha channel are drawn at a fixed alpha.
+        // This is shared with images using the same surface, so it is set
+        // again before each blit.
+        const Uint8 value = (Uint8) (255 * mAlpha);
+        if (mSDLSurface->format->alpha != value)
+            SDL_SetAlpha(mSDLSurface, SDL_SRCALPHA, value);
+
+        return mSDLSurface;
+    }
+
+    const int level = (int) (mAlpha * ALPHA_LEVELS + 0.5f);
+    if (level == ALPHA_LEVELS)
+        return mSDLSurface;
+
+    x = 0;
+    y = 0;
+
+    for (std::vector<AlphaVariant>::iterator i = mAlphaVariants.begin(),
+         i_end = mAlphaVariants.end(); i != i_end; ++i)
     {
-        if (!hasAlphaChannel())
+        if (i->level == level)
         {
-            // Set the alpha value this image is drawn at
-            SDL_SetAlpha(mSDLSurface, SDL_SRCALPHA, (int) (255 * mAlpha));
+            // Move it to the front
+            std::rotate(mAlphaVariants.begin(), i, i + 1);
+            return mAlphaVariants.front().surface;
         }
-        else
+    }
+
+    const SDL_PixelFormat *format = mSDLSurface->format;
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            mBounds.w, mBounds.h, 32,
+            format->Rmask, format->Gmask, format->Bmask, format->Amask);
+
+    if (!surface)
+        return mSDLSurface;
+
+    SDL_SetAlpha(surface, SDL_SRCALPHA, SDL_ALPHA_OPAQUE);
+
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_LockSurface(mSDLSurface);
+
+    // Copy the pixels of the image, replacing their alpha with the scaled
+    // alpha they had at load time
+    const int maxHeight = std::min((int) mBounds.h,
+                                   mSDLSurface->h - mBounds.y);
+    const int maxWidth = std::min((int) mBounds.w,
+                                  mSDLSurface->w - mBounds.x);
+    const Uint32 amask = format->Amask;
+    const Uint8 ashift = format->Ashift;
+
+    for (int y = 0; y < maxHeight; y++)
+    {
+        const int i = (mBounds.y + y) * mSDLSurface->w + mBounds.x;
+        const Uint32 *src = (const Uint32*) mSDLSurface->pixels + i;
+        const Uint8 *srcAlpha = mAlphaChannel + i;
+        Uint32 *dst = (Uint32*) ((Uint8*) surface->pixels +
+                                 y * surface->pitch);
+
+        for (int x = 0; x < maxWidth; x++)
+        {
+            const Uint32 a = srcAlpha[x] * level / ALPHA_LEVELS;
+            dst[x] = (src[x] & ~amask) | ((a << ashift) & amask);
+        }
+    }
+
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_UnlockSurface(mSDLSurface);
+
+    if (mAlphaVariants.size() >= MAX_ALPHA_VARIANTS)
+    {
+        SDL_FreeSurface(mAlphaVariants.back().surface);
+        mAlphaVariants.pop_back();
+    }
+
+    AlphaVariant variant;
+    variant.level = level;
+    variant.surface = surface;
+    mAlphaVariants.insert(mAlphaVariants.begin(), variant);
+
+    return surface;
+}
+
+void Image::SDLclearAlphaVariants()
+{
+    for (std::vector<AlphaVariant>::iterator i = mAlphaVariants.begin(),
+         i_end = mAlphaVariants.end(); i != i_end; ++i)
+    {
+        SDL_FreeSurface(i->surface);
+    }
+    mAlphaVariants.clear();
+}
+
+/**
+ * Reads a pixel of the given size in bytes.
+ */
+static Uint32 readPixel(const Uint8 *p, int bytesPerPixel)
+{
+    switch (bytesPerPixel)
+    {
+        case 1:
+            return *p;
+        case 2:
+            return *(const Uint16*) p;
+        case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+            return p[0] << 16 | p[1] << 8 | p[2];
+#else
+            return p[0] | p[1] << 8 | p[2] << 16;
+#endif
+        default:
+            return *(const Uint32*) p;
+    }
+}
+
+void Image::SDLdrawOnto(SDL_Surface *target, int x, int y) const
+{
+    if (!mSDLSurface)
+        return;
+
+    // Clip to the target surface
+    int srcX = 0;
+    int srcY = 0;
+    int width = mBounds.w;
+    int height = mBounds.h;
+
+    if (x < 0) { srcX = -x; width += x; x = 0; }
+    if (y < 0) { srcY = -y; height += y; y = 0; }
+    if (x + width > target->w) width = target->w - x;
+    if (y + height > target->h) height = target->h - y;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    const SDL_PixelFormat *format = mSDLSurface->format;
+    const SDL_PixelFormat *targetFormat = target->format;
+    const int bpp = format->BytesPerPixel;
+    const bool useColorKey = mSDLSurface->flags & SDL_SRCCOLORKEY;
+
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_LockSurface(mSDLSurface);
+    if (SDL_MUSTLOCK(target))
+        SDL_LockSurface(target);
+
+    for (int row = 0; row < height; row++)
+    {
+        const Uint8 *src = (const Uint8*) mSDLSurface->pixels +
+            (mBounds.y + srcY + row) * mSDLSurface->pitch +
+            (mBounds.x + srcX) * bpp;
+        Uint32 *dst = (Uint32*) ((Uint8*) target->pixels +
+                                 (y + row) * target->pitch) + x;
+
+        for (int col = 0; col < width; col++, src += bpp)
         {
-            if (SDL_MUSTLOCK(mSDLSurface))
-                SDL_LockSurface(mSDLSurface);
-
-            // Precompute as much as possible
-            int maxHeight = std::min((mBounds.y + mBounds.h), mSDLSurface->h);
-            int maxWidth = std::min((mBounds.x + mBounds.w), mSDLSurface->w);
-            int i = 0;
-
-            for (int y = mBounds.y; y < maxHeight; y++)
-              for (int x = mBounds.x; x < maxWidth; x++)
-              {
-                  i = y * mSDLSurface->w + x;
-                  // Only change the pixel if it was visible at load time...
-                  Uint8 sourceAlpha = mAlphaChannel[i];
-                  if (sourceAlpha > 0)
-                  {
-                      Uint8 r, g, b, a;
-                      SDL_GetRGBA(((Uint32*) mSDLSurface->pixels)[i],
-                                  mSDLSurface->format,
-                                  &r, &g, &b, &a);
-
-                      a = (Uint8) (sourceAlpha * mAlpha);
-
-                      // Here is the pixel we want to set
-                      ((Uint32 *)(mSDLSurface->pixels))[i] =
-                      SDL_MapRGBA(mSDLSurface->format, r, g, b, a);
-                  }
-              }
-
-            if (SDL_MUSTLOCK(mSDLSurface))
-                SDL_UnlockSurface(mSDLSurface);
+            const Uint32 pixel = readPixel(src, bpp);
+            if (useColorKey && pixel == format->colorkey)
+                continue;
+
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(pixel, (SDL_PixelFormat*) format, &r, &g, &b, &a);
+
+            if (a == 0)
+                continue;
+
+            if (a < 255)
+            {
+                Uint8 dr, dg, db, da;
+                SDL_GetRGBA(dst[col], (SDL_PixelFormat*) targetFormat,
+                            &dr, &dg, &db, &da);
+
+                // Source over destination, with straight alpha
+                const int dstWeight = da * (255 - a) / 255;
+                const int outA = a + dstWeight;
+                r = (Uint8) ((r * a + dr * dstWeight) / outA);
+                g = (Uint8) ((g * a + dg * dstWeight) / outA);
+                b = (Uint8) ((b * a + db * dstWeight) / outA);
+                a = (Uint8) outA;
+            }
+
+            dst[col] = SDL_MapRGBA((SDL_PixelFormat*) targetFormat,
+                                   r, g, b, a);
         }
     }
+
+    if (SDL_MUSTLOCK(target))
+        SDL_UnlockSurface(target);
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_UnlockSurface(mSDLSurface);
 }
 
 Image* Image::SDLmerge(Image *image, int x, int y)
@@ -359,10 +579,13 @@ Image* Image::SDLgetScaledImage(int width, int height)
                     (double) height / getHeight(),
                     1);
 
-        // The load function takes of the SDL<->OpenGL implementation
-        // and about freeing the given SDL_surface*.
+        // The load function takes care of the SDL<->OpenGL implementation.
+        // It makes a copy of the surface, so the scaled one is freed here.
         if (scaledSurface)
+        {
             scaledImage = load(scaledSurface);
+            SDL_FreeSurface(scaledSurface);
+        }
     }
     return scaledImage;
 }
@@ -421,21 +644,13 @@ Image *Image::_SDLload(SDL_Surface *tmpImage)
 }
 
 #ifdef USE_OPENGL
-Image *Image::_GLload(SDL_Surface *tmpImage)
+Image *Image::_GLload(SDL_Surface *tmpImage, TextureAtlas *atlas)
 {
         // Flush current error flag.
         glGetError();
 
         int width = tmpImage->w;
         int height = tmpImage->h;
-        int realWidth = powerOfTwo(width);
-        int realHeight = powerOfTwo(height);
-
-        if (realWidth < width || realHeight < height)
-        {
-            logger->log("Warning: image too large, cropping to %dx%d texture!",
-                    tmpImage->w, tmpImage->h);
-        }
 
         // Make sure the alpha channel is not used, but copied to destination
         SDL_SetAlpha(tmpImage, 0, SDL_ALPHA_OPAQUE);
@@ -454,6 +669,40 @@ Image *Image::_GLload(SDL_Surface *tmpImage)
         amask = 0xff000000;
 #endif
 
+        if (atlas)
+        {
+            SDL_Surface *rgbaImage = SDL_CreateRGBSurface(SDL_SWSURFACE,
+                    width, height, 32, rmask, gmask, bmask, amask);
+
+            if (rgbaImage)
+            {
+                SDL_BlitSurface(tmpImage, NULL, rgbaImage, NULL);
+
+                int x, y;
+                AtlasPage *page = atlas->add(rgbaImage, x, y);
+                SDL_FreeSurface(rgbaImage);
+
+                if (page)
+                {
+                    Image *image = new Image(page->texture, width, height,
+                                             page->size, page->size);
+                    image->mBounds.x = x;
+                    image->mBounds.y = y;
+                    image->mAtlasPage = page;
+                    return image;
+                }
+            }
+        }
+
+        int realWidth = powerOfTwo(width);
+        int realHeight = powerOfTwo(height);
+
+        if (realWidth < width || realHeight < height)
+        {
+            logger->log("Warning: image too large, cropping to %dx%d texture!",
+                    tmpImage->w, tmpImage->h);
+        }
+
         SDL_Surface *oldImage = tmpImage;
         tmpImage = SDL_CreateRGBSurface(SDL_SWSURFACE, realWidth, realHeight,
             32, rmask, gmask, bmask, amask);
@@ -550,8 +799,8 @@ Image *Image::getSubImage(int x, int y, int width, int height)
     // Create a new clipped sub-image
 #ifdef USE_OPENGL
     if (mUseOpenGL)
-        return new SubImage(this, mGLImage, x, y, width, height,
-                            mTexWidth, mTexHeight);
+        return new SubImage(this, mGLImage, mBounds.x + x, mBounds.y + y,
+                            width, height, mTexWidth, mTexHeight);
 #endif
 
     return new SubImage(this, mSDLSurface, x, y, width, height);
@@ -609,5 +858,13 @@ SubImage::~SubImage()
 
 Image *SubImage::getSubImage(int x, int y, int w, int h)
 {
-    return mParent->getSubImage(mBounds.x + x, mBounds.y + y, w, h);
+    // The bounds of this image are already relative to the parent texture
+#ifdef USE_OPENGL
+    if (mUseOpenGL)
+        return new SubImage(mParent, mGLImage, mBounds.x + x, mBounds.y + y,
+                            w, h, mTexWidth, mTexHeight);
+#endif
+
+    return new SubImage(mParent, mSDLSurface, mBounds.x + x, mBounds.y + y,
+                        w, h);
 }
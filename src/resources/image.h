@@ -28,6 +28,8 @@
 
 #include <SDL.h>
 
+#include <vector>
+
 #ifdef USE_OPENGL
 
 /* The definition of OpenGL extensions by SDL is giving problems with recent
@@ -41,6 +43,10 @@
 
 class Dye;
 class Position;
+class TextureAtlas;
+#ifdef USE_OPENGL
+struct AtlasPage;
+#endif
 
 /**
  * Defines a class for loading and storing images.
@@ -82,11 +88,47 @@ class Image : public Resource
         static Resource *load(void *buffer, unsigned bufferSize,
                               Dye const &dye);
 
+        /**
+         * Decodes an image from a buffer in memory into a 32-bit RGBA
+         * surface, the format images are recolored in.
+         *
+         * @return <code>NULL</code> if an error occurred, a surface to be
+         *         freed using SDL_FreeSurface otherwise.
+         */
+        static SDL_Surface *loadRGBA(void *buffer, unsigned bufferSize);
+
+        /**
+         * Creates a recolored copy of a surface returned by loadRGBA. Unlike
+         * loading images, this may be done from any thread.
+         *
+         * @return <code>NULL</code> if an error occurred, a surface to be
+         *         freed using SDL_FreeSurface otherwise.
+         */
+        static SDL_Surface *applyDye(SDL_Surface *source, Dye const &dye);
+
+        /**
+         * Creates a recolored image from a surface returned by loadRGBA. The
+         * surface itself is left untouched.
+         */
+        static Image *load(SDL_Surface *source, Dye const &dye);
+
         /**
          * Loads an image from an SDL surface.
          */
         static Image *load(SDL_Surface *);
 
+        /**
+         * Loads an image from an SDL surface, allowing it to be packed into
+         * a texture atlas when <code>shared</code> is true.
+         */
+        static Image *load(SDL_Surface *tmpImage, bool shared);
+
+        /**
+         * Loads an image from an SDL surface, packing it into the given
+         * texture atlas when atlases are used.
+         */
+        static Image *load(SDL_Surface *tmpImage, TextureAtlas *atlas);
+
         /**
          * Frees the resources created by SDL.
          */
@@ -123,7 +165,8 @@ class Image : public Resource
         bool hasAlphaChannel();
 
         /**
-         * Sets the alpha value of this image.
+         * Sets the alpha value this image is drawn at. This doesn't change
+         * the pixels of the image.
          */
         virtual void setAlpha(float alpha);
 
@@ -163,6 +206,13 @@ class Image : public Resource
          */
         Image *SDLmerge(Image *image, int x, int y);
 
+        /**
+         * Draws this image onto a 32-bit surface with an alpha channel,
+         * blending it with the pixels already there. Unlike a blit, this
+         * also updates the alpha channel of the target surface.
+         */
+        void SDLdrawOnto(SDL_Surface *target, int x, int y) const;
+
         /**
          * Get the alpha Channel of a SDL surface.
          */
@@ -181,9 +231,16 @@ class Image : public Resource
 
         static bool getLoadAsOpenGL() { return mUseOpenGL; }
 
+        /**
+         * Sets whether shared images, like the ones loaded from files, are
+         * packed into a TextureAtlas.
+         */
+        static void setUseAtlas(bool useAtlas) { mUseAtlas = useAtlas; }
+
         int getTextureWidth() const { return mTexWidth; }
         int getTextureHeight() const { return mTexHeight; }
         static int getTextureType() { return mTextureType; }
+        static int getTextureSize() { return mTextureSize; }
 #endif
 
     protected:
@@ -208,11 +265,38 @@ class Image : public Resource
         /** SDL_Surface to SDL_Surface Image loader */
         static Image *_SDLload(SDL_Surface *tmpImage);
 
+        /**
+         * Returns the surface to blit this image from, with the alpha value
+         * of the image applied.
+         *
+         * @param x set to the horizontal position of the image in the surface
+         * @param y set to the vertical position of the image in the surface
+         */
+        SDL_Surface *SDLgetSurface(int &x, int &y);
+
+        /**
+         * Frees the copies of this image made for other alpha values.
+         */
+        void SDLclearAlphaVariants();
+
+        /**
+         * A copy of an image with an alpha channel, with the alpha of each
+         * pixel multiplied by a fixed amount.
+         */
+        struct AlphaVariant
+        {
+            int level;              /**< Quantized alpha value */
+            SDL_Surface *surface;   /**< Covers only the image bounds */
+        };
+
         SDL_Surface *mSDLSurface;
 
         /** Alpha Channel pointer used for 32bit based SDL surfaces */
         Uint8 *mAlphaChannel;
 
+        /** Alpha variants of this image, most recently used first */
+        std::vector<AlphaVariant> mAlphaVariants;
+
       // -----------------------
       // OpenGL protected members
       // -----------------------
@@ -228,12 +312,14 @@ class Image : public Resource
          */
         static int powerOfTwo(int input);
 
-        static Image *_GLload(SDL_Surface *tmpImage);
+        static Image *_GLload(SDL_Surface *tmpImage, TextureAtlas *atlas);
 
         GLuint mGLImage;
         int mTexWidth, mTexHeight;
+        AtlasPage *mAtlasPage;  /**< Atlas page holding the image, if any */
 
         static bool mUseOpenGL;
+        static bool mUseAtlas;
         static int mTextureType;
         static int mTextureSize;
 #endif
@@ -21,6 +21,7 @@
 
 #include "resources/itemdb.h"
 
+#include "resources/datafile.h"
 #include "resources/iteminfo.h"
 #include "resources/resourcemanager.h"
 
@@ -29,9 +30,6 @@
 #include "utils/dtor.h"
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
-#include "utils/xml.h"
-
-#include <libxml/tree.h>
 
 #include <cassert>
 
@@ -44,8 +42,8 @@ namespace
 }
 
 // Forward declarations
-static void loadSpriteRef(ItemInfo *itemInfo, xmlNodePtr node);
-static void loadSoundRef(ItemInfo *itemInfo, xmlNodePtr node);
+static void loadSpriteRef(ItemInfo *itemInfo, DataFile::Node node);
+static void loadSoundRef(ItemInfo *itemInfo, DataFile::Node node);
 
 static char const *const fields[][2] =
 {
@@ -115,20 +113,20 @@ void ItemDB::load()
     mUnknown->setSprite("error.xml", GENDER_MALE);
     mUnknown->setSprite("error.xml", GENDER_FEMALE);
 
-    XML::Document doc("items.xml");
-    xmlNodePtr rootNode = doc.rootNode();
+    DataFile file("items.xml");
+    DataFile::Node rootNode = file.rootNode();
 
-    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "items"))
+    if (!rootNode.isValid() || !rootNode.hasName("items"))
     {
         logger->error("ItemDB: Error while loading items.xml!");
     }
 
-    for_each_xml_child_node(node, rootNode)
+    for_each_data_child_node(node, rootNode)
     {
-        if (!xmlStrEqual(node->name, BAD_CAST "item"))
+        if (!node.hasName("item"))
             continue;
 
-        int id = XML::getProperty(node, "id", 0);
+        int id = node.getProperty("id", 0);
 
         if (id == 0)
         {
@@ -140,15 +138,15 @@ void ItemDB::load()
             logger->log("ItemDB: Redefinition of item ID %d", id);
         }
 
-        std::string typeStr = XML::getProperty(node, "type", "other");
-        int weight = XML::getProperty(node, "weight", 0);
-        int view = XML::getProperty(node, "view", 0);
+        std::string typeStr = node.getProperty("type", "other");
+        int weight = node.getProperty("weight", 0);
+        int view = node.getProperty("view", 0);
 
-        std::string name = XML::getProperty(node, "name", "");
-        std::string image = XML::getProperty(node, "image", "");
-        std::string description = XML::getProperty(node, "description", "");
-        int weaponType = weaponTypeFromString(XML::getProperty(node, "weapon-type", ""));
-        int attackRange = XML::getProperty(node, "attack-range", 0);
+        std::string name = node.getProperty("name", "");
+        std::string image = node.getProperty("image", "");
+        std::string description = node.getProperty("description", "");
+        int weaponType = weaponTypeFromString(node.getProperty("weapon-type", ""));
+        int attackRange = node.getProperty("attack-range", 0);
 
         ItemInfo *itemInfo = new ItemInfo;
         itemInfo->setId(id);
@@ -164,7 +162,7 @@ void ItemDB::load()
         std::string effect;
         for (int i = 0; i < int(sizeof(fields) / sizeof(fields[0])); ++i)
         {
-            int value = XML::getProperty(node, fields[i][0], 0);
+            int value = node.getProperty(fields[i][0], 0);
             if (!value) continue;
             if (!effect.empty()) effect += " / ";
             effect += strprintf(gettext(fields[i][1]), value);
@@ -172,28 +170,28 @@ void ItemDB::load()
         for (std::list<Stat>::iterator it = extraStats.begin();
                 it != extraStats.end(); it++)
         {
-            int value = XML::getProperty(node, it->tag.c_str(), 0);
+            int value = node.getProperty(it->tag.c_str(), 0);
             if (!value) continue;
             if (!effect.empty()) effect += " / ";
             effect += strprintf(it->format.c_str(), value);
         }
-        std::string temp = XML::getProperty(node, "effect", "");
+        std::string temp = node.getProperty("effect", "");
         if (!effect.empty() && !temp.empty())
             effect += " / ";
         effect += temp;
         itemInfo->setEffect(effect);
 
-        for_each_xml_child_node(itemChild, node)
+        for_each_data_child_node(itemChild, node)
         {
-            if (xmlStrEqual(itemChild->name, BAD_CAST "sprite"))
+            if (itemChild.hasName("sprite"))
             {
-                std::string attackParticle = XML::getProperty(
-                    itemChild, "particle-effect", "");
+                std::string attackParticle = itemChild.getProperty(
+                    "particle-effect", "");
                 itemInfo->setParticleEffect(attackParticle);
 
                 loadSpriteRef(itemInfo, itemChild);
             }
-            else if (xmlStrEqual(itemChild->name, BAD_CAST "sound"))
+            else if (itemChild.hasName("sound"))
             {
                 loadSoundRef(itemInfo, itemChild);
             }
@@ -286,10 +284,10 @@ const ItemInfo &ItemDB::get(const std::string &name)
     return *(i->second);
 }
 
-void loadSpriteRef(ItemInfo *itemInfo, xmlNodePtr node)
+void loadSpriteRef(ItemInfo *itemInfo, DataFile::Node node)
 {
-    std::string gender = XML::getProperty(node, "gender", "unisex");
-    std::string filename = (const char*) node->xmlChildrenNode->content;
+    std::string gender = node.getProperty("gender", "unisex");
+    std::string filename = node.getText();
 
     if (gender == "male" || gender == "unisex")
     {
@@ -301,10 +299,10 @@ void loadSpriteRef(ItemInfo *itemInfo, xmlNodePtr node)
     }
 }
 
-void loadSoundRef(ItemInfo *itemInfo, xmlNodePtr node)
+void loadSoundRef(ItemInfo *itemInfo, DataFile::Node node)
 {
-    std::string event = XML::getProperty(node, "event", "");
-    std::string filename = (const char*) node->xmlChildrenNode->content;
+    std::string event = node.getProperty("event", "");
+    std::string filename = node.getText();
 
     if (event == "hit")
     {
@@ -21,13 +21,13 @@
 
 #include "resources/monsterdb.h"
 
+#include "resources/datafile.h"
 #include "resources/monsterinfo.h"
 
 #include "log.h"
 
 #include "utils/dtor.h"
 #include "utils/gettext.h"
-#include "utils/xml.h"
 
 namespace
 {
@@ -46,28 +46,28 @@ void MonsterDB::load()
 
     logger->log("Initializing monster database...");
 
-    XML::Document doc("monsters.xml");
-    xmlNodePtr rootNode = doc.rootNode();
+    DataFile file("monsters.xml");
+    DataFile::Node rootNode = file.rootNode();
 
-    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "monsters"))
+    if (!rootNode.isValid() || !rootNode.hasName("monsters"))
     {
         logger->error("Monster Database: Error while loading monster.xml!");
     }
 
     //iterate <monster>s
-    for_each_xml_child_node(monsterNode, rootNode)
+    for_each_data_child_node(monsterNode, rootNode)
     {
-        if (!xmlStrEqual(monsterNode->name, BAD_CAST "monster"))
+        if (!monsterNode.hasName("monster"))
         {
             continue;
         }
 
         MonsterInfo *currentInfo = new MonsterInfo;
 
-        currentInfo->setName(XML::getProperty(monsterNode, "name", _("unnamed")));
+        currentInfo->setName(monsterNode.getProperty("name", _("unnamed")));
 
         std::string targetCursor;
-        targetCursor = XML::getProperty(monsterNode, "targetCursor", "medium");
+        targetCursor = monsterNode.getProperty("targetCursor", "medium");
         if (targetCursor == "small")
         {
             currentInfo->setTargetCursorSize(Being::TC_SMALL);
@@ -89,18 +89,16 @@ void MonsterDB::load()
         }
 
         //iterate <sprite>s and <sound>s
-        for_each_xml_child_node(spriteNode, monsterNode)
+        for_each_data_child_node(spriteNode, monsterNode)
         {
-            if (xmlStrEqual(spriteNode->name, BAD_CAST "sprite"))
+            if (spriteNode.hasName("sprite"))
             {
-                currentInfo->addSprite(
-                        (const char*) spriteNode->xmlChildrenNode->content);
+                currentInfo->addSprite(spriteNode.getText());
             }
-            else if (xmlStrEqual(spriteNode->name, BAD_CAST "sound"))
+            else if (spriteNode.hasName("sound"))
             {
-                std::string event = XML::getProperty(spriteNode, "event", "");
-                const char *filename;
-                filename = (const char*) spriteNode->xmlChildrenNode->content;
+                std::string event = spriteNode.getProperty("event", "");
+                const char *filename = spriteNode.getText();
 
                 if (event == "hit")
                 {
@@ -126,22 +124,21 @@ void MonsterDB::load()
                                 currentInfo->getName().c_str());
                 }
             }
-            else if (xmlStrEqual(spriteNode->name, BAD_CAST "attack"))
+            else if (spriteNode.hasName("attack"))
             {
-                const int id = XML::getProperty(spriteNode, "id", 0);
-                const std::string particleEffect = XML::getProperty(
-                        spriteNode, "particle-effect", "");
+                const int id = spriteNode.getProperty("id", 0);
+                const std::string particleEffect = spriteNode.getProperty(
+                        "particle-effect", "");
                 SpriteAction spriteAction = SpriteDef::makeSpriteAction(
-                        XML::getProperty(spriteNode, "action", "attack"));
+                        spriteNode.getProperty("action", "attack"));
                 currentInfo->addMonsterAttack(id, particleEffect, spriteAction);
             }
-            else if (xmlStrEqual(spriteNode->name, BAD_CAST "particlefx"))
+            else if (spriteNode.hasName("particlefx"))
             {
-                currentInfo->addParticleEffect(
-                    (const char*) spriteNode->xmlChildrenNode->content);
+                currentInfo->addParticleEffect(spriteNode.getText());
             }
         }
-        mMonsterInfos[XML::getProperty(monsterNode, "id", 0)] = currentInfo;
+        mMonsterInfos[monsterNode.getProperty("id", 0)] = currentInfo;
     }
 
     mLoaded = true;
@@ -21,9 +21,10 @@
 
 #include "resources/npcdb.h"
 
+#include "resources/datafile.h"
+
 #include "log.h"
 
-#include "utils/xml.h"
 
 namespace
 {
@@ -44,21 +45,21 @@ void NPCDB::load()
 
     logger->log("Initializing NPC database...");
 
-    XML::Document doc("npcs.xml");
-    xmlNodePtr rootNode = doc.rootNode();
+    DataFile file("npcs.xml");
+    DataFile::Node rootNode = file.rootNode();
 
-    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "npcs"))
+    if (!rootNode.isValid() || !rootNode.hasName("npcs"))
     {
         logger->error("NPC Database: Error while loading npcs.xml!");
     }
 
     //iterate <npc>s
-    for_each_xml_child_node(npcNode, rootNode)
+    for_each_data_child_node(npcNode, rootNode)
     {
-        if (!xmlStrEqual(npcNode->name, BAD_CAST "npc"))
+        if (!npcNode.hasName("npc"))
             continue;
 
-        int id = XML::getProperty(npcNode, "id", 0);
+        int id = npcNode.getProperty("id", 0);
         if (id == 0)
         {
             logger->log("NPC Database: NPC with missing ID in npcs.xml!");
@@ -67,18 +68,18 @@ void NPCDB::load()
 
         NPCInfo *currentInfo = new NPCInfo;
 
-        for_each_xml_child_node(spriteNode, npcNode)
+        for_each_data_child_node(spriteNode, npcNode)
         {
-            if (xmlStrEqual(spriteNode->name, BAD_CAST "sprite"))
+            if (spriteNode.hasName("sprite"))
             {
                 NPCsprite *currentSprite = new NPCsprite;
-                currentSprite->sprite = (const char*)spriteNode->xmlChildrenNode->content;
-                currentSprite->variant = XML::getProperty(spriteNode, "variant", 0);
+                currentSprite->sprite = spriteNode.getText();
+                currentSprite->variant = spriteNode.getProperty("variant", 0);
                 currentInfo->sprites.push_back(currentSprite);
             }
-            else if (xmlStrEqual(spriteNode->name, BAD_CAST "particlefx"))
+            else if (spriteNode.hasName("particlefx"))
             {
-                std::string particlefx = (const char*)spriteNode->xmlChildrenNode->content;
+                std::string particlefx = spriteNode.getText();
                 currentInfo->particles.push_back(particlefx);
             }
         }
@@ -0,0 +1,186 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/particleeffectdef.h"
+
+#include "resources/image.h"
+#include "resources/imageset.h"
+#include "resources/resourcemanager.h"
+
+#include "log.h"
+
+#include "utils/xml.h"
+
+int ParticleEffectDef::loadCount = 0;
+int ParticleEffectDef::instanceCount = 0;
+
+ParticleEffectDef *ParticleEffectDef::load(const std::string &file)
+{
+    XML::Document doc(file);
+    xmlNodePtr rootNode = doc.rootNode();
+
+    if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "effect"))
+    {
+        logger->log("Error loading particle: %s", file.c_str());
+        return NULL;
+    }
+
+    loadCount++;
+
+    ParticleEffectDef *def = new ParticleEffectDef;
+
+    for_each_xml_child_node(effectChildNode, rootNode)
+    {
+        // We're only interested in particles
+        if (xmlStrEqual(effectChildNode->name, BAD_CAST "particle"))
+            def->loadParticle(effectChildNode);
+    }
+
+    return def;
+}
+
+ParticleEffectDef::~ParticleEffectDef()
+{
+    for (ParticleDefs::iterator i = mParticles.begin(), i_end = mParticles.end();
+         i != i_end; ++i)
+    {
+        if (i->image)
+            i->image->decRef();
+    }
+}
+
+void ParticleEffectDef::loadParticle(xmlNodePtr particleNode)
+{
+    mParticles.push_back(ParticleDef());
+    ParticleDef &def = mParticles.back();
+
+    // Determine the exact particle type
+    xmlNodePtr node;
+
+    if ((node = XML::findFirstChildByName(particleNode, "animation")))
+    {
+        loadAnimation(node, def.animation);
+        if (def.animation.getLength() > 0)
+            def.type = PARTICLE_ANIMATION;
+    }
+    else if ((node = XML::findFirstChildByName(particleNode, "rotation")))
+    {
+        loadAnimation(node, def.animation);
+        if (def.animation.getLength() > 0)
+            def.type = PARTICLE_ROTATIONAL;
+    }
+    else if ((node = XML::findFirstChildByName(particleNode, "image")))
+    {
+        def.type = PARTICLE_IMAGE;
+        if (node->xmlChildrenNode)
+        {
+            ResourceManager *resman = ResourceManager::getInstance();
+            def.image = resman->getImage((const char*)
+                    node->xmlChildrenNode->content);
+        }
+    }
+
+    def.offset.x = XML::getFloatProperty(particleNode, "position-x", 0);
+    def.offset.y = XML::getFloatProperty(particleNode, "position-y", 0);
+    def.offset.z = XML::getFloatProperty(particleNode, "position-z", 0);
+    def.lifetime = XML::getProperty(particleNode, "lifetime", -1);
+
+    // Look for emitters hosted by this particle
+    for_each_xml_child_node(emitterNode, particleNode)
+    {
+        if (xmlStrEqual(emitterNode->name, BAD_CAST "emitter"))
+            def.emitters.push_back(ParticleEmitter(emitterNode, 0, 0));
+    }
+}
+
+void ParticleEffectDef::loadAnimation(xmlNodePtr animationNode,
+                                      Animation &animation)
+{
+    ImageSet *imageset = ResourceManager::getInstance()->getImageSet(
+        XML::getProperty(animationNode, "imageset", ""),
+        XML::getProperty(animationNode, "width", 0),
+        XML::getProperty(animationNode, "height", 0)
+    );
+
+    // The image set is not released, since particles spawned from this
+    // definition keep using its images after the definition is gone.
+    if (!imageset)
+        return;
+
+    // Get animation frames
+    for_each_xml_child_node(frameNode, animationNode)
+    {
+        int delay = XML::getProperty(frameNode, "delay", 0);
+        int offsetX = XML::getProperty(frameNode, "offsetX", 0);
+        int offsetY = XML::getProperty(frameNode, "offsetY", 0);
+        offsetY -= imageset->getHeight() - 32;
+        offsetX -= imageset->getWidth() / 2 - 16;
+
+        if (xmlStrEqual(frameNode->name, BAD_CAST "frame"))
+        {
+            int index = XML::getProperty(frameNode, "index", -1);
+
+            if (index < 0)
+            {
+                logger->log("No valid value for 'index'");
+                continue;
+            }
+
+            Image *img = imageset->get(index);
+
+            if (!img)
+            {
+                logger->log("No image at index %d", index);
+                continue;
+            }
+
+            animation.addFrame(img, delay, offsetX, offsetY);
+        }
+        else if (xmlStrEqual(frameNode->name, BAD_CAST "sequence"))
+        {
+            int start = XML::getProperty(frameNode, "start", -1);
+            int end = XML::getProperty(frameNode, "end", -1);
+
+            if (start < 0 || end < 0)
+            {
+                logger->log("No valid value for 'start' or 'end'");
+                continue;
+            }
+
+            for (; start <= end; start++)
+            {
+                Image *img = imageset->get(start);
+
+                if (!img)
+                {
+                    logger->log("No image at index %d", start);
+                    continue;
+                }
+
+                animation.addFrame(img, delay, offsetX, offsetY);
+            }
+        }
+        else if (xmlStrEqual(frameNode->name, BAD_CAST "end"))
+        {
+            animation.addTerminator();
+        }
+    }
+}
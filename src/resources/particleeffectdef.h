@@ -0,0 +1,120 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PARTICLEEFFECTDEF_H
+#define PARTICLEEFFECTDEF_H
+
+#include "resources/animation.h"
+#include "resources/resource.h"
+
+#include "particleemitter.h"
+#include "vector.h"
+
+#include <list>
+#include <string>
+
+#include <libxml/tree.h>
+
+class Image;
+
+/**
+ * The compiled contents of a particle effect file. The file is parsed once
+ * when the resource is loaded, after which Particle::addEffect only needs to
+ * instantiate particles and emitters from the stored templates.
+ */
+class ParticleEffectDef : public Resource
+{
+    public:
+        /**
+         * The kind of particle a template describes.
+         */
+        enum ParticleType
+        {
+            PARTICLE_PLAIN,
+            PARTICLE_IMAGE,
+            PARTICLE_ANIMATION,
+            PARTICLE_ROTATIONAL
+        };
+
+        /**
+         * Template for one of the particles of an effect.
+         */
+        struct ParticleDef
+        {
+            ParticleDef():
+                type(PARTICLE_PLAIN),
+                image(0),
+                lifetime(-1)
+            {}
+
+            ParticleType type;
+            Image *image;          /**< Used by image particles */
+            Animation animation;   /**< Used by animation and rotational
+                                        particles */
+            Vector offset;         /**< Position relative to the effect */
+            int lifetime;
+
+            /** Emitters hosted by the particle, bound to no map or target */
+            std::list<ParticleEmitter> emitters;
+        };
+
+        typedef std::list<ParticleDef> ParticleDefs;
+
+        static int loadCount;      /**< Number of effect files parsed */
+        static int instanceCount;  /**< Number of effects instantiated */
+
+        /**
+         * Loads a particle effect file.
+         */
+        static ParticleEffectDef *load(const std::string &file);
+
+        /**
+         * Returns the particle templates of this effect.
+         */
+        const ParticleDefs &getParticles() const
+        { return mParticles; }
+
+    private:
+        /**
+         * Constructor.
+         */
+        ParticleEffectDef() {}
+
+        /**
+         * Destructor.
+         */
+        ~ParticleEffectDef();
+
+        /**
+         * Loads a particle element.
+         */
+        void loadParticle(xmlNodePtr particleNode);
+
+        /**
+         * Loads the frames of an animation or rotation element.
+         */
+        static void loadAnimation(xmlNodePtr animationNode,
+                                  Animation &animation);
+
+        ParticleDefs mParticles;
+};
+
+#endif
@@ -52,6 +52,12 @@ class Resource
          */
         void decRef();
 
+        /**
+         * Returns the number of references to this resource.
+         */
+        unsigned getRefCount() const
+        { return mRefCount; }
+
         /**
          * Return the path identifying this resource.
          */
@@ -25,28 +25,100 @@
 #include "resources/image.h"
 #include "resources/imageset.h"
 #include "resources/music.h"
+#include "resources/particleeffectdef.h"
 #include "resources/soundeffect.h"
 #include "resources/spritedef.h"
 
+#include "configuration.h"
 #include "log.h"
 
+#include "utils/xml.h"
+
+#include <algorithm>
 #include <cassert>
 #include <physfs.h>
 #include <SDL_image.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
 #include <sstream>
 
 #include <sys/time.h>
 
+/** Memory budget of the decoded images shared between dyed variants */
+static const int MAX_DYE_SOURCE_BYTES = 16 * 1024 * 1024;
+
 ResourceManager *ResourceManager::instance = NULL;
 
 ResourceManager::ResourceManager()
-  : mOldestOrphan(0)
+  : mOldestOrphan(0),
+    mDyeSourceBytes(0),
+    mDyeSourceUses(0),
+    mDyeSourceMisses(0),
+    mDyeSourceTime(0),
+    mDyeSourceMutex(SDL_CreateMutex()),
+    mAsyncMutex(SDL_CreateMutex()),
+    mAsyncCond(SDL_CreateCond()),
+    mAsyncQuit(false),
+    mAsyncStarted(false),
+    mAsyncBudget(0)
 {
     logger->log("Initializing resource manager...");
 }
 
+/**
+ * A resource being loaded in the background.
+ */
+struct ResourceManager::AsyncJob
+{
+    std::string idPath;     /**< Id path of the resource */
+    std::string path;       /**< Path the resource was requested with */
+    int variant;
+    bool sprite;
+    std::vector<AsyncResourceListener*> listeners;
+
+    /** Images decoded by the loader thread, with their id paths */
+    std::vector< std::pair<std::string, SDL_Surface*> > images;
+
+    /** Sprite files parsed by the loader thread */
+    SpriteDef::Documents documents;
+
+    ~AsyncJob()
+    {
+        for (SpriteDef::Documents::iterator i = documents.begin(),
+             i_end = documents.end(); i != i_end; ++i)
+        {
+            delete i->second;
+        }
+    }
+};
+
 ResourceManager::~ResourceManager()
 {
+    // Stop the loader threads before anything they may be using goes away
+    SDL_mutexP(mAsyncMutex);
+    mAsyncQuit = true;
+    SDL_CondBroadcast(mAsyncCond);
+    SDL_mutexV(mAsyncMutex);
+
+    for (std::vector<SDL_Thread*>::iterator i = mAsyncThreads.begin(),
+         i_end = mAsyncThreads.end(); i != i_end; ++i)
+    {
+        SDL_WaitThread(*i, NULL);
+    }
+
+    for (std::map<std::string, AsyncJob*>::iterator i = mAsyncJobs.begin(),
+         i_end = mAsyncJobs.end(); i != i_end; ++i)
+    {
+        AsyncJob *job = i->second;
+        for (unsigned int j = 0; j < job->images.size(); ++j)
+            SDL_FreeSurface(job->images[j].second);
+        delete job;
+    }
+
+    SDL_DestroyCond(mAsyncCond);
+    SDL_DestroyMutex(mAsyncMutex);
+
     mResources.insert(mOrphanedResources.begin(), mOrphanedResources.end());
 
     // Release any remaining spritedefs first because they depend on image sets
@@ -90,6 +162,18 @@ ResourceManager::~ResourceManager()
         cleanUp(iter->second);
         ++iter;
     }
+
+    logger->log("ResourceManager::~ResourceManager() decoded %d dye "
+                "source%s in %ld ms for %d dyed images",
+                mDyeSourceMisses, (mDyeSourceMisses == 1) ? "" : "s",
+                mDyeSourceTime / 1000, mDyeSourceUses);
+
+    for (DyeSources::iterator i = mDyeSources.begin(),
+         i_end = mDyeSources.end(); i != i_end; ++i)
+    {
+        SDL_FreeSurface(i->second.surface);
+    }
+    SDL_DestroyMutex(mDyeSourceMutex);
 }
 
 void ResourceManager::cleanUp(Resource *res)
@@ -304,22 +388,433 @@ struct DyedImageLoader
         DyedImageLoader *l = static_cast< DyedImageLoader * >(v);
         std::string path = l->path;
         std::string::size_type p = path.find('|');
-        Dye *d = NULL;
-        if (p != std::string::npos)
+        if (p == std::string::npos)
+        {
+            int fileSize;
+            void *buffer = l->manager->loadFile(path, fileSize);
+            if (!buffer) return NULL;
+            Resource *res = Image::load(buffer, fileSize);
+            free(buffer);
+            return res;
+        }
+
+        // Dyed variants share the decoded image, only recoloring it
+        const std::string sourcePath = path.substr(0, p);
+        SDL_Surface *source = l->manager->getDyeSource(sourcePath);
+        if (!source) return NULL;
+
+        Dye d(path.substr(p + 1));
+        Image *res = Image::load(source, d);
+        l->manager->releaseDyeSource(sourcePath);
+        return res;
+    }
+};
+
+struct SpriteDefLoader
+{
+    std::string path;
+    int variant;
+    const SpriteDef::Documents *documents;
+    static Resource *load(void *v)
+    {
+        SpriteDefLoader *l = static_cast< SpriteDefLoader * >(v);
+        return SpriteDef::load(l->path, l->variant, l->documents);
+    }
+};
+
+void ResourceManager::getImageAsync(const std::string &idPath,
+                                    AsyncResourceListener *listener)
+{
+    AsyncJob *job = new AsyncJob;
+    job->idPath = idPath;
+    job->path = idPath;
+    job->variant = 0;
+    job->sprite = false;
+    queueAsyncJob(job, listener);
+}
+
+void ResourceManager::getSpriteAsync(const std::string &path, int variant,
+                                     AsyncResourceListener *listener)
+{
+    std::stringstream ss;
+    ss << path << "[" << variant << "]";
+
+    AsyncJob *job = new AsyncJob;
+    job->idPath = ss.str();
+    job->path = path;
+    job->variant = variant;
+    job->sprite = true;
+    queueAsyncJob(job, listener);
+}
+
+void ResourceManager::cancelAsync(AsyncResourceListener *listener)
+{
+    for (std::map<std::string, AsyncJob*>::iterator i = mAsyncJobs.begin(),
+         i_end = mAsyncJobs.end(); i != i_end; ++i)
+    {
+        std::vector<AsyncResourceListener*> &listeners = i->second->listeners;
+        listeners.erase(std::remove(listeners.begin(), listeners.end(),
+                                    listener), listeners.end());
+    }
+}
+
+void ResourceManager::queueAsyncJob(AsyncJob *job,
+                                    AsyncResourceListener *listener)
+{
+    std::map<std::string, AsyncJob*>::iterator i =
+        mAsyncJobs.find(job->idPath);
+
+    if (i != mAsyncJobs.end())
+    {
+        i->second->listeners.push_back(listener);
+        delete job;
+        return;
+    }
+
+    job->listeners.push_back(listener);
+    mAsyncJobs[job->idPath] = job;
+
+    if (!mAsyncStarted)
+    {
+        mAsyncStarted = true;
+        mAsyncBudget = (int) config.getValue("loaderBudget", 4);
+
+        // Without loader threads, jobs are run by processAsyncLoads
+        const int threads = (int) config.getValue("loaderThreads", 2);
+        for (int t = 0; t < threads; ++t)
+        {
+            SDL_Thread *thread = SDL_CreateThread(asyncThread, this);
+            if (!thread)
+            {
+                logger->log("Unable to create resource loader thread: %s",
+                            SDL_GetError());
+                break;
+            }
+            mAsyncThreads.push_back(thread);
+        }
+
+        logger->log("Started %d resource loader threads",
+                    (int) mAsyncThreads.size());
+    }
+
+    // Resources that are loaded already only need to be handed out
+    const bool loaded =
+        mResources.find(job->idPath) != mResources.end() ||
+        mOrphanedResources.find(job->idPath) != mOrphanedResources.end();
+
+    SDL_mutexP(mAsyncMutex);
+    if (loaded)
+    {
+        mLoadedJobs.push_back(job);
+    }
+    else
+    {
+        mQueuedJobs.push_back(job);
+        SDL_CondSignal(mAsyncCond);
+    }
+    SDL_mutexV(mAsyncMutex);
+}
+
+int ResourceManager::asyncThread(void *data)
+{
+    ResourceManager *resman = static_cast<ResourceManager*>(data);
+
+    SDL_mutexP(resman->mAsyncMutex);
+
+    for (;;)
+    {
+        while (resman->mQueuedJobs.empty() && !resman->mAsyncQuit)
+            SDL_CondWait(resman->mAsyncCond, resman->mAsyncMutex);
+
+        if (resman->mAsyncQuit)
+            break;
+
+        AsyncJob *job = resman->mQueuedJobs.front();
+        resman->mQueuedJobs.pop_front();
+
+        SDL_mutexV(resman->mAsyncMutex);
+        resman->runAsyncJob(job);
+        SDL_mutexP(resman->mAsyncMutex);
+
+        resman->mLoadedJobs.push_back(job);
+    }
+
+    SDL_mutexV(resman->mAsyncMutex);
+    return 0;
+}
+
+void ResourceManager::runAsyncJob(AsyncJob *job)
+{
+    std::vector<std::string> imagePaths;
+
+    if (!job->sprite)
+    {
+        imagePaths.push_back(job->idPath);
+    }
+    else
+    {
+        // Find the image sets of the sprite and the sprites it includes,
+        // like SpriteDef::load does
+        std::string::size_type pos = job->path.find('|');
+        std::string palettes;
+        if (pos != std::string::npos)
+            palettes = job->path.substr(pos + 1);
+
+        std::vector<std::string> files;
+        files.push_back(job->path.substr(0, pos));
+
+        for (unsigned int f = 0; f < files.size(); ++f)
+        {
+            // Kept for creating the sprite definition
+            XML::Document *doc = new XML::Document(files[f]);
+            job->documents[files[f]] = doc;
+            xmlNodePtr rootNode = doc->rootNode();
+
+            if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "sprite"))
+                continue;
+
+            for_each_xml_child_node(node, rootNode)
+            {
+                if (xmlStrEqual(node->name, BAD_CAST "imageset"))
+                {
+                    std::string src = XML::getProperty(node, "src", "");
+
+                    // Included sprites are not dyed
+                    if (f == 0)
+                        Dye::instantiate(src, palettes);
+
+                    if (!src.empty() &&
+                        std::find(imagePaths.begin(), imagePaths.end(),
+                                  src) == imagePaths.end())
+                    {
+                        imagePaths.push_back(src);
+                    }
+                }
+                else if (xmlStrEqual(node->name, BAD_CAST "include"))
+                {
+                    const std::string file = "graphics/sprites/" +
+                        XML::getProperty(node, "file", "");
+
+                    if (std::find(files.begin(), files.end(), file) ==
+                        files.end())
+                    {
+                        files.push_back(file);
+                    }
+                }
+            }
+        }
+    }
+
+    for (std::vector<std::string>::iterator i = imagePaths.begin(),
+         i_end = imagePaths.end(); i != i_end; ++i)
+    {
+        if (SDL_Surface *surface = loadAsyncImage(*i))
+            job->images.push_back(std::make_pair(*i, surface));
+    }
+}
+
+SDL_Surface *ResourceManager::loadAsyncImage(const std::string &idPath)
+{
+    std::string::size_type p = idPath.find('|');
+    if (p == std::string::npos)
+        return loadSDLSurface(idPath);
+
+    const std::string sourcePath = idPath.substr(0, p);
+    SDL_Surface *source = getDyeSource(sourcePath);
+    if (!source) return NULL;
+
+    Dye dye(idPath.substr(p + 1));
+    SDL_Surface *surface = Image::applyDye(source, dye);
+    releaseDyeSource(sourcePath);
+    return surface;
+}
+
+void ResourceManager::processAsyncLoads()
+{
+    if (mAsyncJobs.empty())
+        return;
+
+    const Uint32 start = SDL_GetTicks();
+
+    do
+    {
+        AsyncJob *job = NULL;
+        bool run = false;
+
+        SDL_mutexP(mAsyncMutex);
+        if (!mLoadedJobs.empty())
+        {
+            job = mLoadedJobs.front();
+            mLoadedJobs.pop_front();
+        }
+        else if (mAsyncThreads.empty() && !mQueuedJobs.empty())
+        {
+            job = mQueuedJobs.front();
+            mQueuedJobs.pop_front();
+            run = true;
+        }
+        SDL_mutexV(mAsyncMutex);
+
+        if (!job)
+            break;
+
+        if (run)
+            runAsyncJob(job);
+
+        finishAsyncJob(job);
+    }
+    while (SDL_GetTicks() - start < (Uint32) mAsyncBudget);
+}
+
+void ResourceManager::finishAsyncJob(AsyncJob *job)
+{
+    mAsyncJobs.erase(job->idPath);
+
+    // Create the decoded images, unless they got loaded in the meantime
+    std::vector<Image*> images;
+
+    for (unsigned int i = 0; i < job->images.size(); ++i)
+    {
+        const std::string &idPath = job->images[i].first;
+        SDL_Surface *surface = job->images[i].second;
+
+        Image *image = NULL;
+        if (mResources.find(idPath) == mResources.end() &&
+            mOrphanedResources.find(idPath) == mOrphanedResources.end())
         {
-            d = new Dye(path.substr(p + 1));
-            path = path.substr(0, p);
+            image = Image::load(surface, true);
         }
+
+        if (addResource(idPath, image))
+            images.push_back(image);
+
+        SDL_FreeSurface(surface);
+    }
+
+    Resource *resource;
+    if (job->sprite)
+    {
+        // Builds the definition from the files parsed by the loader thread
+        SpriteDefLoader l = { job->path, job->variant, &job->documents };
+        resource = get(job->idPath, SpriteDefLoader::load, &l);
+    }
+    else
+    {
+        resource = getImage(job->path);
+    }
+
+    // The images stay around when the sprite uses them
+    for (std::vector<Image*>::iterator i = images.begin(),
+         i_end = images.end(); i != i_end; ++i)
+    {
+        (*i)->decRef();
+    }
+
+    for (std::vector<AsyncResourceListener*>::iterator
+         i = job->listeners.begin(), i_end = job->listeners.end();
+         i != i_end; ++i)
+    {
+        if (resource)
+            resource->incRef();
+        (*i)->resourceLoaded(job->path, resource);
+    }
+
+    if (resource)
+        resource->decRef();
+
+    delete job;
+}
+
+SDL_Surface *ResourceManager::getDyeSource(const std::string &path)
+{
+    SDL_mutexP(mDyeSourceMutex);
+    DyeSources::iterator i = mDyeSources.find(path);
+
+    if (i == mDyeSources.end())
+    {
+        // Decode without holding the lock, so that other threads can go on
+        SDL_mutexV(mDyeSourceMutex);
+
+        timeval start, end;
+        gettimeofday(&start, NULL);
+
         int fileSize;
-        void *buffer = l->manager->loadFile(path, fileSize);
+        void *buffer = loadFile(path, fileSize);
         if (!buffer) return NULL;
-        Resource *res = d ? Image::load(buffer, fileSize, *d)
-                          : Image::load(buffer, fileSize);
+        SDL_Surface *surface = Image::loadRGBA(buffer, fileSize);
         free(buffer);
-        delete d;
-        return res;
+        if (!surface) return NULL;
+
+        gettimeofday(&end, NULL);
+
+        SDL_mutexP(mDyeSourceMutex);
+        i = mDyeSources.find(path);
+
+        if (i == mDyeSources.end())
+        {
+            DyeSource source;
+            source.surface = surface;
+            source.refCount = 0;
+            i = mDyeSources.insert(DyeSources::value_type(path, source)).first;
+
+            mDyeSourceBytes += surface->pitch * surface->h;
+            mDyeSourceMisses++;
+            mDyeSourceTime += (end.tv_sec - start.tv_sec) * 1000000L +
+                              end.tv_usec - start.tv_usec;
+        }
+        else
+        {
+            // Another thread decoded the same file in the meantime
+            SDL_FreeSurface(surface);
+        }
     }
-};
+
+    i->second.refCount++;
+    i->second.lastUse = ++mDyeSourceUses;
+
+    trimDyeSources();
+    SDL_Surface *surface = i->second.surface;
+    SDL_mutexV(mDyeSourceMutex);
+    return surface;
+}
+
+void ResourceManager::releaseDyeSource(const std::string &path)
+{
+    SDL_mutexP(mDyeSourceMutex);
+    DyeSources::iterator i = mDyeSources.find(path);
+
+    if (i != mDyeSources.end() && --i->second.refCount == 0)
+        trimDyeSources();
+    SDL_mutexV(mDyeSourceMutex);
+}
+
+void ResourceManager::trimDyeSources()
+{
+    while (mDyeSourceBytes > MAX_DYE_SOURCE_BYTES)
+    {
+        DyeSources::iterator victim = mDyeSources.end();
+
+        // Sources being recolored stay, even when that exceeds the budget
+        for (DyeSources::iterator i = mDyeSources.begin(),
+             i_end = mDyeSources.end(); i != i_end; ++i)
+        {
+            if (i->second.refCount == 0 &&
+                (victim == mDyeSources.end() ||
+                 i->second.lastUse < victim->second.lastUse))
+            {
+                victim = i;
+            }
+        }
+
+        if (victim == mDyeSources.end())
+            break;
+
+        SDL_Surface *surface = victim->second.surface;
+        mDyeSourceBytes -= surface->pitch * surface->h;
+        SDL_FreeSurface(surface);
+        mDyeSources.erase(victim);
+    }
+}
 
 Image *ResourceManager::getImage(const std::string &idPath)
 {
@@ -352,23 +847,29 @@ ImageSet *ResourceManager::getImageSet(const std::string &imagePath,
     return static_cast<ImageSet*>(get(ss.str(), ImageSetLoader::load, &l));
 }
 
-struct SpriteDefLoader
+SpriteDef *ResourceManager::getSprite(const std::string &path, int variant)
+{
+    SpriteDefLoader l = { path, variant, NULL };
+    std::stringstream ss;
+    ss << path << "[" << variant << "]";
+    return static_cast<SpriteDef*>(get(ss.str(), SpriteDefLoader::load, &l));
+}
+
+struct ParticleEffectDefLoader
 {
     std::string path;
-    int variant;
     static Resource *load(void *v)
     {
-        SpriteDefLoader *l = static_cast< SpriteDefLoader * >(v);
-        return SpriteDef::load(l->path, l->variant);
+        ParticleEffectDefLoader *l = static_cast< ParticleEffectDefLoader * >(v);
+        return ParticleEffectDef::load(l->path);
     }
 };
 
-SpriteDef *ResourceManager::getSprite(const std::string &path, int variant)
+ParticleEffectDef *ResourceManager::getParticleEffect(const std::string &path)
 {
-    SpriteDefLoader l = { path, variant };
-    std::stringstream ss;
-    ss << path << "[" << variant << "]";
-    return static_cast<SpriteDef*>(get(ss.str(), SpriteDefLoader::load, &l));
+    ParticleEffectDefLoader l = { path };
+    return static_cast<ParticleEffectDef*>(
+            get(path, ParticleEffectDefLoader::load, &l));
 }
 
 void ResourceManager::release(Resource *res)
@@ -459,6 +960,25 @@ bool ResourceManager::copyFile(const std::string &src, const std::string &dst)
     return true;
 }
 
+bool ResourceManager::saveFile(const std::string &fileName,
+                               const void *data, int size)
+{
+    PHYSFS_file *file = PHYSFS_openWrite(fileName.c_str());
+    if (!file)
+    {
+        logger->log("Write error: %s", PHYSFS_getLastError());
+        return false;
+    }
+
+    bool success = PHYSFS_write(file, data, 1, size) == size;
+    success = PHYSFS_close(file) && success;
+
+    if (!success)
+        logger->log("Write error: %s", PHYSFS_getLastError());
+
+    return success;
+}
+
 std::vector<std::string> ResourceManager::loadTextFile(
         const std::string &fileName)
 {
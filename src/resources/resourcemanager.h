@@ -23,6 +23,7 @@
 #define RESOURCE_MANAGER_H
 
 #include <ctime>
+#include <list>
 #include <map>
 #include <string>
 #include <vector>
@@ -30,10 +31,35 @@
 class Image;
 class ImageSet;
 class Music;
+class ParticleEffectDef;
 class Resource;
 class SoundEffect;
 class SpriteDef;
+struct SDL_cond;
+struct SDL_mutex;
 struct SDL_Surface;
+struct SDL_Thread;
+
+/**
+ * Receives the resources requested from the resource manager in the
+ * background.
+ */
+class AsyncResourceListener
+{
+    public:
+        virtual ~AsyncResourceListener() {}
+
+        /**
+         * Called on the main thread once a requested resource is available.
+         * The listener owns a reference to the resource.
+         *
+         * @param path     the path the resource was requested with
+         * @param resource the resource, or <code>NULL</code> when it could
+         *                 not be loaded
+         */
+        virtual void resourceLoaded(const std::string &path,
+                                    Resource *resource) = 0;
+};
 
 /**
  * A class for loading and managing resources.
@@ -144,6 +170,16 @@ class ResourceManager
         */
         bool copyFile(const std::string &src, const std::string &dst);
 
+        /**
+         * Writes the given data to a file in the write directory, replacing
+         * the file if it already exists.
+         *
+         * @return true on success, false on failure. An error message should
+         *         be in the log file.
+         */
+        bool saveFile(const std::string &fileName, const void *data,
+                      int size);
+
         /**
          * Convenience wrapper around ResourceManager::get for loading
          * images.
@@ -174,6 +210,47 @@ class ResourceManager
          */
         SpriteDef *getSprite(const std::string &path, int variant = 0);
 
+        /**
+         * Convenience wrapper around ResourceManager::get for loading
+         * particle effect definitions.
+         */
+        ParticleEffectDef *getParticleEffect(const std::string &path);
+
+        /**
+         * Loads an image in the background. The file is read and decoded by
+         * a loader thread, after which the image is created on the main
+         * thread by processAsyncLoads.
+         */
+        void getImageAsync(const std::string &idPath,
+                           AsyncResourceListener *listener);
+
+        /**
+         * Loads a sprite definition in the background. The loader threads
+         * parse its file and decode the image sets it uses, after which the
+         * definition is created on the main thread by processAsyncLoads.
+         */
+        void getSpriteAsync(const std::string &path, int variant,
+                            AsyncResourceListener *listener);
+
+        /**
+         * Makes sure the listener isn't told about any resources it requested
+         * that are still being loaded.
+         */
+        void cancelAsync(AsyncResourceListener *listener);
+
+        /**
+         * Creates the resources loaded in the background and hands them to
+         * their listeners. Stops when the time budget for a frame is spent.
+         * Should be called once per frame.
+         */
+        void processAsyncLoads();
+
+        /**
+         * Returns the number of background loads that are not done yet.
+         */
+        int getAsyncLoadCount() const
+        { return mAsyncJobs.size(); }
+
         /**
          * Releases a resource, placing it in the set of orphaned resources.
          */
@@ -202,6 +279,37 @@ class ResourceManager
          */
         SDL_Surface *loadSDLSurface(const std::string &filename);
 
+        /**
+         * Returns the decoded RGBA surface of the given image file, shared by
+         * all dyed variants of the image so that the file is only decoded
+         * once. Each call takes a reference, to be given back with
+         * releaseDyeSource once the recoloring is done. Sources that are not
+         * referenced are kept within a memory budget. May be called from any
+         * thread.
+         *
+         * @return the surface, owned by the resource manager, or
+         *         <code>NULL</code> when the image could not be loaded
+         */
+        SDL_Surface *getDyeSource(const std::string &path);
+
+        /**
+         * Gives back a reference to the dye source of the given image file.
+         * May be called from any thread.
+         */
+        void releaseDyeSource(const std::string &path);
+
+        /**
+         * Returns the number of times a dye source was decoded.
+         */
+        int getDyeSourceDecodeCount() const
+        { return mDyeSourceMisses; }
+
+        /**
+         * Returns the number of dyed images created from a dye source.
+         */
+        int getDyeSourceUseCount() const
+        { return mDyeSourceUses; }
+
         /**
          * Returns an instance of the class, creating one if it does not
          * already exist.
@@ -221,12 +329,72 @@ class ResourceManager
 
         void cleanOrphans();
 
+        struct AsyncJob;
+
+        /**
+         * Queues a background load, unless one is already going on for the
+         * same resource.
+         */
+        void queueAsyncJob(AsyncJob *job, AsyncResourceListener *listener);
+
+        /**
+         * Reads and decodes the files needed by the job. Runs on a loader
+         * thread, or on the main thread when there are none.
+         */
+        void runAsyncJob(AsyncJob *job);
+
+        /**
+         * Creates the resource of a loaded job and hands it to the
+         * listeners.
+         */
+        void finishAsyncJob(AsyncJob *job);
+
+        /**
+         * Decodes an image, applying its dye if any.
+         */
+        SDL_Surface *loadAsyncImage(const std::string &idPath);
+
+        static int asyncThread(void *data);
+
+        /**
+         * Frees unreferenced dye sources, least recently used first, until
+         * the sources fit in their memory budget. Expects the dye source
+         * mutex to be locked.
+         */
+        void trimDyeSources();
+
         static ResourceManager *instance;
         typedef std::map<std::string, Resource*> Resources;
         typedef Resources::iterator ResourceIterator;
         Resources mResources;
         Resources mOrphanedResources;
         time_t mOldestOrphan;
+
+        struct DyeSource
+        {
+            SDL_Surface *surface;
+            int refCount;       /**< Number of recolorings going on */
+            int lastUse;        /**< Value of mDyeSourceUses when last used */
+        };
+
+        typedef std::map<std::string, DyeSource> DyeSources;
+        DyeSources mDyeSources;
+        int mDyeSourceBytes;
+        int mDyeSourceUses;
+        int mDyeSourceMisses;   /**< Number of times a file was decoded */
+        long mDyeSourceTime;    /**< Microseconds spent decoding sources */
+        SDL_mutex *mDyeSourceMutex;
+
+        typedef std::list<AsyncJob*> AsyncJobs;
+        AsyncJobs mQueuedJobs;  /**< Jobs waiting for a loader thread */
+        AsyncJobs mLoadedJobs;  /**< Jobs waiting to be finished */
+        std::map<std::string, AsyncJob*> mAsyncJobs; /**< Jobs by id path */
+        std::vector<SDL_Thread*> mAsyncThreads;
+        SDL_mutex *mAsyncMutex;
+        SDL_cond *mAsyncCond;
+        bool mAsyncQuit;
+        bool mAsyncStarted;
+        int mAsyncBudget;       /**< Milliseconds per frame for finishing */
 };
 
 #endif
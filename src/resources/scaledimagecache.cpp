@@ -0,0 +1,118 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/scaledimagecache.h"
+
+#include "resources/image.h"
+
+/** Maximum number of scaled images kept around */
+static const unsigned int MAX_ENTRIES = 32;
+
+ScaledImageCache::Entries ScaledImageCache::mEntries;
+int ScaledImageCache::mHits = 0;
+int ScaledImageCache::mMisses = 0;
+
+Image *ScaledImageCache::get(Image *image, int width, int height)
+{
+    for (Entries::iterator i = mEntries.begin(), i_end = mEntries.end();
+         i != i_end; ++i)
+    {
+        if (i->source != image || i->width != width || i->height != height)
+            continue;
+
+        mHits++;
+        mEntries.splice(mEntries.begin(), mEntries, i);
+        i->scaled->setAlpha(image->getAlpha());
+        return i->scaled;
+    }
+
+    mMisses++;
+
+    Image *scaled = image->SDLgetScaledImage(width, height);
+    if (!scaled)
+        return NULL;
+
+    if (mEntries.size() >= MAX_ENTRIES)
+        evict();
+
+    Entry entry;
+    entry.source = image;
+    entry.width = width;
+    entry.height = height;
+    entry.scaled = scaled;
+    mEntries.push_front(entry);
+
+    scaled->setAlpha(image->getAlpha());
+    return scaled;
+}
+
+void ScaledImageCache::evict()
+{
+    // Prefer images that were released to the resource manager, since
+    // they are unlikely to be drawn again
+    Entries::iterator victim = mEntries.end();
+
+    for (Entries::iterator i = mEntries.begin(), i_end = mEntries.end();
+         i != i_end; ++i)
+    {
+        if (i->source->getRefCount() == 0 &&
+            !i->source->getIdPath().empty())
+        {
+            victim = i;
+        }
+    }
+
+    if (victim == mEntries.end())
+        victim = --mEntries.end();
+
+    Image *scaled = victim->scaled;
+    mEntries.erase(victim);
+    delete scaled;
+}
+
+void ScaledImageCache::remove(const Image *image)
+{
+    Entries::iterator i = mEntries.begin();
+
+    while (i != mEntries.end())
+    {
+        if (i->source == image)
+        {
+            Image *scaled = i->scaled;
+            i = mEntries.erase(i);
+            delete scaled;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void ScaledImageCache::clear()
+{
+    while (!mEntries.empty())
+    {
+        Image *scaled = mEntries.front().scaled;
+        mEntries.pop_front();
+        delete scaled;
+    }
+}
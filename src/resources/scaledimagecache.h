@@ -0,0 +1,101 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCALEDIMAGECACHE_H
+#define SCALEDIMAGECACHE_H
+
+#include <list>
+
+class Image;
+
+/**
+ * Keeps the most recently used rescaled versions of images around, so that
+ * the software renderer doesn't need to rescale images on every frame.
+ *
+ * Entries are keyed by source image and size, and are drawn at the alpha
+ * value of their source image. When the cache is full, entries of images
+ * that are no longer referenced are evicted first, and the least recently
+ * used entry otherwise.
+ * Entries are also dropped when their source image is destroyed.
+ */
+class ScaledImageCache
+{
+    public:
+        /**
+         * Returns a version of the image scaled to the given size. The
+         * returned image is owned by the cache and should not be kept
+         * around beyond the current frame.
+         *
+         * @return the scaled image, or <code>NULL</code> when the image could
+         *         not be scaled or already has the given size
+         */
+        static Image *get(Image *image, int width, int height);
+
+        /**
+         * Drops all scaled versions of the given image.
+         */
+        static void remove(const Image *image);
+
+        /**
+         * Drops all scaled images.
+         */
+        static void clear();
+
+        /**
+         * Returns the number of lookups that found a cached image.
+         */
+        static int getHits()
+        { return mHits; }
+
+        /**
+         * Returns the number of lookups that needed to rescale the image.
+         */
+        static int getMisses()
+        { return mMisses; }
+
+        /**
+         * Returns the number of cached images.
+         */
+        static int getSize()
+        { return mEntries.size(); }
+
+    private:
+        struct Entry
+        {
+            const Image *source;
+            int width;
+            int height;
+            Image *scaled;
+        };
+
+        typedef std::list<Entry> Entries;
+
+        /**
+         * Removes an entry to make room for a new one.
+         */
+        static void evict();
+
+        static Entries mEntries;   /**< Most recently used first */
+        static int mHits;
+        static int mMisses;
+};
+
+#endif
@@ -47,19 +47,25 @@ Action *SpriteDef::getAction(SpriteAction action) const
     return i->second;
 }
 
-SpriteDef *SpriteDef::load(const std::string &animationFile, int variant)
+SpriteDef *SpriteDef::load(const std::string &animationFile, int variant,
+                           const Documents *documents)
 {
     std::string::size_type pos = animationFile.find('|');
     std::string palettes;
     if (pos != std::string::npos)
         palettes = animationFile.substr(pos + 1);
 
-    XML::Document doc(animationFile.substr(0, pos));
-    xmlNodePtr rootNode = doc.rootNode();
+    SpriteDef *def = new SpriteDef;
+    def->mDocuments = documents;
+
+    XML::Document *doc = NULL;
+    xmlNodePtr rootNode = def->getRootNode(animationFile.substr(0, pos), doc);
 
     if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "sprite"))
     {
         logger->log("Error, failed to parse %s", animationFile.c_str());
+        delete doc;
+        delete def;
 
         if (animationFile != "graphics/sprites/error.xml") {
             return load("graphics/sprites/error.xml", 0);
@@ -68,12 +74,27 @@ SpriteDef *SpriteDef::load(const std::string &animationFile, int variant)
         }
     }
 
-    SpriteDef *def = new SpriteDef;
     def->loadSprite(rootNode, variant, palettes);
     def->substituteActions();
+    def->mDocuments = NULL;
+    delete doc;
     return def;
 }
 
+xmlNodePtr SpriteDef::getRootNode(const std::string &file,
+                                  XML::Document *&doc)
+{
+    if (mDocuments)
+    {
+        Documents::const_iterator i = mDocuments->find(file);
+        if (i != mDocuments->end())
+            return i->second->rootNode();
+    }
+
+    doc = new XML::Document(file);
+    return doc->rootNode();
+}
+
 void SpriteDef::substituteActions()
 {
     substituteAction(ACTION_STAND, ACTION_DEFAULT);
@@ -275,16 +296,15 @@ void SpriteDef::includeSprite(xmlNodePtr includeNode)
     if (filename.empty())
         return;
 
-    XML::Document doc("graphics/sprites/" + filename);
-    xmlNodePtr rootNode = doc.rootNode();
+    XML::Document *doc = NULL;
+    xmlNodePtr rootNode = getRootNode("graphics/sprites/" + filename, doc);
 
     if (!rootNode || !xmlStrEqual(rootNode->name, BAD_CAST "sprite"))
-    {
         logger->log("Error, no sprite root node in %s", filename.c_str());
-        return;
-    }
+    else
+        loadSprite(rootNode, 0);
 
-    loadSprite(rootNode, 0);
+    delete doc;
 }
 
 void SpriteDef::substituteAction(SpriteAction complete, SpriteAction with)
@@ -29,6 +29,11 @@
 
 #include <libxml/tree.h>
 
+namespace XML
+{
+    class Document;
+}
+
 class Action;
 class ImageSet;
 
@@ -78,10 +83,17 @@ enum SpriteDirection
 class SpriteDef : public Resource
 {
     public:
+        /** Parsed sprite files, by path */
+        typedef std::map<std::string, XML::Document*> Documents;
+
         /**
          * Loads a sprite definition file.
+         *
+         * @param documents the files that were parsed already, or
+         *                  <code>NULL</code> to parse all of them
          */
-        static SpriteDef *load(const std::string &file, int variant);
+        static SpriteDef *load(const std::string &file, int variant,
+                               const Documents *documents = NULL);
 
         /**
          * Returns the specified action.
@@ -103,7 +115,7 @@ class SpriteDef : public Resource
         /**
          * Constructor.
          */
-        SpriteDef() {}
+        SpriteDef(): mDocuments(NULL) {}
 
         /**
          * Destructor.
@@ -138,6 +150,12 @@ class SpriteDef : public Resource
          */
         void includeSprite(xmlNodePtr includeNode);
 
+        /**
+         * Returns the root node of a sprite file. The file is parsed into
+         * doc, unless it is one of the documents given to load.
+         */
+        xmlNodePtr getRootNode(const std::string &file, XML::Document *&doc);
+
         /**
          * Complete missing actions by copying existing ones.
          */
@@ -156,6 +174,7 @@ class SpriteDef : public Resource
 
         ImageSets mImageSets;
         Actions mActions;
+        const Documents *mDocuments;    /**< Only set while loading */
 };
 
 #endif // SPRITEDEF_H
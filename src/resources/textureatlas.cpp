@@ -0,0 +1,299 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/textureatlas.h"
+
+#ifdef USE_OPENGL
+
+#include "resources/image.h"
+
+#include "log.h"
+#include "openglgraphics.h"
+
+#include <algorithm>
+
+/** Preferred width and height of the pages of the shared atlas */
+static const int SHARED_PAGE_SIZE = 1024;
+
+/**
+ * Border around each image, filled with copies of its edge pixels so that
+ * filtered or scaled drawing doesn't pick up the neighbouring images.
+ */
+static const int BORDER = 1;
+
+TextureAtlas::TextureAtlas(int preferredPageSize):
+    mPreferredPageSize(preferredPageSize)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    while (!mPages.empty())
+        deletePage(mPages.front());
+}
+
+TextureAtlas *TextureAtlas::getShared()
+{
+    // Never deleted, since its pages may outlive the OpenGL context
+    static TextureAtlas *shared = new TextureAtlas(SHARED_PAGE_SIZE);
+    return shared;
+}
+
+int TextureAtlas::getPageSize() const
+{
+    return std::min(mPreferredPageSize, Image::getTextureSize());
+}
+
+int TextureAtlas::getOccupancy() const
+{
+    if (mPages.empty())
+        return 0;
+
+    const int pageArea = getPageSize() * getPageSize();
+    long usedArea = 0;
+
+    for (std::list<AtlasPage*>::const_iterator i = mPages.begin(),
+         i_end = mPages.end(); i != i_end; ++i)
+    {
+        usedArea += (*i)->usedArea;
+    }
+
+    return (int) (usedArea * 100 / ((long) pageArea * mPages.size()));
+}
+
+bool TextureAtlas::allocate(AtlasPage *page, int width, int height,
+                            int &x, int &y)
+{
+    const int size = page->size;
+    std::vector<AtlasPage::Shelf> &shelves = page->shelves;
+    int emptyShelf = -1;
+
+    // Look for a shelf that fits without wasting too much height
+    for (unsigned int i = 0; i < shelves.size(); ++i)
+    {
+        AtlasPage::Shelf &shelf = shelves[i];
+
+        if (shelf.images == 0)
+        {
+            // Remember the smallest empty shelf that is high enough
+            if (shelf.height >= height && (emptyShelf == -1 ||
+                shelf.height < shelves[emptyShelf].height))
+            {
+                emptyShelf = i;
+            }
+        }
+        else if (shelf.height >= height &&
+                 shelf.height <= height * 3 / 2 + 2 &&
+                 shelf.x + width <= size)
+        {
+            x = shelf.x;
+            y = shelf.y;
+            shelf.x += width;
+            shelf.images++;
+            return true;
+        }
+    }
+
+    // Reuse an empty shelf, leaving the height it doesn't need empty
+    if (emptyShelf != -1)
+    {
+        AtlasPage::Shelf &shelf = shelves[emptyShelf];
+
+        if (shelf.height > height)
+        {
+            AtlasPage::Shelf rest;
+            rest.y = shelf.y + height;
+            rest.height = shelf.height - height;
+            rest.x = 0;
+            rest.images = 0;
+            shelf.height = height;
+            shelves.insert(shelves.begin() + emptyShelf + 1, rest);
+        }
+
+        AtlasPage::Shelf &reused = shelves[emptyShelf];
+        reused.x = width;
+        reused.images = 1;
+        x = 0;
+        y = reused.y;
+        return true;
+    }
+
+    // Open a new shelf
+    if (page->nextShelfY + height > size)
+        return false;
+
+    AtlasPage::Shelf shelf;
+    shelf.y = page->nextShelfY;
+    shelf.height = height;
+    shelf.x = width;
+    shelf.images = 1;
+    shelves.push_back(shelf);
+    page->nextShelfY += height;
+
+    x = 0;
+    y = shelf.y;
+    return true;
+}
+
+AtlasPage *TextureAtlas::add(SDL_Surface *surface, int &x, int &y)
+{
+    const int size = getPageSize();
+    const int width = surface->w + 2 * BORDER;
+    const int height = surface->h + 2 * BORDER;
+
+    // Large images would fill up pages too quickly
+    if (width > size / 2 || height > size / 2 ||
+        surface->w == 0 || surface->h == 0)
+        return NULL;
+
+    AtlasPage *page = NULL;
+
+    for (std::list<AtlasPage*>::iterator i = mPages.begin(),
+         i_end = mPages.end(); i != i_end; ++i)
+    {
+        if (allocate(*i, width, height, x, y))
+        {
+            page = *i;
+            break;
+        }
+    }
+
+    if (!page)
+    {
+        page = new AtlasPage;
+        page->atlas = this;
+        page->size = size;
+        page->images = 0;
+        page->usedArea = 0;
+        page->nextShelfY = 0;
+
+        glGenTextures(1, &page->texture);
+        glBindTexture(Image::getTextureType(), page->texture);
+        glTexImage2D(Image::getTextureType(), 0, 4, size, size, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(Image::getTextureType(),
+                        GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(Image::getTextureType(),
+                        GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        if (glGetError())
+        {
+            logger->log("Error: Couldn't create texture atlas page");
+            glDeleteTextures(1, &page->texture);
+            delete page;
+            return NULL;
+        }
+
+        logger->log("Created texture atlas page %d (%dx%d)",
+                    (int) mPages.size() + 1, size, size);
+
+        mPages.push_back(page);
+        allocate(page, width, height, x, y);
+    }
+
+    // Surround the image with copies of its edge pixels
+    std::vector<Uint32> pixels(width * height);
+
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+
+    for (int row = 0; row < height; ++row)
+    {
+        const int sourceRow =
+            std::min(std::max(row - BORDER, 0), surface->h - 1);
+        const Uint32 *source = (const Uint32*) ((const Uint8*) surface->pixels
+                                                + sourceRow * surface->pitch);
+        Uint32 *dest = &pixels[row * width];
+
+        std::fill(dest, dest + BORDER, source[0]);
+        std::copy(source, source + surface->w, dest + BORDER);
+        std::fill(dest + BORDER + surface->w, dest + width,
+                  source[surface->w - 1]);
+    }
+
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+
+    glBindTexture(Image::getTextureType(), page->texture);
+    glTexSubImage2D(Image::getTextureType(), 0, x, y, width, height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    x += BORDER;
+    y += BORDER;
+
+    page->images++;
+    page->usedArea += width * height;
+
+    return page;
+}
+
+void TextureAtlas::release(AtlasPage *page, int y, int width, int height)
+{
+    page->images--;
+    page->usedArea -= (width + 2 * BORDER) * (height + 2 * BORDER);
+
+    if (page->images == 0)
+    {
+        page->atlas->deletePage(page);
+        return;
+    }
+
+    std::vector<AtlasPage::Shelf> &shelves = page->shelves;
+    unsigned int i = 0;
+    while (i < shelves.size() && shelves[i].y != y - BORDER)
+        ++i;
+
+    if (i == shelves.size() || --shelves[i].images > 0)
+        return;
+
+    // Merge the emptied shelf with the empty shelves around it
+    shelves[i].x = 0;
+
+    if (i + 1 < shelves.size() && shelves[i + 1].images == 0)
+    {
+        shelves[i].height += shelves[i + 1].height;
+        shelves.erase(shelves.begin() + i + 1);
+    }
+    if (i > 0 && shelves[i - 1].images == 0)
+    {
+        shelves[i - 1].height += shelves[i].height;
+        shelves.erase(shelves.begin() + i);
+        --i;
+    }
+
+    // An empty shelf at the bottom gives its space back to the page
+    if (i + 1 == shelves.size())
+    {
+        page->nextShelfY = shelves[i].y;
+        shelves.pop_back();
+    }
+}
+
+void TextureAtlas::deletePage(AtlasPage *page)
+{
+    OpenGLGraphics::releaseTexture(page->texture);
+    glDeleteTextures(1, &page->texture);
+
+    mPages.remove(page);
+    delete page;
+}
+
+#endif // USE_OPENGL
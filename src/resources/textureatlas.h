@@ -0,0 +1,144 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#ifdef USE_OPENGL
+
+#include <list>
+#include <vector>
+
+#include <SDL.h>
+
+#define NO_SDL_GLEXT
+
+#include <SDL_opengl.h>
+
+class TextureAtlas;
+
+/**
+ * A large texture that several images are packed into.
+ */
+struct AtlasPage
+{
+    /**
+     * A row of images with the same maximum height.
+     */
+    struct Shelf
+    {
+        int y;       /**< Top of the shelf */
+        int height;  /**< Height of the shelf */
+        int x;       /**< Start of the free space on the shelf */
+        int images;  /**< Number of images living on the shelf */
+    };
+
+    TextureAtlas *atlas; /**< Atlas the page belongs to */
+    GLuint texture;
+    int size;        /**< Width and height of the page */
+    int images;      /**< Number of images living in this page */
+    int usedArea;    /**< Number of pixels taken by those images */
+    int nextShelfY;  /**< Top of the free space below the shelves */
+    std::vector<Shelf> shelves; /**< Sorted from top to bottom */
+};
+
+/**
+ * Packs images into a few large textures, so that drawing images from the
+ * same page doesn't require binding a different texture.
+ *
+ * Space is allocated on shelves. A shelf is emptied once all of its images
+ * are freed, after which it is merged with the empty shelves next to it and
+ * handed out again, split to the height of the new images. A page is
+ * deleted once none of its images are alive anymore. Each image gets a one
+ * pixel border repeating its edge pixels, to keep scaled and filtered
+ * drawing from bleeding into its neighbours.
+ */
+class TextureAtlas
+{
+    public:
+        /**
+         * Constructor. The pages are made as large as the preferred size
+         * when the graphics card supports it.
+         */
+        TextureAtlas(int preferredPageSize);
+
+        /**
+         * Destructor. The images in the atlas have to be deleted before.
+         */
+        ~TextureAtlas();
+
+        /**
+         * Returns the atlas that images are packed into by default.
+         */
+        static TextureAtlas *getShared();
+
+        /**
+         * Uploads the given surface into an atlas page. The surface is
+         * expected to be in 32-bit RGBA format.
+         *
+         * @param x set to the horizontal position of the image in the page
+         * @param y set to the vertical position of the image in the page
+         * @return the page the image was added to, or <code>NULL</code>
+         *         when the image is too large to be put in an atlas
+         */
+        AtlasPage *add(SDL_Surface *surface, int &x, int &y);
+
+        /**
+         * Releases an image added at the given vertical position with the
+         * given size, deleting the page when it no longer holds any images.
+         */
+        static void release(AtlasPage *page, int y, int width, int height);
+
+        /**
+         * Returns the width and height of the atlas pages.
+         */
+        int getPageSize() const;
+
+        /**
+         * Returns the number of atlas pages.
+         */
+        int getPageCount() const
+        { return mPages.size(); }
+
+        /**
+         * Returns the percentage of atlas space taken by images.
+         */
+        int getOccupancy() const;
+
+    private:
+        /**
+         * Finds room for an image in the given page.
+         */
+        static bool allocate(AtlasPage *page, int width, int height,
+                             int &x, int &y);
+
+        /**
+         * Deletes the texture of a page and removes it from the atlas.
+         */
+        void deletePage(AtlasPage *page);
+
+        int mPreferredPageSize;
+        std::list<AtlasPage*> mPages;
+};
+
+#endif // USE_OPENGL
+
+#endif
@@ -39,9 +39,9 @@ Image *Text::mBubbleArrow;
 
 Text::Text(const std::string &text, int x, int y,
            gcn::Graphics::Alignment alignment,
-           const gcn::Color* color, bool isSpeech) :
+           Palette::ColorType colorType, bool isSpeech) :
     mText(text),
-    mColor(color),
+    mColorType(colorType),
     mFont(gui->getFont()),
     mIsSpeech(isSpeech)
 {
@@ -110,9 +110,9 @@ Text::~Text()
     }
 }
 
-void Text::setColor(const gcn::Color *color)
+void Text::setColor(Palette::ColorType colorType)
 {
-    mColor = color;
+    mColorType = colorType;
 }
 
 void Text::adviseXY(int x, int y)
@@ -137,13 +137,14 @@ void Text::draw(gcn::Graphics *graphics, int xOff, int yOff)
 
     TextRenderer::renderText(graphics, mText,
             mX - xOff, mY - yOff, gcn::Graphics::LEFT,
-            *mColor, mFont, !mIsSpeech, true);
+            guiPalette->getColor(mColorType), mFont, !mIsSpeech, true, 255,
+            guiPalette->isAnimated(mColorType));
 }
 
 FlashText::FlashText(const std::string &text, int x, int y,
                      gcn::Graphics::Alignment alignment,
-                     const gcn::Color *color) :
-    Text(text, x, y, alignment, color),
+                     Palette::ColorType colorType) :
+    Text(text, x, y, alignment, colorType),
     mTime(0)
 {
 }
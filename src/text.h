@@ -23,11 +23,11 @@
 #ifndef TEXT_H
 #define TEXT_H
 
-#include <guichan/color.hpp>
-
 #include "graphics.h"
 #include "guichanfwd.h"
 
+#include "gui/palette.h"
+
 class TextManager;
 
 class Text
@@ -40,14 +40,14 @@ class Text
          */
         Text(const std::string &text, int x, int y,
              gcn::Graphics::Alignment alignment,
-             const gcn::Color *color, bool isSpeech = false);
+             Palette::ColorType colorType, bool isSpeech = false);
 
         /**
          * Destructor. The text is removed from the screen.
          */
         virtual ~Text();
 
-        void setColor(const gcn::Color *color);
+        void setColor(Palette::ColorType colorType);
 
         int getWidth() const { return mWidth; }
         int getHeight() const { return mHeight; }
@@ -70,7 +70,7 @@ class Text
         int mXOffset;          /**< The offset of mX from the desired x. */
         static int mInstances; /**< Instances of text. */
         std::string mText;     /**< The text to display. */
-        const gcn::Color *mColor;     /**< The color of the text. */
+        Palette::ColorType mColorType; /**< The color of the text. */
         gcn::Font *mFont;      /**< The font of the text */
         bool mIsSpeech;        /**< Is this text a speech bubble? */
 
@@ -84,7 +84,7 @@ class FlashText : public Text
     public:
         FlashText(const std::string &text, int x, int y,
                   gcn::Graphics::Alignment alignment,
-                  const gcn::Color* color);
+                  Palette::ColorType colorType);
 
         /**
          * Remove the text from the screen
@@ -26,12 +26,12 @@
 #include "gui/textrenderer.h"
 
 TextParticle::TextParticle(Map *map, const std::string &text,
-                           const gcn::Color *color,
+                           Palette::ColorType colorType,
                            gcn::Font *font, bool outline):
     Particle(map),
     mText(text),
     mTextFont(font),
-    mColor(color),
+    mColorType(colorType),
     mOutline(outline)
 {
 }
@@ -52,9 +52,8 @@ void TextParticle::draw(Graphics *graphics, int offsetX, int offsetY) const
     if (mLifetimePast < mFadeIn)
         alpha = alpha * mLifetimePast / mFadeIn;
 
-    gcn::Color color = *mColor;
-
     TextRenderer::renderText(graphics, mText,
             screenX, screenY, gcn::Graphics::CENTER,
-            color, mTextFont, mOutline, false, (int) alpha);
+            guiPalette->getColor(mColorType), mTextFont, mOutline, false,
+            (int) alpha, guiPalette->isAnimated(mColorType));
 }
@@ -0,0 +1,149 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "utils/taskpool.h"
+
+#include "log.h"
+
+#include <SDL_timer.h>
+
+TaskPool::TaskPool(int threads):
+    mThreadCount(threads),
+    mNextTask(0),
+    mPooledTasks(0),
+    mStartTime(0)
+{
+}
+
+TaskPool::~TaskPool()
+{
+    wait();
+}
+
+void TaskPool::add(const std::string &name, Task task)
+{
+    Entry entry;
+    entry.name = name;
+    entry.task = task;
+    entry.time = 0;
+    entry.pooled = true;
+    mTasks.push_back(entry);
+    mPooledTasks = mTasks.size();
+}
+
+void TaskPool::start()
+{
+    mStartTime = SDL_GetTicks();
+
+    for (int i = 0; i < mThreadCount; i++)
+    {
+        SDL_Thread *thread = SDL_CreateThread(workerThread, this);
+        if (!thread)
+        {
+            logger->log("Unable to create task pool thread: %s",
+                        SDL_GetError());
+            break;
+        }
+        mThreads.push_back(thread);
+    }
+    mThreadCount = mThreads.size();
+
+    // Without threads, the tasks are run by wait
+}
+
+void TaskPool::run(const std::string &name, Task task)
+{
+    mMutex.lock();
+    Entry entry;
+    entry.name = name;
+    entry.task = task;
+    entry.time = 0;
+    entry.pooled = false;
+    mTasks.push_back(entry);
+    const int index = mTasks.size() - 1;
+    mMutex.unlock();
+
+    runTask(index);
+}
+
+void TaskPool::wait()
+{
+    if (mThreads.empty())
+    {
+        // Run the remaining tasks on this thread
+        workerThread(this);
+    }
+
+    for (std::vector<SDL_Thread*>::iterator i = mThreads.begin(),
+         i_end = mThreads.end(); i != i_end; ++i)
+    {
+        SDL_WaitThread(*i, NULL);
+    }
+    mThreads.clear();
+}
+
+int TaskPool::workerThread(void *data)
+{
+    TaskPool *pool = static_cast<TaskPool*>(data);
+
+    for (;;)
+    {
+        pool->mMutex.lock();
+        const unsigned int index = pool->mNextTask;
+        if (index < pool->mPooledTasks)
+            pool->mNextTask++;
+        pool->mMutex.unlock();
+
+        if (index >= pool->mPooledTasks)
+            break;
+
+        pool->runTask(index);
+    }
+
+    return 0;
+}
+
+void TaskPool::runTask(int index)
+{
+    mMutex.lock();
+    Task task = mTasks[index].task;
+    mMutex.unlock();
+
+    const Uint32 start = SDL_GetTicks();
+    task();
+    const int time = SDL_GetTicks() - start;
+
+    MutexLocker lock(&mMutex);
+    mTasks[index].time = time;
+}
+
+void TaskPool::logTimes(const std::string &title) const
+{
+    logger->log("%s took %d ms using %d threads:", title.c_str(),
+                (int) (SDL_GetTicks() - mStartTime), mThreadCount);
+
+    for (std::vector<Entry>::const_iterator i = mTasks.begin(),
+         i_end = mTasks.end(); i != i_end; ++i)
+    {
+        logger->log("  %s: %d ms%s", i->name.c_str(), i->time,
+                    i->pooled ? "" : " (main thread)");
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include "utils/mutex.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Runs a set of independent tasks on a few threads, keeping track of the
+ * time each of them took.
+ *
+ * Tasks run on the pool shouldn't touch anything that is only safe to use
+ * from the main thread, like the resource manager or the screen. Those can
+ * be given to run, which executes them on the calling thread while the pool
+ * is busy with the others.
+ */
+class TaskPool
+{
+    public:
+        typedef void (*Task)();
+
+        /**
+         * Constructor.
+         *
+         * @param threads the number of threads to run the tasks on
+         */
+        TaskPool(int threads);
+
+        /**
+         * Destructor. Waits for the tasks to finish.
+         */
+        ~TaskPool();
+
+        /**
+         * Adds a task to be run by the pool. Tasks can only be added
+         * before the pool is started.
+         */
+        void add(const std::string &name, Task task);
+
+        /**
+         * Starts running the added tasks.
+         */
+        void start();
+
+        /**
+         * Runs a task on the calling thread, timing it like the others.
+         */
+        void run(const std::string &name, Task task);
+
+        /**
+         * Waits for all the tasks added to the pool to finish.
+         */
+        void wait();
+
+        /**
+         * Logs the time taken by each task, and the time since the pool was
+         * started.
+         */
+        void logTimes(const std::string &title) const;
+
+    private:
+        static int workerThread(void *data);
+
+        /**
+         * Runs the task with the given index and records its duration.
+         */
+        void runTask(int index);
+
+        struct Entry
+        {
+            std::string name;
+            Task task;
+            int time;           /**< Milliseconds taken by the task */
+            bool pooled;        /**< Whether it was run by the pool */
+        };
+
+        int mThreadCount;
+        std::vector<Entry> mTasks;
+        std::vector<SDL_Thread*> mThreads;
+        unsigned int mNextTask;  /**< Index of the next task to be run */
+        unsigned int mPooledTasks;
+        Uint32 mStartTime;
+        Mutex mMutex;
+};
+
+#endif
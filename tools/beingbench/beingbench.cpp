@@ -0,0 +1,614 @@
+/*
+ *  BeingBench
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "beingmanager.h"
+
+using namespace std;
+
+BeingManager *beingManager = NULL;
+LocalPlayer *player_node = NULL;
+
+Being::Being(int id, int, Map *):
+    mFrame(0),
+    mAction(STAND),
+    mId(id)
+{
+}
+
+void Being::setName(const std::string &name)
+{
+    const std::string oldName = mName;
+    mName = name;
+
+    if (beingManager)
+        beingManager->beingNameChanged(this, oldName);
+}
+
+void Being::setId(int id)
+{
+    const int oldId = mId;
+    mId = id;
+
+    if (beingManager)
+        beingManager->beingIdChanged(this, oldId);
+}
+
+void Being::setPosition(const Vector &pos)
+{
+    const Vector oldPos = mPos;
+    mPos = pos;
+
+    if (beingManager)
+        beingManager->beingMoved(this, oldPos);
+}
+
+/**
+ * The id and name lookups of the being manager as they were before the
+ * beings were indexed, walking the list of all beings.
+ */
+class ReferenceManager
+{
+    public:
+        ~ReferenceManager()
+        {
+            for (Beings::iterator i = mBeings.begin(), i_end = mBeings.end();
+                 i != i_end; ++i)
+            {
+                delete *i;
+            }
+        }
+
+        Being *createBeing(int id, Being::Type type, int subtype)
+        {
+            Being *being;
+
+            switch (type)
+            {
+                case Being::PLAYER:
+                    being = new Player(id, subtype, 0);
+                    break;
+                case Being::NPC:
+                    being = new NPC(id, subtype, 0);
+                    break;
+                case Being::MONSTER:
+                    being = new Monster(id, subtype, 0);
+                    break;
+                default:
+                    being = new Being(id, subtype, 0);
+                    break;
+            }
+
+            mBeings.push_back(being);
+            return being;
+        }
+
+        void destroyBeing(Being *being)
+        {
+            mBeings.remove(being);
+            delete being;
+        }
+
+        Being *findBeing(int id) const
+        {
+            for (Beings::const_iterator i = mBeings.begin(),
+                 i_end = mBeings.end(); i != i_end; ++i)
+            {
+                Being *being = (*i);
+                if (being->getId() == id)
+                    return being;
+            }
+            return NULL;
+        }
+
+        Being *findBeingByName(const std::string &name,
+                               Being::Type type = Being::UNKNOWN) const
+        {
+            for (Beings::const_iterator i = mBeings.begin(),
+                 i_end = mBeings.end(); i != i_end; ++i)
+            {
+                Being *being = (*i);
+                if (being->getName() == name &&
+                   (type == Being::UNKNOWN || type == being->getType()))
+                    return being;
+            }
+            return NULL;
+        }
+
+    private:
+        Beings mBeings;
+};
+
+/**
+ * A being related message from the server, reduced to what the network
+ * handlers do with the being manager when receiving it.
+ */
+struct Packet
+{
+    enum Kind
+    {
+        APPEAR,     /**< Being comes into view, created when unknown */
+        MOVE,       /**< Being moves or changes state, looked up by id */
+        NAME,       /**< Name response, looked up by id */
+        REMOVE,     /**< Being leaves the view */
+        WHISPER     /**< Chat command looking up a being by name */
+    };
+
+    Kind kind;
+    int id;
+    Being::Type type;
+    Vector position;
+    string name;
+};
+
+static unsigned int randomSeed = 1;
+
+/**
+ * A small deterministic random number generator, so that runs can be
+ * compared.
+ */
+static int nextRandom()
+{
+    randomSeed = randomSeed * 1103515245 + 12345;
+    return (randomSeed >> 16) & 0x7fff;
+}
+
+static Vector randomPosition(int mapSize)
+{
+    const int size = mapSize * 32;
+    const int x = (nextRandom() * 32 + nextRandom()) % size;
+    const int y = (nextRandom() * 32 + nextRandom()) % size;
+    return Vector((float) x, (float) y, 0.0f);
+}
+
+static string nameOf(int id)
+{
+    char name[32];
+    sprintf(name, "Being%d", id);
+    return name;
+}
+
+/**
+ * Adds a being coming into view, followed by the answer to its name
+ * request.
+ */
+static void appear(vector<Packet> &packets, vector<int> &live, int &nextId,
+                   int mapSize)
+{
+    Packet packet;
+    packet.kind = Packet::APPEAR;
+    packet.type = (nextRandom() % 10 < 3) ? Being::PLAYER : Being::MONSTER;
+    packet.id = (packet.type == Being::PLAYER ? 150000 : 110000000) +
+                nextId++;
+    packet.position = randomPosition(mapSize);
+    packets.push_back(packet);
+
+    packet.kind = Packet::NAME;
+    packet.name = nameOf(packet.id);
+    packets.push_back(packet);
+
+    live.push_back(packet.id);
+}
+
+/**
+ * Generates the packets of a map with about the given number of beings in
+ * view. Most packets update a being that is in view, some replace a being
+ * by a new one, and a few look up a being by name.
+ */
+static void generate(vector<Packet> &packets, int beings, int count,
+                     int mapSize)
+{
+    vector<int> live;
+    int nextId = 0;
+
+    while ((int) live.size() < beings)
+        appear(packets, live, nextId, mapSize);
+
+    while ((int) packets.size() < count)
+    {
+        const int kind = nextRandom() % 100;
+        const int index = (nextRandom() * 32768 + nextRandom()) % live.size();
+
+        Packet packet;
+        packet.id = live[index];
+        packet.type = Being::UNKNOWN;
+
+        if (kind < 90)
+        {
+            packet.kind = Packet::MOVE;
+            packet.position = randomPosition(mapSize);
+            packets.push_back(packet);
+        }
+        else if (kind < 92)
+        {
+            packet.kind = Packet::NAME;
+            packet.name = nameOf(packet.id);
+            packets.push_back(packet);
+        }
+        else if (kind < 97)
+        {
+            packet.kind = Packet::REMOVE;
+            packets.push_back(packet);
+
+            live[index] = live.back();
+            live.pop_back();
+            appear(packets, live, nextId, mapSize);
+        }
+        else
+        {
+            packet.kind = Packet::WHISPER;
+            packet.name = nameOf(packet.id);
+            packets.push_back(packet);
+        }
+    }
+}
+
+/**
+ * Replays the packets on the given being manager. Returns the number of
+ * name lookups that found a being.
+ */
+template <class Manager>
+static int replay(Manager &manager, const vector<Packet> &packets)
+{
+    int found = 0;
+
+    for (vector<Packet>::const_iterator i = packets.begin(),
+         i_end = packets.end(); i != i_end; ++i)
+    {
+        Being *being = manager.findBeing(i->id);
+
+        switch (i->kind)
+        {
+            case Packet::APPEAR:
+                if (!being)
+                    being = manager.createBeing(i->id, i->type, 0);
+                being->setPosition(i->position);
+                break;
+            case Packet::MOVE:
+                if (being)
+                    being->setPosition(i->position);
+                break;
+            case Packet::NAME:
+                if (being)
+                    being->setName(i->name);
+                break;
+            case Packet::REMOVE:
+                if (being)
+                    manager.destroyBeing(being);
+                break;
+            case Packet::WHISPER:
+                if (manager.findBeingByName(i->name))
+                    ++found;
+                break;
+        }
+    }
+
+    return found;
+}
+
+template <class Manager>
+static int run(const char *name, Manager &manager,
+               const vector<Packet> &packets)
+{
+    clock_t start = clock();
+    const int found = replay(manager, packets);
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    cout << name << ": " << packets.size() << " packets in " << seconds
+         << " s";
+    if (seconds > 0)
+        cout << ", " << (int) (packets.size() / seconds) << " packets/s";
+    cout << ", " << found << " names found" << endl;
+
+    return found;
+}
+
+/**
+ * The position queries of the being manager as they were before it kept
+ * its beings in a grid, walking the list of all beings. Positions are
+ * compared in pixels, like the being manager does now.
+ */
+struct ReferenceQueries
+{
+    ReferenceQueries(const Beings &beings):
+        beings(beings)
+    {}
+
+    Being *findBeing(int x, int y) const
+    {
+        for (Beings::const_iterator i = beings.begin(), i_end = beings.end();
+             i != i_end; ++i)
+        {
+            Being *being = (*i);
+            const int otherY = y + ((being->getType() == Being::NPC) ? 1 : 0);
+            const Vector &pos = being->getPosition();
+            if ((int) pos.x / 32 == x &&
+                ((int) pos.y / 32 == y || (int) pos.y / 32 == otherY) &&
+                being->mAction != Being::DEAD)
+                return being;
+        }
+        return NULL;
+    }
+
+    Being *findBeingByPixel(int x, int y) const
+    {
+        for (Beings::const_iterator i = beings.begin(), i_end = beings.end();
+             i != i_end; ++i)
+        {
+            Being *being = (*i);
+
+            int xtol = being->getWidth() / 2;
+            int uptol = being->getHeight();
+
+            if ((being->mAction != Being::DEAD) &&
+                (being->getPixelX() - xtol <= x) &&
+                (being->getPixelX() + xtol >= x) &&
+                (being->getPixelY() - uptol <= y) &&
+                (being->getPixelY() >= y))
+            {
+                return being;
+            }
+        }
+        return NULL;
+    }
+
+    Being *findNearestLivingBeing(int x, int y, int maxdist) const
+    {
+        Being *closestBeing = NULL;
+        int dist = 0;
+
+        x = x * 32 + 16;
+        y = y * 32 + 32;
+        maxdist = maxdist * 32;
+
+        for (Beings::const_iterator i = beings.begin(), i_end = beings.end();
+             i != i_end; ++i)
+        {
+            Being *being = (*i);
+            const Vector &pos = being->getPosition();
+            int d = abs(((int) pos.x) - x) + abs(((int) pos.y) - y);
+
+            if ((d < dist || closestBeing == NULL) &&
+                being->mAction != Being::DEAD)
+            {
+                dist = d;
+                closestBeing = being;
+            }
+        }
+
+        return (maxdist >= dist) ? closestBeing : NULL;
+    }
+
+    const Beings &beings;
+};
+
+/**
+ * A position query, in tiles for finding beings on a tile or near it and
+ * in pixels for picking a being with the mouse.
+ */
+struct Query
+{
+    enum Kind
+    {
+        TILE,
+        PIXEL,
+        NEAREST
+    };
+
+    Kind kind;
+    int x, y;
+};
+
+/**
+ * Returns a number that depends on which beings the query results are at,
+ * so that different finders can be compared even when they pick different
+ * beings from the same spot.
+ */
+static long resultSum(Being *being, const Query &query)
+{
+    if (!being)
+        return 0;
+
+    if (query.kind != Query::NEAREST)
+        return 1;
+
+    const Vector &pos = being->getPosition();
+    return 1 + abs((int) pos.x - (query.x * 32 + 16)) +
+               abs((int) pos.y - (query.y * 32 + 32));
+}
+
+template <class Finder>
+static long runQueries(const char *name, const Finder &finder,
+                       const vector<Query> &queries)
+{
+    long sum = 0;
+    clock_t start = clock();
+
+    for (vector<Query>::const_iterator i = queries.begin(),
+         i_end = queries.end(); i != i_end; ++i)
+    {
+        Being *being = NULL;
+
+        switch (i->kind)
+        {
+            case Query::TILE:
+                being = finder.findBeing(i->x, i->y);
+                break;
+            case Query::PIXEL:
+                being = finder.findBeingByPixel(i->x, i->y);
+                break;
+            case Query::NEAREST:
+                being = finder.findNearestLivingBeing(i->x, i->y, 20);
+                break;
+        }
+
+        sum += resultSum(being, *i);
+    }
+
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    cout << name << ": " << queries.size() << " queries in " << seconds
+         << " s";
+    if (seconds > 0)
+        cout << ", " << seconds * 1000000.0 / queries.size()
+             << " us per query";
+    cout << endl;
+
+    return sum;
+}
+
+/**
+ * Puts the given number of beings on the map, a tenth of them dead, and
+ * runs the mouse and targeting queries of the client on them.
+ */
+static int runGrid(int beings, int count, int mapSize)
+{
+    BeingManager manager;
+    manager.setMap(NULL);
+    beingManager = &manager;
+
+    for (int i = 0; i < beings; ++i)
+    {
+        const Being::Type type = (nextRandom() % 10 < 3) ? Being::PLAYER
+                                                         : Being::MONSTER;
+        Being *being = manager.createBeing(150000 + i, type, 0);
+        being->setPosition(randomPosition(mapSize));
+        if (nextRandom() % 10 == 0)
+            being->mAction = Being::DEAD;
+    }
+
+    vector<Query> queries(count);
+    for (int i = 0; i < count; ++i)
+    {
+        Query &query = queries[i];
+        query.kind = (Query::Kind) (i % 3);
+
+        const Vector position = randomPosition(mapSize);
+        query.x = (int) position.x;
+        query.y = (int) position.y;
+        if (query.kind != Query::PIXEL)
+        {
+            query.x /= 32;
+            query.y /= 32;
+        }
+    }
+
+    cout << beings << " beings on a " << mapSize << "x" << mapSize
+         << " map, " << count << " queries" << endl;
+
+    const long referenceSum = runQueries("reference",
+                                         ReferenceQueries(manager.getAll()),
+                                         queries);
+    const long managerSum = runQueries("being manager", manager, queries);
+
+    beingManager = NULL;
+
+    if (referenceSum != managerSum)
+    {
+        cerr << "Error: the queries gave different results" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void printUsage()
+{
+    cerr << "Usage: beingbench [-b beings] [-p packets] [-s map size]" << endl
+         << "       beingbench -g [-b beings] [-q queries] [-s map size]"
+         << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int beings = 300;
+    int count = 1000000;
+    int mapSize = 200;
+    int queries = 100000;
+    bool grid = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-g"))
+        {
+            grid = true;
+            continue;
+        }
+
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2)
+        {
+            printUsage();
+            return 1;
+        }
+
+        const int value = atoi(argv[++i]);
+        switch (argv[i - 1][1])
+        {
+            case 'b': beings = value; break;
+            case 'p': count = value; break;
+            case 'q': queries = value; break;
+            case 's': mapSize = value; break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    if (beings < 1 || count < 1 || queries < 1 || mapSize < 1)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (grid)
+        return runGrid(beings, queries, mapSize);
+
+    vector<Packet> packets;
+    generate(packets, beings, count, mapSize);
+
+    cout << beings << " beings in view, " << packets.size() << " packets"
+         << endl;
+
+    ReferenceManager reference;
+    const int referenceFound = run("reference", reference, packets);
+
+    BeingManager manager;
+    manager.setMap(NULL);
+    beingManager = &manager;
+    const int managerFound = run("being manager", manager, packets);
+    beingManager = NULL;
+
+    if (referenceFound != managerFound)
+    {
+        cerr << "Error: the name lookups gave different results" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ *  BeingBench
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Stand-ins for the being classes of the client, so that the being manager
+ * and the being grid can be compiled without the rest of the client. This
+ * header is included before anything else (see the Makefile), and defines
+ * the include guards of the headers it replaces.
+ */
+
+#ifndef BEINGSTUB_H
+#define BEINGSTUB_H
+
+#define BEING_H
+#define LOCALPLAYER_H
+#define MONSTER_H
+#define NPC_H
+#define PLAYER_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "vector.h"
+
+class Map;
+
+/** As defined by SDL_types.h */
+typedef unsigned short Uint16;
+
+/**
+ * The part of Being used by BeingManager and BeingGrid. Changes of the
+ * id, name and position are reported to the being manager, like the client
+ * does.
+ */
+class Being
+{
+    public:
+        enum Type
+        {
+            UNKNOWN,
+            PLAYER,
+            NPC,
+            MONSTER
+        };
+
+        enum Action
+        {
+            STAND,
+            WALK,
+            ATTACK,
+            SIT,
+            DEAD,
+            HURT
+        };
+
+        Being(int id, int job, Map *map);
+
+        virtual ~Being() {}
+
+        const std::string &getName() const
+        { return mName; }
+
+        void setName(const std::string &name);
+
+        virtual void logic() {}
+
+        virtual Type getType() const { return UNKNOWN; }
+
+        void setId(int id);
+
+        int getId() const { return mId; }
+
+        int getPixelX() const
+        { return (int) mPos.x; }
+
+        int getPixelY() const
+        { return (int) mPos.y; }
+
+        void setPosition(const Vector &pos);
+
+        const Vector &getPosition() const { return mPos; }
+
+        int getWidth() const { return 32; }
+
+        int getHeight() const { return 64; }
+
+        int mFrame;
+        Action mAction;
+
+    private:
+        int mId;
+        std::string mName;
+        Vector mPos;
+};
+
+class Player : public Being
+{
+    public:
+        Player(int id, int job, Map *map): Being(id, job, map) {}
+
+        Type getType() const { return PLAYER; }
+};
+
+class NPC : public Being
+{
+    public:
+        NPC(int id, int job, Map *map): Being(id, job, map) {}
+
+        Type getType() const { return Being::NPC; }
+};
+
+class Monster : public Being
+{
+    public:
+        Monster(int id, int job, Map *map): Being(id, job, map) {}
+
+        Type getType() const { return MONSTER; }
+};
+
+class LocalPlayer : public Player
+{
+    public:
+        LocalPlayer(int id, int job, Map *map): Player(id, job, map) {}
+
+        void setMap(Map *) {}
+};
+
+extern LocalPlayer *player_node;
+
+#endif
@@ -105,10 +105,28 @@ void Palette::getColor(int intensity, int color[3]) const
     color[2] = ((255 - t) * b1 + t * b2) / 255;
 }
 
+bool Palette::getTable(unsigned int table[256]) const
+{
+    if (mColors.empty())
+        return false;
+
+    table[0] = 0;
+    for (int intensity = 1; intensity < 256; ++intensity)
+    {
+        int color[3];
+        getColor(intensity, color);
+        table[intensity] = (color[0] << 24) | (color[1] << 16) | (color[2] << 8);
+    }
+    return true;
+}
+
 Dye::Dye(const std::string &description)
 {
     for (int i = 0; i < 7; ++i)
+    {
         mPalettes[i] = 0;
+        mTables[i] = 0;
+    }
 
     if (description.empty()) return;
 
@@ -140,12 +158,26 @@ Dye::Dye(const std::string &description)
         ++next_pos;
     }
     while (next_pos < length);
+
+    for (int i = 0; i < 7; ++i)
+    {
+        if (!mPalettes[i]) continue;
+        mTables[i] = new unsigned int[256];
+        if (!mPalettes[i]->getTable(mTables[i]))
+        {
+            delete[] mTables[i];
+            mTables[i] = 0;
+        }
+    }
 }
 
 Dye::~Dye()
 {
     for (int i = 0; i < 7; ++i)
+    {
         delete mPalettes[i];
+        delete[] mTables[i];
+    }
 }
 
 void Dye::update(int color[3]) const
@@ -169,6 +201,33 @@ void Dye::update(int color[3]) const
         mPalettes[i - 1]->getColor(cmax, color);
 }
 
+void Dye::update(unsigned int *pixels, int count) const
+{
+    for (unsigned int *p_end = pixels + count; pixels != p_end; ++pixels)
+    {
+        const unsigned int pixel = *pixels;
+        if (!(pixel & 255)) continue;
+
+        const unsigned int r = pixel >> 24;
+        const unsigned int g = (pixel >> 16) & 255;
+        const unsigned int b = (pixel >> 8) & 255;
+        const unsigned int cmax = std::max(r, std::max(g, b));
+
+        // Only pure colors, whose non-zero channels are all equal, are dyed
+        if ((r != 0 && r != cmax) | (g != 0 && g != cmax) |
+            (b != 0 && b != cmax) | (cmax == 0))
+        {
+            continue;
+        }
+
+        const unsigned int *table =
+            mTables[((r != 0) | ((g != 0) << 1) | ((b != 0) << 2)) - 1];
+
+        if (table)
+            *pixels = table[cmax] | (pixel & 255);
+    }
+}
+
 void Dye::instantiate(std::string &target, const std::string &palettes)
 {
     std::string::size_type next_pos = target.find('|');
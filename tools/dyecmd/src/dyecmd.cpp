@@ -19,7 +19,11 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <vector>
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
 
@@ -36,8 +40,9 @@ using namespace std;
 #define INVALID_INPUT_IMAGE     101
 #define INVALID_OUTPUT_IMAGE    102
 #define INVALID_DYE_PARAMETER   105
+#define BENCHMARK_MISMATCH      106
 
-SDL_Surface* recolor(SDL_Surface* tmpImage, Dye* dye)
+SDL_Surface* convertToRGBA(SDL_Surface* tmpImage)
 {
     SDL_PixelFormat rgba;
     rgba.palette = NULL;
@@ -50,11 +55,19 @@ SDL_Surface* recolor(SDL_Surface* tmpImage, Dye* dye)
     rgba.colorkey = 0;
     rgba.alpha = 255;
 
-    SDL_Surface *surf = SDL_ConvertSurface(tmpImage, &rgba, SDL_SWSURFACE);
-    //SDL_FreeSurface(tmpImage);
+    return SDL_ConvertSurface(tmpImage, &rgba, SDL_SWSURFACE);
+}
+
+void dyePixels(Uint32* pixels, int count, Dye* dye)
+{
+    dye->update(pixels, count);
+}
 
-    Uint32 *pixels = static_cast< Uint32 * >(surf->pixels);
-    for (Uint32 *p_end = pixels + surf->w * surf->h; pixels != p_end; ++pixels)
+// The per-pixel recoloring the table based kernel replaced, kept around
+// as the reference for the benchmark
+void dyePixelsReference(Uint32* pixels, int count, Dye* dye)
+{
+    for (Uint32 *p_end = pixels + count; pixels != p_end; ++pixels)
     {
         int alpha = *pixels & 255;
         if (!alpha) continue;
@@ -65,17 +78,98 @@ SDL_Surface* recolor(SDL_Surface* tmpImage, Dye* dye)
         dye->update(v);
         *pixels = (v[0] << 24) | (v[1] << 16) | (v[2] << 8) | alpha;
     }
+}
+
+SDL_Surface* recolor(SDL_Surface* tmpImage, Dye* dye)
+{
+    SDL_Surface *surf = convertToRGBA(tmpImage);
+
+    Uint8 *row = static_cast< Uint8 * >(surf->pixels);
+    for (int y = 0; y < surf->h; ++y, row += surf->pitch)
+        dyePixels(reinterpret_cast< Uint32 * >(row), surf->w, dye);
 
     return surf;
 }
 
+/**
+ * Dyes the image the given number of times with both the reference and the
+ * table based kernel, printing their speed and whether they agree.
+ */
+int benchmark(SDL_Surface* source, Dye* dye, int iterations)
+{
+    SDL_Surface *surf = convertToRGBA(source);
+    const int count = surf->w * surf->h;
+
+    vector<Uint32> original(count), reference(count), result(count);
+    for (int y = 0; y < surf->h; ++y)
+    {
+        memcpy(&original[y * surf->w],
+               static_cast< Uint8 * >(surf->pixels) + y * surf->pitch,
+               surf->w * 4);
+    }
+    SDL_FreeSurface(surf);
+
+    void (*kernels[2])(Uint32*, int, Dye*) =
+        { dyePixelsReference, dyePixels };
+    const char *names[2] = { "reference", "table" };
+    vector<Uint32> *outputs[2] = { &reference, &result };
+
+    for (int k = 0; k < 2; ++k)
+    {
+        vector<Uint32> &pixels = *outputs[k];
+        clock_t start = clock();
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            memcpy(&pixels[0], &original[0], count * 4);
+            kernels[k](&pixels[0], count, dye);
+        }
+
+        double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        double mpixels = (double) count * iterations / 1000000.0;
+
+        cout << names[k] << ": " << mpixels << " MPixels in " << seconds
+             << " s, ";
+        if (seconds > 0)
+            cout << mpixels / seconds << " MPixels/s" << endl;
+        else
+            cout << "too fast to measure" << endl;
+    }
+
+    if (reference != result)
+    {
+        cout << "results differ" << endl;
+        return BENCHMARK_MISMATCH;
+    }
+
+    cout << "results are identical" << endl;
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
     Dye* dye = NULL;
     SDL_Surface* source = NULL;
+    int iterations = 0;
+    const char* sourceFile;
+    const char* targetFile = NULL;
+    const char* dyeString;
 
+    if (argc == 4)
+    {
+        sourceFile = argv[1];
+        targetFile = argv[2];
+        dyeString = argv[3];
+    }
+    // benchmark mode: dyecmd -b <count> <source_image> <dye_string>
+    else if (argc == 5 && !strcmp(argv[1], "-b") && atoi(argv[2]) > 0)
+    {
+        iterations = atoi(argv[2]);
+        sourceFile = argv[3];
+        dyeString = argv[4];
+    }
     // not enough or to many parameters
-    if (argc != 4)
+    else
     {
         cout << INVALID_PARAMETER_LIST << " - INVALID_PARAMETER_LIST";
         exit(INVALID_PARAMETER_LIST);
@@ -83,7 +177,7 @@ int main(int argc, char* argv[])
 
     try
     {
-        dye = new Dye(argv[3]);
+        dye = new Dye(dyeString);
     }
     catch (exception &e)
     {
@@ -93,7 +187,7 @@ int main(int argc, char* argv[])
 
     try
     {
-        source = IMG_Load(argv[1]);
+        source = IMG_Load(sourceFile);
         if (!source)
         {
             throw;
@@ -105,9 +199,17 @@ int main(int argc, char* argv[])
         exit(INVALID_INPUT_IMAGE);
     }
 
+    if (iterations > 0)
+    {
+        int result = benchmark(source, dye, iterations);
+        SDL_FreeSurface(source);
+        delete dye;
+        return result;
+    }
+
     SDL_Surface* target = recolor(source, dye);
 
-    if (!ImageWriter::writePNG(target, argv[2]))
+    if (!ImageWriter::writePNG(target, targetFile))
     {
         cout << INVALID_OUTPUT_IMAGE << " - INVALID_OUTPUT_IMAGE";
         exit(INVALID_OUTPUT_IMAGE);
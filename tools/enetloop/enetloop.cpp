@@ -0,0 +1,156 @@
+/*
+ *  ENetLoop
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <enet/enet.h>
+
+/** Maximum number of connected clients */
+static const int MAX_CLIENTS = 16;
+
+static void printUsage()
+{
+    std::cerr << "Usage: enetloop [port] [packets per second] [message id] "
+                 "[packet size]" << std::endl
+              << "    Echoes received packets, and floods the clients with "
+                 "the given packets" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 5 || (argc > 1 && !strcmp(argv[1], "-h")))
+    {
+        printUsage();
+        return 1;
+    }
+
+    const int port = argc > 1 ? atoi(argv[1]) : 9601;
+    const int rate = argc > 2 ? atoi(argv[2]) : 0;
+    const int id = argc > 3 ? strtol(argv[3], NULL, 0) : 0;
+    const int size = argc > 4 ? atoi(argv[4]) : 2;
+
+    if (size < 2)
+    {
+        std::cerr << "Packets need room for the message id" << std::endl;
+        return 1;
+    }
+
+    if (enet_initialize())
+    {
+        std::cerr << "Failed to initialize ENet" << std::endl;
+        return 1;
+    }
+
+    ENetAddress address;
+    address.host = ENET_HOST_ANY;
+    address.port = port;
+
+    ENetHost *server = enet_host_create(&address, MAX_CLIENTS, 0, 0);
+    if (!server)
+    {
+        std::cerr << "Failed to listen on port " << port << std::endl;
+        enet_deinitialize();
+        return 1;
+    }
+
+    std::cout << "Listening on port " << port << std::endl;
+
+    std::vector<ENetPeer*> clients;
+    std::vector<enet_uint8> floodData(size, 0);
+    const enet_uint16 netId = ENET_HOST_TO_NET_16(id);
+    memcpy(&floodData[0], &netId, 2);
+
+    unsigned long received = 0, sent = 0;
+    double floodDebt = 0.0;
+    enet_uint32 lastTime = enet_time_get();
+    enet_uint32 lastReport = lastTime;
+
+    for (;;)
+    {
+        ENetEvent event;
+
+        while (enet_host_service(server, &event, 1) > 0)
+        {
+            switch (event.type)
+            {
+                case ENET_EVENT_TYPE_CONNECT:
+                    std::cout << "Client connected" << std::endl;
+                    clients.push_back(event.peer);
+                    break;
+
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    std::cout << "Client disconnected" << std::endl;
+                    for (std::vector<ENetPeer*>::iterator i = clients.begin();
+                         i != clients.end(); ++i)
+                    {
+                        if (*i == event.peer)
+                        {
+                            clients.erase(i);
+                            break;
+                        }
+                    }
+                    break;
+
+                case ENET_EVENT_TYPE_RECEIVE:
+                    // The packet is passed back as is
+                    received++;
+                    if (enet_peer_send(event.peer, 0, event.packet) < 0)
+                        enet_packet_destroy(event.packet);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        const enet_uint32 now = enet_time_get();
+
+        if (rate > 0 && !clients.empty())
+        {
+            floodDebt += (now - lastTime) * rate / 1000.0;
+
+            for (; floodDebt >= 1.0; floodDebt -= 1.0)
+            {
+                ENetPacket *packet = enet_packet_create(
+                        &floodData[0], size, ENET_PACKET_FLAG_RELIABLE);
+                enet_host_broadcast(server, 0, packet);
+                sent++;
+            }
+        }
+        lastTime = now;
+
+        if (now - lastReport >= 5000)
+        {
+            std::cout << clients.size() << " clients, " << received
+                      << " packets echoed, " << sent << " packets flooded"
+                      << std::endl;
+            lastReport = now;
+        }
+    }
+
+    enet_host_destroy(server);
+    enet_deinitialize();
+
+    return 0;
+}
@@ -0,0 +1,514 @@
+/*
+ *  LayerBench
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "maplayer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+SDL_Surface *SDL_CreateRGBSurface(Uint32, int width, int height, int,
+                                  Uint32, Uint32, Uint32, Uint32)
+{
+    SDL_Surface *surface = new SDL_Surface;
+    surface->w = width;
+    surface->h = height;
+    surface->pitch = width * 4;
+    surface->pixels = new Uint32[width * height];
+    return surface;
+}
+
+int SDL_FillRect(SDL_Surface *surface, void *, Uint32 color)
+{
+    Uint32 *pixels = (Uint32*) surface->pixels;
+    fill(pixels, pixels + surface->w * surface->h, color);
+    return 0;
+}
+
+void SDL_FreeSurface(SDL_Surface *surface)
+{
+    delete[] (Uint32*) surface->pixels;
+    delete surface;
+}
+
+Image::Image(int width, int height):
+    mWidth(width), mHeight(height),
+    mHasAlphaChannel(true),
+    mPixels(width * height, 0)
+{
+}
+
+Image::~Image()
+{
+}
+
+Image *Image::load(SDL_Surface *surface)
+{
+    Image *image = new Image(surface->w, surface->h);
+    const Uint32 *pixels = (const Uint32*) surface->pixels;
+    copy(pixels, pixels + surface->w * surface->h, image->mPixels.begin());
+
+    image->mHasAlphaChannel = false;
+    for (int i = 0; i < surface->w * surface->h; i++)
+    {
+        if (pixels[i] >> 24 != 255)
+        {
+            image->mHasAlphaChannel = true;
+            break;
+        }
+    }
+
+    return image;
+}
+
+void Image::SDLdrawOnto(SDL_Surface *target, int x, int y) const
+{
+    for (int row = 0; row < mHeight; row++)
+    {
+        const int ty = y + row;
+        if (ty < 0 || ty >= target->h)
+            continue;
+
+        Uint32 *dst = (Uint32*) target->pixels + ty * target->w;
+
+        for (int col = 0; col < mWidth; col++)
+        {
+            const int tx = x + col;
+            if (tx < 0 || tx >= target->w)
+                continue;
+
+            const Uint32 pixel = mPixels[row * mWidth + col];
+            const int a = pixel >> 24;
+            if (a == 0)
+                continue;
+            if (a == 255)
+            {
+                dst[tx] = pixel;
+                continue;
+            }
+
+            // Source over destination, with straight alpha
+            const Uint32 d = dst[tx];
+            const int da = d >> 24;
+            const int dstWeight = da * (255 - a) / 255;
+            const int outA = a + dstWeight;
+            Uint32 out = (Uint32) outA << 24;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                const int s = (pixel >> shift) & 0xFF;
+                const int dc = (d >> shift) & 0xFF;
+                out |= (Uint32) ((s * a + dc * dstWeight) / outA) << shift;
+            }
+            dst[tx] = out;
+        }
+    }
+}
+
+Graphics::Graphics(int width, int height):
+    mWidth(width), mHeight(height),
+    mPixels(width * height, 0xFF000000),
+    mDrawCount(0)
+{
+}
+
+bool Graphics::drawImage(Image *image, int x, int y)
+{
+    ++mDrawCount;
+
+    // Clip to the screen
+    const int startCol = max(0, -x);
+    const int startRow = max(0, -y);
+    const int endCol = min(image->getWidth(), mWidth - x);
+    const int endRow = min(image->getHeight(), mHeight - y);
+
+    if (startCol >= endCol)
+        return true;
+
+    const Uint32 *pixels = image->getPixels();
+
+    if (!image->hasAlphaChannel())
+    {
+        for (int row = startRow; row < endRow; row++)
+        {
+            const Uint32 *src = pixels + row * image->getWidth();
+            copy(src + startCol, src + endCol,
+                 &mPixels[(y + row) * mWidth + x + startCol]);
+        }
+        return true;
+    }
+
+    for (int row = startRow; row < endRow; row++)
+    {
+        const Uint32 *src = pixels + row * image->getWidth();
+        Uint32 *dst = &mPixels[(y + row) * mWidth + x];
+
+        for (int col = startCol; col < endCol; col++)
+        {
+            const Uint32 s = src[col];
+            const Uint32 a = s >> 24;
+            if (a == 0)
+                continue;
+            if (a == 255)
+            {
+                dst[col] = (dst[col] & 0xFF000000) | (s & 0xFFFFFF);
+                continue;
+            }
+
+            // Blend like SDL does, keeping the alpha of the screen
+            const Uint32 d = dst[col];
+            Uint32 s1 = s & 0xFF00FF;
+            Uint32 d1 = d & 0xFF00FF;
+            d1 = (d1 + ((s1 - d1) * a >> 8)) & 0xFF00FF;
+            Uint32 s2 = s & 0xFF00;
+            Uint32 d2 = d & 0xFF00;
+            d2 = (d2 + ((s2 - d2) * a >> 8)) & 0xFF00;
+            dst[col] = d1 | d2 | (d & 0xFF000000);
+        }
+    }
+
+    return true;
+}
+
+void Graphics::clear()
+{
+    fill(mPixels.begin(), mPixels.end(), 0xFF000000);
+}
+
+static unsigned int randomSeed = 1;
+
+static int nextRandom()
+{
+    randomSeed = randomSeed * 1103515245 + 12345;
+    return (randomSeed >> 16) & 0x7FFF;
+}
+
+/**
+ * Creates a tile image. Opaque tiles are filled with noise, others get a
+ * transparent border and a half transparent edge around an opaque middle,
+ * like the overlay tiles of the shipped maps.
+ */
+static Image *createTile(int width, int height, bool opaque)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                                32, 0, 0, 0, 0);
+    Uint32 *pixels = (Uint32*) surface->pixels;
+
+    const Uint32 color = (nextRandom() << 8 | nextRandom()) & 0xFFFFFF;
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const int edge = min(min(x, width - 1 - x),
+                                 min(y, height - 1 - y));
+            Uint32 alpha = 255;
+            if (!opaque)
+                alpha = edge < 3 ? 0 : (edge < 6 ? 128 : 255);
+
+            const Uint32 noise = nextRandom() & 0x1F;
+            pixels[x + y * width] =
+                alpha << 24 | ((color + noise * 0x010101) & 0xFFFFFF);
+        }
+    }
+
+    Image *image = Image::load(surface);
+    SDL_FreeSurface(surface);
+    return image;
+}
+
+/**
+ * The tiles of a synthetic map, set on the layers the same way by both
+ * drawing methods.
+ */
+struct Scene
+{
+    int width, height;
+    std::vector<Image*> groundTiles;
+    std::vector<Image*> overlayTiles;
+    std::vector<Image*> frames[2];
+
+    std::vector<int> ground;            /**< Index of the ground tile */
+    std::vector<int> overlay;           /**< Index of the overlay tile */
+    std::vector<int> animatedGround;    /**< Animated ground tiles */
+    std::vector<int> animatedOverlay;   /**< Animated overlay tiles */
+};
+
+static void createScene(Scene &scene, int width, int height, int animated)
+{
+    scene.width = width;
+    scene.height = height;
+
+    for (int i = 0; i < 8; i++)
+        scene.groundTiles.push_back(createTile(32, 32, true));
+
+    // Overlay tiles of 32x32, and some tall and wide ones like trees
+    for (int i = 0; i < 8; i++)
+        scene.overlayTiles.push_back(createTile(32, 32, false));
+    for (int i = 0; i < 4; i++)
+        scene.overlayTiles.push_back(createTile(64, 96, false));
+
+    for (int f = 0; f < 2; f++)
+    {
+        scene.frames[f].push_back(createTile(32, 32, true));
+        scene.frames[f].push_back(createTile(32, 32, false));
+    }
+
+    for (int i = 0; i < width * height; i++)
+    {
+        scene.ground.push_back(nextRandom() % 8);
+
+        const int r = nextRandom() % 100;
+        scene.overlay.push_back(r < 15 ? r % 8 : (r < 18 ? 8 + r % 4 : -1));
+
+        // Animated tiles in groups, like water and torches
+        if (nextRandom() % 1000 < animated)
+        {
+            for (int j = 0; j < 4 && i + j < width * height; j++)
+                scene.animatedGround.push_back(i + j);
+        }
+        if (nextRandom() % 1000 < animated / 4)
+            scene.animatedOverlay.push_back(i);
+    }
+
+    // Put a tree in front of each animated overlay tile, which has to be
+    // drawn over it
+    for (unsigned int i = 0; i < scene.animatedOverlay.size(); i++)
+    {
+        const int below = scene.animatedOverlay[i] + width;
+        if (below < width * height)
+            scene.overlay[below] = 8 + nextRandom() % 4;
+    }
+}
+
+static void deleteScene(Scene &scene)
+{
+    for (unsigned int i = 0; i < scene.groundTiles.size(); i++)
+        delete scene.groundTiles[i];
+    for (unsigned int i = 0; i < scene.overlayTiles.size(); i++)
+        delete scene.overlayTiles[i];
+    for (int f = 0; f < 2; f++)
+    {
+        for (unsigned int i = 0; i < scene.frames[f].size(); i++)
+            delete scene.frames[f][i];
+    }
+}
+
+/**
+ * Sets the tiles of the scene on the layers, like the map reader does.
+ */
+static void setTiles(const Scene &scene, MapLayer &ground, MapLayer &overlay)
+{
+    for (int i = 0; i < scene.width * scene.height; i++)
+    {
+        ground.setTile(i, scene.groundTiles[scene.ground[i]]);
+        if (scene.overlay[i] >= 0)
+            overlay.setTile(i, scene.overlayTiles[scene.overlay[i]]);
+    }
+
+    for (unsigned int i = 0; i < scene.animatedGround.size(); i++)
+    {
+        ground.setTile(scene.animatedGround[i], scene.frames[0][0]);
+        ground.setAnimated(scene.animatedGround[i]);
+    }
+    for (unsigned int i = 0; i < scene.animatedOverlay.size(); i++)
+    {
+        overlay.setTile(scene.animatedOverlay[i], scene.frames[0][1]);
+        overlay.setAnimated(scene.animatedOverlay[i]);
+    }
+}
+
+/**
+ * Shows the next frame of the animated tiles, like TileAnimation does.
+ */
+static void animate(const Scene &scene, MapLayer &ground, MapLayer &overlay,
+                    int frame)
+{
+    for (unsigned int i = 0; i < scene.animatedGround.size(); i++)
+        ground.setTile(scene.animatedGround[i], scene.frames[frame][0]);
+    for (unsigned int i = 0; i < scene.animatedOverlay.size(); i++)
+        overlay.setTile(scene.animatedOverlay[i], scene.frames[frame][1]);
+}
+
+/**
+ * Draws a layer tile by tile, as in Map::draw but also taking the tiles that
+ * stick out from the left of the screen, so that the result can be compared
+ * with drawing the prerendered chunks.
+ */
+static void drawTiles(MapLayer &layer, Graphics &graphics,
+                      int scrollX, int scrollY)
+{
+    static const MapSprites sprites;
+
+    const int startX = max(0, scrollX / 32 - 1);
+    const int startY = scrollY / 32;
+    const int endX = (graphics.getWidth() + scrollX + 31) / 32;
+    const int endY = (graphics.getHeight() + scrollY + 31 + 96 - 32) / 32;
+
+    layer.draw(&graphics, startX, startY, endX, endY,
+               scrollX, scrollY, sprites);
+}
+
+/**
+ * Returns whether any pixel differs by more than a few steps of rounding in
+ * any color component.
+ */
+static bool differs(const std::vector<Uint32> &a, const std::vector<Uint32> &b)
+{
+    for (unsigned int i = 0; i < a.size(); i++)
+    {
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            const int ca = (a[i] >> shift) & 0xFF;
+            const int cb = (b[i] >> shift) & 0xFF;
+            if (abs(ca - cb) > 3)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static void printResult(const char *name, clock_t time, long draws,
+                        int frames)
+{
+    cout << name << ": " << (double) time / CLOCKS_PER_SEC * 1000.0 / frames
+         << " ms per frame, " << (double) draws / frames
+         << " images drawn per frame" << endl;
+}
+
+static void printUsage()
+{
+    cerr << "Usage: layerbench [-s map size] [-f frames] [-v scroll speed] "
+            "[-a animated per mille] [-w width] [-h height]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int size = 100;
+    int frames = 1000;
+    int speed = 2;
+    int animated = 10;
+    int width = 800;
+    int height = 600;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || !argv[i][1] || argv[i][2] || i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+
+        const int value = atoi(argv[++i]);
+
+        switch (argv[i - 1][1])
+        {
+            case 's': size = value; break;
+            case 'f': frames = value; break;
+            case 'v': speed = value; break;
+            case 'a': animated = value; break;
+            case 'w': width = value; break;
+            case 'h': height = value; break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    if (size * 32 <= width || size * 32 <= height || frames <= 0)
+    {
+        cerr << "The map has to be larger than the screen" << endl;
+        return 1;
+    }
+
+    Scene scene;
+    createScene(scene, size, size, animated);
+
+    cout << size << "x" << size << " map, " << width << "x" << height
+         << " screen, 2 layers, " << scene.animatedGround.size() << " + "
+         << scene.animatedOverlay.size() << " animated tiles, view moving "
+         << speed << " pixels per frame, " << frames << " frames" << endl;
+
+    // Both ways of drawing get their own layers, since drawing the chunks
+    // keeps state in the layers
+    MapLayer ground(0, 0, size, size, false);
+    MapLayer overlay(0, 0, size, size, false);
+    MapLayer chunkGround(0, 0, size, size, false);
+    MapLayer chunkOverlay(0, 0, size, size, false);
+    setTiles(scene, ground, overlay);
+    setTiles(scene, chunkGround, chunkOverlay);
+
+    Graphics tileGraphics(width, height);
+    Graphics chunkGraphics(width, height);
+
+    const int maxScrollX = size * 32 - width;
+    const int maxScrollY = size * 32 - height;
+    int scrollX = 0, scrollY = 0;
+    int dx = speed, dy = speed / 2;
+
+    clock_t tileTime = 0, chunkTime = 0;
+    int differentFrames = 0;
+
+    for (int f = 0; f < frames; f++)
+    {
+        // Tile animations change their frame a few times per second
+        if (f % 10 == 0)
+        {
+            animate(scene, ground, overlay, (f / 10) % 2);
+            animate(scene, chunkGround, chunkOverlay, (f / 10) % 2);
+        }
+
+        tileGraphics.clear();
+        chunkGraphics.clear();
+
+        clock_t start = clock();
+        drawTiles(ground, tileGraphics, scrollX, scrollY);
+        drawTiles(overlay, tileGraphics, scrollX, scrollY);
+        tileTime += clock() - start;
+
+        start = clock();
+        chunkGround.drawPrerendered(&chunkGraphics, scrollX, scrollY);
+        chunkOverlay.drawPrerendered(&chunkGraphics, scrollX, scrollY);
+        chunkTime += clock() - start;
+
+        if (differs(tileGraphics.getPixels(), chunkGraphics.getPixels()))
+            ++differentFrames;
+
+        // Bounce around the map
+        if (scrollX + dx < 0 || scrollX + dx > maxScrollX) dx = -dx;
+        if (scrollY + dy < 0 || scrollY + dy > maxScrollY) dy = -dy;
+        scrollX += dx;
+        scrollY += dy;
+    }
+
+    printResult("tile by tile", tileTime, tileGraphics.getDrawCount(), frames);
+    printResult("prerendered", chunkTime, chunkGraphics.getDrawCount(),
+                frames);
+    cout << differentFrames << " frames differ" << endl;
+
+    deleteScene(scene);
+    return differentFrames > 0 ? 1 : 0;
+}
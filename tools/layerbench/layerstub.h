@@ -0,0 +1,139 @@
+/*
+ *  LayerBench
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Stand-ins for the parts of SDL, Image, Graphics and Sprite used by the map
+ * layers, so that the map layers can be compiled without the rest of the
+ * client. This header is included before anything else (see the Makefile),
+ * and defines the include guards of the headers it replaces.
+ *
+ * Images are 32-bit ARGB surfaces with straight alpha. Like Image::_SDLload,
+ * Image::load drops the alpha channel of images that are opaque everywhere,
+ * which Graphics::drawImage then copies row by row. Other images are blended
+ * onto the screen like SDL 1.2 blits a surface with per pixel alpha:
+ * transparent pixels are skipped, opaque pixels are copied and the others
+ * are blended, leaving the alpha of the screen untouched.
+ */
+
+#ifndef LAYERSTUB_H
+#define LAYERSTUB_H
+
+#define GRAPHICS_H
+#define IMAGE_H
+#define SPRITE_H
+
+#include <vector>
+
+typedef unsigned char Uint8;
+typedef unsigned int Uint32;
+
+#define SDL_LIL_ENDIAN 1234
+#define SDL_BIG_ENDIAN 4321
+#define SDL_BYTEORDER SDL_LIL_ENDIAN
+#define SDL_SWSURFACE 0
+
+struct SDL_Surface
+{
+    int w, h;
+    int pitch;
+    void *pixels;
+};
+
+SDL_Surface *SDL_CreateRGBSurface(Uint32 flags, int width, int height,
+                                  int depth, Uint32 rmask, Uint32 gmask,
+                                  Uint32 bmask, Uint32 amask);
+
+int SDL_FillRect(SDL_Surface *surface, void *rect, Uint32 color);
+
+void SDL_FreeSurface(SDL_Surface *surface);
+
+class Image
+{
+    public:
+        Image(int width, int height);
+
+        ~Image();
+
+        /**
+         * Creates an image holding a copy of the given surface, which has
+         * an alpha channel when any of its pixels is not opaque.
+         */
+        static Image *load(SDL_Surface *surface);
+
+        int getWidth() const { return mWidth; }
+
+        int getHeight() const { return mHeight; }
+
+        bool hasAlphaChannel() const { return mHasAlphaChannel; }
+
+        Uint32 *getPixels() { return &mPixels[0]; }
+
+        const Uint32 *getPixels() const { return &mPixels[0]; }
+
+        /**
+         * Draws the image onto a surface with an alpha channel, like
+         * Image::SDLdrawOnto of the client.
+         */
+        void SDLdrawOnto(SDL_Surface *target, int x, int y) const;
+
+    private:
+        int mWidth, mHeight;
+        bool mHasAlphaChannel;
+        std::vector<Uint32> mPixels;
+};
+
+class Graphics
+{
+    public:
+        Graphics(int width, int height);
+
+        int getWidth() const { return mWidth; }
+
+        int getHeight() const { return mHeight; }
+
+        bool drawImage(Image *image, int x, int y);
+
+        void clear();
+
+        const std::vector<Uint32> &getPixels() const { return mPixels; }
+
+        int getDrawCount() const { return mDrawCount; }
+
+    private:
+        int mWidth, mHeight;
+        std::vector<Uint32> mPixels;
+        int mDrawCount;
+};
+
+class Sprite
+{
+    public:
+        virtual ~Sprite() {}
+
+        virtual void draw(Graphics *graphics, int offsetX, int offsetY) const
+        {}
+
+        virtual int getPixelY() const { return 0; }
+
+        virtual void setAlpha(float alpha) {}
+};
+
+#endif
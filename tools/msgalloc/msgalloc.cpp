@@ -0,0 +1,181 @@
+/*
+ *  MsgAlloc
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <enet/enet.h>
+
+#include "net/manaserv/messageout.h"
+
+using namespace std;
+
+typedef vector<ENetPacket*> Packets;
+
+static unsigned int randomSeed = 1;
+
+/**
+ * A small deterministic random number generator, so that runs can be
+ * compared.
+ */
+static int nextRandom()
+{
+    randomSeed = randomSeed * 1103515245 + 12345;
+    return (randomSeed >> 16) & 0x7fff;
+}
+
+/**
+ * Writes a message like the ones sent by the client: mostly a few numbers,
+ * like walking and attacking, sometimes a chat line and rarely a long one.
+ */
+static ENetPacket *createMessage()
+{
+    const int kind = nextRandom() % 100;
+
+    ManaServ::MessageOut msg(0x0260);
+
+    if (kind < 80)
+    {
+        msg.writeInt16(nextRandom());
+        msg.writeInt16(nextRandom());
+        msg.writeInt8(nextRandom());
+    }
+    else if (kind < 98)
+    {
+        msg.writeString(string(10 + nextRandom() % 60, 'a'));
+    }
+    else
+    {
+        msg.writeString(string(100 + nextRandom() % 400, 'b'));
+        msg.writeInt32(nextRandom());
+    }
+
+    return msg.createPacket(ENET_PACKET_FLAG_RELIABLE);
+}
+
+/**
+ * Sends messages in ticks, keeping the packets of the last few ticks alive
+ * like ENet does until they are acknowledged.
+ */
+static void send(int count, int perTick, unsigned int ticksInFlight,
+                 deque<Packets> &inFlight)
+{
+    for (int sent = 0; sent < count; )
+    {
+        Packets tick;
+        for (int i = 0; i < perTick && sent < count; ++i, ++sent)
+            tick.push_back(createMessage());
+        inFlight.push_back(tick);
+
+        while (inFlight.size() > ticksInFlight)
+        {
+            const Packets &acknowledged = inFlight.front();
+            for (Packets::const_iterator i = acknowledged.begin(),
+                 i_end = acknowledged.end(); i != i_end; ++i)
+            {
+                enet_packet_destroy(*i);
+            }
+            inFlight.pop_front();
+        }
+    }
+}
+
+static void printUsage()
+{
+    cerr << "Usage: msgalloc [-n messages] [-w warm-up messages] "
+            "[-t messages per tick] [-d ticks in flight]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = 1000000;
+    int warmUp = 100000;
+    int perTick = 10;
+    int ticksInFlight = 5;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2)
+        {
+            printUsage();
+            return 1;
+        }
+
+        const int value = atoi(argv[++i]);
+        switch (argv[i - 1][1])
+        {
+            case 'n': count = value; break;
+            case 'w': warmUp = value; break;
+            case 't': perTick = value; break;
+            case 'd': ticksInFlight = value; break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    if (count < 1 || warmUp < 0 || perTick < 1 || ticksInFlight < 0)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (enet_initialize() != 0)
+    {
+        cerr << "Error: couldn't initialize ENet" << endl;
+        return 1;
+    }
+
+    deque<Packets> inFlight;
+
+    send(warmUp, perTick, ticksInFlight, inFlight);
+    const int warmUpAllocations = ManaServ::MessageOut::getAllocationCount();
+
+    clock_t start = clock();
+    send(count, perTick, ticksInFlight, inFlight);
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    const int allocations =
+        ManaServ::MessageOut::getAllocationCount() - warmUpAllocations;
+
+    send(0, perTick, 0, inFlight);
+    enet_deinitialize();
+
+    cout << warmUpAllocations << " allocations while sending " << warmUp
+         << " messages to warm up, " << allocations << " while sending "
+         << count << " more in " << seconds << " s";
+    if (count > 0)
+        cout << ", " << seconds * 1000000000.0 / count << " ns per message";
+    cout << endl;
+
+    if (allocations > 0)
+    {
+        cerr << "Error: the number of allocations kept increasing" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,538 @@
+/*
+ *  NetReplay
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+#define SMSG_SERVER_VERSION_RESPONSE 0x7531
+
+/** Message lengths, copied from src/net/ea/network.cpp */
+static const short packet_lengths[] = {
+   10,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+// #0x0040
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  50,  3, -1, 55, 17,  3, 37, 46, -1, 23, -1,  3,108,  3,  2,
+    3, 28, 19, 11,  3, -1,  9,  5, 54, 53, 58, 60, 41,  2,  6,  6,
+// #0x0080
+    7,  3,  2,  2,  2,  5, 16, 12, 10,  7, 29, 23, -1, -1, -1,  0,
+    7, 22, 28,  2,  6, 30, -1, -1,  3, -1, -1,  5,  9, 17, 17,  6,
+   23,  6,  6, -1, -1, -1, -1,  8,  7,  6,  7,  4,  7,  0, -1,  6,
+    8,  8,  3,  3, -1,  6,  6, -1,  7,  6,  2,  5,  6, 44,  5,  3,
+// #0x00C0
+    7,  2,  6,  8,  6,  7, -1, -1, -1, -1,  3,  3,  6,  6,  2, 27,
+    3,  4,  4,  2, -1, -1,  3, -1,  6, 14,  3, -1, 28, 29, -1, -1,
+   30, 30, 26,  2,  6, 26,  3,  3,  8, 19,  5,  2,  3,  2,  2,  2,
+    3,  2,  6,  8, 21,  8,  8,  2,  2, 26,  3, -1,  6, 27, 30, 10,
+// #0x0100
+    2,  6,  6, 30, 79, 31, 10, 10, -1, -1,  4,  6,  6,  2, 11, -1,
+   10, 39,  4, 10, 31, 35, 10, 18,  2, 13, 15, 20, 68,  2,  3, 16,
+    6, 14, -1, -1, 21,  8,  8,  8,  8,  8,  2,  2,  3,  4,  2, -1,
+    6, 86,  6, -1, -1,  7, -1,  6,  3, 16,  4,  4,  4,  6, 24, 26,
+// #0x0140
+   22, 14,  6, 10, 23, 19,  6, 39,  8,  9,  6, 27, -1,  2,  6,  6,
+  110,  6, -1, -1, -1, -1, -1,  6, -1, 54, 66, 54, 90, 42,  6, 42,
+   -1, -1, -1, -1, -1, 30, -1,  3, 14,  3, 30, 10, 43, 14,186,182,
+   14, 30, 10,  3, -1,  6,106, -1,  4,  5,  4, -1,  6,  7, -1, -1,
+// #0x0180
+    6,  3,106, 10, 10, 34,  0,  6,  8,  4,  4,  4, 29, -1, 10,  6,
+   90, 86, 24,  6, 30,102,  9,  4,  8,  4, 14, 10,  4,  6,  2,  6,
+    3,  3, 35,  5, 11, 26, -1,  4,  4,  6, 10, 12,  6, -1,  4,  4,
+   11,  7, -1, 67, 12, 18,114,  6,  3,  6, 26, 26, 26, 26,  2,  3,
+// #0x01C0
+    2, 14, 10, -1, 22, 22,  4,  2, 13, 97,  0,  9,  9, 29,  6, 28,
+    8, 14, 10, 35,  6,  8,  4, 11, 54, 53, 60,  2, -1, 47, 33,  6,
+   30,  8, 34, 14,  2,  6, 26,  2, 28, 81,  6, 10, 26,  2, -1, -1,
+   -1, -1, 20, 10, 32,  9, 34, 14,  2,  6, 48, 56, -1,  4,  5, 10,
+// #0x2000
+   26,  0,  0,  0, 18,  0,  0,  0,  0,  0,  0, 19,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+/** Size of the receive buffer, needs to be a power of two */
+static const unsigned int BUFFER_SIZE = 65536;
+
+/**
+ * Stands in for the message handlers. It reads every byte of the messages,
+ * so that the results of the buffers can be compared.
+ */
+struct Handler
+{
+    Handler():
+        messages(0),
+        checksum(0)
+    {}
+
+    void handle(const char *data, unsigned int length)
+    {
+        messages++;
+        for (unsigned int i = 0; i < length; ++i)
+            checksum = checksum * 31 + (unsigned char) data[i];
+    }
+
+    unsigned int messages;
+    unsigned int checksum;
+};
+
+static unsigned int readWord(const char *data)
+{
+    // Words are sent in little endian byte order
+    return (unsigned char) data[0] | ((unsigned char) data[1] << 8);
+}
+
+/**
+ * The receive buffer of the eAthena network before it became a ring: the
+ * rest of the buffer is moved to the front after every handled message, and
+ * the mutex is locked for every step. Copied from the old network.cpp, with
+ * the locks counted instead of taken.
+ */
+class ShiftBuffer
+{
+    public:
+        ShiftBuffer():
+            mInBuffer(new char[BUFFER_SIZE]),
+            mInSize(0),
+            mToSkip(0),
+            mLocks(0)
+        {}
+
+        ~ShiftBuffer()
+        { delete[] mInBuffer; }
+
+        /**
+         * Receives up to the given number of bytes, like the network thread
+         * does. Returns how many bytes fit.
+         */
+        unsigned int receive(const char *data, unsigned int size)
+        {
+            mLocks++;
+            size = min(size, BUFFER_SIZE - mInSize);
+            memcpy(mInBuffer + mInSize, data, size);
+            mInSize += size;
+            return size;
+        }
+
+        void dispatchMessages(Handler &handler)
+        {
+            while (messageReady())
+            {
+                unsigned int length;
+                const char *data = getNextMessage(length);
+                handler.handle(data, length);
+                skip(length);
+            }
+        }
+
+        unsigned int getLocks() const
+        { return mLocks; }
+
+    private:
+        int messageLength() const
+        {
+            int len = -1;
+
+            if (mInSize >= 2)
+            {
+                const int msgId = readWord(mInBuffer);
+                if (msgId == SMSG_SERVER_VERSION_RESPONSE)
+                    len = 10;
+                else
+                    len = packet_lengths[msgId];
+
+                if (len == -1 && mInSize > 4)
+                    len = readWord(mInBuffer + 2);
+            }
+
+            return len;
+        }
+
+        bool messageReady()
+        {
+            mLocks++;
+            return mInSize >= (unsigned int) messageLength();
+        }
+
+        const char *getNextMessage(unsigned int &length)
+        {
+            messageReady();
+            mLocks++;
+            length = messageLength();
+            return mInBuffer;
+        }
+
+        void skip(unsigned int len)
+        {
+            mLocks++;
+            mToSkip += len;
+            if (!mInSize)
+                return;
+
+            if (mInSize >= mToSkip)
+            {
+                mInSize -= mToSkip;
+                memmove(mInBuffer, mInBuffer + mToSkip, mInSize);
+                mToSkip = 0;
+            }
+            else
+            {
+                mToSkip -= mInSize;
+                mInSize = 0;
+            }
+        }
+
+        char *mInBuffer;
+        unsigned int mInSize;
+        unsigned int mToSkip;
+        unsigned int mLocks;
+};
+
+/**
+ * The receive ring of the eAthena network. Copied from network.cpp, with
+ * the locks counted instead of taken.
+ */
+class RingBuffer
+{
+    public:
+        RingBuffer():
+            mInBuffer(new char[BUFFER_SIZE]),
+            mReadPos(0),
+            mWritePos(0),
+            mMessageBuffer(new char[BUFFER_SIZE]),
+            mLocks(0)
+        {}
+
+        ~RingBuffer()
+        {
+            delete[] mInBuffer;
+            delete[] mMessageBuffer;
+        }
+
+        /**
+         * Receives up to the given number of bytes into the free space of
+         * the ring, like the network thread does. Returns how many bytes
+         * fit.
+         */
+        unsigned int receive(const char *data, unsigned int size)
+        {
+            mLocks++;
+            const unsigned int writePos = mWritePos;
+            const unsigned int space = BUFFER_SIZE - (mWritePos - mReadPos);
+
+            const unsigned int offset = writePos & (BUFFER_SIZE - 1);
+            size = min(size, min(space, BUFFER_SIZE - offset));
+            memcpy(mInBuffer + offset, data, size);
+
+            mLocks++;
+            mWritePos += size;
+            return size;
+        }
+
+        void dispatchMessages(Handler &handler)
+        {
+            mLocks++;
+            unsigned int available = mWritePos - mReadPos;
+
+            unsigned int readPos = mReadPos;
+
+            while (available >= 2)
+            {
+                const int msgId = readWord(readPos);
+                int len;
+
+                if (msgId == SMSG_SERVER_VERSION_RESPONSE)
+                    len = 10;
+                else if (msgId < (int) (sizeof(packet_lengths) /
+                                        sizeof(short)))
+                    len = packet_lengths[msgId];
+                else
+                    len = 0;
+
+                if (len == -1)
+                {
+                    if (available < 4)
+                        break;
+                    len = readWord(readPos + 2);
+                }
+
+                // Don't get stuck on messages of unknown length
+                if (len < 2)
+                    len = 2;
+
+                if (available < (unsigned int) len)
+                    break;
+
+                handler.handle(getData(readPos, len), len);
+
+                readPos += len;
+                available -= len;
+            }
+
+            mLocks++;
+            mReadPos = readPos;
+        }
+
+        unsigned int getLocks() const
+        { return mLocks; }
+
+    private:
+        unsigned int readWord(unsigned int pos) const
+        {
+            const unsigned char low = mInBuffer[pos & (BUFFER_SIZE - 1)];
+            const unsigned char high = mInBuffer[(pos + 1) & (BUFFER_SIZE - 1)];
+            return low | (high << 8);
+        }
+
+        const char *getData(unsigned int pos, unsigned int length)
+        {
+            const unsigned int offset = pos & (BUFFER_SIZE - 1);
+
+            if (offset + length <= BUFFER_SIZE)
+                return mInBuffer + offset;
+
+            const unsigned int firstPart = BUFFER_SIZE - offset;
+            memcpy(mMessageBuffer, mInBuffer + offset, firstPart);
+            memcpy(mMessageBuffer + firstPart, mInBuffer, length - firstPart);
+            return mMessageBuffer;
+        }
+
+        char *mInBuffer;
+        unsigned int mReadPos, mWritePos;
+        char *mMessageBuffer;
+        unsigned int mLocks;
+};
+
+/**
+ * Feeds the capture to the buffer in pieces of at most the given receive
+ * size, dispatching the messages after every frame worth of data, or when
+ * the buffer is full.
+ */
+template <class Buffer>
+static void replay(Buffer &buffer, Handler &handler,
+                   const vector<char> &capture,
+                   unsigned int receiveSize, unsigned int frameSize)
+{
+    unsigned int offset = 0;
+    unsigned int received = 0;
+
+    while (offset < capture.size())
+    {
+        const unsigned int size = min(receiveSize,
+                                      (unsigned int) capture.size() - offset);
+        const unsigned int taken = buffer.receive(&capture[offset], size);
+        offset += taken;
+        received += taken;
+
+        if (received >= frameSize || taken < size)
+        {
+            buffer.dispatchMessages(handler);
+            received = 0;
+        }
+    }
+
+    buffer.dispatchMessages(handler);
+}
+
+template <class Buffer>
+static Handler run(const char *name, const vector<char> &capture,
+                   int count, unsigned int receiveSize,
+                   unsigned int frameSize)
+{
+    Handler handler;
+    unsigned int locks = 0;
+
+    clock_t start = clock();
+
+    for (int i = 0; i < count; ++i)
+    {
+        Buffer buffer;
+        replay(buffer, handler, capture, receiveSize, frameSize);
+        locks += buffer.getLocks();
+    }
+
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    cout << name << ": " << handler.messages << " messages in " << seconds
+         << " s";
+    if (seconds > 0)
+    {
+        cout << ", " << (int) (handler.messages / seconds) << " messages/s, "
+             << (double) capture.size() * count / seconds / 1000000.0
+             << " MB/s";
+    }
+    cout << ", " << (double) locks / handler.messages
+         << " mutex locks per message" << endl;
+
+    return handler;
+}
+
+static unsigned int randomSeed = 1;
+
+/**
+ * A small deterministic random number generator, so that generated
+ * captures are the same on every run.
+ */
+static int nextRandom()
+{
+    randomSeed = randomSeed * 1103515245 + 12345;
+    return (randomSeed >> 16) & 0x7fff;
+}
+
+/**
+ * Writes a capture of the given number of messages, mostly being updates
+ * like the ones received on a crowded map.
+ */
+static bool writeCapture(const char *fileName, int messages)
+{
+    // Being visible, monster and player moves, being removal, actions,
+    // name responses and chat
+    static const int ids[] = {
+        0x0078, 0x007b, 0x007b, 0x007b, 0x01da, 0x01da, 0x0080, 0x008a,
+        0x008a, 0x0095, 0x008d
+    };
+    static const int idCount = sizeof(ids) / sizeof(int);
+
+    ofstream file(fileName, ios::out | ios::binary);
+    if (!file)
+        return false;
+
+    vector<char> message;
+
+    for (int i = 0; i < messages; ++i)
+    {
+        const int id = ids[nextRandom() % idCount];
+        int length = packet_lengths[id];
+        if (length == -1)
+            length = 8 + nextRandom() % 80;
+
+        message.resize(length);
+        for (int j = 0; j < length; ++j)
+            message[j] = (char) nextRandom();
+
+        message[0] = (char) (id & 0xff);
+        message[1] = (char) (id >> 8);
+        if (packet_lengths[id] == -1)
+        {
+            message[2] = (char) (length & 0xff);
+            message[3] = (char) (length >> 8);
+        }
+
+        file.write(&message[0], length);
+    }
+
+    return file.good();
+}
+
+static bool readCapture(const char *fileName, vector<char> &capture)
+{
+    ifstream file(fileName, ios::in | ios::binary);
+    if (!file)
+        return false;
+
+    file.seekg(0, ios::end);
+    capture.resize(file.tellg());
+    file.seekg(0, ios::beg);
+
+    if (!capture.empty())
+        file.read(&capture[0], capture.size());
+
+    return file.good();
+}
+
+static void printUsage()
+{
+    cerr << "Usage: netreplay [-n count] [-r receive size] [-f frame size] "
+            "<capture>" << endl
+         << "       netreplay -w <capture> [messages]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && !strcmp(argv[1], "-w"))
+    {
+        const int messages = (argc >= 4) ? atoi(argv[3]) : 100000;
+        if (!writeCapture(argv[2], messages))
+        {
+            cerr << "Error: couldn't write " << argv[2] << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    int count = 10;
+    unsigned int receiveSize = 4096;
+    unsigned int frameSize = 16384;
+
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        const int value = atoi(argv[i + 1]);
+        switch (argv[i][1])
+        {
+            case 'n': count = value; break;
+            case 'r': receiveSize = value; break;
+            case 'f': frameSize = value; break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    if (i + 1 != argc || count < 1 || receiveSize < 1 || frameSize < 1)
+    {
+        printUsage();
+        return 1;
+    }
+
+    vector<char> capture;
+    if (!readCapture(argv[i], capture))
+    {
+        cerr << "Error: couldn't read " << argv[i] << endl;
+        return 1;
+    }
+
+    cout << capture.size() << " bytes, replayed " << count << " times, "
+         << receiveSize << " bytes per receive, " << frameSize
+         << " bytes per frame" << endl;
+
+    const Handler shifted = run<ShiftBuffer>("shifting buffer", capture,
+                                             count, receiveSize, frameSize);
+    const Handler ring = run<RingBuffer>("ring buffer", capture,
+                                         count, receiveSize, frameSize);
+
+    if (shifted.messages != ring.messages ||
+        shifted.checksum != ring.checksum)
+    {
+        cerr << "Error: the buffers delivered different messages" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,547 @@
+/*
+ *  PathBench
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <list>
+#include <queue>
+#include <vector>
+
+#include "map.h"
+#include "pathfinder.h"
+
+using namespace std;
+
+static const int basicCost = 100;
+static const int diagonalCost = basicCost * 362 / 256;
+
+/**
+ * A synthetic map: the blockmask of each tile and the number of beings
+ * standing on it. The beings are also kept in a list, the way the being
+ * manager held them.
+ */
+struct Grid
+{
+    int width, height;
+    vector<MetaTile> tiles;
+    vector<int> beings;
+    list<Position> beingList;
+
+    bool walkable(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width && y < height &&
+               !(tiles[x + y * width].blockmask & Map::BLOCKMASK_WALL);
+    }
+};
+
+struct Search
+{
+    int startX, startY, destX, destY;
+};
+
+/**
+ * Small deterministic random number generator, so that runs can be compared.
+ */
+static unsigned int randomState = 12345;
+
+static int nextRandom(int range)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) % range;
+}
+
+/**
+ * The A* search the client used before, with its state stored in each tile
+ * and duplicate entries pushed on a priority queue. Kept as the reference
+ * for the benchmark.
+ */
+class ReferenceSearch
+{
+    public:
+        ReferenceSearch(const Grid &grid):
+            mGrid(grid),
+            mTiles(grid.width * grid.height),
+            mOnOpenList(1), mOnClosedList(2),
+            mExpanded(0)
+        {
+            for (int i = 0; i < (int) mTiles.size(); ++i)
+            {
+                mTiles[i].whichList = 0;
+                mTiles[i].blockmask = grid.tiles[i].blockmask;
+            }
+        }
+
+        int getExpandedCount() const { return mExpanded; }
+
+        Path findPath(int startX, int startY, int destX, int destY,
+                      unsigned char walkmask, int maxCost);
+
+    private:
+        struct Tile
+        {
+            int Fcost;
+            int Gcost;
+            int Hcost;
+            int whichList;
+            int parentX;
+            int parentY;
+            unsigned char blockmask;
+        };
+
+        struct Location
+        {
+            Location(int px, int py, Tile *ptile):
+                x(px), y(py), tile(ptile)
+            {}
+
+            bool operator< (const Location &loc) const
+            {
+                return tile->Fcost > loc.tile->Fcost;
+            }
+
+            int x, y;
+            Tile *tile;
+        };
+
+        bool contains(int x, int y) const
+        {
+            return x >= 0 && y >= 0 && x < mGrid.width && y < mGrid.height;
+        }
+
+        Tile *getTile(int x, int y)
+        {
+            return &mTiles[x + y * mGrid.width];
+        }
+
+        /**
+         * Walks all beings, as Map::occupied did before the map counted
+         * the beings on each tile.
+         */
+        bool occupied(int x, int y) const
+        {
+            for (list<Position>::const_iterator i = mGrid.beingList.begin(),
+                 i_end = mGrid.beingList.end(); i != i_end; ++i)
+            {
+                if (i->x == x && i->y == y)
+                    return true;
+            }
+            return false;
+        }
+
+        const Grid &mGrid;
+        vector<Tile> mTiles;
+        int mOnOpenList, mOnClosedList;
+        int mExpanded;
+};
+
+Path ReferenceSearch::findPath(int startX, int startY, int destX, int destY,
+                               unsigned char walkmask, int maxCost)
+{
+    Path path;
+    priority_queue<Location> openList;
+    mExpanded = 0;
+
+    if (!contains(destX, destY) || (getTile(destX, destY)->blockmask & walkmask))
+        return path;
+
+    Tile *startTile = getTile(startX, startY);
+    startTile->Gcost = 0;
+    openList.push(Location(startX, startY, startTile));
+
+    bool foundPath = false;
+
+    while (!openList.empty() && !foundPath)
+    {
+        Location curr = openList.top();
+        openList.pop();
+
+        if (curr.tile->whichList == mOnClosedList)
+            continue;
+
+        curr.tile->whichList = mOnClosedList;
+        ++mExpanded;
+
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                const int x = curr.x + dx;
+                const int y = curr.y + dy;
+
+                if ((dx == 0 && dy == 0) || !contains(x, y))
+                    continue;
+
+                Tile *newTile = getTile(x, y);
+
+                if (newTile->whichList == mOnClosedList ||
+                    ((newTile->blockmask & walkmask)
+                     && !(x == destX && y == destY)))
+                    continue;
+
+                if (dx != 0 && dy != 0)
+                {
+                    Tile *t1 = getTile(curr.x, curr.y + dy);
+                    Tile *t2 = getTile(curr.x + dx, curr.y);
+
+                    if ((t1->blockmask | t2->blockmask) & Map::BLOCKMASK_WALL)
+                        continue;
+                }
+
+                int Gcost = curr.tile->Gcost +
+                    (dx == 0 || dy == 0 ? basicCost : diagonalCost);
+
+                if (dx == 0 || dy == 0)
+                    ++Gcost;
+
+                if (occupied(x, y))
+                    Gcost += 3 * basicCost;
+
+                if (Gcost > maxCost * basicCost)
+                    continue;
+
+                if (newTile->whichList != mOnOpenList)
+                {
+                    int hx = std::abs(x - destX), hy = std::abs(y - destY);
+                    newTile->Hcost = std::abs(hx - hy) * basicCost +
+                        std::min(hx, hy) * diagonalCost;
+
+                    newTile->parentX = curr.x;
+                    newTile->parentY = curr.y;
+                    newTile->Gcost = Gcost;
+                    newTile->Fcost = Gcost + newTile->Hcost;
+
+                    if (x != destX || y != destY)
+                    {
+                        newTile->whichList = mOnOpenList;
+                        openList.push(Location(x, y, newTile));
+                    }
+                    else
+                    {
+                        foundPath = true;
+                    }
+                }
+                else if (Gcost < newTile->Gcost)
+                {
+                    newTile->Gcost = Gcost;
+                    newTile->Fcost = Gcost + newTile->Hcost;
+                    newTile->parentX = curr.x;
+                    newTile->parentY = curr.y;
+                    openList.push(Location(x, y, newTile));
+                }
+            }
+        }
+    }
+
+    mOnClosedList += 2;
+    mOnOpenList += 2;
+
+    if (foundPath)
+    {
+        int pathX = destX;
+        int pathY = destY;
+
+        while (pathX != startX || pathY != startY)
+        {
+            path.push_front(Position(pathX, pathY));
+            Tile *tile = getTile(pathX, pathY);
+            pathX = tile->parentX;
+            pathY = tile->parentY;
+        }
+    }
+
+    return path;
+}
+
+/**
+ * Fills the grid with walls, either scattered over single tiles or as
+ * rectangular obstacles, until the given part of the map is covered.
+ */
+static void generate(Grid &grid, int size, int wallPercentage,
+                     bool obstacles)
+{
+    grid.width = grid.height = size;
+    grid.tiles.assign(size * size, MetaTile());
+    grid.beings.assign(size * size, 0);
+
+    if (!obstacles)
+    {
+        for (int i = 0; i < size * size; ++i)
+        {
+            if (nextRandom(100) < wallPercentage)
+                grid.tiles[i].blockmask = Map::BLOCKMASK_WALL;
+        }
+        return;
+    }
+
+    long walls = 0;
+    while (walls * 100 < (long) size * size * wallPercentage)
+    {
+        const int w = 2 + nextRandom(11);
+        const int h = 2 + nextRandom(11);
+        const int left = nextRandom(size - w + 1);
+        const int top = nextRandom(size - h + 1);
+
+        for (int y = top; y < top + h; ++y)
+        {
+            for (int x = left; x < left + w; ++x)
+            {
+                MetaTile &tile = grid.tiles[x + y * size];
+                if (!tile.blockmask)
+                {
+                    tile.blockmask = Map::BLOCKMASK_WALL;
+                    ++walls;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Puts beings on random walkable tiles.
+ */
+static void addBeings(Grid &grid, int count)
+{
+    while ((int) grid.beingList.size() < count)
+    {
+        const int x = nextRandom(grid.width);
+        const int y = nextRandom(grid.height);
+
+        if (grid.walkable(x, y))
+        {
+            grid.beings[x + y * grid.width]++;
+            grid.beingList.push_back(Position(x, y));
+        }
+    }
+}
+
+/**
+ * Picks searches between walkable tiles at most range tiles apart.
+ */
+static vector<Search> makeSearches(const Grid &grid, int count, int range)
+{
+    vector<Search> searches;
+
+    while ((int) searches.size() < count)
+    {
+        Search s;
+        s.startX = nextRandom(grid.width);
+        s.startY = nextRandom(grid.height);
+        s.destX = s.startX + nextRandom(2 * range + 1) - range;
+        s.destY = s.startY + nextRandom(2 * range + 1) - range;
+
+        if (grid.walkable(s.startX, s.startY) &&
+            grid.walkable(s.destX, s.destY))
+        {
+            searches.push_back(s);
+        }
+    }
+
+    return searches;
+}
+
+static void printResult(const char *name, double seconds, long expanded,
+                        int searches, int found)
+{
+    cout << name << ": " << found << " of " << searches << " paths found, "
+         << expanded << " tiles expanded in " << seconds << " s";
+
+    if (seconds > 0)
+    {
+        cout << ", " << expanded / seconds << " tiles/s, "
+             << seconds * 1000000.0 / searches << " us per search";
+    }
+    cout << endl;
+}
+
+/**
+ * Runs the searches with the jump point search used for long routes.
+ */
+static void runLongRange(PathFinder &finder, const vector<Search> &searches,
+                         int scanLimit)
+{
+    const unsigned char walkmask = Map::BLOCKMASK_WALL;
+    long scanned = 0;
+    int found = 0;
+    int limited = 0;
+    int maxScanned = 0;
+
+    clock_t failedTime = 0;
+    clock_t start = clock();
+
+    for (vector<Search>::const_iterator i = searches.begin(),
+         i_end = searches.end(); i != i_end; ++i)
+    {
+        const clock_t searchStart = clock();
+        Path path = finder.findJumpPointPath(i->startX, i->startY,
+                                             i->destX, i->destY, walkmask);
+        scanned += finder.getScannedCount();
+        maxScanned = max(maxScanned, finder.getScannedCount());
+        if (!path.empty())
+        {
+            ++found;
+            continue;
+        }
+
+        failedTime += clock() - searchStart;
+        if (finder.getScannedCount() > scanLimit)
+            ++limited;
+    }
+
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    const int failed = searches.size() - found;
+
+    cout << "jump points: " << found << " of " << searches.size()
+         << " paths found, " << limited << " searches hit the scan limit, "
+         << scanned << " scan steps (at most " << maxScanned
+         << " in one search) in " << seconds << " s";
+    if (seconds > 0)
+        cout << ", " << seconds * 1000.0 / searches.size() << " ms per search";
+    cout << endl;
+
+    if (failed > 0)
+    {
+        cout << "failed searches took "
+             << (double) failedTime * 1000.0 / CLOCKS_PER_SEC / failed
+             << " ms each" << endl;
+    }
+}
+
+template<typename Finder>
+static void run(const char *name, Finder &finder,
+                const vector<Search> &searches, int maxCost)
+{
+    const unsigned char walkmask = Map::BLOCKMASK_WALL;
+    long expanded = 0;
+    int found = 0;
+
+    clock_t start = clock();
+
+    for (vector<Search>::const_iterator i = searches.begin(),
+         i_end = searches.end(); i != i_end; ++i)
+    {
+        Path path = finder.findPath(i->startX, i->startY, i->destX, i->destY,
+                                    walkmask, maxCost);
+        expanded += finder.getExpandedCount();
+        if (!path.empty())
+            ++found;
+    }
+
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printResult(name, seconds, expanded, searches.size(), found);
+}
+
+static void printUsage()
+{
+    cerr << "Usage: pathbench [-o] [-s size] [-w wall percentage] "
+            "[-n searches] [-r range] [-c max cost] [-b beings]" << endl
+         << "       pathbench -l [-o] [-s size] [-w wall percentage] "
+            "[-n searches] [-b beings] [-m scan limit]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int size = 500;
+    int wallPercentage = 20;
+    int count = 10000;
+    int range = 15;
+    int maxCost = 20;
+    int beings = 0;
+    bool longRange = false;
+    bool obstacles = false;
+    int scanLimit = PathFinder::DEFAULT_SCAN_LIMIT;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-l"))
+        {
+            longRange = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "-o"))
+        {
+            obstacles = true;
+            continue;
+        }
+
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2)
+        {
+            printUsage();
+            return 1;
+        }
+
+        const int value = atoi(argv[++i]);
+        switch (argv[i - 1][1])
+        {
+            case 's': size = value; break;
+            case 'w': wallPercentage = value; break;
+            case 'n': count = value; break;
+            case 'r': range = value; break;
+            case 'c': maxCost = value; break;
+            case 'b': beings = value; break;
+            case 'm': scanLimit = value; break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    if (size < 2 || count < 1 || range < 1 || beings < 0 ||
+        wallPercentage < 0 || wallPercentage > 90)
+    {
+        printUsage();
+        return 1;
+    }
+
+    Grid grid;
+    generate(grid, size, wallPercentage, obstacles);
+    addBeings(grid, beings);
+    // Long routes go from anywhere to anywhere
+    if (longRange)
+        range = size;
+
+    const vector<Search> searches = makeSearches(grid, count, range);
+
+    cout << size << "x" << size << " map, " << wallPercentage << "% "
+         << (obstacles ? "obstacles, " : "walls, ")
+         << beings << " beings, " << count << " searches" << endl;
+
+    PathFinder finder(grid.width, grid.height,
+                      &grid.tiles[0], &grid.beings[0]);
+
+    if (longRange)
+    {
+        // Compare with A* without a cost limit, which is what the jump
+        // point search replaces for long routes
+        finder.setScanLimit(scanLimit);
+        runLongRange(finder, searches, scanLimit);
+        run("A*", finder, searches, size * size);
+        return 0;
+    }
+
+    ReferenceSearch reference(grid);
+    run("reference", reference, searches, maxCost);
+    run("pathfinder", finder, searches, maxCost);
+
+    return 0;
+}